@@ -0,0 +1,269 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "device_caps.h"
+
+/* First word of every SPIR-V module */
+#define SPIRV_MAGIC 0x07230203
+
+/* Find the device the worker and the examples pick: a GPU, or a CPU if
+   there's no GPU or cpu is set. Returns NULL if there's no device */
+cl_device_id create_device(int cpu) {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0)
+      return NULL;
+
+   /* Access a device */
+   err = CL_DEVICE_NOT_FOUND;
+   if(!cpu)
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0)
+      return NULL;
+
+   return dev;
+}
+
+unsigned char* read_file(const char *filename, size_t *size) {
+
+   FILE *handle;
+   unsigned char *buffer;
+
+   handle = fopen(filename, "rb");
+   if(handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(handle, 0, SEEK_END);
+   *size = ftell(handle);
+   rewind(handle);
+   buffer = (unsigned char*)malloc(*size + 1);
+   buffer[*size] = '\0';
+   *size = fread(buffer, 1, *size, handle);
+   fclose(handle);
+   return buffer;
+}
+
+int is_spirv(const unsigned char *data, size_t size) {
+
+   return size >= 4 && data[0] == (SPIRV_MAGIC & 0xff) &&
+         data[1] == ((SPIRV_MAGIC >> 8) & 0xff) &&
+         data[2] == ((SPIRV_MAGIC >> 16) & 0xff) &&
+         data[3] == ((SPIRV_MAGIC >> 24) & 0xff);
+}
+
+/* Build source for one device and return the device binary */
+unsigned char* compile_binary(cl_context ctx, cl_device_id dev,
+      const char *source, const char *options, const char *filename,
+      size_t *size) {
+
+   cl_program program;
+   unsigned char *binary;
+   char *program_log;
+   size_t log_size;
+   cl_int err;
+
+   program = clCreateProgramWithSource(ctx, 1, &source, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   err = clBuildProgram(program, 1, &dev, options, NULL, NULL);
+   if(err < 0) {
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG,
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG,
+            log_size + 1, program_log, NULL);
+      fprintf(stderr, "%s:\n%s\n", filename, program_log);
+      free(program_log);
+      exit(1);
+   }
+
+   /* One device, so one binary */
+   err = clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES,
+         sizeof(*size), size, NULL);
+   if(err < 0 || *size == 0) {
+      fprintf(stderr, "Couldn't read the binary of %s\n", filename);
+      exit(1);
+   }
+   binary = (unsigned char*)malloc(*size);
+   clGetProgramInfo(program, CL_PROGRAM_BINARIES, sizeof(binary),
+         &binary, NULL);
+   clReleaseProgram(program);
+   return binary;
+}
+
+/* Write a C string literal */
+void write_string(FILE *out, const char *s) {
+
+   if(s == NULL) {
+      fprintf(out, "NULL");
+      return;
+   }
+   fputc('"', out);
+   for(; *s != '\0'; s++) {
+      if(*s == '"' || *s == '\\')
+         fputc('\\', out);
+      fputc(*s, out);
+   }
+   fputc('"', out);
+}
+
+void write_image(FILE *out, const char *name, const unsigned char *data,
+      size_t size, int is_il, const char *device_name,
+      const char *driver_version, const char *options) {
+
+   size_t i;
+
+   /* No device to build for: program_load builds from source */
+   if(data == NULL) {
+      fprintf(out, "static const program_image %s_image = {\n"
+            "   NULL, 0, 0, NULL, NULL, NULL\n};\n\n", name);
+      return;
+   }
+
+   fprintf(out, "static const unsigned char %s_data[] = {", name);
+   for(i=0; i<size; i++)
+      fprintf(out, "%s0x%02x%s", i % 12 ? " " : "\n   ", data[i],
+            i + 1 < size ? "," : "");
+   fprintf(out, "\n};\n\nstatic const program_image %s_image = {\n"
+         "   %s_data, sizeof(%s_data), %d,\n   ", name, name, name, is_il);
+   write_string(out, device_name);
+   fprintf(out, ",\n   ");
+   write_string(out, driver_version);
+   fprintf(out, ",\n   ");
+   write_string(out, options);
+   fprintf(out, "\n};\n\n");
+}
+
+int main(int argc, char **argv) {
+
+   cl_device_id device = NULL;
+   cl_context context = NULL;
+   cl_int err;
+   FILE *out = stdout;
+   char options[1024] = "", device_name[256], driver_version[256];
+   char caps_options[2048], *build_options = options;
+   char name[64], *file;
+   unsigned char *data, *binary;
+   size_t size, binary_size, name_len;
+   int cpu = 0, caps = 0, no_device = 0, spirv, i, num_images = 0;
+
+   /* Options before the images */
+   for(i=1; i<argc && argv[i][0] == '-'; i++) {
+      if(strcmp(argv[i], "-cpu") == 0)
+         cpu = 1;
+      else if(strcmp(argv[i], "-caps") == 0)
+         caps = 1;
+      else if(strcmp(argv[i], "-o") == 0 && i+1 < argc) {
+         out = fopen(argv[++i], "w");
+         if(out == NULL) {
+            perror("Couldn't create the header");
+            exit(1);
+         }
+      }
+      else if(strlen(options) + strlen(argv[i]) + 2 < sizeof(options)) {
+         if(options[0] != '\0')
+            strcat(options, " ");
+         strcat(options, argv[i]);
+      }
+   }
+   if(i == argc) {
+      printf("Usage: %s [-cpu] [-caps] [-o header] [build options] "
+            "name=file.cl|name=file.spv ...\n", argv[0]);
+      exit(1);
+   }
+
+   fprintf(out, "/* Generated by cl_precompile. Do not edit */\n"
+         "#include \"program_binary.h\"\n\n");
+
+   for(; i<argc; i++) {
+      file = strchr(argv[i], '=');
+      name_len = file ? (size_t)(file - argv[i]) : 0;
+      if(name_len == 0 || name_len >= sizeof(name)) {
+         fprintf(stderr, "Expected name=file, not %s\n", argv[i]);
+         exit(1);
+      }
+      memcpy(name, argv[i], name_len);
+      name[name_len] = '\0';
+      file++;
+
+      data = read_file(file, &size);
+
+      /* The device is only opened once it's needed. -caps puts the
+         device's capability options in front of the others, as
+         device_caps_options does for the hosts, so it needs the device
+         for every image */
+      spirv = is_spirv(data, size);
+      if(context == NULL && !no_device && (caps || !spirv)) {
+         device = create_device(cpu);
+         if(device == NULL) {
+            fprintf(stderr, "No OpenCL device, the programs will be "
+                  "built from source at startup\n");
+            no_device = 1;
+         }
+         else {
+            clGetDeviceInfo(device, CL_DEVICE_NAME,
+                  sizeof(device_name), device_name, NULL);
+            clGetDeviceInfo(device, CL_DRIVER_VERSION,
+                  sizeof(driver_version), driver_version, NULL);
+            context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+            if(err < 0) {
+               perror("Couldn't create a context");
+               exit(1);
+            }
+            if(caps) {
+               if(device_caps_options(device, options, caps_options,
+                     sizeof(caps_options)) < 0) {
+                  fprintf(stderr, "Couldn't write the build options\n");
+                  exit(1);
+               }
+               build_options = caps_options;
+            }
+         }
+      }
+
+      /* SPIR-V goes in as it is. Source is built for the device */
+      if(no_device && (caps || !spirv))
+         write_image(out, name, NULL, 0, 0, NULL, NULL, NULL);
+      else if(spirv)
+         write_image(out, name, data, size, 1, NULL, NULL, build_options);
+      else {
+         binary = compile_binary(context, device, (const char*)data,
+               build_options, file, &binary_size);
+         write_image(out, name, binary, binary_size, 0, device_name,
+               driver_version, build_options);
+         free(binary);
+      }
+      free(data);
+      num_images++;
+   }
+
+   if(out != stdout)
+      fclose(out);
+   if(context != NULL) {
+      fprintf(stderr, "%d programs precompiled for %s\n", num_images,
+            device_name);
+      clReleaseContext(context);
+   }
+   return 0;
+}
@@ -0,0 +1,136 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "program_binary.h"
+
+/* Create program from a file and compile it */
+static cl_program build_source(cl_context ctx, cl_device_id dev,
+      const char* filename, const char* options) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer, *program_log;
+   size_t program_size, log_size;
+   int err;
+
+   /* Read program file and place content into buffer */
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   /* Create program from file */
+   program = clCreateProgramWithSource(ctx, 1,
+      (const char**)&program_buffer, &program_size, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   free(program_buffer);
+
+   /* Build program */
+   err = clBuildProgram(program, 1, &dev, options, NULL, NULL);
+   if(err < 0) {
+
+      /* Find size of log and print to std output */
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG,
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG,
+            log_size + 1, program_log, NULL);
+      printf("%s\n", program_log);
+      free(program_log);
+      exit(1);
+   }
+
+   return program;
+}
+
+/* Create a program from an embedded image. Returns NULL if the image
+   is for another device or driver or the runtime rejects it */
+static cl_program load_image(cl_context ctx, cl_device_id dev,
+      const program_image *image) {
+
+   cl_program program = NULL;
+   const unsigned char *data = image->data;
+   cl_int err, status;
+   char name[256], version[256];
+
+   if(image->is_il) {
+#ifdef CL_VERSION_2_1
+      program = clCreateProgramWithIL(ctx, image->data, image->size, &err);
+      if(err < 0)
+         return NULL;
+#else
+      return NULL;
+#endif
+   }
+   else {
+
+      /* Binaries are only good for the device and driver that made them */
+      clGetDeviceInfo(dev, CL_DEVICE_NAME, sizeof(name), name, NULL);
+      clGetDeviceInfo(dev, CL_DRIVER_VERSION, sizeof(version), version, NULL);
+      if(strcmp(name, image->device_name) != 0 ||
+            strcmp(version, image->driver_version) != 0)
+         return NULL;
+      program = clCreateProgramWithBinary(ctx, 1, &dev, &image->size,
+            &data, &status, &err);
+      if(err < 0 || status < 0)
+         return NULL;
+   }
+
+   /* Still required, but only finishes what cl_precompile started */
+   err = clBuildProgram(program, 1, &dev, image->options, NULL, NULL);
+   if(err < 0) {
+      clReleaseProgram(program);
+      return NULL;
+   }
+   return program;
+}
+
+/* Whether image was built with options. NULL is the same as none */
+static int same_options(const program_image *image, const char *options) {
+
+   return strcmp(image->options != NULL ? image->options : "",
+         options != NULL ? options : "") == 0;
+}
+
+cl_program program_load_image(cl_context ctx, cl_device_id dev,
+      const program_image *image, const char *options) {
+
+   if(image == NULL || image->size == 0 || !same_options(image, options))
+      return NULL;
+   return load_image(ctx, dev, image);
+}
+
+cl_program program_load(cl_context ctx, cl_device_id dev,
+      const program_image *image, const char *filename,
+      const char *options, int *precompiled) {
+
+   cl_program program;
+
+   program = program_load_image(ctx, dev, image, options);
+   if(precompiled != NULL)
+      *precompiled = (program != NULL);
+   if(program != NULL)
+      return program;
+
+   /* Only a rejected image is worth mentioning. Empty images and other
+      options are expected */
+   if(image != NULL && image->size != 0 && same_options(image, options))
+      printf("Couldn't load the precompiled %s, building from source\n",
+            filename);
+   return build_source(ctx, dev, filename, options);
+}
@@ -0,0 +1,48 @@
+#ifndef PROGRAM_BINARY_H
+#define PROGRAM_BINARY_H
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* A program compiled ahead of time by cl_precompile and embedded in the
+   executable. A device binary only loads on the device and driver it
+   was built for. SPIR-V loads anywhere clCreateProgramWithIL exists.
+   cl_precompile writes images with no data when it finds no device.
+   An image is only used by a program built with the options it was
+   built with, so a host that picks its options at run time falls back
+   to source for any it wasn't precompiled with */
+typedef struct program_image {
+   const unsigned char *data;
+   size_t size;
+   int is_il;
+   const char *device_name;      /* NULL for SPIR-V */
+   const char *driver_version;
+   const char *options;          /* Options the image was built with */
+} program_image;
+
+/* The image cl_precompile wrote as name, when the example's Makefile
+   defines PRECOMPILED and its header is included, and NULL otherwise */
+#ifdef PRECOMPILED
+#define PROGRAM_IMAGE(name) (&name ## _image)
+#else
+#define PROGRAM_IMAGE(name) NULL
+#endif
+
+/* Create and build a program from image, or from the source in filename
+   with options if there's no image, it's empty, it was built with other
+   options or it can't be loaded. precompiled, if not NULL, is set to 1
+   when the image was used. Prints the build log and exits if the source
+   doesn't build */
+cl_program program_load(cl_context ctx, cl_device_id dev,
+      const program_image *image, const char *filename,
+      const char *options, int *precompiled);
+
+/* Only the image: NULL for any of the reasons program_load would build
+   from source. For hosts that build source their own way */
+cl_program program_load_image(cl_context ctx, cl_device_id dev,
+      const program_image *image, const char *options);
+
+#endif
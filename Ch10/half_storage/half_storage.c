@@ -0,0 +1,505 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define REDUCTION_FILE "../reduction/reduction.cl"
+#define TRANSPOSE_FILE "../../Ch12/transpose/transpose.cl"
+#define SPMV_FILE "../../Ch9/PyOpenCL/oclia/sparse.cl"
+#define FFT_FILE "../../Ch14/fft/fft.cl"
+
+/* fft.cl includes device_lib.h and reduction.cl accumulate.h, both from
+   Ch2/program_link */
+#define DEVICE_LIB_OPTION "-I../../Ch2/program_link"
+
+#define NUM_FLOATS (1 << 22)
+#define MATRIX_DIM 2048
+#define NUM_ROWS (1 << 18)
+#define ROW_LENGTH 16
+#define NUM_POINTS (1 << 21)
+#define FFT_SIZE 1024
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "device_caps.h"
+
+/* Each kernel runs once with float storage and once with
+   -DHALF_STORAGE, which stores its data as half and computes in float */
+enum {FP32, FP16, NUM_STORAGE};
+
+static const char *storage_options[NUM_STORAGE] = {
+   DEVICE_LIB_OPTION, DEVICE_LIB_OPTION " -DHALF_STORAGE"
+};
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   }
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);
+   }
+
+   return dev;
+}
+
+/* Round a float to the nearest half, ties to even. Values too small for
+   a normal half become subnormals, values too large infinity */
+cl_half float_to_half(float f) {
+
+   cl_uint bits, sign, mantissa, half, rest, halfway, shift;
+   int exponent;
+
+   memcpy(&bits, &f, sizeof(bits));
+   sign = (bits >> 16) & 0x8000;
+   mantissa = bits & 0x7fffff;
+   if(((bits >> 23) & 0xff) == 0xff)
+      return (cl_half)(sign | 0x7c00 | (mantissa ? 0x200 : 0));
+
+   exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+   if(exponent >= 31)
+      return (cl_half)(sign | 0x7c00);
+   if(exponent <= 0) {
+      if(exponent < -10)
+         return (cl_half)sign;
+      mantissa |= 0x800000;
+      shift = 14 - exponent;
+   }
+   else {
+      mantissa |= (cl_uint)exponent << 23;
+      shift = 13;
+   }
+
+   /* A carry out of the mantissa moves on to the exponent */
+   half = mantissa >> shift;
+   rest = mantissa & ((1u << shift) - 1);
+   halfway = 1u << (shift - 1);
+   if(rest > halfway || (rest == halfway && (half & 1)))
+      half++;
+   return (cl_half)(sign | half);
+}
+
+float half_to_float(cl_half h) {
+
+   cl_uint bits, exponent = (h >> 10) & 0x1f, mantissa = h & 0x3ff;
+   float f;
+
+   if(exponent == 0) {
+      f = ldexpf((float)mantissa, -24);
+      return (h & 0x8000) ? -f : f;
+   }
+   bits = ((cl_uint)(h & 0x8000) << 16) | (mantissa << 13);
+   if(exponent == 31)
+      bits |= 0x7f800000;
+   else
+      bits |= (exponent - 15 + 127) << 23;
+   memcpy(&f, &bits, sizeof(f));
+   return f;
+}
+
+/* A buffer holding n floats, stored as floats or halfs */
+cl_mem create_data(cl_context ctx, const float *data, size_t n,
+      int storage, cl_mem_flags flags) {
+
+   cl_half *halfs;
+   cl_mem buffer;
+   size_t i;
+   cl_int err;
+
+   if(storage == FP32) {
+      buffer = clCreateBuffer(ctx, flags | CL_MEM_COPY_HOST_PTR,
+            n * sizeof(float), (void*)data, &err);
+   }
+   else {
+      halfs = (cl_half*)malloc(n * sizeof(cl_half));
+      for(i=0; i<n; i++)
+         halfs[i] = float_to_half(data[i]);
+      buffer = clCreateBuffer(ctx, flags | CL_MEM_COPY_HOST_PTR,
+            n * sizeof(cl_half), halfs, &err);
+      free(halfs);
+   }
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);
+   }
+   return buffer;
+}
+
+/* Read n floats or halfs back as floats */
+void read_data(cl_command_queue queue, cl_mem buffer, float *data,
+      size_t n, int storage) {
+
+   cl_half *halfs;
+   size_t i;
+   cl_int err;
+
+   if(storage == FP32) {
+      err = clEnqueueReadBuffer(queue, buffer, CL_TRUE, 0,
+            n * sizeof(float), data, 0, NULL, NULL);
+   }
+   else {
+      halfs = (cl_half*)malloc(n * sizeof(cl_half));
+      err = clEnqueueReadBuffer(queue, buffer, CL_TRUE, 0,
+            n * sizeof(cl_half), halfs, 0, NULL, NULL);
+      for(i=0; i<n; i++)
+         data[i] = half_to_float(halfs[i]);
+      free(halfs);
+   }
+   if(err < 0) {
+      perror("Couldn't read the buffer");
+      exit(1);
+   }
+}
+
+cl_kernel create_kernel(cl_context ctx, cl_device_id dev,
+      const char *filename, const char *name, int storage) {
+
+   cl_program program;
+   cl_kernel kernel;
+   cl_int err;
+
+   program = device_caps_build(ctx, dev, filename, storage_options[storage]);
+   kernel = clCreateKernel(program, name, &err);
+   if(err < 0) {
+      printf("Couldn't create the %s kernel: %d\n", name, err);
+      exit(1);
+   }
+
+   /* The kernel keeps its program alive */
+   clReleaseProgram(program);
+   return kernel;
+}
+
+/* The largest power of two up to 256 the kernel accepts */
+size_t group_size(cl_kernel kernel, cl_device_id dev) {
+
+   size_t max_size, size = 256;
+
+   clGetKernelWorkGroupInfo(kernel, dev, CL_KERNEL_WORK_GROUP_SIZE,
+         sizeof(max_size), &max_size, NULL);
+   while(size > max_size)
+      size /= 2;
+   return size;
+}
+
+/* Run a kernel to completion and return its time in ms */
+double run_kernel(cl_command_queue queue, cl_kernel kernel,
+      size_t global_size, size_t local_size) {
+
+   cl_event prof_event;
+   cl_ulong time_start, time_end;
+   cl_int err;
+
+   err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_size,
+         &local_size, 0, NULL, &prof_event);
+   if(err < 0) {
+      printf("Couldn't enqueue the kernel: %d\n", err);
+      exit(1);
+   }
+   clWaitForEvents(1, &prof_event);
+   clGetEventProfilingInfo(prof_event, CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(prof_event, CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+   clReleaseEvent(prof_event);
+   return (time_end - time_start) * 1.0e-6;
+}
+
+/* Largest difference from the fp32 results, relative to their largest
+   magnitude */
+double max_error(const float *result, const float *reference, size_t n) {
+
+   double diff = 0.0, scale = 0.0;
+   size_t i;
+
+   for(i=0; i<n; i++) {
+      diff = fmax(diff, fabs((double)result[i] - reference[i]));
+      scale = fmax(scale, fabs((double)reference[i]));
+   }
+   return scale > 0.0 ? diff/scale : diff;
+}
+
+void report(const char *name, const double *times, double error) {
+
+   printf("%-18s fp32 %8.3f ms   fp16 %8.3f ms   %5.2fx   "
+         "error %.2e\n", name, times[FP32], times[FP16],
+         times[FP32]/times[FP16], error);
+}
+
+/* reduction_vector: the data is read once */
+void reduction_case(cl_context ctx, cl_device_id dev,
+      cl_command_queue queue, const float *data) {
+
+   cl_kernel kernel;
+   cl_mem data_buffer, sum_buffer;
+   size_t local_size, global_size = NUM_FLOATS/4, num_groups, i;
+   float *partials;
+   double sums[NUM_STORAGE], times[NUM_STORAGE];
+   cl_int err;
+   int storage;
+
+   for(storage=0; storage<NUM_STORAGE; storage++) {
+      kernel = create_kernel(ctx, dev, REDUCTION_FILE, "reduction_vector",
+            storage);
+      local_size = group_size(kernel, dev);
+      num_groups = global_size/local_size;
+      data_buffer = create_data(ctx, data, NUM_FLOATS, storage,
+            CL_MEM_READ_ONLY);
+      sum_buffer = clCreateBuffer(ctx, CL_MEM_WRITE_ONLY,
+            num_groups * sizeof(float), NULL, &err);
+      if(err < 0) {
+         perror("Couldn't create a buffer");
+         exit(1);
+      };
+      err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &data_buffer);
+      err |= clSetKernelArg(kernel, 1, local_size * 4 * sizeof(float), NULL);
+      err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &sum_buffer);
+      if(err < 0) {
+         printf("Couldn't set a kernel argument");
+         exit(1);
+      };
+      times[storage] = run_kernel(queue, kernel, global_size, local_size);
+
+      partials = (float*)malloc(num_groups * sizeof(float));
+      read_data(queue, sum_buffer, partials, num_groups, FP32);
+      sums[storage] = 0.0;
+      for(i=0; i<num_groups; i++)
+         sums[storage] += partials[i];
+      free(partials);
+
+      clReleaseMemObject(data_buffer);
+      clReleaseMemObject(sum_buffer);
+      clReleaseKernel(kernel);
+   }
+   report("reduction_vector", times, fabs(sums[FP16] - sums[FP32])/
+         fabs(sums[FP32]));
+}
+
+/* transpose: the matrix is read and written in place */
+void transpose_case(cl_context ctx, cl_device_id dev,
+      cl_command_queue queue, const float *data) {
+
+   cl_kernel kernel;
+   cl_mem data_buffer;
+   size_t local_size, global_size, n = MATRIX_DIM * MATRIX_DIM;
+   cl_uint blocks = MATRIX_DIM/4;
+   float *results[NUM_STORAGE];
+   double times[NUM_STORAGE];
+   cl_int err;
+   int storage;
+
+   /* One work-item per 4x4 block on or above the diagonal, each holding
+      two blocks in local memory */
+   global_size = (blocks * (blocks + 1))/2;
+   for(storage=0; storage<NUM_STORAGE; storage++) {
+      kernel = create_kernel(ctx, dev, TRANSPOSE_FILE, "transpose", storage);
+      local_size = group_size(kernel, dev);
+      while(local_size * 8 * 4 * sizeof(float) >
+            device_caps_get(dev)->local_mem_size)
+         local_size /= 2;
+      data_buffer = create_data(ctx, data, n, storage, CL_MEM_READ_WRITE);
+      err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &data_buffer);
+      err |= clSetKernelArg(kernel, 1, local_size * 8 * 4 * sizeof(float),
+            NULL);
+      err |= clSetKernelArg(kernel, 2, sizeof(blocks), &blocks);
+      if(err < 0) {
+         printf("Couldn't set a kernel argument");
+         exit(1);
+      };
+      times[storage] = run_kernel(queue, kernel, global_size, local_size);
+
+      results[storage] = (float*)malloc(n * sizeof(float));
+      read_data(queue, data_buffer, results[storage], n, storage);
+      clReleaseMemObject(data_buffer);
+      clReleaseKernel(kernel);
+   }
+   report("transpose", times, max_error(results[FP16], results[FP32], n));
+   free(results[FP32]);
+   free(results[FP16]);
+}
+
+/* spmv_csr: half coefficients, int columns and float vectors, so the
+   bytes per nonzero drop from 8 to 6 */
+void spmv_case(cl_context ctx, cl_device_id dev, cl_command_queue queue,
+      const float *data) {
+
+   cl_kernel kernel;
+   cl_mem row_buffer, col_buffer, value_buffer, x_buffer, y_buffer;
+   size_t local_size, global_size, num_values = NUM_ROWS * ROW_LENGTH;
+   int *row_start, *cols, num_rows = NUM_ROWS, i;
+   float *results[NUM_STORAGE];
+   double times[NUM_STORAGE];
+   cl_int err;
+   int storage;
+
+   /* ROW_LENGTH random columns per row. The coefficients are the first
+      part of data and x the part after them */
+   row_start = (int*)malloc((NUM_ROWS + 1) * sizeof(int));
+   cols = (int*)malloc(num_values * sizeof(int));
+   for(i=0; i<=NUM_ROWS; i++)
+      row_start[i] = i * ROW_LENGTH;
+   for(i=0; i<(int)num_values; i++)
+      cols[i] = rand() % NUM_ROWS;
+
+   row_buffer = clCreateBuffer(ctx, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+         (NUM_ROWS + 1) * sizeof(int), row_start, &err);
+   col_buffer = clCreateBuffer(ctx, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+         num_values * sizeof(int), cols, &err);
+   x_buffer = clCreateBuffer(ctx, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+         NUM_ROWS * sizeof(float), (void*)(data + num_values), &err);
+   y_buffer = clCreateBuffer(ctx, CL_MEM_WRITE_ONLY,
+         NUM_ROWS * sizeof(float), NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);
+   };
+
+   for(storage=0; storage<NUM_STORAGE; storage++) {
+      kernel = create_kernel(ctx, dev, SPMV_FILE, "spmv_csr", storage);
+      local_size = group_size(kernel, dev);
+      global_size = (NUM_ROWS + local_size - 1)/local_size * local_size;
+      value_buffer = create_data(ctx, data, num_values, storage,
+            CL_MEM_READ_ONLY);
+      err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &row_buffer);
+      err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &col_buffer);
+      err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &value_buffer);
+      err |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &x_buffer);
+      err |= clSetKernelArg(kernel, 4, sizeof(cl_mem), &y_buffer);
+      err |= clSetKernelArg(kernel, 5, sizeof(num_rows), &num_rows);
+      if(err < 0) {
+         printf("Couldn't set a kernel argument");
+         exit(1);
+      };
+      times[storage] = run_kernel(queue, kernel, global_size, local_size);
+
+      results[storage] = (float*)malloc(NUM_ROWS * sizeof(float));
+      read_data(queue, y_buffer, results[storage], NUM_ROWS, FP32);
+      clReleaseMemObject(value_buffer);
+      clReleaseKernel(kernel);
+   }
+   report("spmv_csr", times, max_error(results[FP16], results[FP32],
+         NUM_ROWS));
+
+   free(row_start);
+   free(cols);
+   free(results[FP32]);
+   free(results[FP16]);
+   clReleaseMemObject(row_buffer);
+   clReleaseMemObject(col_buffer);
+   clReleaseMemObject(x_buffer);
+   clReleaseMemObject(y_buffer);
+}
+
+/* fft_scale: the points are read and written in place. They're scaled
+   as an inverse FFT of FFT_SIZE points would, so the input has that
+   magnitude */
+void scale_case(cl_context ctx, cl_device_id dev, cl_command_queue queue,
+      const float *data) {
+
+   cl_kernel kernel;
+   cl_mem data_buffer;
+   size_t local_size, global_size, n = 2 * NUM_POINTS, i;
+   cl_uint points_per_group, scale = FFT_SIZE;
+   float *points, *results[NUM_STORAGE];
+   double times[NUM_STORAGE];
+   cl_int err;
+   int storage;
+
+   points = (float*)malloc(n * sizeof(float));
+   for(i=0; i<n; i++)
+      points[i] = (2.0f * data[i] - 1.0f) * FFT_SIZE;
+
+   for(storage=0; storage<NUM_STORAGE; storage++) {
+      kernel = create_kernel(ctx, dev, FFT_FILE, "fft_scale", storage);
+      local_size = group_size(kernel, dev);
+      points_per_group = local_size * 16;
+      global_size = NUM_POINTS/points_per_group * local_size;
+      data_buffer = create_data(ctx, points, n, storage, CL_MEM_READ_WRITE);
+      err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &data_buffer);
+      err |= clSetKernelArg(kernel, 1, sizeof(points_per_group),
+            &points_per_group);
+      err |= clSetKernelArg(kernel, 2, sizeof(scale), &scale);
+      if(err < 0) {
+         printf("Couldn't set a kernel argument");
+         exit(1);
+      };
+      times[storage] = run_kernel(queue, kernel, global_size, local_size);
+
+      results[storage] = (float*)malloc(n * sizeof(float));
+      read_data(queue, data_buffer, results[storage], n, storage);
+      clReleaseMemObject(data_buffer);
+      clReleaseKernel(kernel);
+   }
+   report("fft_scale", times, max_error(results[FP16], results[FP32], n));
+
+   free(points);
+   free(results[FP32]);
+   free(results[FP16]);
+}
+
+int main() {
+
+   cl_device_id device;
+   cl_context context;
+   cl_command_queue queue;
+   float *data;
+   size_t size, i;
+   cl_int err;
+
+   /* Values in [0, 1), enough for the largest case */
+   size = MATRIX_DIM * MATRIX_DIM;
+   if(size < NUM_FLOATS)
+      size = NUM_FLOATS;
+   if(size < NUM_ROWS * (ROW_LENGTH + 1))
+      size = NUM_ROWS * (ROW_LENGTH + 1);
+   if(size < 2 * NUM_POINTS)
+      size = 2 * NUM_POINTS;
+   data = (float*)malloc(size * sizeof(float));
+   srand(0);
+   for(i=0; i<size; i++)
+      data[i] = (float)rand()/RAND_MAX;
+
+   device = create_device();
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);
+   }
+   queue = clCreateCommandQueue(context, device,
+         CL_QUEUE_PROFILING_ENABLE, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);
+   };
+
+   /* Errors are relative to the fp32 results */
+   reduction_case(context, device, queue, data);
+   transpose_case(context, device, queue, data);
+   spmv_case(context, device, queue, data);
+   scale_case(context, device, queue, data);
+
+   free(data);
+   clReleaseCommandQueue(queue);
+   clReleaseContext(context);
+   return 0;
+}
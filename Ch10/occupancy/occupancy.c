@@ -0,0 +1,469 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define DEFAULT_SIZE (1 << 20)
+#define MAX_KERNELS 32
+#define MAX_LOCAL_ARGS 8
+
+/* The kernels include device_lib.h or accumulate.h from Ch2/program_link */
+#define DEVICE_LIB_OPTION "-I../../Ch2/program_link"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* The tree's kernels, apart from one-line demos, deliberately broken
+   programs and sources that need a prelude or a link step */
+static const char *default_programs[] = {
+   "../../Ch1/matvec/matvec.cl",
+   "../../Ch3/zero_copy/zero_copy.cl",
+   "../../Ch4/specialize/specialize.cl",
+   "../../Ch5/batch_math/batch_math.cl",
+   "../../Ch6/resample_engine/resample_engine.cl",
+   "../../Ch7/bench/bench.cl",
+   "../../Ch7/trace/trace.cl",
+   "../../Ch8/buffer_pool/buffer_pool.cl",
+   "../../Ch10/reduction/reduction.cl",
+   "../../Ch10/reduction_complete/reduction_complete.cl",
+   "../../Ch11/bsort/bsort.cl",
+   "../../Ch11/bsort8/bsort8.cl",
+   "../../Ch11/radix_sort8/radix_sort8.cl",
+   "../../Ch11/string_search/string_search.cl",
+   "../../Ch12/matrix_mult/matrix_mult.cl",
+   "../../Ch12/qr/qr.cl",
+   "../../Ch12/transpose/transpose.cl",
+   "../../Ch13/conj_grad/conj_grad.cl",
+   "../../Ch13/steep_desc/steep_desc.cl",
+   "../../Ch14/fft/fft.cl",
+   "../../Ch14/rdft/rdft.cl",
+   "../../Ch16/filter_engine/filter_engine.cl",
+   "../../Ch16/image_pyramid/image_pyramid.cl"
+};
+#define NUM_DEFAULT_PROGRAMS \
+   (sizeof(default_programs)/sizeof(default_programs[0]))
+
+/* How the host sizes a kernel's __local arguments */
+enum {
+   LOCAL_PER_ITEM,      /* count elements per work-item */
+   LOCAL_FIXED,         /* count elements */
+   LOCAL_PER_ELEMENT,   /* count elements per problem element */
+   LOCAL_ALL,           /* All of local memory */
+   LOCAL_TILE           /* A square group plus a border of count */
+};
+
+typedef struct kernel_rule {
+   const char *name;
+   int local_rule;
+   size_t count;
+   size_t elems_per_item;     /* Problem elements per work-item */
+   int single_group;          /* The problem must fit one work-group */
+   size_t elem_size;          /* Bytes per __local element, or 0 to
+                                 size it from the argument's type */
+} kernel_rule;
+
+/* Kernels whose hosts don't give one __local element per work-item or
+   one work-item per problem element */
+static const kernel_rule rules[] = {
+
+   /* bsort.c gives each work-item two float4s of l_data */
+   {"bsort_init", LOCAL_PER_ITEM, 2, 8, 0},
+   {"bsort_stage_0", LOCAL_PER_ITEM, 2, 8, 0},
+   {"bsort_stage_n", LOCAL_PER_ITEM, 2, 8, 0},
+   {"bsort_merge", LOCAL_PER_ITEM, 2, 8, 0},
+   {"bsort_merge_last", LOCAL_PER_ITEM, 2, 8, 0},
+   {"bsort8", LOCAL_PER_ITEM, 0, 8, 0},
+   {"radix_sort8", LOCAL_PER_ITEM, 0, 8, 0},
+   {"reduction_complete", LOCAL_PER_ITEM, 1, 4, 0},
+   {"string_search", LOCAL_FIXED, 4, 1, 0},
+
+   /* reduction.cl keeps an acc_t, float in the default build, per
+      work-item */
+   {"reduction_scalar", LOCAL_PER_ITEM, 1, 1, 0, 4},
+   {"reduction_vector", LOCAL_PER_ITEM, 1, 4, 0, 4},
+
+   /* One work-group solves the whole system, with each __local array
+      holding a float per row. The sums are a typedef, acc_t, which is
+      float in the default build */
+   {"conj_grad", LOCAL_PER_ELEMENT, 1, 1, 1, 4},
+   {"steep_desc", LOCAL_PER_ELEMENT, 1, 1, 1},
+   {"qr", LOCAL_PER_ELEMENT, 1, 1, 1},
+
+   /* fft.c and the transposes hand over all of local memory. fft_init's
+      complex_t is float2 in the default build */
+   {"fft_init", LOCAL_ALL, 0, 1, 0, 8},
+   {"transpose", LOCAL_ALL, 0, 1, 0},
+
+   /* A 5x5 filter: the tile is (lw+4) x (lh+4) floats, which also
+      bounds the separable passes */
+   {"filter_tiled", LOCAL_TILE, 4, 1, 0},
+   {"filter_rows", LOCAL_TILE, 4, 1, 0},
+   {"filter_cols", LOCAL_TILE, 4, 1, 0},
+   {"filter_row_only", LOCAL_TILE, 4, 1, 0},
+   {"filter_col_only", LOCAL_TILE, 4, 1, 0}
+};
+#define NUM_RULES (sizeof(rules)/sizeof(rules[0]))
+
+static const kernel_rule default_rule = {NULL, LOCAL_PER_ITEM, 1, 1, 0};
+
+typedef struct device_limits {
+   char name[128];
+   cl_uint compute_units;
+   size_t max_group_size;
+   cl_ulong local_mem;
+} device_limits;
+
+typedef struct kernel_info {
+   char name[64];
+   size_t group_size;            /* CL_KERNEL_WORK_GROUP_SIZE */
+   size_t multiple;
+   cl_ulong static_local;
+   cl_ulong private_mem;
+   size_t local_args[MAX_LOCAL_ARGS];   /* Element size of each */
+   int num_local_args;
+   char unknown_type[64];        /* First __local type type_size missed */
+   const kernel_rule *rule;
+} kernel_info;
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   }
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);
+   }
+
+   return dev;
+}
+
+/* Create a program from a file and compile it with argument information.
+   Returns NULL if it doesn't build */
+cl_program build_program(cl_context ctx, cl_device_id dev,
+      const char* filename) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer;
+   size_t program_size;
+   int err;
+
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL)
+      return NULL;
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   program = clCreateProgramWithSource(ctx, 1,
+      (const char**)&program_buffer, &program_size, &err);
+   free(program_buffer);
+   if(err < 0)
+      return NULL;
+
+   err = clBuildProgram(program, 1, &dev, "-cl-kernel-arg-info "
+         DEVICE_LIB_OPTION, NULL, NULL);
+   if(err < 0) {
+      clReleaseProgram(program);
+      return NULL;
+   }
+   return program;
+}
+
+/* Bytes of an OpenCL C type such as "float4*" or "uint", or 0 for a
+   name it doesn't know, such as a typedef */
+size_t type_size(const char *type_name) {
+
+   static const struct {
+      const char *name;
+      size_t size;
+   } scalars[] = {
+      {"char", 1}, {"uchar", 1}, {"short", 2}, {"ushort", 2}, {"half", 2},
+      {"int", 4}, {"uint", 4}, {"float", 4}, {"long", 8}, {"ulong", 8},
+      {"double", 8}
+   };
+   size_t len = 0, i, width;
+
+   while(type_name[len] >= 'a' && type_name[len] <= 'z')
+      len++;
+   width = (size_t)atoi(type_name + len);
+   if(width == 0)
+      width = 1;
+   if(width == 3)
+      width = 4;
+   for(i=0; i<sizeof(scalars)/sizeof(scalars[0]); i++)
+      if(strlen(scalars[i].name) == len &&
+            strncmp(type_name, scalars[i].name, len) == 0)
+         return scalars[i].size * width;
+   return 0;
+}
+
+/* Local memory a work-group of size items needs for a problem of n */
+cl_ulong local_bytes(const kernel_info *k, const device_limits *dev,
+      size_t size, size_t n) {
+
+   cl_ulong bytes = k->static_local;
+   size_t side;
+   int i;
+
+   if(k->rule->local_rule == LOCAL_ALL && k->num_local_args > 0)
+      return dev->local_mem;
+   for(i=0; i<k->num_local_args; i++) {
+      switch(k->rule->local_rule) {
+         case LOCAL_PER_ITEM:
+            bytes += (cl_ulong)k->rule->count * size * k->local_args[i];
+            break;
+         case LOCAL_FIXED:
+            bytes += (cl_ulong)k->rule->count * k->local_args[i];
+            break;
+         case LOCAL_PER_ELEMENT:
+            bytes += (cl_ulong)k->rule->count * n * k->local_args[i];
+            break;
+         case LOCAL_TILE:
+            side = (size_t)sqrt((double)size) + k->rule->count;
+            bytes += (cl_ulong)side * side * k->local_args[i];
+            break;
+      }
+   }
+   return bytes;
+}
+
+/* Query a kernel's limits and the element sizes of its __local
+   arguments. Types that type_size doesn't know are taken as 4 bytes
+   unless the kernel's rule gives the size */
+void read_kernel(cl_kernel kernel, cl_device_id dev, kernel_info *k) {
+
+   cl_kernel_arg_address_qualifier qualifier;
+   cl_uint num_args, i;
+   size_t size;
+   char type_name[64];
+
+   memset(k, 0, sizeof(*k));
+   clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, sizeof(k->name),
+         k->name, NULL);
+   clGetKernelWorkGroupInfo(kernel, dev, CL_KERNEL_WORK_GROUP_SIZE,
+         sizeof(k->group_size), &k->group_size, NULL);
+   clGetKernelWorkGroupInfo(kernel, dev,
+         CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE,
+         sizeof(k->multiple), &k->multiple, NULL);
+   clGetKernelWorkGroupInfo(kernel, dev, CL_KERNEL_LOCAL_MEM_SIZE,
+         sizeof(k->static_local), &k->static_local, NULL);
+   clGetKernelWorkGroupInfo(kernel, dev, CL_KERNEL_PRIVATE_MEM_SIZE,
+         sizeof(k->private_mem), &k->private_mem, NULL);
+   if(k->multiple == 0)
+      k->multiple = 1;
+
+   k->rule = &default_rule;
+   for(i=0; i<NUM_RULES; i++)
+      if(strcmp(k->name, rules[i].name) == 0)
+         k->rule = &rules[i];
+
+   clGetKernelInfo(kernel, CL_KERNEL_NUM_ARGS, sizeof(num_args),
+         &num_args, NULL);
+   for(i=0; i<num_args && k->num_local_args<MAX_LOCAL_ARGS; i++) {
+      if(clGetKernelArgInfo(kernel, i, CL_KERNEL_ARG_ADDRESS_QUALIFIER,
+            sizeof(qualifier), &qualifier, NULL) < 0 ||
+            qualifier != CL_KERNEL_ARG_ADDRESS_LOCAL)
+         continue;
+      type_name[0] = '\0';
+      clGetKernelArgInfo(kernel, i, CL_KERNEL_ARG_TYPE_NAME,
+            sizeof(type_name), type_name, NULL);
+      size = k->rule->elem_size;
+      if(size == 0)
+         size = type_size(type_name);
+      if(size == 0) {
+         if(k->unknown_type[0] == '\0')
+            strncpy(k->unknown_type, type_name, sizeof(k->unknown_type)-1);
+         size = 4;
+      }
+      k->local_args[k->num_local_args++] = size;
+   }
+}
+
+/* Report a kernel's resource use, what it allows and a launch for a
+   problem of n elements */
+void analyze(const kernel_info *k, const device_limits *dev, size_t n) {
+
+   size_t fit, size, items, num_groups, per_unit, max_n;
+   cl_ulong bytes, per_element;
+
+   printf("  %s\n", k->name);
+   printf("    work-group size up to %zu, multiple of %zu, "
+         "%lu bytes private per work-item\n", k->group_size, k->multiple,
+         (unsigned long)k->private_mem);
+   printf("    local memory: %lu bytes static, %d __local argument%s\n",
+         (unsigned long)k->static_local, k->num_local_args,
+         k->num_local_args == 1 ? "" : "s");
+   if(k->unknown_type[0] != '\0')
+      printf("    * unknown __local type %s, assumed 4 bytes per element\n",
+            k->unknown_type);
+
+   /* A problem that has to fit in a single work-group */
+   if(k->rule->single_group) {
+      per_element = local_bytes(k, dev, 1, 1) - k->static_local;
+      max_n = k->group_size;
+      if(per_element > 0 &&
+            (dev->local_mem - k->static_local)/per_element < max_n)
+         max_n = (size_t)((dev->local_mem - k->static_local)/per_element);
+      printf("    runs as one work-group: at most %zu elements", max_n);
+      if(n > max_n)
+         printf("\n    * n = %zu doesn't fit\n", n);
+      else
+         printf(", n = %zu: global %zu, local %zu\n", n, n, n);
+      return;
+   }
+
+   /* Largest power of two that the kernel and local memory allow */
+   fit = 1;
+   while(fit * 2 <= k->group_size)
+      fit *= 2;
+   while(fit > 1 && local_bytes(k, dev, fit, n) > dev->local_mem)
+      fit /= 2;
+   if(local_bytes(k, dev, fit, n) > dev->local_mem) {
+      printf("    * needs %lu bytes of local memory per work-group, "
+            "more than the device has\n",
+            (unsigned long)local_bytes(k, dev, fit, n));
+      return;
+   }
+   if(fit < k->group_size && k->num_local_args > 0 &&
+         local_bytes(k, dev, fit * 2, n) > dev->local_mem)
+      printf("    * local memory limits work-groups to %zu work-items\n",
+            fit);
+   if(fit < k->multiple)
+      printf("    * work-groups of %zu are smaller than the preferred "
+            "multiple\n", fit);
+
+   /* Launch for n: whole groups, no larger than the problem */
+   items = (n + k->rule->elems_per_item - 1)/k->rule->elems_per_item;
+   size = fit;
+   while(size > 1 && size/2 >= items)
+      size /= 2;
+   num_groups = (items + size - 1)/size;
+   bytes = local_bytes(k, dev, size, n);
+   per_unit = bytes > 0 ? (size_t)(dev->local_mem/bytes) : 0;
+
+   printf("    n = %zu: global %zu, local %zu, %zu work-group%s\n", n,
+         num_groups * size, size, num_groups, num_groups == 1 ? "" : "s");
+   if(per_unit > 0)
+      printf("    %lu bytes of local memory per group: %zu group%s "
+            "(%zu work-items) per compute unit, %zu wave%s\n",
+            (unsigned long)bytes, per_unit, per_unit == 1 ? "" : "s",
+            per_unit * size,
+            (num_groups + per_unit * dev->compute_units - 1)/
+                  (per_unit * dev->compute_units),
+            num_groups > per_unit * dev->compute_units ? "s" : "");
+   else
+      printf("    local memory doesn't limit concurrency\n");
+   if(num_groups < dev->compute_units)
+      printf("    * %zu work-groups leave compute units idle\n",
+            num_groups);
+}
+
+int main(int argc, char **argv) {
+
+   /* Host/device structures */
+   cl_device_id device;
+   cl_context context;
+   cl_program program;
+   cl_kernel kernels[MAX_KERNELS];
+   cl_uint num_kernels, j;
+   cl_int err;
+
+   device_limits dev;
+   kernel_info info;
+   const char **files = default_programs;
+   size_t num_files = NUM_DEFAULT_PROGRAMS, n = DEFAULT_SIZE, i;
+   int first_file = argc;
+
+   /* occupancy [-n size] [program.cl ...] */
+   for(i=1; i<(size_t)argc; i++) {
+      if(strcmp(argv[i], "-n") == 0 && i+1 < (size_t)argc)
+         n = strtoul(argv[++i], NULL, 10);
+      else if(argv[i][0] == '-') {
+         printf("Usage: %s [-n problem_size] [program.cl ...]\n", argv[0]);
+         exit(1);
+      }
+      else {
+         first_file = (int)i;
+         break;
+      }
+   }
+   if(first_file < argc) {
+      files = (const char**)(argv + first_file);
+      num_files = argc - first_file;
+   }
+   if(n == 0)
+      n = 1;
+
+   device = create_device();
+   err = clGetDeviceInfo(device, CL_DEVICE_NAME, sizeof(dev.name),
+         dev.name, NULL);
+   err |= clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS,
+         sizeof(dev.compute_units), &dev.compute_units, NULL);
+   err |= clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE,
+         sizeof(dev.max_group_size), &dev.max_group_size, NULL);
+   err |= clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE,
+         sizeof(dev.local_mem), &dev.local_mem, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);
+   }
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);
+   }
+
+   printf("%s: %u compute units, work-groups up to %zu, "
+         "%lu bytes of local memory\n\n", dev.name, dev.compute_units,
+         dev.max_group_size, (unsigned long)dev.local_mem);
+
+   for(i=0; i<num_files; i++) {
+      program = build_program(context, device, files[i]);
+      if(program == NULL) {
+         printf("%s: doesn't build on this device, skipped\n\n", files[i]);
+         continue;
+      }
+      err = clCreateKernelsInProgram(program, MAX_KERNELS, kernels,
+            &num_kernels);
+      if(err < 0) {
+         printf("%s: couldn't create its kernels\n\n", files[i]);
+         clReleaseProgram(program);
+         continue;
+      }
+      printf("%s\n", files[i]);
+      for(j=0; j<num_kernels; j++) {
+         read_kernel(kernels[j], device, &info);
+         analyze(&info, &dev, n);
+         clReleaseKernel(kernels[j]);
+      }
+      printf("\n");
+      clReleaseProgram(program);
+   }
+
+   clReleaseContext(context);
+   return 0;
+}
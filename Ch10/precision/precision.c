@@ -0,0 +1,244 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "precision.cl"
+
+#define ARRAY_SIZE (1 << 24)
+#define MAX_GROUPS 256
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "device_caps.h"
+#include "precision_mode.h"
+#include "program_binary.h"
+
+/* The kernels compiled for this machine by the Makefile */
+#ifdef PRECOMPILED
+#include "precision_binaries.h"
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   }
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);
+   }
+
+   return dev;
+}
+
+/* Run a reduction kernel and add the groups' sums on the host in double.
+   Returns the kernel's time in ms */
+double run_reduction(cl_command_queue queue, cl_kernel kernel,
+      size_t global_size, size_t local_size, cl_mem partial_buffer,
+      int mode, double *sum) {
+
+   cl_event prof_event;
+   cl_ulong time_start, time_end;
+   unsigned char partials[MAX_GROUPS * sizeof(cl_double)];
+   size_t num_groups = global_size/local_size, i;
+   cl_float pair[2];
+   cl_double d;
+   cl_int err;
+
+   err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_size,
+         &local_size, 0, NULL, &prof_event);
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);
+   }
+   err = clEnqueueReadBuffer(queue, partial_buffer, CL_TRUE, 0,
+         num_groups * accumulate_sizes[mode], partials, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't read the buffer");
+      exit(1);
+   }
+   clGetEventProfilingInfo(prof_event, CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(prof_event, CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+   clReleaseEvent(prof_event);
+
+   /* Kahan partials are a sum and the error it still owes */
+   *sum = 0.0;
+   for(i=0; i<num_groups; i++) {
+      if(mode == MODE_FP64) {
+         memcpy(&d, partials + i * sizeof(d), sizeof(d));
+         *sum += d;
+      }
+      else if(mode == MODE_KAHAN) {
+         memcpy(pair, partials + i * sizeof(pair), sizeof(pair));
+         *sum += (double)pair[0] + (double)pair[1];
+      }
+      else {
+         memcpy(pair, partials + i * sizeof(cl_float), sizeof(cl_float));
+         *sum += pair[0];
+      }
+   }
+   return (time_end - time_start) * 1.0e-6;
+}
+
+int main() {
+
+   /* Host/device data structures */
+   cl_device_id device;
+   cl_context context;
+   cl_command_queue queue;
+   cl_program program;
+   char options[1024];
+   cl_kernel sum_kernel, dot_kernel;
+   const device_caps *caps;
+   size_t local_size, global_size, max_size, num_groups;
+   cl_uint count = ARRAY_SIZE;
+   cl_int err;
+   int i, mode;
+
+   /* Data and buffers */
+   float *a, *b;
+   long double ref_sum = 0.0L, ref_dot = 0.0L;
+   double sum, dot, sum_time, dot_time;
+   cl_mem a_buffer, b_buffer, partial_buffer;
+
+   /* Many small positive terms make the sum drift; the dot product
+      cancels */
+   a = (float*)malloc(ARRAY_SIZE * sizeof(float));
+   b = (float*)malloc(ARRAY_SIZE * sizeof(float));
+   srand(0);
+   for(i=0; i<ARRAY_SIZE; i++) {
+      a[i] = 0.1f + (float)rand()/RAND_MAX;
+      b[i] = 2.0f * rand()/RAND_MAX - 1.0f;
+      ref_sum += a[i];
+      ref_dot += (long double)a[i] * b[i];
+   }
+
+   device = create_device();
+   caps = device_caps_get(device);
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);
+   }
+   queue = clCreateCommandQueue(context, device,
+         CL_QUEUE_PROFILING_ENABLE, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);
+   };
+
+   a_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, ARRAY_SIZE * sizeof(float), a, &err);
+   b_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, ARRAY_SIZE * sizeof(float), b, &err);
+   partial_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE,
+         MAX_GROUPS * sizeof(cl_double), NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);
+   };
+
+   /* A few work-groups per compute unit, each work-item summing many
+      elements in its accumulator */
+   num_groups = caps->compute_units * 4;
+   if(num_groups > MAX_GROUPS)
+      num_groups = MAX_GROUPS;
+
+   printf("%u elements\n", count);
+   for(mode=0; mode<NUM_MODES; mode++) {
+      if(mode == MODE_FP64 && !caps->fp64) {
+         printf("%-6s not supported by the device\n", accumulate_names[mode]);
+         continue;
+      }
+      if(device_caps_options(device, accumulate_options[mode], options,
+            sizeof(options)) < 0) {
+         printf("Couldn't write the build options\n");
+         exit(1);
+      }
+      program = program_load(context, device, PROGRAM_IMAGE(precision),
+            PROGRAM_FILE, options, NULL);
+      sum_kernel = clCreateKernel(program, "reduce_sum", &err);
+      if(err < 0) {
+         perror("Couldn't create a kernel");
+         exit(1);
+      };
+      dot_kernel = clCreateKernel(program, "dot_product", &err);
+      if(err < 0) {
+         perror("Couldn't create a kernel");
+         exit(1);
+      };
+
+      /* The largest power of two up to 256 that both kernels accept */
+      local_size = 256;
+      clGetKernelWorkGroupInfo(sum_kernel, device,
+            CL_KERNEL_WORK_GROUP_SIZE, sizeof(max_size), &max_size, NULL);
+      while(local_size > max_size)
+         local_size /= 2;
+      clGetKernelWorkGroupInfo(dot_kernel, device,
+            CL_KERNEL_WORK_GROUP_SIZE, sizeof(max_size), &max_size, NULL);
+      while(local_size > max_size)
+         local_size /= 2;
+      global_size = num_groups * local_size;
+
+      err = clSetKernelArg(sum_kernel, 0, sizeof(cl_mem), &a_buffer);
+      err |= clSetKernelArg(sum_kernel, 1, sizeof(count), &count);
+      err |= clSetKernelArg(sum_kernel, 2, local_size * accumulate_sizes[mode],
+            NULL);
+      err |= clSetKernelArg(sum_kernel, 3, sizeof(cl_mem), &partial_buffer);
+      err |= clSetKernelArg(dot_kernel, 0, sizeof(cl_mem), &a_buffer);
+      err |= clSetKernelArg(dot_kernel, 1, sizeof(cl_mem), &b_buffer);
+      err |= clSetKernelArg(dot_kernel, 2, sizeof(count), &count);
+      err |= clSetKernelArg(dot_kernel, 3, local_size * accumulate_sizes[mode],
+            NULL);
+      err |= clSetKernelArg(dot_kernel, 4, sizeof(cl_mem), &partial_buffer);
+      if(err < 0) {
+         perror("Couldn't set a kernel argument");
+         exit(1);
+      };
+
+      sum_time = run_reduction(queue, sum_kernel, global_size, local_size,
+            partial_buffer, mode, &sum);
+      dot_time = run_reduction(queue, dot_kernel, global_size, local_size,
+            partial_buffer, mode, &dot);
+      printf("%-6s sum: relative error %.2e, %.3f ms   "
+            "dot: relative error %.2e, %.3f ms\n", accumulate_names[mode],
+            (double)fabsl((sum - ref_sum)/ref_sum), sum_time,
+            (double)fabsl((dot - ref_dot)/ref_dot), dot_time);
+
+      clReleaseKernel(sum_kernel);
+      clReleaseKernel(dot_kernel);
+      clReleaseProgram(program);
+   }
+
+   /* Deallocate resources */
+   free(a);
+   free(b);
+   clReleaseMemObject(a_buffer);
+   clReleaseMemObject(b_buffer);
+   clReleaseMemObject(partial_buffer);
+   clReleaseCommandQueue(queue);
+   clReleaseContext(context);
+   return 0;
+}
@@ -0,0 +1,47 @@
+/* acc_t, ACC_ZERO, acc_add, acc_add_product and acc_merge for the mode
+   the host chooses */
+#include "accumulate.h"
+
+/* Each work-group writes the sum of its work-items' partial sums */
+void group_store(acc_t sum, __local acc_t *partial_sums,
+      __global acc_t *output) {
+
+   uint lid = get_local_id(0);
+
+   partial_sums[lid] = sum;
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   for(uint i = get_local_size(0)/2; i>0; i >>= 1) {
+      if(lid < i) {
+         partial_sums[lid] = acc_merge(partial_sums[lid],
+               partial_sums[lid + i]);
+      }
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+
+   if(lid == 0) {
+      output[get_group_id(0)] = partial_sums[0];
+   }
+}
+
+__kernel void reduce_sum(__global const float *data, uint count,
+      __local acc_t *partial_sums, __global acc_t *output) {
+
+   acc_t sum = ACC_ZERO;
+
+   for(uint i=get_global_id(0); i<count; i+=get_global_size(0)) {
+      sum = acc_add(sum, data[i]);
+   }
+   group_store(sum, partial_sums, output);
+}
+
+__kernel void dot_product(__global const float *a, __global const float *b,
+      uint count, __local acc_t *partial_sums, __global acc_t *output) {
+
+   acc_t sum = ACC_ZERO;
+
+   for(uint i=get_global_id(0); i<count; i+=get_global_size(0)) {
+      sum = acc_add_product(sum, a[i], b[i]);
+   }
+   group_store(sum, partial_sums, output);
+}
@@ -16,6 +16,15 @@
 #include <CL/cl.h>
 #endif
 
+#include "device_caps.h"
+#include "precision_mode.h"
+#include "program_binary.h"
+
+/* The kernels compiled for this machine by the Makefile */
+#ifdef PRECOMPILED
+#include "reduction_binaries.h"
+#endif
+
 /* Find a GPU or CPU associated with the first available platform */
 cl_device_id create_device() {
 
@@ -43,58 +52,48 @@ cl_device_id create_device() {
    return dev;
 }
 
-/* Create program from a file and compile it */
-cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename) {
+/* Load the precompiled program, or build it from the file, with the
+   device's capabilities and extra options */
+cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename,
+      const char* extra) {
 
-   cl_program program;
-   FILE *program_handle;
-   char *program_buffer, *program_log;
-   size_t program_size, log_size;
-   int err;
+   char options[1024];
 
-   /* Read program file and place content into buffer */
-   program_handle = fopen(filename, "r");
-   if(program_handle == NULL) {
-      perror("Couldn't find the program file");
-      exit(1);
-   }
-   fseek(program_handle, 0, SEEK_END);
-   program_size = ftell(program_handle);
-   rewind(program_handle);
-   program_buffer = (char*)malloc(program_size + 1);
-   program_buffer[program_size] = '\0';
-   fread(program_buffer, sizeof(char), program_size, program_handle);
-   fclose(program_handle);
-
-   /* Create program from file */
-   program = clCreateProgramWithSource(ctx, 1, 
-      (const char**)&program_buffer, &program_size, &err);
-   if(err < 0) {
-      perror("Couldn't create the program");
+   if(device_caps_options(dev, extra, options, sizeof(options)) < 0) {
+      printf("Couldn't write the build options\n");
       exit(1);
    }
-   free(program_buffer);
+   return program_load(ctx, dev, PROGRAM_IMAGE(reduction), filename,
+         options, NULL);
+}
 
-   /* Build program */
-   err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
-   if(err < 0) {
+/* Read a kernel's group sums, which are double in the fp64 mode and
+   float otherwise, and add them in double */
+double read_sum(cl_command_queue queue, cl_mem buffer, size_t count,
+      int mode) {
+
+   void *sums;
+   double sum = 0.0;
+   size_t size = mode == MODE_FP64 ? sizeof(cl_double) : sizeof(cl_float);
+   size_t j;
+   cl_int err;
 
-      /* Find size of log and print to std output */
-      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
-            0, NULL, &log_size);
-      program_log = (char*) malloc(log_size + 1);
-      program_log[log_size] = '\0';
-      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
-            log_size + 1, program_log, NULL);
-      printf("%s\n", program_log);
-      free(program_log);
+   sums = malloc(count * size);
+   err = clEnqueueReadBuffer(queue, buffer, CL_TRUE, 0,
+         count * size, sums, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't read the buffer");
       exit(1);
    }
-
-   return program;
+   for(j=0; j<count; j++) {
+      sum += mode == MODE_FP64 ? ((cl_double*)sums)[j] :
+            ((cl_float*)sums)[j];
+   }
+   free(sums);
+   return sum;
 }
 
-int main() {
+int main(int argc, char **argv) {
 
    /* OpenCL structures */
    cl_device_id device;
@@ -103,18 +102,21 @@ int main() {
    cl_kernel kernel[NUM_KERNELS];
    cl_command_queue queue;
    cl_event prof_event;
-   cl_int i, j, err;
-   size_t local_size, global_size;
+   cl_int i, err;
+   int mode;
+   size_t local_size, global_size, num_groups;
    char kernel_names[NUM_KERNELS][20] = 
          {"reduction_scalar", "reduction_vector"};
 
    /* Data and buffers */
    float data[ARRAY_SIZE];
-   float sum, actual_sum, *scalar_sum, *vector_sum;
-   cl_mem data_buffer, scalar_sum_buffer, vector_sum_buffer;
-   cl_int num_groups;
+   double sum, actual_sum;
+   cl_mem data_buffer, sum_buffer;
    cl_ulong time_start, time_end, total_time;
 
+   /* Choose the accumulation */
+   mode = precision_mode_parse(argc, argv, accumulate_names);
+
    /* Initialize data */
    for(i=0; i<ARRAY_SIZE; i++) {
       data[i] = 1.0f*i;
@@ -128,16 +130,9 @@ int main() {
       perror("Couldn't obtain device information");
       exit(1);   
    }
-
-   /* Allocate and initialize output arrays */
-   num_groups = ARRAY_SIZE/local_size;
-   scalar_sum = (float*) malloc(num_groups * sizeof(float));
-   vector_sum = (float*) malloc(num_groups/4 * sizeof(float));
-   for(i=0; i<num_groups; i++) {
-      scalar_sum[i] = 0.0f;
-   }
-   for(i=0; i<num_groups/4; i++) {
-      vector_sum[i] = 0.0f;
+   if(mode == MODE_FP64 && !device_caps_get(device)->fp64) {
+      printf("The device doesn't support double precision\n");
+      exit(1);
    }
 
    /* Create a context */
@@ -147,16 +142,18 @@ int main() {
       exit(1);   
    }
 
-   /* Build program */
-   program = build_program(context, device, PROGRAM_FILE);
+   /* Build program. Compensated sums don't use subgroup functions */
+   program = build_program(context, device, PROGRAM_FILE,
+         accumulate_options[mode]);
+   if(device_caps_has_subgroups(device) && mode != MODE_KAHAN)
+      printf("Summing with subgroup functions\n");
 
-   /* Create data buffer */
+   /* Create data buffer, and one for the scalar kernel's group sums,
+      which outnumber the vector kernel's */
    data_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
          CL_MEM_COPY_HOST_PTR, ARRAY_SIZE * sizeof(float), data, &err);
-   scalar_sum_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE |
-         CL_MEM_COPY_HOST_PTR, num_groups * sizeof(float), scalar_sum, &err);
-   vector_sum_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE |
-         CL_MEM_COPY_HOST_PTR, num_groups * sizeof(float), vector_sum, &err);
+   sum_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE,
+         ARRAY_SIZE/local_size * sizeof(cl_double), NULL, &err);
    if(err < 0) {
       perror("Couldn't create a buffer");
       exit(1);   
@@ -170,6 +167,7 @@ int main() {
       exit(1);   
    };
 
+   actual_sum = (double)ARRAY_SIZE/2*(ARRAY_SIZE-1);
    for(i=0; i<NUM_KERNELS; i++) {
 
       /* Create a kernel */
@@ -179,18 +177,13 @@ int main() {
          exit(1);
       };
 
-      /* Create kernel arguments */
+      /* Create kernel arguments. Each work-item keeps one partial sum */
+      global_size = i == 0 ? ARRAY_SIZE : ARRAY_SIZE/4;
+      num_groups = global_size/local_size;
       err = clSetKernelArg(kernel[i], 0, sizeof(cl_mem), &data_buffer);
-      if(i == 0) {
-         global_size = ARRAY_SIZE;
-         err |= clSetKernelArg(kernel[i], 1, local_size * sizeof(float), NULL);
-         err |= clSetKernelArg(kernel[i], 2, sizeof(cl_mem), &scalar_sum_buffer);
-      }
-      else {
-         global_size = ARRAY_SIZE/4;
-         err |= clSetKernelArg(kernel[i], 1, local_size * 4 * sizeof(float), NULL);
-         err |= clSetKernelArg(kernel[i], 2, sizeof(cl_mem), &vector_sum_buffer);
-      }
+      err |= clSetKernelArg(kernel[i], 1,
+            local_size * accumulate_sizes[mode], NULL);
+      err |= clSetKernelArg(kernel[i], 2, sizeof(cl_mem), &sum_buffer);
       if(err < 0) {
          perror("Couldn't create a kernel argument");
          exit(1);   
@@ -212,35 +205,10 @@ int main() {
             sizeof(time_end), &time_end, NULL);
       total_time = time_end - time_start;
 
-      /* Read the result */
-      if(i == 0) {
-         err = clEnqueueReadBuffer(queue, scalar_sum_buffer, CL_TRUE, 0, 
-            num_groups * sizeof(float), scalar_sum, 0, NULL, NULL);
-         if(err < 0) {
-            perror("Couldn't read the buffer");
-            exit(1);   
-         }
-         sum = 0.0f;
-         for(j=0; j<num_groups; j++) {
-            sum += scalar_sum[j];
-         }
-      }
-      else {
-         err = clEnqueueReadBuffer(queue, vector_sum_buffer, CL_TRUE, 0, 
-            num_groups/4 * sizeof(float), vector_sum, 0, NULL, NULL);
-         if(err < 0) {
-            perror("Couldn't read the buffer");
-            exit(1);   
-         }
-         sum = 0.0f;
-         for(j=0; j<num_groups/4; j++) {
-            sum += vector_sum[j];
-         }
-      }
-
-      /* Check result */
-      printf("%s: ", kernel_names[i]);
-      actual_sum = 1.0f * ARRAY_SIZE/2*(ARRAY_SIZE-1);
+      /* Read the result and check it */
+      sum = read_sum(queue, sum_buffer, num_groups, mode);
+      printf("%s (%s): relative error %.2e. ", kernel_names[i],
+            accumulate_names[mode], fabs(sum - actual_sum)/actual_sum);
       if(fabs(sum - actual_sum) > 0.01*fabs(sum))
          printf("Check failed.\n");
       else
@@ -252,13 +220,10 @@ int main() {
    }
 
    /* Deallocate resources */
-   free(scalar_sum);
-   free(vector_sum);
    for(i=0; i<NUM_KERNELS; i++) {
       clReleaseKernel(kernel[i]);
    }
-   clReleaseMemObject(scalar_sum_buffer);
-   clReleaseMemObject(vector_sum_buffer);
+   clReleaseMemObject(sum_buffer);
    clReleaseMemObject(data_buffer);
    clReleaseCommandQueue(queue);
    clReleaseProgram(program);
@@ -1,41 +1,92 @@
-__kernel void reduction_scalar(__global float* data, 
-      __local float* partial_sums, __global float* output) {
+/* With HALF_STORAGE the data is stored as half and summed in float.
+   vload_half doesn't need cl_khr_fp16 */
+#ifdef HALF_STORAGE
+typedef half storage_t;
+typedef half storage4_t;
+#define LOAD(p, i) vload_half(i, p)
+#define LOAD4(p, i) vload_half4(i, p)
+#else
+typedef float storage_t;
+typedef float4 storage4_t;
+#define LOAD(p, i) (p)[i]
+#define LOAD4(p, i) (p)[i]
+#endif
 
-   int lid = get_local_id(0);
-   int group_size = get_local_size(0);
+/* acc_t, real_t and their operations for the mode the host chooses.
+   Each work-group's sum is written as real_t */
+#include "accumulate.h"
 
-   partial_sums[lid] = data[get_global_id(0)];
-   barrier(CLK_LOCAL_MEM_FENCE);
+#ifdef ACC_SUB_GROUPS
+#pragma OPENCL EXTENSION cl_khr_subgroups : enable
 
-   for(int i = group_size/2; i>0; i >>= 1) {
-      if(lid < i) {
-         partial_sums[lid] += partial_sums[lid + i];
-      }
-      barrier(CLK_LOCAL_MEM_FENCE);
+/* Each subgroup adds its work-items' values without barriers, then the
+   first subgroup adds the subgroups' sums. The total is only valid in
+   the first subgroup */
+acc_t group_sum(acc_t x, __local acc_t* sub_group_sums) {
+
+   uint sg_lid = get_sub_group_local_id();
+
+   x = sub_group_reduce_add(x);
+   if(sg_lid == 0) {
+      sub_group_sums[get_sub_group_id()] = x;
    }
+   barrier(CLK_LOCAL_MEM_FENCE);
 
-   if(lid == 0) {
-      output[get_group_id(0)] = partial_sums[0];
+   if(get_sub_group_id() == 0) {
+      x = ACC_ZERO;
+      for(uint i=sg_lid; i<get_num_sub_groups(); i+=get_sub_group_size()) {
+         x += sub_group_sums[i];
+      }
+      x = sub_group_reduce_add(x);
    }
+   return x;
 }
 
-__kernel void reduction_vector(__global float4* data, 
-      __local float4* partial_sums, __global float* output) {
+#else
+
+/* Tree of pairwise sums in local memory. The group size must be a power
+   of two, and the total is only valid in work-item 0 */
+acc_t group_sum(acc_t x, __local acc_t* partial_sums) {
 
-   int lid = get_local_id(0);
-   int group_size = get_local_size(0);
+   uint lid = get_local_id(0);
 
-   partial_sums[lid] = data[get_global_id(0)];
+   partial_sums[lid] = x;
    barrier(CLK_LOCAL_MEM_FENCE);
 
-   for(int i = group_size/2; i>0; i >>= 1) {
+   for(uint i = get_local_size(0)/2; i>0; i >>= 1) {
       if(lid < i) {
-         partial_sums[lid] += partial_sums[lid + i];
+         partial_sums[lid] = acc_merge(partial_sums[lid],
+               partial_sums[lid + i]);
       }
       barrier(CLK_LOCAL_MEM_FENCE);
    }
+   return partial_sums[0];
+}
+#endif
+
+/* partial_sums needs an acc_t per work-item */
+__kernel void reduction_scalar(__global storage_t* data,
+      __local acc_t* partial_sums, __global real_t* output) {
+
+   acc_t sum = group_sum(acc_add(ACC_ZERO, LOAD(data, get_global_id(0))),
+         partial_sums);
+
+   if(get_local_id(0) == 0) {
+      output[get_group_id(0)] = acc_value(sum);
+   }
+}
+
+/* Each work-item adds its four values before the group sums them, so
+   partial_sums also needs just an acc_t per work-item */
+__kernel void reduction_vector(__global storage4_t* data,
+      __local acc_t* partial_sums, __global real_t* output) {
+
+   float4 x = LOAD4(data, get_global_id(0));
+   acc_t sum = acc_add(acc_add(acc_add(acc_add(ACC_ZERO, x.s0), x.s1),
+         x.s2), x.s3);
 
-   if(lid == 0) {
-      output[get_group_id(0)] = dot(partial_sums[0], (float4)(1.0f));
+   sum = group_sum(sum, partial_sums);
+   if(get_local_id(0) == 0) {
+      output[get_group_id(0)] = acc_value(sum);
    }
 }
@@ -1,7 +1,45 @@
-__kernel void reduction_vector(__global float4* data, 
+#ifdef HAS_SUBGROUPS
+#pragma OPENCL EXTENSION cl_khr_subgroups : enable
+
+/* Each subgroup adds its work-items' vectors without barriers, then the
+   first subgroup adds the subgroups' sums. Subgroup functions take
+   scalars, so the components are added separately. The total is only
+   valid in the first subgroup */
+float4 group_sum(float4 x, __local float4* sub_group_sums) {
+
+   uint sg_lid = get_sub_group_local_id();
+
+   x = (float4)(sub_group_reduce_add(x.s0), sub_group_reduce_add(x.s1),
+                sub_group_reduce_add(x.s2), sub_group_reduce_add(x.s3));
+   if(sg_lid == 0) {
+      sub_group_sums[get_sub_group_id()] = x;
+   }
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   if(get_sub_group_id() == 0) {
+      x = (float4)(0.0f);
+      for(uint i=sg_lid; i<get_num_sub_groups(); i+=get_sub_group_size()) {
+         x += sub_group_sums[i];
+      }
+      x = (float4)(sub_group_reduce_add(x.s0), sub_group_reduce_add(x.s1),
+                   sub_group_reduce_add(x.s2), sub_group_reduce_add(x.s3));
+   }
+   return x;
+}
+#endif
+
+__kernel void reduction_vector(__global float4* data,
       __local float4* partial_sums) {
 
    int lid = get_local_id(0);
+
+#ifdef HAS_SUBGROUPS
+   float4 sum = group_sum(data[get_global_id(0)], partial_sums);
+
+   if(lid == 0) {
+      data[get_group_id(0)] = sum;
+   }
+#else
    int group_size = get_local_size(0);
 
    partial_sums[lid] = data[get_global_id(0)];
@@ -17,12 +55,21 @@ __kernel void reduction_vector(__global float4* data,
    if(lid == 0) {
       data[get_group_id(0)] = partial_sums[0];
    }
+#endif
 }
 
-__kernel void reduction_complete(__global float4* data, 
+__kernel void reduction_complete(__global float4* data,
       __local float4* partial_sums, __global float* sum) {
 
    int lid = get_local_id(0);
+
+#ifdef HAS_SUBGROUPS
+   float4 total = group_sum(data[get_local_id(0)], partial_sums);
+
+   if(lid == 0) {
+      *sum = total.s0 + total.s1 + total.s2 + total.s3;
+   }
+#else
    int group_size = get_local_size(0);
 
    partial_sums[lid] = data[get_local_id(0)];
@@ -39,6 +86,5 @@ __kernel void reduction_complete(__global float4* data,
       *sum = partial_sums[0].s0 + partial_sums[0].s1 +
              partial_sums[0].s2 + partial_sums[0].s3;
    }
+#endif
 }
-
-
@@ -11,6 +11,13 @@
 #include <CL/cl.h>
 #endif
 
+#include "program_binary.h"
+
+/* The kernels compiled for this machine by the Makefile */
+#ifdef PRECOMPILED
+#include "wg_test_binaries.h"
+#endif
+
 /* Find a GPU or CPU associated with the first available platform */
 cl_device_id create_device() {
 
@@ -38,57 +45,6 @@ cl_device_id create_device() {
    return dev;
 }
 
-/* Create program from a file and compile it */
-cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename) {
-
-   cl_program program;
-   FILE *program_handle;
-   char *program_buffer, *program_log;
-   size_t program_size, log_size;
-   int err;
-
-   /* Read program file and place content into buffer */
-   program_handle = fopen(filename, "r");
-   if(program_handle == NULL) {
-      perror("Couldn't find the program file");
-      exit(1);
-   }
-   fseek(program_handle, 0, SEEK_END);
-   program_size = ftell(program_handle);
-   rewind(program_handle);
-   program_buffer = (char*)malloc(program_size + 1);
-   program_buffer[program_size] = '\0';
-   fread(program_buffer, sizeof(char), program_size, program_handle);
-   fclose(program_handle);
-
-   /* Create program from file */
-   program = clCreateProgramWithSource(ctx, 1, 
-      (const char**)&program_buffer, &program_size, &err);
-   if(err < 0) {
-      perror("Couldn't create the program");
-      exit(1);
-   }
-   free(program_buffer);
-
-   /* Build program */
-   err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
-   if(err < 0) {
-
-      /* Find size of log and print to std output */
-      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
-            0, NULL, &log_size);
-      program_log = (char*) malloc(log_size + 1);
-      program_log[log_size] = '\0';
-      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
-            log_size + 1, program_log, NULL);
-      printf("%s\n", program_log);
-      free(program_log);
-      exit(1);
-   }
-
-   return program;
-}
-
 int main(int argc, char **argv) {
 
    /* Host/device structures */
@@ -97,6 +53,7 @@ int main(int argc, char **argv) {
    cl_program program;
    cl_kernel kernel;
    char *program_name, *kernel_name;
+   const program_image *image = NULL;
    cl_command_queue queue;
    cl_int err;
 
@@ -110,6 +67,7 @@ int main(int argc, char **argv) {
       case 1:
          program_name = DEFAULT_PROGRAM;
          kernel_name = DEFAULT_KERNEL;
+         image = PROGRAM_IMAGE(blank);
       break;
       case 3:
          program_name = argv[1];
@@ -139,8 +97,8 @@ int main(int argc, char **argv) {
       exit(1);   
    }
 
-   /* Build program */
-   program = build_program(context, device, program_name);
+   /* Build program, the default one from its precompiled image */
+   program = program_load(context, device, image, program_name, NULL, NULL);
 
    /* Create a command queue */
    queue = clCreateCommandQueue(context, device, 0, &err);
@@ -6,6 +6,13 @@
 #define BSORT_MERGE        "bsort_merge"
 #define BSORT_MERGE_LAST   "bsort_merge_last"
 
+/* The device library with VECTOR_SORT and VECTOR_SWAP */
+#define LIB_FILE           "../../Ch2/program_link/device_lib.cl"
+#define LIB_HEADER         "../../Ch2/program_link/device_lib.h"
+
+/* The precompiled program includes the library's source from here */
+#define DEVICE_LIB_OPTION  "-I../../Ch2/program_link"
+
 /* Ascending: 0, Descending: -1 */
 #define DIRECTION 0
 #define NUM_FLOATS 1048576
@@ -22,6 +29,19 @@
 #include <CL/cl.h>
 #endif
 
+#include "cl_library.h"
+#include "device_caps.h"
+#include "program_binary.h"
+
+/* The kernels compiled for this machine by the Makefile */
+#ifdef PRECOMPILED
+#include "bsort_binaries.h"
+#endif
+
+#ifdef CL_TRACE
+#include "cl_trace.h"
+#endif
+
 /* Find a GPU or CPU associated with the first available platform */
 cl_device_id create_device() {
 
@@ -49,64 +69,17 @@ cl_device_id create_device() {
    return dev;
 }
 
-/* Create program from a file and compile it */
-cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename) {
-
-   cl_program program;
-   FILE *program_handle;
-   char *program_buffer, *program_log;
-   size_t program_size, log_size;
-   int err;
-
-   /* Read program file and place content into buffer */
-   program_handle = fopen(filename, "r");
-   if(program_handle == NULL) {
-      perror("Couldn't find the program file");
-      exit(1);
-   }
-   fseek(program_handle, 0, SEEK_END);
-   program_size = ftell(program_handle);
-   rewind(program_handle);
-   program_buffer = (char*)malloc(program_size + 1);
-   program_buffer[program_size] = '\0';
-   fread(program_buffer, sizeof(char), program_size, program_handle);
-   fclose(program_handle);
-
-   /* Create program from file */
-   program = clCreateProgramWithSource(ctx, 1, 
-      (const char**)&program_buffer, &program_size, &err);
-   if(err < 0) {
-      perror("Couldn't create the program");
-      exit(1);
-   }
-   free(program_buffer);
-
-   /* Build program */
-   err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
-   if(err < 0) {
-
-      /* Find size of log and print to std output */
-      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
-            0, NULL, &log_size);
-      program_log = (char*) malloc(log_size + 1);
-      program_log[log_size] = '\0';
-      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
-            log_size + 1, program_log, NULL);
-      printf("%s\n", program_log);
-      free(program_log);
-      exit(1);
-   }
-
-   return program;
-}
-
 int main() {
 
    /* Host/device data structures */
    cl_device_id device;
    cl_context context;
    cl_command_queue queue;
+   cl_library lib;
    cl_program program;
+   const device_caps *caps;
+   char options[1024], image_options[1024];
+   int linked = 0;
    cl_kernel kernel_init, kernel_stage_0, kernel_stage_n, kernel_merge,
          kernel_merge_last;
    cl_int i, err, check, direction;
@@ -115,7 +88,7 @@ int main() {
    float data[NUM_FLOATS];
    cl_mem data_buffer;
    cl_uint stage, high_stage, num_stages;
-   size_t local_size, global_size;
+   size_t local_size, global_size, local_bytes;
 
    /* Initialize data */
    srand(time(NULL));
@@ -131,8 +104,24 @@ int main() {
       exit(1);   
    }
 
-   /* Build the program */
-   program = build_program(context, device, PROGRAM_FILE);
+   /* Load the program precompiled for this device, or build it for the
+      device's capabilities and link it with the device library */
+   caps = device_caps_get(device);
+   if(device_caps_options(device, NULL, options, sizeof(options)) < 0 ||
+         device_caps_options(device, DEVICE_LIB_OPTION, image_options,
+         sizeof(image_options)) < 0) {
+      printf("Build options are too long\n");
+      exit(1);
+   }
+   program = program_load_image(context, device, PROGRAM_IMAGE(bsort),
+         image_options);
+   if(program == NULL) {
+      cl_library_create(&lib, context, device, LIB_FILE, LIB_HEADER,
+            "device_lib.h", NULL);
+      program = cl_library_link(&lib, context, device, PROGRAM_FILE,
+            options);
+      linked = 1;
+   }
 
    /* Create kernels */
    kernel_init = clCreateKernel(program, BSORT_INIT, &err);
@@ -170,6 +159,17 @@ int main() {
    };
    local_size = (int)pow(2, trunc(log2(local_size))); 
 
+   /* Each work-group sorts 8 floats per work-item in local memory, if
+      the kernels use it. Otherwise they sort in place and l_data is
+      never touched */
+   if(caps->local_mem_dedicated) {
+      while(8*local_size*sizeof(float) > caps->local_mem_size)
+         local_size /= 2;
+      local_bytes = 8*local_size*sizeof(float);
+   }
+   else
+      local_bytes = 4*sizeof(float);
+
 
    /* Create buffer */
    data_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE |
@@ -191,11 +191,11 @@ int main() {
    };
 
    /* Create kernel argument */
-   err = clSetKernelArg(kernel_init, 1, 8*local_size*sizeof(float), NULL);
-   err |= clSetKernelArg(kernel_stage_0, 1, 8*local_size*sizeof(float), NULL);
-   err |= clSetKernelArg(kernel_stage_n, 1, 8*local_size*sizeof(float), NULL);
-   err |= clSetKernelArg(kernel_merge, 1, 8*local_size*sizeof(float), NULL);
-   err |= clSetKernelArg(kernel_merge_last, 1, 8*local_size*sizeof(float), NULL);
+   err = clSetKernelArg(kernel_init, 1, local_bytes, NULL);
+   err |= clSetKernelArg(kernel_stage_0, 1, local_bytes, NULL);
+   err |= clSetKernelArg(kernel_stage_n, 1, local_bytes, NULL);
+   err |= clSetKernelArg(kernel_merge, 1, local_bytes, NULL);
+   err |= clSetKernelArg(kernel_merge_last, 1, local_bytes, NULL);
    if(err < 0) {
       printf("Couldn't set a kernel argument");
       exit(1);
@@ -333,6 +333,8 @@ int main() {
    clReleaseKernel(kernel_merge_last);
    clReleaseCommandQueue(queue);
    clReleaseProgram(program);
+   if(linked)
+      cl_library_release(&lib);
    clReleaseContext(context);
    return 0;
 }
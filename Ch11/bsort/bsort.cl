@@ -1,21 +1,29 @@
-/* Sort elements within a vector */
-#define VECTOR_SORT(input, dir)                                   \
-   comp = input < shuffle(input, mask2) ^ dir;                    \
-   input = shuffle(input, as_uint4(comp * 2 + add2));             \
-   comp = input < shuffle(input, mask1) ^ dir;                    \
-   input = shuffle(input, as_uint4(comp + add1));                 \
-
-#define VECTOR_SWAP(input1, input2, dir)                          \
-   temp = input1;                                                 \
-   comp = (input1 < input2 ^ dir) * 4 + add3;                     \
-   input1 = shuffle2(input1, input2, as_uint4(comp));             \
-   input2 = shuffle2(input2, temp, as_uint4(comp));               \
+/* Built with the options from device_caps_options. Where local memory
+   is emulated in global memory, as on most CPUs, the kernels that work
+   on a block per work-group sort it in place in g_data rather than
+   copying it to l_data and back. A block is only ever touched by its own
+   work-group, so a global fence is all the barriers need */
+#ifndef LOCAL_MEM_DEDICATED
+#define LOCAL_MEM_DEDICATED 1
+#endif
+
+#if LOCAL_MEM_DEDICATED
+#define BLOCK(base) l_data
+#define BLOCK_FENCE CLK_LOCAL_MEM_FENCE
+#else
+#define BLOCK(base) (g_data + (base))
+#define BLOCK_FENCE CLK_GLOBAL_MEM_FENCE
+#endif
+
+/* VECTOR_SORT and VECTOR_SWAP come from the device library's header in
+   Ch2/program_link */
+#include "device_lib.h"
 
 /* Perform initial sort */
 __kernel void bsort_init(__global float4 *g_data, __local float4 *l_data) {
 
    int dir;
-   uint id, global_start, size, stride;
+   uint id, group_start, global_start, size, stride;
    float4 input1, input2, temp;
    int4 comp;
 
@@ -28,7 +36,8 @@ __kernel void bsort_init(__global float4 *g_data, __local float4 *l_data) {
    int4 add3 = (int4)(1, 2, 2, 3);
 
    id = get_local_id(0) * 2;
-   global_start = get_group_id(0) * get_local_size(0) * 2 + id;
+   group_start = get_group_id(0) * get_local_size(0) * 2;
+   global_start = group_start + id;
 
    input1 = g_data[global_start]; 
    input2 = g_data[global_start+1];
@@ -60,44 +69,48 @@ __kernel void bsort_init(__global float4 *g_data, __local float4 *l_data) {
    /* Sort data and store in local memory */
    VECTOR_SORT(input1, dir);
    VECTOR_SORT(input2, dir);
-   l_data[id] = input1;
-   l_data[id+1] = input2;
+   BLOCK(group_start)[id] = input1;
+   BLOCK(group_start)[id+1] = input2;
 
    /* Create bitonic set */
    for(size = 2; size < get_local_size(0); size <<= 1) {
       dir = (get_local_id(0)/size & 1) * -1;
 
       for(stride = size; stride > 1; stride >>= 1) {
-         barrier(CLK_LOCAL_MEM_FENCE);
+         barrier(BLOCK_FENCE);
          id = get_local_id(0) + (get_local_id(0)/stride)*stride;
-         VECTOR_SWAP(l_data[id], l_data[id + stride], dir)
+         VECTOR_SWAP(BLOCK(group_start)[id],
+            BLOCK(group_start)[id + stride], dir)
       }
 
-      barrier(CLK_LOCAL_MEM_FENCE);
+      barrier(BLOCK_FENCE);
       id = get_local_id(0) * 2;
-      input1 = l_data[id]; input2 = l_data[id+1];
+      input1 = BLOCK(group_start)[id];
+      input2 = BLOCK(group_start)[id+1];
       temp = input1;
       comp = (input1 < input2 ^ dir) * 4 + add3;
       input1 = shuffle2(input1, input2, as_uint4(comp));
       input2 = shuffle2(input2, temp, as_uint4(comp));
       VECTOR_SORT(input1, dir);
       VECTOR_SORT(input2, dir);
-      l_data[id] = input1;
-      l_data[id+1] = input2;
+      BLOCK(group_start)[id] = input1;
+      BLOCK(group_start)[id+1] = input2;
    }
 
    /* Perform bitonic merge */
    dir = (get_group_id(0) % 2) * -1;
    for(stride = get_local_size(0); stride > 1; stride >>= 1) {
-      barrier(CLK_LOCAL_MEM_FENCE);
+      barrier(BLOCK_FENCE);
       id = get_local_id(0) + (get_local_id(0)/stride)*stride;
-      VECTOR_SWAP(l_data[id], l_data[id + stride], dir)
+      VECTOR_SWAP(BLOCK(group_start)[id],
+            BLOCK(group_start)[id + stride], dir)
    }
-   barrier(CLK_LOCAL_MEM_FENCE);
+   barrier(BLOCK_FENCE);
 
    /* Perform final sort */
    id = get_local_id(0) * 2;
-   input1 = l_data[id]; input2 = l_data[id+1];
+   input1 = BLOCK(group_start)[id];
+   input2 = BLOCK(group_start)[id+1];
    temp = input1;
    comp = (input1 < input2 ^ dir) * 4 + add3;
    input1 = shuffle2(input1, input2, as_uint4(comp));
@@ -113,7 +126,7 @@ __kernel void bsort_stage_0(__global float4 *g_data, __local float4 *l_data,
                             uint high_stage) {
 
    int dir;
-   uint id, global_start, stride;
+   uint id, group_start, global_start, stride;
    float4 input1, input2, temp;
    int4 comp;
 
@@ -128,26 +141,30 @@ __kernel void bsort_stage_0(__global float4 *g_data, __local float4 *l_data,
    /* Determine data location in global memory */
    id = get_local_id(0);
    dir = (get_group_id(0)/high_stage & 1) * -1;
-   global_start = get_group_id(0) * get_local_size(0) * 2 + id;
+   group_start = get_group_id(0) * get_local_size(0) * 2;
+   global_start = group_start + id;
 
    /* Perform initial swap */
    input1 = g_data[global_start];
    input2 = g_data[global_start + get_local_size(0)];
    comp = (input1 < input2 ^ dir) * 4 + add3;
-   l_data[id] = shuffle2(input1, input2, as_uint4(comp));
-   l_data[id + get_local_size(0)] = shuffle2(input2, input1, as_uint4(comp));
+   BLOCK(group_start)[id] = shuffle2(input1, input2, as_uint4(comp));
+   BLOCK(group_start)[id + get_local_size(0)] =
+         shuffle2(input2, input1, as_uint4(comp));
 
    /* Perform bitonic merge */
    for(stride = get_local_size(0)/2; stride > 1; stride >>= 1) {
-      barrier(CLK_LOCAL_MEM_FENCE);
+      barrier(BLOCK_FENCE);
       id = get_local_id(0) + (get_local_id(0)/stride)*stride;
-      VECTOR_SWAP(l_data[id], l_data[id + stride], dir)
+      VECTOR_SWAP(BLOCK(group_start)[id],
+            BLOCK(group_start)[id + stride], dir)
    }
-   barrier(CLK_LOCAL_MEM_FENCE);
+   barrier(BLOCK_FENCE);
 
    /* Perform final sort */
    id = get_local_id(0) * 2;
-   input1 = l_data[id]; input2 = l_data[id+1];
+   input1 = BLOCK(group_start)[id];
+   input2 = BLOCK(group_start)[id+1];
    temp = input1;
    comp = (input1 < input2 ^ dir) * 4 + add3;
    input1 = shuffle2(input1, input2, as_uint4(comp));
@@ -210,7 +227,7 @@ __kernel void bsort_merge(__global float4 *g_data, __local float4 *l_data, uint
 /* Perform final step of the bitonic merge */
 __kernel void bsort_merge_last(__global float4 *g_data, __local float4 *l_data, int dir) {
 
-   uint id, global_start, stride;
+   uint id, group_start, global_start, stride;
    float4 input1, input2, temp;
    int4 comp;
 
@@ -224,26 +241,30 @@ __kernel void bsort_merge_last(__global float4 *g_data, __local float4 *l_data,
 
    /* Determine location of data in global memory */
    id = get_local_id(0);
-   global_start = get_group_id(0) * get_local_size(0) * 2 + id;
+   group_start = get_group_id(0) * get_local_size(0) * 2;
+   global_start = group_start + id;
 
    /* Perform initial swap */
    input1 = g_data[global_start];
    input2 = g_data[global_start + get_local_size(0)];
    comp = (input1 < input2 ^ dir) * 4 + add3;
-   l_data[id] = shuffle2(input1, input2, as_uint4(comp));
-   l_data[id + get_local_size(0)] = shuffle2(input2, input1, as_uint4(comp));
+   BLOCK(group_start)[id] = shuffle2(input1, input2, as_uint4(comp));
+   BLOCK(group_start)[id + get_local_size(0)] =
+         shuffle2(input2, input1, as_uint4(comp));
 
    /* Perform bitonic merge */
    for(stride = get_local_size(0)/2; stride > 1; stride >>= 1) {
-      barrier(CLK_LOCAL_MEM_FENCE);
+      barrier(BLOCK_FENCE);
       id = get_local_id(0) + (get_local_id(0)/stride)*stride;
-      VECTOR_SWAP(l_data[id], l_data[id + stride], dir)
+      VECTOR_SWAP(BLOCK(group_start)[id],
+            BLOCK(group_start)[id + stride], dir)
    }
-   barrier(CLK_LOCAL_MEM_FENCE);
+   barrier(BLOCK_FENCE);
 
    /* Perform final sort */
    id = get_local_id(0) * 2;
-   input1 = l_data[id]; input2 = l_data[id+1];
+   input1 = BLOCK(group_start)[id];
+   input2 = BLOCK(group_start)[id+1];
    temp = input1;
    comp = (input1 < input2 ^ dir) * 4 + add3;
    input1 = shuffle2(input1, input2, as_uint4(comp));
@@ -16,6 +16,13 @@
 #include <CL/cl.h>
 #endif
 
+#include "program_binary.h"
+
+/* The kernels compiled for this machine by the Makefile */
+#ifdef PRECOMPILED
+#include "radix_sort8_binaries.h"
+#endif
+
 int main() {
 
    /* Host/device data structures */
@@ -27,9 +34,6 @@ int main() {
 
    /* Program/kernel data structures */
    cl_program program;
-   FILE *program_handle;
-   char *program_buffer, *program_log;
-   size_t program_size, log_size;
    cl_kernel kernel;     
 
    /* Data and buffers */
@@ -73,42 +77,9 @@ int main() {
       exit(1);   
    }
 
-   /* Read program file and place content into buffer */
-   program_handle = fopen(PROGRAM_FILE, "r");
-   if(program_handle == NULL) {
-      perror("Couldn't find the program file");
-      exit(1);
-   }
-   fseek(program_handle, 0, SEEK_END);
-   program_size = ftell(program_handle);
-   rewind(program_handle);
-   program_buffer = (char*)calloc(program_size+1, sizeof(char));
-   fread(program_buffer, sizeof(char), program_size, program_handle);
-   fclose(program_handle);
-
-   /* Create program from file */
-   program = clCreateProgramWithSource(context, 1, 
-      (const char**)&program_buffer, &program_size, &err);
-   if(err < 0) {
-      perror("Couldn't create the program");
-      exit(1);
-   }
-   free(program_buffer);
-
    /* Build program */
-   err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
-   if(err < 0) {
-            
-      /* Find size of log and print to std output */
-      clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 
-            0, NULL, &log_size);
-      program_log = (char*) calloc(log_size+1, sizeof(char));
-      clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 
-            log_size+1, program_log, NULL);
-      printf("%s\n", program_log);
-      free(program_log);
-      exit(1);
-   }
+   program = program_load(context, device, PROGRAM_IMAGE(radix_sort8),
+         PROGRAM_FILE, NULL, NULL);
 
    /* Create a kernel */
    kernel = clCreateKernel(program, KERNEL_FUNC, &err);
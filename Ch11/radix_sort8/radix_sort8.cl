@@ -9,7 +9,7 @@ __kernel void radix_sort8(__global ushort8 *global_data) {
    uint cmp_value = 1;
    vec_array mask, ones, data;
 
-   data.vec = global_data[0];
+   data.vec = global_data[get_global_id(0)];
 
    /* Rearrange elements according to bits */
    for(int i=0; i<3; i++) {
@@ -35,5 +35,5 @@ __kernel void radix_sort8(__global ushort8 *global_data) {
       data.vec = shuffle2(data.vec, ones.vec, mask.vec);
       cmp_value <<= 1;
    }
-   global_data[0] = data.vec;
+   global_data[get_global_id(0)] = data.vec;
 }
@@ -0,0 +1,345 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "segmented_sort.cl"
+
+/* Segments of up to ITEM_LEN elements are sorted by one work-item, up
+   to SUB_GROUP_LEN by a subgroup and longer ones by a work-group */
+#define ITEM_LEN 16
+#define SUB_GROUP_LEN 256
+
+/* Tells the kernels the same length, and where the device library's
+   header is */
+#define STR(x) #x
+#define XSTR(x) STR(x)
+#define PROGRAM_OPTIONS "-DSUB_GROUP_LEN=" XSTR(SUB_GROUP_LEN) \
+      " -I../../Ch2/program_link"
+
+/* Segments of 1 to MAX_LEN elements, a third of them in each tier */
+#define NUM_SEGMENTS 6000
+#define MAX_LEN 4096
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "device_caps.h"
+#include "program_binary.h"
+
+/* The kernels compiled for this machine by the Makefile */
+#ifdef PRECOMPILED
+#include "segmented_sort_binaries.h"
+#endif
+
+#ifdef CL_TRACE
+#include "cl_trace.h"
+#endif
+
+enum {TIER_ITEM, TIER_SUB_GROUP, TIER_GROUP, NUM_TIERS};
+
+static const char *tier_names[NUM_TIERS] = {
+   "work-item", "subgroup", "work-group"
+};
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   }
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);
+   }
+
+   return dev;
+}
+
+int compare_floats(const void *a, const void *b) {
+
+   float x = *(const float*)a, y = *(const float*)b;
+   return (x > y) - (x < y);
+}
+
+/* The largest power of two up to 256 the kernel accepts */
+size_t group_size(cl_kernel kernel, cl_device_id dev) {
+
+   size_t max_size, size = 256;
+
+   clGetKernelWorkGroupInfo(kernel, dev, CL_KERNEL_WORK_GROUP_SIZE,
+         sizeof(max_size), &max_size, NULL);
+   while(size > max_size)
+      size /= 2;
+   return size;
+}
+
+/* Work-items in each subgroup of a work-group of local_size. Only
+   OpenCL 2.1 reports it; otherwise the whole group is taken as one
+   subgroup, which leaves any others idle but never shares a region */
+size_t max_sub_group_size(cl_kernel kernel, cl_device_id dev,
+      size_t local_size) {
+
+   size_t size = 0;
+
+#ifdef CL_VERSION_2_1
+   clGetKernelSubGroupInfo(kernel, dev,
+         CL_KERNEL_MAX_SUB_GROUP_SIZE_FOR_NDRANGE, sizeof(local_size),
+         &local_size, sizeof(size), &size, NULL);
+#endif
+   if(size == 0 || size > local_size)
+      size = local_size;
+   return size;
+}
+
+int main() {
+
+   /* Host/device data structures */
+   cl_device_id device;
+   cl_context context;
+   cl_command_queue queue;
+   cl_program program;
+   char options[1024];
+   cl_kernel kernels[NUM_TIERS];
+   cl_event events[NUM_TIERS];
+   cl_ulong time_start, time_end, total_time = 0;
+   const device_caps *caps;
+   size_t local_size, global_size, local_bytes, sub_group_size;
+   cl_uint regions;
+   cl_int err;
+   int use_sub_groups, tier, check;
+
+   /* Data and buffers */
+   cl_uint *offsets, *segments[NUM_TIERS], counts[NUM_TIERS] = {0};
+   cl_uint num_values, len, max_group_len = 0, i;
+   float *data, *expected;
+   cl_mem data_buffer, offset_buffer, segment_buffers[NUM_TIERS];
+
+   device = create_device();
+   caps = device_caps_get(device);
+
+   use_sub_groups = device_caps_has_subgroups(device);
+
+   /* Choose segment lengths and sort them into tiers */
+   srand(0);
+   offsets = (cl_uint*)malloc((NUM_SEGMENTS + 1) * sizeof(cl_uint));
+   for(tier=0; tier<NUM_TIERS; tier++) {
+      segments[tier] = (cl_uint*)malloc(NUM_SEGMENTS * sizeof(cl_uint));
+   }
+   offsets[0] = 0;
+   for(i=0; i<NUM_SEGMENTS; i++) {
+      switch(i % 3) {
+         case 0: len = 1 + rand() % ITEM_LEN; break;
+         case 1: len = ITEM_LEN + 1 + rand() % (SUB_GROUP_LEN - ITEM_LEN);
+            break;
+         default: len = SUB_GROUP_LEN + 1 +
+            rand() % (MAX_LEN - SUB_GROUP_LEN); break;
+      }
+      offsets[i + 1] = offsets[i] + len;
+
+      if(len <= ITEM_LEN)
+         tier = TIER_ITEM;
+      else if(len <= SUB_GROUP_LEN && use_sub_groups)
+         tier = TIER_SUB_GROUP;
+      else
+         tier = TIER_GROUP;
+      segments[tier][counts[tier]++] = i;
+      if(tier == TIER_GROUP && len > max_group_len)
+         max_group_len = len;
+   }
+   num_values = offsets[NUM_SEGMENTS];
+
+   /* Initialize data, and sort each segment on the host for the check */
+   data = (float*)malloc(num_values * sizeof(float));
+   expected = (float*)malloc(num_values * sizeof(float));
+   for(i=0; i<num_values; i++) {
+      data[i] = (float)rand()/RAND_MAX;
+   }
+   memcpy(expected, data, num_values * sizeof(float));
+   for(i=0; i<NUM_SEGMENTS; i++) {
+      qsort(expected + offsets[i], offsets[i + 1] - offsets[i],
+            sizeof(float), compare_floats);
+   }
+
+   /* Create a context, program and command queue */
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);
+   }
+   if(device_caps_options(device, PROGRAM_OPTIONS, options,
+         sizeof(options)) < 0) {
+      printf("Couldn't write the build options\n");
+      exit(1);
+   }
+   program = program_load(context, device, PROGRAM_IMAGE(segmented_sort),
+         PROGRAM_FILE, options, NULL);
+   queue = clCreateCommandQueue(context, device,
+         CL_QUEUE_PROFILING_ENABLE, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);
+   };
+
+   /* Create buffers */
+   data_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE |
+         CL_MEM_COPY_HOST_PTR, num_values * sizeof(float), data, &err);
+   offset_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, (NUM_SEGMENTS + 1) * sizeof(cl_uint),
+         offsets, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);
+   };
+
+   /* One launch per tier */
+   for(tier=0; tier<NUM_TIERS; tier++) {
+      kernels[tier] = NULL;
+      segment_buffers[tier] = NULL;
+      if(counts[tier] == 0)
+         continue;
+
+      segment_buffers[tier] = clCreateBuffer(context, CL_MEM_READ_ONLY |
+            CL_MEM_COPY_HOST_PTR, counts[tier] * sizeof(cl_uint),
+            segments[tier], &err);
+      if(err < 0) {
+         perror("Couldn't create a buffer");
+         exit(1);
+      };
+      kernels[tier] = clCreateKernel(program, tier == TIER_ITEM ?
+            "sort_items" : tier == TIER_SUB_GROUP ? "sort_sub_groups" :
+            "sort_groups", &err);
+      if(err < 0) {
+         printf("Couldn't create the %s kernel: %d\n", tier_names[tier],
+               err);
+         exit(1);
+      };
+      local_size = group_size(kernels[tier], device);
+
+      err = clSetKernelArg(kernels[tier], 0, sizeof(cl_mem), &data_buffer);
+      err |= clSetKernelArg(kernels[tier], 1, sizeof(cl_mem),
+            &offset_buffer);
+      err |= clSetKernelArg(kernels[tier], 2, sizeof(cl_mem),
+            &segment_buffers[tier]);
+      switch(tier) {
+
+         /* One work-item per segment */
+         case TIER_ITEM:
+            err |= clSetKernelArg(kernels[tier], 3, sizeof(cl_uint),
+                  &counts[tier]);
+            global_size = (counts[tier] + local_size - 1)/local_size *
+                  local_size;
+            break;
+
+         /* A region of SUB_GROUP_LEN floats for each subgroup, as many
+            as local memory holds. Each region sorts a segment */
+         case TIER_SUB_GROUP:
+            sub_group_size = max_sub_group_size(kernels[tier], device,
+                  local_size);
+            regions = (cl_uint)((local_size + sub_group_size - 1) /
+                  sub_group_size);
+            while(regions > 1 && regions * SUB_GROUP_LEN * sizeof(float) >
+                  caps->local_mem_size)
+               regions--;
+            local_bytes = regions * SUB_GROUP_LEN * sizeof(float);
+            err |= clSetKernelArg(kernels[tier], 3, sizeof(cl_uint),
+                  &counts[tier]);
+            err |= clSetKernelArg(kernels[tier], 4, sizeof(cl_uint),
+                  &regions);
+            err |= clSetKernelArg(kernels[tier], 5, local_bytes, NULL);
+            global_size = (counts[tier] + regions - 1)/regions * local_size;
+            break;
+
+         /* One work-group per segment, with room for the longest padded
+            to a power of two */
+         case TIER_GROUP:
+            for(len=8; len<max_group_len; len <<= 1);
+            local_bytes = len * sizeof(float);
+            if(local_bytes > caps->local_mem_size) {
+               printf("Segments of %u elements don't fit in local memory\n",
+                     max_group_len);
+               exit(1);
+            }
+            err |= clSetKernelArg(kernels[tier], 3, local_bytes, NULL);
+            global_size = counts[tier] * local_size;
+            break;
+      }
+      if(err < 0) {
+         printf("Couldn't set a kernel argument");
+         exit(1);
+      };
+
+      err = clEnqueueNDRangeKernel(queue, kernels[tier], 1, NULL,
+            &global_size, &local_size, 0, NULL, &events[tier]);
+      if(err < 0) {
+         perror("Couldn't enqueue the kernel");
+         exit(1);
+      }
+   }
+
+   /* Read the sorted segments */
+   err = clEnqueueReadBuffer(queue, data_buffer, CL_TRUE, 0,
+         num_values * sizeof(float), data, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't read the buffer");
+      exit(1);
+   }
+
+   printf("%d segments, %u elements\n", NUM_SEGMENTS, num_values);
+   for(tier=0; tier<NUM_TIERS; tier++) {
+      if(counts[tier] == 0) {
+         printf("%-10s no segments\n", tier_names[tier]);
+         continue;
+      }
+      clGetEventProfilingInfo(events[tier], CL_PROFILING_COMMAND_START,
+            sizeof(time_start), &time_start, NULL);
+      clGetEventProfilingInfo(events[tier], CL_PROFILING_COMMAND_END,
+            sizeof(time_end), &time_end, NULL);
+      total_time += time_end - time_start;
+      printf("%-10s %5u segments, %.3f ms\n", tier_names[tier],
+            counts[tier], (time_end - time_start) * 1.0e-6);
+      clReleaseEvent(events[tier]);
+   }
+   printf("Total %.3f ms\n", total_time * 1.0e-6);
+
+   /* Check the result */
+   check = memcmp(data, expected, num_values * sizeof(float)) == 0;
+   if(check)
+      printf("Check passed.\n");
+   else
+      printf("Check failed.\n");
+
+   /* Deallocate resources */
+   for(tier=0; tier<NUM_TIERS; tier++) {
+      free(segments[tier]);
+      if(kernels[tier] != NULL) {
+         clReleaseKernel(kernels[tier]);
+         clReleaseMemObject(segment_buffers[tier]);
+      }
+   }
+   free(offsets);
+   free(data);
+   free(expected);
+   clReleaseMemObject(data_buffer);
+   clReleaseMemObject(offset_buffer);
+   clReleaseCommandQueue(queue);
+   clReleaseProgram(program);
+   clReleaseContext(context);
+   return 0;
+}
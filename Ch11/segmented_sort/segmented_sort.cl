@@ -0,0 +1,247 @@
+/* Sorts many independent segments of a float array in ascending order.
+   Segment s is data[offsets[s]] to data[offsets[s+1]-1]. The host sorts
+   each segment with one of three kernels, depending on its length:
+
+   sort_items        up to 16 elements, in one work-item's registers
+   sort_sub_groups   up to SUB_GROUP_LEN elements, by a subgroup in local
+                     memory (needs HAS_SUBGROUPS)
+   sort_groups       longer segments, by a work-group in local memory
+
+   Each kernel is given the list of segments it sorts. Segments are
+   padded with INFINITY to a power of two, so the padding sorts last and
+   is never stored */
+
+#ifndef SUB_GROUP_LEN
+#define SUB_GROUP_LEN 256
+#endif
+#define SUB_GROUP_VECTORS (SUB_GROUP_LEN/4)
+
+#define UP 0
+#define DOWN -1
+
+/* VECTOR_SORT and VECTOR_SWAP come from the device library's header in
+   Ch2/program_link */
+#include "device_lib.h"
+
+/* Sort elements in a vector. Each pair is sorted, the second against
+   dir, which makes the vector bitonic for VECTOR_SORT */
+#define SORT_VECTOR(input, dir)                                   \
+   comp = input < shuffle(input, mask1) ^ (dir ^ pair_dir);       \
+   input = shuffle(input, as_uint4(comp + add1));                 \
+   VECTOR_SORT(input, dir)                                        \
+
+/* Sort the n4 vectors of l_data, n4 a power of two of at least 2. The
+   work-items numbered lid among workers share each step and wait for
+   one another with SYNC. Every vector is sorted first, alternating
+   direction so that pairs are bitonic; then the bitonic sets double in
+   size until one holds all the vectors, as in bsort_init */
+#define SORT_LOCAL(l_data, n4, lid, workers, SYNC)                \
+   for(i=lid; i<n4; i+=workers) {                                 \
+      input1 = l_data[i];                                         \
+      dir = (i & 1) * -1;                                         \
+      SORT_VECTOR(input1, dir)                                    \
+      l_data[i] = input1;                                         \
+   }                                                              \
+   for(size = 2; size <= n4; size <<= 1) {                        \
+      for(stride = size/2; stride > 0; stride >>= 1) {            \
+         SYNC;                                                    \
+         for(i=lid; i<n4/2; i+=workers) {                         \
+            id = i + (i/stride)*stride;                           \
+            dir = (id/size & 1) * -1;                             \
+            input1 = l_data[id];                                  \
+            input2 = l_data[id + stride];                         \
+            VECTOR_SWAP(input1, input2, dir)                      \
+            l_data[id] = input1;                                  \
+            l_data[id + stride] = input2;                         \
+         }                                                        \
+      }                                                           \
+      SYNC;                                                       \
+      for(i=lid; i<n4; i+=workers) {                              \
+         input1 = l_data[i];                                      \
+         dir = (i/size & 1) * -1;                                 \
+         VECTOR_SORT(input1, dir)                                 \
+         l_data[i] = input1;                                      \
+      }                                                           \
+   }                                                              \
+   SYNC;                                                          \
+
+/* Elements 4i to 4i+3 of a segment, padded past its end */
+float4 load_vector(__global float *data, uint start, uint len, uint i) {
+
+   float4 x;
+
+   i *= 4;
+   x.s0 = i < len ? data[start + i] : INFINITY;
+   x.s1 = i + 1 < len ? data[start + i + 1] : INFINITY;
+   x.s2 = i + 2 < len ? data[start + i + 2] : INFINITY;
+   x.s3 = i + 3 < len ? data[start + i + 3] : INFINITY;
+   return x;
+}
+
+void store_vector(__global float *data, uint start, uint len, uint i,
+      float4 x) {
+
+   i *= 4;
+   if(i < len) data[start + i] = x.s0;
+   if(i + 1 < len) data[start + i + 1] = x.s1;
+   if(i + 2 < len) data[start + i + 2] = x.s2;
+   if(i + 3 < len) data[start + i + 3] = x.s3;
+}
+
+/* Vectors in a segment padded to a power of two, at least two */
+uint padded_vectors(uint len) {
+
+   uint n4 = 2;
+
+   while(n4 * 4 < len)
+      n4 <<= 1;
+   return n4;
+}
+
+/* One segment of up to 16 elements per work-item. Two bitonic sets of
+   eight are built as in bsort8, then merged */
+__kernel void sort_items(__global float *data,
+      __global const uint *offsets, __global const uint *segments,
+      uint count) {
+
+   float4 input1, input2, input3, input4, temp;
+   int4 comp;
+   uint id, start, len;
+
+   uint4 mask1 = (uint4)(1, 0, 3, 2);
+   uint4 mask2 = (uint4)(2, 3, 0, 1);
+
+   int4 add1 = (int4)(1, 1, 3, 3);
+   int4 add2 = (int4)(2, 3, 2, 3);
+   int4 add3 = (int4)(4, 5, 6, 7);
+   int4 pair_dir = (int4)(0, 0, -1, -1);
+
+   if(get_global_id(0) >= count)
+      return;
+   id = segments[get_global_id(0)];
+   start = offsets[id];
+   len = offsets[id + 1] - start;
+
+   input1 = load_vector(data, start, len, 0);
+   input2 = load_vector(data, start, len, 1);
+   input3 = load_vector(data, start, len, 2);
+   input4 = load_vector(data, start, len, 3);
+
+   /* Sort the first eight up and the second eight down */
+   SORT_VECTOR(input1, UP)
+   SORT_VECTOR(input2, DOWN)
+   SORT_VECTOR(input3, UP)
+   SORT_VECTOR(input4, DOWN)
+   VECTOR_SWAP(input1, input2, UP)
+   VECTOR_SWAP(input3, input4, DOWN)
+   VECTOR_SORT(input1, UP)
+   VECTOR_SORT(input2, UP)
+   VECTOR_SORT(input3, DOWN)
+   VECTOR_SORT(input4, DOWN)
+
+   /* Merge the bitonic set of sixteen */
+   VECTOR_SWAP(input1, input3, UP)
+   VECTOR_SWAP(input2, input4, UP)
+   VECTOR_SWAP(input1, input2, UP)
+   VECTOR_SWAP(input3, input4, UP)
+   VECTOR_SORT(input1, UP)
+   VECTOR_SORT(input2, UP)
+   VECTOR_SORT(input3, UP)
+   VECTOR_SORT(input4, UP)
+
+   store_vector(data, start, len, 0, input1);
+   store_vector(data, start, len, 1, input2);
+   store_vector(data, start, len, 2, input3);
+   store_vector(data, start, len, 3, input4);
+}
+
+#ifdef HAS_SUBGROUPS
+#pragma OPENCL EXTENSION cl_khr_subgroups : enable
+
+/* One segment of up to SUB_GROUP_LEN elements per subgroup at a time.
+   l_data holds regions of SUB_GROUP_VECTORS, one per subgroup as the
+   host counts them from the subgroup size it queries. Each subgroup
+   works in its own region, so it only waits at subgroup barriers. If
+   there are more subgroups than regions, the extra ones have nothing
+   to do */
+__kernel void sort_sub_groups(__global float *data,
+      __global const uint *offsets, __global const uint *segments,
+      uint count, uint regions, __local float4 *l_data) {
+
+   float4 input1, input2, temp;
+   int4 comp;
+   int dir;
+   uint id, i, size, stride, start, len, n4, s, active;
+   uint lid = get_sub_group_local_id();
+   uint workers = get_sub_group_size();
+
+   uint4 mask1 = (uint4)(1, 0, 3, 2);
+   uint4 mask2 = (uint4)(2, 3, 0, 1);
+
+   int4 add1 = (int4)(1, 1, 3, 3);
+   int4 add2 = (int4)(2, 3, 2, 3);
+   int4 add3 = (int4)(4, 5, 6, 7);
+   int4 pair_dir = (int4)(0, 0, -1, -1);
+
+   active = min(regions, get_num_sub_groups());
+   if(get_sub_group_id() >= active)
+      return;
+   l_data += get_sub_group_id() * SUB_GROUP_VECTORS;
+
+   for(s = get_group_id(0) * active + get_sub_group_id(); s < count;
+         s += get_num_groups(0) * active) {
+
+      start = offsets[segments[s]];
+      len = offsets[segments[s] + 1] - start;
+      n4 = padded_vectors(len);
+      for(i=lid; i<n4; i+=workers) {
+         l_data[i] = load_vector(data, start, len, i);
+      }
+      sub_group_barrier(CLK_LOCAL_MEM_FENCE);
+
+      SORT_LOCAL(l_data, n4, lid, workers,
+            sub_group_barrier(CLK_LOCAL_MEM_FENCE))
+
+      for(i=lid; i<n4; i+=workers) {
+         store_vector(data, start, len, i, l_data[i]);
+      }
+      sub_group_barrier(CLK_LOCAL_MEM_FENCE);
+   }
+}
+#endif
+
+/* One segment per work-group. l_data holds the longest segment the host
+   assigns to this kernel */
+__kernel void sort_groups(__global float *data,
+      __global const uint *offsets, __global const uint *segments,
+      __local float4 *l_data) {
+
+   float4 input1, input2, temp;
+   int4 comp;
+   int dir;
+   uint id, i, size, stride, start, len, n4;
+   uint lid = get_local_id(0);
+   uint workers = get_local_size(0);
+
+   uint4 mask1 = (uint4)(1, 0, 3, 2);
+   uint4 mask2 = (uint4)(2, 3, 0, 1);
+
+   int4 add1 = (int4)(1, 1, 3, 3);
+   int4 add2 = (int4)(2, 3, 2, 3);
+   int4 add3 = (int4)(4, 5, 6, 7);
+   int4 pair_dir = (int4)(0, 0, -1, -1);
+
+   start = offsets[segments[get_group_id(0)]];
+   len = offsets[segments[get_group_id(0)] + 1] - start;
+   n4 = padded_vectors(len);
+   for(i=lid; i<n4; i+=workers) {
+      l_data[i] = load_vector(data, start, len, i);
+   }
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   SORT_LOCAL(l_data, n4, lid, workers, barrier(CLK_LOCAL_MEM_FENCE))
+
+   for(i=lid; i<n4; i+=workers) {
+      store_vector(data, start, len, i, l_data[i]);
+   }
+}
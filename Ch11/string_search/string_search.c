@@ -13,6 +13,14 @@
 #include <CL/cl.h>
 #endif
 
+#include "device_caps.h"
+#include "program_binary.h"
+
+/* The kernels compiled for this machine by the Makefile */
+#ifdef PRECOMPILED
+#include "string_search_binaries.h"
+#endif
+
 int main() {
 
    /* Host/device data structures */
@@ -24,9 +32,7 @@ int main() {
 
    /* Program/kernel data structures */
    cl_program program;
-   FILE *program_handle;
-   char *program_buffer, *program_log;
-   size_t program_size, log_size;
+   char options[1024];
    cl_kernel kernel;
    size_t offset = 0;
    size_t global_size, local_size;
@@ -68,19 +74,6 @@ int main() {
       exit(1);   
    }
 
-   /* Read program file and place content into buffer */
-   program_handle = fopen(PROGRAM_FILE, "r");
-   if(program_handle == NULL) {
-      perror("Couldn't find the program file");
-      exit(1);
-   }
-   fseek(program_handle, 0, SEEK_END);
-   program_size = ftell(program_handle);
-   rewind(program_handle);
-   program_buffer = (char*)calloc(program_size+1, sizeof(char));
-   fread(program_buffer, sizeof(char), program_size, program_handle);
-   fclose(program_handle);
-
    /* Read text file and place content into buffer */
    text_handle = fopen(TEXT_FILE, "r");
    if(text_handle == NULL) {
@@ -95,29 +88,15 @@ int main() {
    fclose(text_handle);
    chars_per_item = text_size / global_size + 1;
 
-   /* Create program from file */
-   program = clCreateProgramWithSource(context, 1, 
-      (const char**)&program_buffer, &program_size, &err);
-   if(err < 0) {
-      perror("Couldn't create the program");
-      exit(1);
-   }
-   free(program_buffer);
-
-   /* Build program */
-   err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
-   if(err < 0) {
-            
-      /* Find size of log and print to std output */
-      clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 
-            0, NULL, &log_size);
-      program_log = (char*) calloc(log_size+1, sizeof(char));
-      clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 
-            log_size+1, program_log, NULL);
-      printf("%s\n", program_log);
-      free(program_log);
+   /* Build program with the device's capabilities */
+   if(device_caps_options(device, NULL, options, sizeof(options)) < 0) {
+      printf("Couldn't write the build options\n");
       exit(1);
    }
+   if(device_caps_has_subgroups(device))
+      printf("Summing with subgroup functions\n");
+   program = program_load(context, device, PROGRAM_IMAGE(string_search),
+         PROGRAM_FILE, options, NULL);
 
    /* Create a kernel */
    kernel = clCreateKernel(program, KERNEL_FUNC, &err);
@@ -1,9 +1,42 @@
+#ifdef HAS_SUBGROUPS
+#pragma OPENCL EXTENSION cl_khr_subgroups : enable
+#endif
+
 __kernel void string_search(char16 pattern, __global char* text,
      int chars_per_item, __local int* local_result, 
      __global int* global_result) {
 
    char16 text_vector, check_vector;
 
+#ifdef HAS_SUBGROUPS
+
+   /* Count privately, add the counts across the subgroup and let its
+      first work-item add them to the global result. local_result and
+      the barriers aren't needed */
+   int4 counts = (int4)(0);
+   int item_offset = get_global_id(0) * chars_per_item;
+
+   for(int i=item_offset; i<item_offset + chars_per_item; i++) {
+      text_vector = vload16(0, text + i);
+      check_vector = text_vector == pattern;
+      counts.s0 += all(check_vector.s0123);
+      counts.s1 += all(check_vector.s4567);
+      counts.s2 += all(check_vector.s89AB);
+      counts.s3 += all(check_vector.sCDEF);
+   }
+
+   counts = (int4)(sub_group_reduce_add(counts.s0),
+                   sub_group_reduce_add(counts.s1),
+                   sub_group_reduce_add(counts.s2),
+                   sub_group_reduce_add(counts.s3));
+   if(get_sub_group_local_id() == 0) {
+      atomic_add(global_result, counts.s0);
+      atomic_add(global_result + 1, counts.s1);
+      atomic_add(global_result + 2, counts.s2);
+      atomic_add(global_result + 3, counts.s3);
+   }
+#else
+
    /* initialize local data */
    local_result[0] = 0;
    local_result[1] = 0;
@@ -51,4 +84,5 @@ __kernel void string_search(char16 pattern, __global char* text,
       atomic_add(global_result + 2, local_result[2]);
       atomic_add(global_result + 3, local_result[3]);
    }
+#endif
 }
@@ -3,6 +3,7 @@
 #define TRANSPOSE_FUNC "transpose"
 #define MULT_FUNC "matrix_mult"
 
+/* A multiple of every vector width the kernel may be built for */
 #define MATRIX_DIM 32
 
 #include <math.h>
@@ -17,6 +18,14 @@
 #include <CL/cl.h>
 #endif
 
+#include "device_caps.h"
+#include "program_binary.h"
+
+/* The kernels compiled for this machine by the Makefile */
+#ifdef PRECOMPILED
+#include "matrix_mult_binaries.h"
+#endif
+
 /* Find a GPU or CPU associated with the first available platform */
 cl_device_id create_device() {
 
@@ -44,56 +53,6 @@ cl_device_id create_device() {
    return dev;
 }
 
-/* Create program from a file and compile it */
-cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename) {
-
-   cl_program program;
-   FILE *program_handle;
-   char *program_buffer, *program_log;
-   size_t program_size, log_size;
-   int err;
-
-   /* Read program file and place content into buffer */
-   program_handle = fopen(filename, "r");
-   if(program_handle == NULL) {
-      perror("Couldn't find the program file");
-      exit(1);
-   }
-   fseek(program_handle, 0, SEEK_END);
-   program_size = ftell(program_handle);
-   rewind(program_handle);
-   program_buffer = (char*)malloc(program_size + 1);
-   program_buffer[program_size] = '\0';
-   fread(program_buffer, sizeof(char), program_size, program_handle);
-   fclose(program_handle);
-
-   /* Create program from file */
-   program = clCreateProgramWithSource(ctx, 1, 
-      (const char**)&program_buffer, &program_size, &err);
-   if(err < 0) {
-      perror("Couldn't create the program");
-      exit(1);
-   }
-   free(program_buffer);
-
-   /* Build program */
-   err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
-   if(err < 0) {
-
-      /* Find size of log and print to std output */
-      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
-            0, NULL, &log_size);
-      program_log = (char*) malloc(log_size + 1);
-      program_log[log_size] = '\0';
-      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
-            log_size + 1, program_log, NULL);
-      printf("%s\n", program_log);
-      free(program_log);
-      exit(1);
-   }
-   return program;
-}
-
 int main() {
 
    /* Host/device data structures */
@@ -101,9 +60,10 @@ int main() {
    cl_context context;
    cl_command_queue queue;
    cl_program program;
+   char options[1024];
+   const device_caps *caps;
    cl_kernel transpose_kernel, mult_kernel;
    size_t global_size;
-   cl_ulong mem_size;
    cl_int i, j, k, err, check;
 
    /* Data and buffers */
@@ -142,8 +102,14 @@ int main() {
       exit(1);   
    }
 
-   /* Build the program */
-   program = build_program(context, device, PROGRAM_FILE);
+   /* Build the program for this device's capabilities */
+   caps = device_caps_get(device);
+   if(device_caps_options(device, NULL, options, sizeof(options)) < 0) {
+      printf("Couldn't write the build options\n");
+      exit(1);
+   }
+   program = program_load(context, device, PROGRAM_IMAGE(matrix_mult),
+         PROGRAM_FILE, options, NULL);
 
    /* Create a kernel for the transpose function */
    transpose_kernel = clCreateKernel(program, TRANSPOSE_FUNC, &err);
@@ -182,13 +148,12 @@ int main() {
 
    /* Determine transpose parameters */
    global_size = (MATRIX_DIM/4 * (MATRIX_DIM/4 + 1))/2;
-   clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, 	
-         sizeof(mem_size), &mem_size, NULL);
 
    /* Set arguments for transpose kernel */
    matrix_dim = MATRIX_DIM/4;
    err |= clSetKernelArg(transpose_kernel, 0, sizeof(cl_mem), &b_buffer);
-   err |= clSetKernelArg(transpose_kernel, 1, (size_t)mem_size, NULL);
+   err |= clSetKernelArg(transpose_kernel, 1, (size_t)caps->local_mem_size,
+         NULL);
    err = clSetKernelArg(transpose_kernel, 2, sizeof(matrix_dim), &matrix_dim);
    if(err < 0) {
       printf("Couldn't set an argument for the transpose kernel");
@@ -1,21 +1,89 @@
-__kernel void matrix_mult(__global float4 *a_mat, 
-      __global float4 *b_mat, __global float *c_mat) {
+/* Built with the options from device_caps_options. The defaults below
+   are for a build without them */
+#ifndef VEC_WIDTH
+#define VEC_WIDTH 4
+#endif
+
+#ifndef LOCAL_MEM_SIZE
+#define LOCAL_MEM_SIZE 16384
+#endif
+
+#ifndef LOCAL_MEM_DEDICATED
+#define LOCAL_MEM_DEDICATED 1
+#endif
+
+/* floatn is a float vector of the preferred width, and SUM_VEC adds
+   its components */
+#if VEC_WIDTH == 1
+typedef float floatn;
+#define SUM_VEC(v) (v)
+#elif VEC_WIDTH == 2
+typedef float2 floatn;
+#define SUM_VEC(v) ((v).x + (v).y)
+#elif VEC_WIDTH == 4
+typedef float4 floatn;
+#define SUM_VEC(v) dot((v), (float4)(1.0f))
+#elif VEC_WIDTH == 8
+typedef float8 floatn;
+#define SUM_VEC(v) dot((v).lo + (v).hi, (float4)(1.0f))
+#else
+typedef float16 floatn;
+#define SUM_VEC(v) dot((v).lo.lo + (v).lo.hi + (v).hi.lo + (v).hi.hi, \
+      (float4)(1.0f))
+#endif
+
+/* Half of local memory holds a slice of a B row, at most 2048 vectors */
+#if LOCAL_MEM_SIZE/2/(4*VEC_WIDTH) > 2048
+#define TILE_VECS 2048
+#else
+#define TILE_VECS (LOCAL_MEM_SIZE/2/(4*VEC_WIDTH))
+#endif
+
+/* One row of C per work-item, with b_mat already transposed. Where local
+   memory is on-chip, each work-group copies slices of the B row into it
+   once instead of every work-item reading global memory. The number of
+   rows must be a multiple of VEC_WIDTH */
+__kernel void matrix_mult(__global floatn *a_mat, 
+      __global floatn *b_mat, __global float *c_mat) {
 
    float sum;
 
    int num_rows = get_global_size(0);
-   int vectors_per_row = num_rows/4;
+   int vectors_per_row = num_rows/VEC_WIDTH;
    int start = get_global_id(0) * vectors_per_row;
    a_mat += start;
-   c_mat += start*4;
+   c_mat += get_global_id(0) * num_rows;
+
+#if LOCAL_MEM_DEDICATED
+   __local floatn b_tile[TILE_VECS];
+   int lid = get_local_id(0);
+   int group_size = get_local_size(0);
+   int base, count;
 
+   for(int i=0; i<num_rows; i++) {
+      sum = 0.0f;
+      for(base=0; base<vectors_per_row; base+=TILE_VECS) {
+         count = min(TILE_VECS, vectors_per_row - base);
+         barrier(CLK_LOCAL_MEM_FENCE);
+         for(int j=lid; j<count; j+=group_size) {
+            b_tile[j] = b_mat[i * vectors_per_row + base + j];
+         }
+         barrier(CLK_LOCAL_MEM_FENCE);
+         for(int j=0; j<count; j++) {
+            sum += SUM_VEC(a_mat[base + j] * b_tile[j]);
+         }
+      }
+      c_mat[i] = sum;
+   }
+#else
    for(int i=0; i<num_rows; i++) {
       sum = 0.0f;
       for(int j=0; j<vectors_per_row; j++) {
-         sum += dot(a_mat[j], b_mat[i * vectors_per_row + j]);
+         sum += SUM_VEC(a_mat[j] * b_mat[i * vectors_per_row + j]);
       }
       c_mat[i] = sum;
    }   
+#endif
 }
 
 inline void on_diagonal_transpose(int row_size, 
@@ -17,6 +17,19 @@
 #include <CL/cl.h>
 #endif
 
+#include "device_caps.h"
+#include "precision_mode.h"
+#include "program_binary.h"
+
+/* The kernels compiled for this machine by the Makefile */
+#ifdef PRECOMPILED
+#include "conj_grad_binaries.h"
+#endif
+
+#ifdef CL_TRACE
+#include "cl_trace.h"
+#endif
+
 /* Rearrange data to be sorted by row instead of by column */
 void sort(int num, int *rows, int *cols, float *values) {
 
@@ -50,7 +63,7 @@ void sort(int num, int *rows, int *cols, float *values) {
    }
 }
 
-int main() {
+int main(int argc, char **argv) {
 
    /* Host/device data structures */
    cl_platform_id platform;
@@ -58,12 +71,11 @@ int main() {
    cl_context context;
    cl_command_queue queue;
    cl_int err, i;
+   int mode;
 
    /* Program/kernel data structures */
    cl_program program;
-   FILE *program_handle;
-   char *program_buffer, *program_log;
-   size_t program_size, log_size;
+   char options[1024];
    cl_kernel kernel;
    size_t global_size, local_size;
 
@@ -80,6 +92,9 @@ int main() {
    FILE *mm_handle;
    MM_typecode code;
 
+   /* Choose how the dot products accumulate */
+   mode = precision_mode_parse(argc, argv, accumulate_names);
+
    /* Read matrix file */   
    if ((mm_handle = fopen(MM_FILE, "r")) == NULL) {
       perror("Couldn't open the MatrixMarket file");
@@ -142,42 +157,21 @@ int main() {
       exit(1);   
    }
 
-   /* Read program file and place content into buffer */
-   program_handle = fopen(PROGRAM_FILE, "r");
-   if(program_handle == NULL) {
-      perror("Couldn't find the program file");
+   /* Build program with the device's capabilities and the
+      accumulation mode */
+   if(mode == MODE_FP64 && !device_caps_get(device)->fp64) {
+      printf("The device doesn't support double precision\n");
       exit(1);
    }
-   fseek(program_handle, 0, SEEK_END);
-   program_size = ftell(program_handle);
-   rewind(program_handle);
-   program_buffer = (char*)calloc(program_size+1, sizeof(char));
-   fread(program_buffer, sizeof(char), program_size, program_handle);
-   fclose(program_handle);
-
-   /* Create program from file */
-   program = clCreateProgramWithSource(context, 1, 
-      (const char**)&program_buffer, &program_size, &err);
-   if(err < 0) {
-      perror("Couldn't create the program");
-      exit(1);
-   }
-   free(program_buffer);
-
-   /* Build program */
-   err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
-   if(err < 0) {
-            
-      /* Find size of log and print to std output */
-      clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 
-            0, NULL, &log_size);
-      program_log = (char*) calloc(log_size+1, sizeof(char));
-      clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 
-            log_size+1, program_log, NULL);
-      printf("%s\n", program_log);
-      free(program_log);
+   if(device_caps_options(device, accumulate_options[mode], options,
+         sizeof(options)) < 0) {
+      printf("Couldn't write the build options\n");
       exit(1);
    }
+   if(device_caps_has_subgroups(device) && mode != MODE_KAHAN)
+      printf("Summing with subgroup functions\n");
+   program = program_load(context, device, PROGRAM_IMAGE(conj_grad),
+         PROGRAM_FILE, options, NULL);
 
    /* Create a kernel */
    kernel = clCreateKernel(program, KERNEL_FUNC, &err);
@@ -218,6 +212,8 @@ int main() {
    err |= clSetKernelArg(kernel, 8, sizeof(cl_mem), &values_buffer);
    err |= clSetKernelArg(kernel, 9, sizeof(cl_mem), &b_buffer);
    err |= clSetKernelArg(kernel, 10, sizeof(cl_mem), &result_buffer);
+   err |= clSetKernelArg(kernel, 11, num_rows * accumulate_sizes[mode],
+         NULL);
    if(err < 0) {
       printf("Couldn't set a kernel argument");
       exit(1);   
@@ -250,8 +246,8 @@ int main() {
    }
 
    /* Print the result */
-   printf("After %d iterations, the residual length is %f.\n", 
-         (int)result[0], result[1]);
+   printf("%s: after %d iterations, the residual length is %f.\n", 
+         accumulate_names[mode], (int)result[0], result[1]);
 
    /* Deallocate resources */
    free(b_vec);
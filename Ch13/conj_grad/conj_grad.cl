@@ -1,15 +1,70 @@
+/* acc_t, real_t and their operations for the mode the host chooses.
+   The scalars of the iteration are real_t */
+#include "accumulate.h"
+
+#ifdef ACC_SUB_GROUPS
+#pragma OPENCL EXTENSION cl_khr_subgroups : enable
+
+/* Sum of x over the work-group. Each subgroup adds its values without
+   barriers, then the first subgroup adds the subgroups' sums. The total
+   is only valid in the first subgroup */
+real_t group_sum(acc_t x, __local acc_t *sums) {
+
+   uint sg_lid = get_sub_group_local_id();
+
+   x = sub_group_reduce_add(x);
+   if(sg_lid == 0)
+      sums[get_sub_group_id()] = x;
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   if(get_sub_group_id() == 0) {
+      x = 0;
+      for(uint i=sg_lid; i<get_num_sub_groups(); i+=get_sub_group_size())
+         x += sums[i];
+      x = sub_group_reduce_add(x);
+   }
+   return x;
+}
+#else
+
+/* Sum of x over the work-group, by a tree in local memory. The group
+   needn't be a power of two: the first step folds everything above the
+   largest power of two below its size */
+real_t group_sum(acc_t x, __local acc_t *sums) {
+
+   uint id = get_local_id(0);
+   uint size = get_local_size(0);
+   uint i = 1;
+
+   sums[id] = x;
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   while(i < size)
+      i <<= 1;
+   for(i >>= 1; i>0; i >>= 1) {
+      if(id < i && id + i < size)
+         sums[id] = acc_merge(sums[id], sums[id + i]);
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+   return acc_value(sums[0]);
+}
+#endif
+
+/* The dot products are summed by group_sum, which leaves the result in
+   the first work-item, rather than by one work-item looping over dim */
 __kernel void conj_grad(int dim, int num_vals, __local float *r, 
       __local float *x, __local float* A_times_p, __local float *p,
       __global int *rows, __global int *cols, __global float *A, 
-      __global float *b, __global float *result) {
+      __global float *b, __global float *result, __local acc_t *sums) {
 
-   local float alpha, r_length, old_r_dot_r, new_r_dot_r;
+   local real_t alpha, r_length, old_r_dot_r, new_r_dot_r;
    local int iteration;
 
    int id = get_local_id(0);
    int start_index = -1;
    int end_index = -1;
-   float Ap_dot_p;
+   real_t sum;
+   acc_t row_sum;
 
    /* Find matrix values for each work-item */
    for(int i=id; i<num_vals; i++) {
@@ -31,11 +86,9 @@ __kernel void conj_grad(int dim, int num_vals, __local float *r,
    barrier(CLK_LOCAL_MEM_FENCE);
 
    /* Compute old r_dot_r */
+   sum = group_sum(acc_product(r[id], r[id]), sums);
    if(id == 0) {
-      old_r_dot_r = 0.0f;
-      for(int i=0; i<dim; i++) {
-         old_r_dot_r += r[i] * r[i];
-      }
+      old_r_dot_r = sum;
       r_length = sqrt(old_r_dot_r);
    }
    barrier(CLK_LOCAL_MEM_FENCE);
@@ -44,19 +97,17 @@ __kernel void conj_grad(int dim, int num_vals, __local float *r,
    while((iteration < 1000) && (r_length >= 0.01)) {
 
       /* Compute Ap.p */
-      A_times_p[id] = 0.0f;
+      row_sum = ACC_ZERO;
       for(int i=start_index; i<=end_index; i++) {
-         A_times_p[id] += A[i] * p[cols[i]];
+         row_sum = acc_add_product(row_sum, A[i], p[cols[i]]);
       }
+      A_times_p[id] = acc_value(row_sum);
       barrier(CLK_LOCAL_MEM_FENCE);
 
       /* Compute alpha = r.r/Ap.p */
+      sum = group_sum(acc_product(A_times_p[id], p[id]), sums);
       if(id == 0) {
-         Ap_dot_p = 0.0f;
-         for(int i=0; i<dim; i++) {
-            Ap_dot_p += A_times_p[i] * p[i];
-         } 
-         alpha = old_r_dot_r/Ap_dot_p;
+         alpha = old_r_dot_r/sum;
       }
       barrier(CLK_LOCAL_MEM_FENCE);
 
@@ -66,11 +117,9 @@ __kernel void conj_grad(int dim, int num_vals, __local float *r,
       barrier(CLK_LOCAL_MEM_FENCE);
 
       /* Compute new r_dot_r */
+      sum = group_sum(acc_product(r[id], r[id]), sums);
       if(id == 0) {
-         new_r_dot_r = 0.0f;
-         for(int i=0; i<dim; i++) {
-            new_r_dot_r += r[i] * r[i];
-         }
+         new_r_dot_r = sum;
          r_length = sqrt(new_r_dot_r);
       }
       barrier(CLK_LOCAL_MEM_FENCE);
@@ -4,6 +4,13 @@
 #define STAGE_FUNC "fft_stage"
 #define SCALE_FUNC "fft_scale"
 
+/* The device library with bit_reverse4 */
+#define LIB_FILE "../../Ch2/program_link/device_lib.cl"
+#define LIB_HEADER "../../Ch2/program_link/device_lib.h"
+
+/* The precompiled program includes the library's source from here */
+#define DEVICE_LIB_OPTION "-I../../Ch2/program_link"
+
 /* Each point contains 2 floats - 1 real, 1 imaginary */
 #define NUM_POINTS 65536
 
@@ -24,6 +31,20 @@
 #include <CL/cl.h>
 #endif
 
+#include "cl_library.h"
+#include "device_caps.h"
+#include "precision_mode.h"
+#include "program_binary.h"
+
+/* The kernels compiled for this machine by the Makefile */
+#ifdef PRECOMPILED
+#include "fft_binaries.h"
+#endif
+
+#ifdef CL_TRACE
+#include "cl_trace.h"
+#endif
+
 /* Find a GPU or CPU associated with the first available platform */
 cl_device_id create_device() {
 
@@ -51,66 +72,27 @@ cl_device_id create_device() {
    return dev;
 }
 
-/* Create program from a file and compile it */
-cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename) {
+/* The FFT's modes. Instead of Kahan summation, the middle one takes
+   its twiddles from sinpi and cospi */
+static const char *mode_names[NUM_MODES] = {"fp32", "exact-twiddle", "fp64"};
+static const char *mode_options[NUM_MODES] = {
+   NULL, "-DPRECISION_EXACT_TWIDDLE", "-DPRECISION_DOUBLE"
+};
+static const size_t complex_sizes[NUM_MODES] = {
+   2 * sizeof(cl_float), 2 * sizeof(cl_float), 2 * sizeof(cl_double)
+};
 
-   cl_program program;
-   FILE *program_handle;
-   char *program_buffer, *program_log;
-   size_t program_size, log_size;
-   int err;
-
-   /* Read program file and place content into buffer */
-   program_handle = fopen(filename, "r");
-   if(program_handle == NULL) {
-      perror("Couldn't find the program file");
-      exit(1);
-   }
-   fseek(program_handle, 0, SEEK_END);
-   program_size = ftell(program_handle);
-   rewind(program_handle);
-   program_buffer = (char*)malloc(program_size + 1);
-   program_buffer[program_size] = '\0';
-   fread(program_buffer, sizeof(char), program_size, program_handle);
-   fclose(program_handle);
-
-   /* Create program from file */
-   program = clCreateProgramWithSource(ctx, 1, 
-      (const char**)&program_buffer, &program_size, &err);
-   if(err < 0) {
-      perror("Couldn't create the program");
-      exit(1);
-   }
-   free(program_buffer);
-
-   /* Build program */
-   err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
-   if(err < 0) {
-
-      /* Find size of log and print to std output */
-      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
-            0, NULL, &log_size);
-      program_log = (char*) malloc(log_size + 1);
-      program_log[log_size] = '\0';
-      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
-            log_size + 1, program_log, NULL);
-      printf("%s\n", program_log);
-      free(program_log);
-      exit(1);
-   }
-
-   return program;
-}
-
-int main() {
+int main(int argc, char **argv) {
 
    /* Host/device data structures */
    cl_device_id device;
    cl_context context;
    cl_command_queue queue;
+   cl_library lib;
    cl_program program;
    cl_kernel init_kernel, stage_kernel, scale_kernel;
    cl_int err, i;
+   int mode, linked = 0;
    size_t global_size, local_size;
    cl_ulong local_mem_size;
 
@@ -121,6 +103,9 @@ int main() {
    double error, check_input[NUM_POINTS][2], check_output[NUM_POINTS][2];
    cl_mem data_buffer;
 
+   /* Choose the precision */
+   mode = precision_mode_parse(argc, argv, mode_names);
+
    /* Initialize data */
    srand(time(NULL));
    for(i=0; i<NUM_POINTS; i++) {
@@ -139,7 +124,23 @@ int main() {
    }
 
    /* Build the program */
-   program = build_program(context, device, PROGRAM_FILE);
+   if(mode == MODE_FP64 && !device_caps_get(device)->fp64) {
+      printf("The device doesn't support double precision\n");
+      exit(1);
+   }
+   /* Only the fp32 mode is precompiled. The others, or an image that
+      doesn't load, are linked with the device library */
+   program = NULL;
+   if(mode == MODE_FP32)
+      program = program_load_image(context, device, PROGRAM_IMAGE(fft),
+            DEVICE_LIB_OPTION);
+   if(program == NULL) {
+      cl_library_create(&lib, context, device, LIB_FILE, LIB_HEADER,
+            "device_lib.h", NULL);
+      program = cl_library_link(&lib, context, device, PROGRAM_FILE,
+            mode_options[mode]);
+      linked = 1;
+   }
 
    /* Create kernels for the FFT */
    init_kernel = clCreateKernel(program, INIT_FUNC, &err);
@@ -187,7 +188,7 @@ int main() {
    /* Initialize kernel arguments */
    direction = DIRECTION;
    num_points = NUM_POINTS;
-   points_per_group = local_mem_size/(2*sizeof(float));
+   points_per_group = local_mem_size/complex_sizes[mode];
    if(points_per_group > num_points)
       points_per_group = num_points;
 
@@ -279,7 +280,7 @@ int main() {
    error = error/(NUM_POINTS*2);
 
    /* Display check results */
-   printf("%u-point ", num_points);
+   printf("%s: %u-point ", mode_names[mode], num_points);
    if(direction > 0) 
       printf("FFT ");
    else
@@ -293,6 +294,8 @@ int main() {
    clReleaseKernel(scale_kernel);
    clReleaseCommandQueue(queue);
    clReleaseProgram(program);
+   if(linked)
+      cl_library_release(&lib);
    clReleaseContext(context);
    return 0;
 }
@@ -1,18 +1,66 @@
-#define mask_left fft_index
-#define mask_right stage
-#define shift_pos N2
+/* bit_reverse4 comes from the device library in Ch2/program_link,
+   linked in or, in a build from source, included by its header */
+#include "device_lib.h"
+
+/* Points are stored as float2, or with HALF_STORAGE as two halves,
+   which vload_half2/vstore_half2 convert without cl_khr_fp16 */
+#ifdef HALF_STORAGE
+typedef half storage_t;
+#define LOAD_FLOAT2(p, i) vload_half2(i, p)
+#define STORE_FLOAT2(x, p, i) vstore_half2(x, i, p)
+#else
+typedef float2 storage_t;
+#define LOAD_FLOAT2(p, i) (p)[i]
+#define STORE_FLOAT2(x, p, i) ((p)[i] = (x))
+#endif
+
+/* Precision modes for the arithmetic, chosen at build time.
+
+   PRECISION_DOUBLE  butterflies and twiddles in double, which needs
+                     cl_khr_fp64
+   PRECISION_EXACT_TWIDDLE
+                     float butterflies with twiddles from sinpi/cospi,
+                     whose argument k/N is exact, rather than from
+                     sin/cos of the rounded product M_PI_F*k
+   neither           float throughout */
+#if defined(PRECISION_DOUBLE)
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+
+typedef double real_t;
+typedef double2 complex_t;
+#define LOAD(p, i) convert_double2(LOAD_FLOAT2(p, i))
+#define STORE(x, p, i) STORE_FLOAT2(convert_float2(x), p, i)
+#define COS_PI(k, n) cospi((double)(k)/(n))
+#define SIN_PI(k, n) sinpi((double)(k)/(n))
+
+#else
+
+typedef float real_t;
+typedef float2 complex_t;
+#define LOAD(p, i) LOAD_FLOAT2(p, i)
+#define STORE(x, p, i) STORE_FLOAT2(x, p, i)
+#ifdef PRECISION_EXACT_TWIDDLE
+#define COS_PI(k, n) cospi((float)(k)/(n))
+#define SIN_PI(k, n) sinpi((float)(k)/(n))
+#else
+#define COS_PI(k, n) cos(M_PI_F*(k)/(n))
+#define SIN_PI(k, n) sin(M_PI_F*(k)/(n))
+#endif
+
+#endif
+
 #define angle size
 #define start br.s0
 #define cosine x3.s0
 #define sine x3.s1
 #define wk x2
 
-__kernel void fft_init(__global float2* g_data, __local float2* l_data, 
+__kernel void fft_init(__global storage_t* g_data, __local complex_t* l_data, 
                        uint points_per_group, uint size, int dir) {
 
    uint4 br, index;
    uint points_per_item, g_addr, l_addr, i, fft_index, stage, N2;
-   float2 x1, x2, x3, x4, sum12, diff12, sum34, diff34;
+   complex_t x1, x2, x3, x4, sum12, diff12, sum34, diff34;
 
    points_per_item = points_per_group/get_local_size(0);
    l_addr = get_local_id(0) * points_per_item;
@@ -21,31 +69,22 @@ __kernel void fft_init(__global float2* g_data, __local float2* l_data,
    /* Load data from bit-reversed addresses and perform 4-point FFTs */
    for(i=0; i<points_per_item; i+=4) {
       index = (uint4)(g_addr, g_addr+1, g_addr+2, g_addr+3);
-      mask_left = size/2;
-      mask_right = 1;
-      shift_pos = log2(size)-1;
-      br = (index << shift_pos) & mask_left;
-      br |= (index >> shift_pos) & mask_right;
-
-      /* Bit-reverse addresses */
-      while(shift_pos > 1) {
-         shift_pos -= 2;
-         mask_left >>= 1;
-         mask_right <<= 1;
-         br |= (index << shift_pos) & mask_left;
-         br |= (index >> shift_pos) & mask_right;
-      }
+
+      /* Bit-reverse addresses, keeping the transform's base so a buffer
+         can hold a batch */
+      br = bit_reverse4(index, size);
+      br |= index & ~(size - 1);
 
       /* Load global data */
-      x1 = g_data[br.s0];
-      x2 = g_data[br.s1];
-      x3 = g_data[br.s2];
-      x4 = g_data[br.s3];
+      x1 = LOAD(g_data, br.s0);
+      x2 = LOAD(g_data, br.s1);
+      x3 = LOAD(g_data, br.s2);
+      x4 = LOAD(g_data, br.s3);
 
       sum12 = x1 + x2;
       diff12 = x1 - x2;
       sum34 = x3 + x4;
-      diff34 = (float2)(x3.s1 - x4.s1, x4.s0 - x3.s0) * dir;
+      diff34 = (complex_t)(x3.s1 - x4.s1, x4.s0 - x3.s0) * dir;
       l_data[l_addr] = sum12 + sum34;
       l_data[l_addr+1] = diff12 + diff34;
       l_data[l_addr+2] = sum12 - sum34;
@@ -62,9 +101,9 @@ __kernel void fft_init(__global float2* g_data, __local float2* l_data,
          l_data[l_addr] += l_data[l_addr + N2];
          l_data[l_addr + N2] = x1 - l_data[l_addr + N2];
          for(i=1; i<N2; i++) {
-            cosine = cos(M_PI_F*i/N2);
-            sine = dir * sin(M_PI_F*i/N2);
-            wk = (float2)(l_data[l_addr+N2+i].s0*cosine + l_data[l_addr+N2+i].s1*sine, 
+            cosine = COS_PI(i, N2);
+            sine = dir * SIN_PI(i, N2);
+            wk = (complex_t)(l_data[l_addr+N2+i].s0*cosine + l_data[l_addr+N2+i].s1*sine, 
                           l_data[l_addr+N2+i].s1*cosine - l_data[l_addr+N2+i].s0*sine);
             l_data[l_addr+N2+i] = l_data[l_addr+i] - wk;
             l_data[l_addr+i] += wk;
@@ -80,9 +119,9 @@ __kernel void fft_init(__global float2* g_data, __local float2* l_data,
       start = (get_local_id(0) + (get_local_id(0)/stage)*stage) * (points_per_item/2);
       angle = start % (N2*2);
       for(i=start; i<start + points_per_item/2; i++) {
-         cosine = cos(M_PI_F*angle/N2);
-         sine = dir * sin(M_PI_F*angle/N2);
-         wk = (float2)(l_data[N2+i].s0*cosine + l_data[N2+i].s1*sine, 
+         cosine = COS_PI(angle, N2);
+         sine = dir * SIN_PI(angle, N2);
+         wk = (complex_t)(l_data[N2+i].s0*cosine + l_data[N2+i].s1*sine, 
                        l_data[N2+i].s1*cosine - l_data[N2+i].s0*sine);
          l_data[N2+i] = l_data[i] - wk;
          l_data[i] += wk;
@@ -96,20 +135,20 @@ __kernel void fft_init(__global float2* g_data, __local float2* l_data,
    l_addr = get_local_id(0) * points_per_item;
    g_addr = get_group_id(0) * points_per_group + l_addr;
    for(i=0; i<points_per_item; i+=4) {
-      g_data[g_addr] = l_data[l_addr];
-      g_data[g_addr+1] = l_data[l_addr+1];
-      g_data[g_addr+2] = l_data[l_addr+2];
-      g_data[g_addr+3] = l_data[l_addr+3];    
+      STORE(l_data[l_addr], g_data, g_addr);
+      STORE(l_data[l_addr+1], g_data, g_addr+1);
+      STORE(l_data[l_addr+2], g_data, g_addr+2);
+      STORE(l_data[l_addr+3], g_data, g_addr+3);    
       g_addr += 4;
       l_addr += 4;
    }
 }
 
-__kernel void fft_stage(__global float2* g_data, uint stage, uint points_per_group, int dir) {
+__kernel void fft_stage(__global storage_t* g_data, uint stage, uint points_per_group, int dir) {
 
    uint points_per_item, addr, N, ang, i;
-   float c, s;
-   float2 input1, input2, w;
+   real_t c, s;
+   complex_t input1, input2, w;
 
    points_per_item = points_per_group/get_local_size(0);
    addr = (get_group_id(0) + (get_group_id(0)/stage)*stage) * (points_per_group/2) +
@@ -118,18 +157,18 @@ __kernel void fft_stage(__global float2* g_data, uint stage, uint points_per_gro
    ang = addr % (N*2);
 
    for(i=addr; i<addr + points_per_item/2; i++) {
-      c = cos(M_PI_F*ang/N);
-      s = dir * sin(M_PI_F*ang/N);
-      input1 = g_data[i];
-      input2 = g_data[i+N];
-      w = (float2)(input2.s0*c + input2.s1*s, input2.s1*c - input2.s0*s);
-      g_data[i] = input1 + w;
-      g_data[i+N] = input1 - w;
+      c = COS_PI(ang, N);
+      s = dir * SIN_PI(ang, N);
+      input1 = LOAD(g_data, i);
+      input2 = LOAD(g_data, i+N);
+      w = (complex_t)(input2.s0*c + input2.s1*s, input2.s1*c - input2.s0*s);
+      STORE(input1 + w, g_data, i);
+      STORE(input1 - w, g_data, i+N);
       ang++;
    }
 }
 
-__kernel void fft_scale(__global float2* g_data, uint points_per_group, uint scale) {
+__kernel void fft_scale(__global storage_t* g_data, uint points_per_group, uint scale) {
 
    uint points_per_item, addr, i;
 
@@ -137,6 +176,6 @@ __kernel void fft_scale(__global float2* g_data, uint points_per_group, uint sca
    addr = get_group_id(0) * points_per_group + get_local_id(0) * points_per_item;
 
    for(i=addr; i<addr + points_per_item; i++) {
-      g_data[i] /= scale;
+      STORE(LOAD(g_data, i)/scale, g_data, i);
    }
 }
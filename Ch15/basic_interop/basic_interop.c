@@ -19,6 +19,13 @@
 #define GL_SHARING_EXTENSION "cl_khr_gl_sharing"
 #endif
 
+#include "program_binary.h"
+
+/* The kernels compiled for this machine by the Makefile */
+#ifdef PRECOMPILED
+#include "basic_interop_binaries.h"
+#endif
+
 cl_platform_id platform;
 cl_device_id device;
 cl_context context;
@@ -54,8 +61,6 @@ char* read_file(const char* filename, size_t* size) {
 /* Initialize OpenCl processing */
 void init_cl() {
 
-   char *program_buffer, *program_log;
-   size_t program_size, log_size;
    int err;
 
    /* Identify a platform */
@@ -103,31 +108,9 @@ void init_cl() {
       exit(1);   
    }
 
-   /* Create program from file */
-   program_buffer = read_file(PROGRAM_FILE, &program_size);
-   program = clCreateProgramWithSource(context, 1, 
-      (const char**)&program_buffer, &program_size, &err);
-   if(err < 0) {
-      perror("Couldn't create the program");
-      exit(1);
-   }
-   free(program_buffer);
-
    /* Build program */
-   err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
-   if(err < 0) {
-
-      /* Find size of log and print to std output */
-      clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 
-            0, NULL, &log_size);
-      program_log = (char*) malloc(log_size + 1);
-      program_log[log_size] = '\0';
-      clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 
-            log_size + 1, program_log, NULL);
-      printf("%s\n", program_log);
-      free(program_log);
-      exit(1);
-   }
+   program = program_load(context, device, PROGRAM_IMAGE(basic_interop),
+         PROGRAM_FILE, NULL, NULL);
 
    /* Create a command queue */
    queue = clCreateCommandQueue(context, device, 0, &err);
@@ -0,0 +1,458 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define _POSIX_C_SOURCE 200809L
+#define PROGRAM_FILE "../texture_filter/texture_filter.cl"
+#define KERNEL_FUNC "texture_filter"
+
+#define INPUT_DIR "../texture_filter"
+#define OUTPUT_DIR "output"
+
+#define NUM_IO_THREADS 4
+#define MAX_IN_FLIGHT 4
+
+/* Decoded images waiting for the device */
+#define DECODED_CAPACITY (4 * MAX_IN_FLIGHT)
+
+#define PNG_DEBUG 3
+#include <png.h>
+
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "program_binary.h"
+
+/* The kernels compiled for this machine by the Makefile */
+#ifdef PRECOMPILED
+#include "batch_filter_binaries.h"
+#endif
+
+/* One image moving through decode -> upload -> filter -> download -> encode */
+typedef struct job {
+   char in_path[1024], out_path[1024];
+   png_bytep in_pixels, out_pixels;
+   size_t width, height;
+   cl_mem in_image, out_buffer;
+   cl_event read_event;
+   struct job *next;
+} job;
+
+/* Blocking FIFO shared between pipeline stages. A push waits while
+   the queue holds capacity jobs, unless capacity is 0 */
+typedef struct {
+   job *head, *tail;
+   int count, capacity, closed;
+   pthread_mutex_t lock;
+   pthread_cond_t ready, space;
+} job_queue;
+
+job_queue path_queue, decoded_queue, encode_queue;
+
+/* Number of jobs holding device memory, from upload until encoded,
+   bounded by MAX_IN_FLIGHT */
+int in_flight;
+pthread_mutex_t flight_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t flight_ready = PTHREAD_COND_INITIALIZER;
+
+void queue_init(job_queue *q, int capacity) {
+   q->head = q->tail = NULL;
+   q->count = 0;
+   q->capacity = capacity;
+   q->closed = 0;
+   pthread_mutex_init(&q->lock, NULL);
+   pthread_cond_init(&q->ready, NULL);
+   pthread_cond_init(&q->space, NULL);
+}
+
+void queue_push(job_queue *q, job *j) {
+   pthread_mutex_lock(&q->lock);
+   while(q->capacity > 0 && q->count >= q->capacity)
+      pthread_cond_wait(&q->space, &q->lock);
+   q->count++;
+   j->next = NULL;
+   if(q->tail)
+      q->tail->next = j;
+   else
+      q->head = j;
+   q->tail = j;
+   pthread_cond_signal(&q->ready);
+   pthread_mutex_unlock(&q->lock);
+}
+
+/* Returns NULL once the queue is closed and drained */
+job* queue_pop(job_queue *q) {
+   job *j;
+   pthread_mutex_lock(&q->lock);
+   while(q->head == NULL && !q->closed)
+      pthread_cond_wait(&q->ready, &q->lock);
+   j = q->head;
+   if(j) {
+      q->head = j->next;
+      if(q->head == NULL)
+         q->tail = NULL;
+      q->count--;
+      pthread_cond_signal(&q->space);
+   }
+   pthread_mutex_unlock(&q->lock);
+   return j;
+}
+
+void queue_close(job_queue *q) {
+   pthread_mutex_lock(&q->lock);
+   q->closed = 1;
+   pthread_cond_broadcast(&q->ready);
+   pthread_mutex_unlock(&q->lock);
+}
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   }
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);
+   }
+
+   return dev;
+}
+
+/* Read a PNG and convert it to 8-bit grayscale. Returns -1 and
+   leaves *data NULL if the file can't be read or decoded */
+int read_image_data(const char* filename, png_bytep* data, size_t* w, size_t* h) {
+
+   int i, color_type;
+   FILE *png_input;
+   png_structp png_ptr;
+   png_infop info_ptr = NULL;
+
+   *data = NULL;
+
+   /* Open input file */
+   if((png_input = fopen(filename, "rb")) == NULL) {
+      perror("Can't read input image file");
+      return -1;
+   }
+
+   /* libpng jumps back here if the file is corrupt or truncated */
+   png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+   if(png_ptr != NULL)
+      info_ptr = png_create_info_struct(png_ptr);
+   if(info_ptr == NULL || setjmp(png_jmpbuf(png_ptr))) {
+      png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
+      fclose(png_input);
+      free(*data);
+      *data = NULL;
+      return -1;
+   }
+
+   /* Read image data */
+   png_init_io(png_ptr, png_input);
+   png_read_info(png_ptr, info_ptr);
+
+   *w = png_get_image_width(png_ptr, info_ptr);
+   *h = png_get_image_height(png_ptr, info_ptr);
+
+   /* The filter expects one unsigned byte per pixel */
+   color_type = png_get_color_type(png_ptr, info_ptr);
+   png_set_strip_16(png_ptr);
+   png_set_strip_alpha(png_ptr);
+   if(color_type == PNG_COLOR_TYPE_PALETTE)
+      png_set_palette_to_rgb(png_ptr);
+   if(color_type == PNG_COLOR_TYPE_GRAY)
+      png_set_expand_gray_1_2_4_to_8(png_ptr);
+   if(color_type & PNG_COLOR_MASK_COLOR || color_type == PNG_COLOR_TYPE_PALETTE)
+      png_set_rgb_to_gray_fixed(png_ptr, 1, -1, -1);
+   png_read_update_info(png_ptr, info_ptr);
+
+   /* Allocate memory and read image data */
+   *data = malloc(*h * png_get_rowbytes(png_ptr, info_ptr));
+   for(i=0; i<*h; i++) {
+      png_read_row(png_ptr, *data + i * png_get_rowbytes(png_ptr, info_ptr), NULL);
+   }
+
+   /* Close input file */
+   png_read_end(png_ptr, info_ptr);
+   png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
+   fclose(png_input);
+   return 0;
+}
+
+void write_image_data(const char* filename, png_bytep data, size_t w, size_t h) {
+
+   int i;
+
+   /* Open output file */
+   FILE *png_output;
+   if((png_output = fopen(filename, "wb")) == NULL) {
+      perror("Create output image file");
+      exit(1);
+   }
+
+   /* Write image data */
+   png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+   png_infop info_ptr = png_create_info_struct(png_ptr);
+   png_init_io(png_ptr, png_output);
+   png_set_IHDR(png_ptr, info_ptr, w, h, 8,
+         PNG_COLOR_TYPE_GRAY, PNG_INTERLACE_NONE,
+         PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+   png_write_info(png_ptr, info_ptr);
+   for(i=0; i<h; i++) {
+      png_write_row(png_ptr, data + i * w);
+   }
+
+   /* Close file */
+   png_write_end(png_ptr, NULL);
+   png_destroy_write_struct(&png_ptr, &info_ptr);
+   fclose(png_output);
+}
+
+/* Decode stage: path_queue -> decoded_queue. Images that fail to decode
+   are passed on with no pixels so the main thread can count them */
+void* decode_thread(void *arg) {
+   job *j;
+   while((j = queue_pop(&path_queue)) != NULL) {
+      if(read_image_data(j->in_path, &j->in_pixels, &j->width, &j->height) < 0)
+         printf("Couldn't decode %s, skipping it\n", j->in_path);
+      queue_push(&decoded_queue, j);
+   }
+   return NULL;
+}
+
+/* Encode stage: encode_queue -> disk. Freeing the device memory frees
+   a slot for the next upload */
+void* encode_thread(void *arg) {
+   job *j;
+   while((j = queue_pop(&encode_queue)) != NULL) {
+      write_image_data(j->out_path, j->out_pixels, j->width, j->height);
+      clReleaseEvent(j->read_event);
+      clReleaseMemObject(j->in_image);
+      clReleaseMemObject(j->out_buffer);
+      free(j->in_pixels);
+      free(j->out_pixels);
+      free(j);
+
+      pthread_mutex_lock(&flight_lock);
+      in_flight--;
+      pthread_cond_signal(&flight_ready);
+      pthread_mutex_unlock(&flight_lock);
+   }
+   return NULL;
+}
+
+/* Download complete: hand the job to the encoders. The encode queue holds
+   MAX_IN_FLIGHT jobs, and every job in it still holds a slot, so this
+   push never blocks the runtime's callback thread */
+void CL_CALLBACK read_complete(cl_event e, cl_int status, void* data) {
+
+   if(status < 0) {
+      printf("Couldn't process %s: %d\n", ((job*)data)->in_path, status);
+      exit(1);
+   }
+   queue_push(&encode_queue, (job*)data);
+}
+
+int has_png_suffix(const char* name) {
+   size_t len = strlen(name);
+   return len > 4 && strcmp(name + len - 4, ".png") == 0;
+}
+
+int main(int argc, char **argv) {
+
+   /* Host/device data structures */
+   cl_device_id device;
+   cl_context context;
+   cl_command_queue queue;
+   cl_program program;
+   cl_kernel kernel;
+   cl_int err;
+   cl_image_format png_format;
+   size_t global_size[2], origin[3], region[3];
+
+   /* Pipeline */
+   const char *in_dir, *out_dir;
+   pthread_t decoders[NUM_IO_THREADS], encoders[NUM_IO_THREADS];
+   DIR *dir;
+   struct dirent *entry;
+   struct timespec start, end;
+   job *j;
+   int i, num_images = 0, num_failed = 0;
+
+   in_dir = argc > 1 ? argv[1] : INPUT_DIR;
+   out_dir = argc > 2 ? argv[2] : OUTPUT_DIR;
+   mkdir(out_dir, 0755);
+
+   /* Create a device, context and queue - no display required */
+   device = create_device();
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);
+   }
+   queue = clCreateCommandQueue(context, device, 0, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);
+   };
+
+   /* Create kernel */
+   program = program_load(context, device, PROGRAM_IMAGE(texture_filter),
+         PROGRAM_FILE, NULL, NULL);
+   kernel = clCreateKernel(program, KERNEL_FUNC, &err);
+   if(err < 0) {
+      printf("Couldn't create a kernel: %d", err);
+      exit(1);
+   };
+   png_format.image_channel_order = CL_R;
+   png_format.image_channel_data_type = CL_UNSIGNED_INT8;
+
+   /* Start the PNG I/O thread pools. The path queue is unbounded because
+      every path is queued before the main thread starts popping images */
+   queue_init(&path_queue, 0);
+   queue_init(&decoded_queue, DECODED_CAPACITY);
+   queue_init(&encode_queue, MAX_IN_FLIGHT);
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   for(i=0; i<NUM_IO_THREADS; i++) {
+      pthread_create(&decoders[i], NULL, decode_thread, NULL);
+      pthread_create(&encoders[i], NULL, encode_thread, NULL);
+   }
+
+   /* Queue every PNG in the input directory */
+   if((dir = opendir(in_dir)) == NULL) {
+      perror("Couldn't open the input directory");
+      exit(1);
+   }
+   while((entry = readdir(dir)) != NULL) {
+      if(!has_png_suffix(entry->d_name))
+         continue;
+      j = (job*)calloc(1, sizeof(job));
+      snprintf(j->in_path, sizeof(j->in_path), "%s/%s", in_dir, entry->d_name);
+      snprintf(j->out_path, sizeof(j->out_path), "%s/%s", out_dir, entry->d_name);
+      queue_push(&path_queue, j);
+      num_images++;
+   }
+   closedir(dir);
+   queue_close(&path_queue);
+
+   /* Upload, filter and download decoded images as they arrive */
+   for(i=0; i<num_images; i++) {
+      j = queue_pop(&decoded_queue);
+      if(j->in_pixels == NULL) {
+         free(j);
+         num_failed++;
+         continue;
+      }
+
+      /* Bound the number of images resident on the device */
+      pthread_mutex_lock(&flight_lock);
+      while(in_flight >= MAX_IN_FLIGHT)
+         pthread_cond_wait(&flight_ready, &flight_lock);
+      in_flight++;
+      pthread_mutex_unlock(&flight_lock);
+
+      j->in_image = clCreateImage2D(context, CL_MEM_READ_ONLY,
+            &png_format, j->width, j->height, 0, NULL, &err);
+      if(err < 0) {
+         perror("Couldn't create the image object");
+         exit(1);
+      };
+      j->out_buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY,
+            j->width * j->height, NULL, &err);
+      if(err < 0) {
+         perror("Couldn't create a buffer");
+         exit(1);
+      };
+      j->out_pixels = (png_bytep)malloc(j->width * j->height);
+
+      /* Non-blocking upload */
+      origin[0] = 0; origin[1] = 0; origin[2] = 0;
+      region[0] = j->width; region[1] = j->height; region[2] = 1;
+      err = clEnqueueWriteImage(queue, j->in_image, CL_FALSE, origin,
+            region, j->width, 0, j->in_pixels, 0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't write to the image object");
+         exit(1);
+      }
+
+      /* Filter */
+      err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &j->in_image);
+      err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &j->out_buffer);
+      if(err < 0) {
+         printf("Couldn't set a kernel argument");
+         exit(1);
+      };
+      global_size[0] = j->width;
+      global_size[1] = j->height;
+      err = clEnqueueNDRangeKernel(queue, kernel, 2, NULL, global_size,
+            NULL, 0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't enqueue the kernel");
+         exit(1);
+      }
+
+      /* Non-blocking download, completed by callback */
+      err = clEnqueueReadBuffer(queue, j->out_buffer, CL_FALSE, 0,
+            j->width * j->height, j->out_pixels, 0, NULL, &j->read_event);
+      if(err < 0) {
+         perror("Couldn't read the buffer");
+         exit(1);
+      }
+      err = clSetEventCallback(j->read_event, CL_COMPLETE, &read_complete, j);
+      if(err < 0) {
+         perror("Couldn't set callback for event");
+         exit(1);
+      }
+      clFlush(queue);
+   }
+
+   /* Drain the device and the encoders */
+   clFinish(queue);
+   pthread_mutex_lock(&flight_lock);
+   while(in_flight > 0)
+      pthread_cond_wait(&flight_ready, &flight_lock);
+   pthread_mutex_unlock(&flight_lock);
+   queue_close(&decoded_queue);
+   queue_close(&encode_queue);
+   for(i=0; i<NUM_IO_THREADS; i++) {
+      pthread_join(decoders[i], NULL);
+      pthread_join(encoders[i], NULL);
+   }
+   clock_gettime(CLOCK_MONOTONIC, &end);
+
+   printf("Filtered %d images from %s into %s\n", num_images - num_failed,
+         in_dir, out_dir);
+   if(num_failed > 0)
+      printf("Skipped %d images that couldn't be decoded\n", num_failed);
+   printf("Elapsed time: %.3f s\n", (end.tv_sec - start.tv_sec) +
+         (end.tv_nsec - start.tv_nsec) * 1.0e-9);
+
+   /* Deallocate resources */
+   clReleaseKernel(kernel);
+   clReleaseCommandQueue(queue);
+   clReleaseProgram(program);
+   clReleaseContext(context);
+   return 0;
+}
@@ -0,0 +1,309 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "filter.h"
+
+/* Build options for each channel type */
+static const char* type_options[FILTER_NUM_TYPES] = {
+   "-DPIXEL=uchar -DPIXEL_UCHAR",
+   "-DPIXEL=ushort -DPIXEL_USHORT",
+   "-DPIXEL=float -DPIXEL_FLOAT"
+};
+
+size_t filter_pixel_size(filter_type type) {
+   switch(type) {
+      case FILTER_USHORT: return sizeof(cl_ushort);
+      case FILTER_FLOAT: return sizeof(cl_float);
+      default: return sizeof(cl_uchar);
+   }
+}
+
+static cl_kernel create_kernel(cl_program program, const char* name) {
+
+   cl_kernel kernel;
+   int err;
+
+   kernel = clCreateKernel(program, name, &err);
+   if(err < 0) {
+      printf("Couldn't create the %s kernel: %d\n", name, err);
+      exit(1);
+   }
+   return kernel;
+}
+
+void filter_engine_init(filter_engine *engine, cl_context ctx,
+      cl_device_id dev, cl_command_queue queue,
+      const program_image *const *images, const char* program_file) {
+
+   size_t wg_size, max_size;
+   int i, err;
+
+   memset(engine, 0, sizeof(filter_engine));
+   engine->context = ctx;
+   engine->device = dev;
+   engine->queue = queue;
+
+   /* Build one program per channel type */
+   max_size = 256;
+   for(i=0; i<FILTER_NUM_TYPES; i++) {
+      engine->program[i] = program_load(ctx, dev,
+            images ? images[i] : NULL, program_file, type_options[i], NULL);
+      engine->rows[i] = create_kernel(engine->program[i], "filter_rows");
+      engine->cols[i] = create_kernel(engine->program[i], "filter_cols");
+      engine->row_only[i] = create_kernel(engine->program[i],
+            "filter_row_only");
+      engine->col_only[i] = create_kernel(engine->program[i],
+            "filter_col_only");
+      engine->tiled[i] = create_kernel(engine->program[i], "filter_tiled");
+      engine->direct[i] = create_kernel(engine->program[i], "filter_direct");
+
+      /* The work-group must suit every kernel */
+      clGetKernelWorkGroupInfo(engine->rows[i], dev, CL_KERNEL_WORK_GROUP_SIZE,
+            sizeof(wg_size), &wg_size, NULL);
+      if(wg_size < max_size) max_size = wg_size;
+      clGetKernelWorkGroupInfo(engine->cols[i], dev, CL_KERNEL_WORK_GROUP_SIZE,
+            sizeof(wg_size), &wg_size, NULL);
+      if(wg_size < max_size) max_size = wg_size;
+      clGetKernelWorkGroupInfo(engine->tiled[i], dev, CL_KERNEL_WORK_GROUP_SIZE,
+            sizeof(wg_size), &wg_size, NULL);
+      if(wg_size < max_size) max_size = wg_size;
+   }
+
+   /* Start from 16x16 and shrink to fit the device */
+   engine->local_size[0] = 16;
+   engine->local_size[1] = 16;
+   while(engine->local_size[0] * engine->local_size[1] > max_size) {
+      if(engine->local_size[1] >= engine->local_size[0])
+         engine->local_size[1] >>= 1;
+      else
+         engine->local_size[0] >>= 1;
+   }
+
+   err = clGetDeviceInfo(dev, CL_DEVICE_LOCAL_MEM_SIZE,
+         sizeof(engine->local_mem_size), &engine->local_mem_size, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);
+   }
+}
+
+int filter_is_separable(const float *coeffs, int kw, int kh,
+      float *row, float *col) {
+
+   int i, j, pi = 0, pj = 0;
+   float pivot = 0.0f, tol;
+
+   /* Find the largest coefficient */
+   for(j=0; j<kh; j++) {
+      for(i=0; i<kw; i++) {
+         if(fabs(coeffs[j*kw + i]) > fabs(pivot)) {
+            pivot = coeffs[j*kw + i];
+            pi = i; pj = j;
+         }
+      }
+   }
+   if(pivot == 0.0f)
+      return 0;
+
+   /* The kernel is separable if it equals the outer product of
+      its pivot column and its pivot row */
+   for(j=0; j<kh; j++) {
+      col[j] = coeffs[j*kw + pi];
+   }
+   for(i=0; i<kw; i++) {
+      row[i] = coeffs[pj*kw + i]/pivot;
+   }
+   tol = 1.0e-5f * fabs(pivot);
+   for(j=0; j<kh; j++) {
+      for(i=0; i<kw; i++) {
+         if(fabs(coeffs[j*kw + i] - col[j]*row[i]) > tol)
+            return 0;
+      }
+   }
+   return 1;
+}
+
+static cl_mem create_coeffs(cl_context ctx, const float *coeffs, int num) {
+
+   cl_mem buffer;
+   int err;
+
+   buffer = clCreateBuffer(ctx, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+         num * sizeof(float), (void*)coeffs, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);
+   };
+   return buffer;
+}
+
+static void enqueue_2d(filter_engine *engine, cl_kernel kernel,
+      const size_t *local_size, size_t width, size_t height,
+      cl_uint num_events, const cl_event *wait_list, cl_event *event) {
+
+   size_t global_size[2];
+   int err;
+
+   /* Round the global size up to a multiple of the work-group */
+   global_size[0] = (width + local_size[0] - 1)/local_size[0] * local_size[0];
+   global_size[1] = (height + local_size[1] - 1)/local_size[1] * local_size[1];
+   err = clEnqueueNDRangeKernel(engine->queue, kernel, 2, NULL, global_size,
+         local_size, num_events, wait_list, event);
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);
+   }
+}
+
+/* One pass of a separable filter from in to out */
+static void enqueue_pass(filter_engine *engine, cl_kernel kernel,
+      cl_mem in, cl_mem out, cl_mem coeff_buffer, cl_int len,
+      size_t local_bytes, const size_t *local_size, size_t width,
+      size_t height, cl_uint num_events, const cl_event *wait_list,
+      cl_event *event) {
+
+   cl_int w = (cl_int)width, h = (cl_int)height, anchor = len/2;
+   int err;
+
+   err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &in);
+   err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &out);
+   err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &coeff_buffer);
+   err |= clSetKernelArg(kernel, 3, sizeof(cl_int), &len);
+   err |= clSetKernelArg(kernel, 4, sizeof(cl_int), &anchor);
+   err |= clSetKernelArg(kernel, 5, sizeof(cl_int), &w);
+   err |= clSetKernelArg(kernel, 6, sizeof(cl_int), &h);
+   err |= clSetKernelArg(kernel, 7, local_bytes, NULL);
+   if(err < 0) {
+      printf("Couldn't set a kernel argument");
+      exit(1);
+   };
+   enqueue_2d(engine, kernel, local_size, width, height,
+         num_events, wait_list, event);
+}
+
+void filter_enqueue(filter_engine *engine, filter_type type,
+      cl_mem src, cl_mem dst, size_t width, size_t height,
+      const float *coeffs, int kw, int kh,
+      cl_uint num_events, const cl_event *wait_list, cl_event *event) {
+
+   float *row, *col;
+   size_t row_local[2], col_local[2], row_bytes, col_bytes, tmp_size;
+   cl_mem row_buffer, col_buffer, coeff_buffer, tmp_buffer;
+   cl_kernel kernel;
+   cl_event row_event;
+   cl_int w = (cl_int)width, h = (cl_int)height;
+   int err, separable;
+
+   /* A single row or column needs no factoring */
+   row = (float*)malloc(kw * sizeof(float));
+   col = (float*)malloc(kh * sizeof(float));
+   separable = kw == 1 || kh == 1 ||
+         filter_is_separable(coeffs, kw, kh, row, col);
+
+   /* Narrow the work-group across the filter direction if the
+      tile and its halo won't fit in local memory */
+   memcpy(row_local, engine->local_size, sizeof(row_local));
+   memcpy(col_local, engine->local_size, sizeof(col_local));
+   while(row_local[1] > 1 && row_local[1] *
+         (row_local[0] + kw - 1) * sizeof(float) > engine->local_mem_size)
+      row_local[1] >>= 1;
+   while(col_local[0] > 1 && col_local[0] *
+         (col_local[1] + kh - 1) * sizeof(float) > engine->local_mem_size)
+      col_local[0] >>= 1;
+   row_bytes = row_local[1] * (row_local[0] + kw - 1) * sizeof(float);
+   col_bytes = col_local[0] * (col_local[1] + kh - 1) * sizeof(float);
+   if(row_bytes > engine->local_mem_size || col_bytes > engine->local_mem_size)
+      separable = 0;
+
+   if(separable && kh == 1) {
+
+      /* Horizontal pass straight into dst */
+      row_buffer = create_coeffs(engine->context, coeffs, kw);
+      enqueue_pass(engine, engine->row_only[type], src, dst, row_buffer,
+            kw, row_bytes, row_local, width, height,
+            num_events, wait_list, event);
+      clReleaseMemObject(row_buffer);
+   }
+   else if(separable && kw == 1) {
+
+      /* Vertical pass straight into dst */
+      col_buffer = create_coeffs(engine->context, coeffs, kh);
+      enqueue_pass(engine, engine->col_only[type], src, dst, col_buffer,
+            kh, col_bytes, col_local, width, height,
+            num_events, wait_list, event);
+      clReleaseMemObject(col_buffer);
+   }
+   else if(separable) {
+
+      /* Allocate the intermediate float image for this call only. The
+         release is deferred until the vertical pass has read it */
+      tmp_size = width * height * sizeof(float);
+      tmp_buffer = clCreateBuffer(engine->context, CL_MEM_READ_WRITE,
+            tmp_size, NULL, &err);
+      if(err < 0) {
+         perror("Couldn't create a buffer");
+         exit(1);
+      };
+      row_buffer = create_coeffs(engine->context, row, kw);
+      col_buffer = create_coeffs(engine->context, col, kh);
+
+      /* Horizontal pass, then vertical pass */
+      enqueue_pass(engine, engine->rows[type], src, tmp_buffer, row_buffer,
+            kw, row_bytes, row_local, width, height,
+            num_events, wait_list, &row_event);
+      enqueue_pass(engine, engine->cols[type], tmp_buffer, dst, col_buffer,
+            kh, col_bytes, col_local, width, height,
+            1, &row_event, event);
+
+      clReleaseEvent(row_event);
+      clReleaseMemObject(row_buffer);
+      clReleaseMemObject(col_buffer);
+      clReleaseMemObject(tmp_buffer);
+   }
+   else {
+
+      /* Use the tiled kernel if the tile fits in local memory */
+      coeff_buffer = create_coeffs(engine->context, coeffs, kw*kh);
+      tmp_size = (engine->local_size[0] + kw - 1) *
+            (engine->local_size[1] + kh - 1) * sizeof(float);
+      kernel = tmp_size <= engine->local_mem_size ?
+            engine->tiled[type] : engine->direct[type];
+      err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &src);
+      err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &dst);
+      err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &coeff_buffer);
+      err |= clSetKernelArg(kernel, 3, sizeof(cl_int), &kw);
+      err |= clSetKernelArg(kernel, 4, sizeof(cl_int), &kh);
+      err |= clSetKernelArg(kernel, 5, sizeof(cl_int), &w);
+      err |= clSetKernelArg(kernel, 6, sizeof(cl_int), &h);
+      if(kernel == engine->tiled[type])
+         err |= clSetKernelArg(kernel, 7, tmp_size, NULL);
+      if(err < 0) {
+         printf("Couldn't set a kernel argument");
+         exit(1);
+      };
+      enqueue_2d(engine, kernel, engine->local_size, width, height,
+            num_events, wait_list, event);
+      clReleaseMemObject(coeff_buffer);
+   }
+
+   free(row);
+   free(col);
+}
+
+void filter_engine_release(filter_engine *engine) {
+
+   int i;
+
+   for(i=0; i<FILTER_NUM_TYPES; i++) {
+      clReleaseKernel(engine->rows[i]);
+      clReleaseKernel(engine->cols[i]);
+      clReleaseKernel(engine->row_only[i]);
+      clReleaseKernel(engine->col_only[i]);
+      clReleaseKernel(engine->tiled[i]);
+      clReleaseKernel(engine->direct[i]);
+      clReleaseProgram(engine->program[i]);
+   }
+}
@@ -0,0 +1,61 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "program_binary.h"
+
+/* Channel types supported by the filter engine */
+typedef enum {
+   FILTER_UCHAR,
+   FILTER_USHORT,
+   FILTER_FLOAT,
+   FILTER_NUM_TYPES
+} filter_type;
+
+/* One program and kernel set per channel type */
+typedef struct {
+   cl_context context;
+   cl_device_id device;
+   cl_command_queue queue;
+   cl_program program[FILTER_NUM_TYPES];
+   cl_kernel rows[FILTER_NUM_TYPES];
+   cl_kernel cols[FILTER_NUM_TYPES];
+   cl_kernel row_only[FILTER_NUM_TYPES];
+   cl_kernel col_only[FILTER_NUM_TYPES];
+   cl_kernel tiled[FILTER_NUM_TYPES];
+   cl_kernel direct[FILTER_NUM_TYPES];
+   cl_ulong local_mem_size;
+   size_t local_size[2];
+} filter_engine;
+
+/* Size in bytes of one pixel of the given type */
+size_t filter_pixel_size(filter_type type);
+
+/* Load the filter program for every channel type from images, in
+   filter_type order, or build it from program_file where images is NULL
+   or an image doesn't load */
+void filter_engine_init(filter_engine *engine, cl_context ctx,
+      cl_device_id dev, cl_command_queue queue,
+      const program_image *const *images, const char* program_file);
+
+/* Factor a kh x kw kernel into col (kh) x row (kw). Returns 1 if separable */
+int filter_is_separable(const float *coeffs, int kw, int kh,
+      float *row, float *col);
+
+/* Filter a width x height buffer with a kh x kw kernel (row-major).
+   The kernel is centered at (kw/2, kh/2) and edges are clamped. Every
+   call allocates its own intermediate image, so calls may run
+   concurrently on an out-of-order queue. */
+void filter_enqueue(filter_engine *engine, filter_type type,
+      cl_mem src, cl_mem dst, size_t width, size_t height,
+      const float *coeffs, int kw, int kh,
+      cl_uint num_events, const cl_event *wait_list, cl_event *event);
+
+void filter_engine_release(filter_engine *engine);
+
+#endif
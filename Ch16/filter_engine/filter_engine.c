@@ -0,0 +1,322 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "filter_engine.cl"
+#define INPUT_FILE "../texture_filter/input.png"
+#define OUTPUT_FILE "output.png"
+
+#define NUM_FILTERS 4
+#define MAX_TAPS 81
+
+#define PNG_DEBUG 3
+#include <png.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "filter.h"
+
+/* The kernels compiled for this machine by the Makefile */
+#ifdef PRECOMPILED
+#include "filter_engine_binaries.h"
+#endif
+
+/* A named filter kernel of size kh x kw */
+typedef struct {
+   const char* name;
+   int kw, kh;
+   float coeffs[MAX_TAPS];
+} filter_desc;
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   }
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);
+   }
+
+   return dev;
+}
+
+void read_image_data(const char* filename, png_bytep* data, size_t* w, size_t* h) {
+
+   int i;
+
+   /* Open input file */
+   FILE *png_input;
+   if((png_input = fopen(filename, "rb")) == NULL) {
+      perror("Can't read input image file");
+      exit(1);
+   }
+
+   /* Read image data */
+   png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+   png_infop info_ptr = png_create_info_struct(png_ptr);
+   png_init_io(png_ptr, png_input);
+   png_read_info(png_ptr, info_ptr);
+
+   *w = png_get_image_width(png_ptr, info_ptr);
+   *h = png_get_image_height(png_ptr, info_ptr);
+
+   /* Allocate memory and read image data */
+   *data = malloc(*h * png_get_rowbytes(png_ptr, info_ptr));
+   for(i=0; i<*h; i++) {
+      png_read_row(png_ptr, *data + i * png_get_rowbytes(png_ptr, info_ptr), NULL);
+   }
+
+   /* Close input file */
+   png_read_end(png_ptr, info_ptr);
+   png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
+   fclose(png_input);
+}
+
+void write_image_data(const char* filename, png_bytep data, size_t w, size_t h) {
+
+   int i;
+
+   /* Open output file */
+   FILE *png_output;
+   if((png_output = fopen(filename, "wb")) == NULL) {
+      perror("Create output image file");
+      exit(1);
+   }
+
+   /* Write image data */
+   png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+   png_infop info_ptr = png_create_info_struct(png_ptr);
+   png_init_io(png_ptr, png_output);
+   png_set_IHDR(png_ptr, info_ptr, w, h, 8,
+         PNG_COLOR_TYPE_GRAY, PNG_INTERLACE_NONE,
+         PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+   png_write_info(png_ptr, info_ptr);
+   for(i=0; i<h; i++) {
+      png_write_row(png_ptr, data + i * png_get_rowbytes(png_ptr, info_ptr));
+   }
+
+   /* Close file */
+   png_write_end(png_ptr, NULL);
+   png_destroy_write_struct(&png_ptr, &info_ptr);
+   fclose(png_output);
+}
+
+/* Fill in the Gaussian, Sobel, box and sharpening kernels */
+void init_filters(filter_desc *filters) {
+
+   int i, j;
+   float g[5] = {1.0f, 4.0f, 6.0f, 4.0f, 1.0f};
+   float sharpen[9] = {-1, -1, -1, -1, 9, -1, -1, -1, -1};
+   float sobel[9] = {-1, 0, 1, -2, 0, 2, -1, 0, 1};
+
+   filters[0].name = "gaussian_5x5";
+   filters[0].kw = filters[0].kh = 5;
+   for(j=0; j<5; j++)
+      for(i=0; i<5; i++)
+         filters[0].coeffs[j*5 + i] = g[j]*g[i]/256.0f;
+
+   filters[1].name = "sobel_x_3x3";
+   filters[1].kw = filters[1].kh = 3;
+   memcpy(filters[1].coeffs, sobel, sizeof(sobel));
+
+   filters[2].name = "box_9x9";
+   filters[2].kw = filters[2].kh = 9;
+   for(i=0; i<81; i++)
+      filters[2].coeffs[i] = 1.0f/81.0f;
+
+   filters[3].name = "sharpen_3x3";
+   filters[3].kw = filters[3].kh = 3;
+   memcpy(filters[3].coeffs, sharpen, sizeof(sharpen));
+}
+
+/* Compute the filtered value of one pixel on the host */
+double reference_pixel(const float *src, size_t w, size_t h,
+      int x, int y, const filter_desc *f) {
+
+   int i, j, sx, sy;
+   double sum = 0.0;
+
+   for(j=0; j<f->kh; j++) {
+      sy = y + j - f->kh/2;
+      sy = sy < 0 ? 0 : (sy >= (int)h ? (int)h-1 : sy);
+      for(i=0; i<f->kw; i++) {
+         sx = x + i - f->kw/2;
+         sx = sx < 0 ? 0 : (sx >= (int)w ? (int)w-1 : sx);
+         sum += f->coeffs[j*f->kw + i] * src[sy*w + sx];
+      }
+   }
+   return sum;
+}
+
+/* Compare device output against the host reference */
+int check_output(const void *output, filter_type type, const float *src,
+      size_t w, size_t h, const filter_desc *f) {
+
+   int x, y;
+   double expected, actual, max_val;
+
+   max_val = type == FILTER_USHORT ? 65535.0 : 255.0;
+   for(y=0; y<(int)h; y++) {
+      for(x=0; x<(int)w; x++) {
+         expected = reference_pixel(src, w, h, x, y, f);
+         if(type == FILTER_FLOAT) {
+            actual = ((float*)output)[y*w + x];
+            if(fabs(actual - expected) > 1.0e-3 * (1.0 + fabs(expected)))
+               return 0;
+         }
+         else {
+            actual = type == FILTER_USHORT ?
+                  ((cl_ushort*)output)[y*w + x] : ((cl_uchar*)output)[y*w + x];
+            expected = expected < 0.0 ? 0.0 :
+                  (expected > max_val ? max_val : expected);
+            if(fabs(actual - expected) > 1.0)
+               return 0;
+         }
+      }
+   }
+   return 1;
+}
+
+int main() {
+
+   /* Host/device data structures */
+   cl_device_id device;
+   cl_context context;
+   cl_command_queue queue;
+   cl_event prof_event;
+   cl_ulong time_start, time_end;
+   cl_int err;
+   filter_engine engine;
+   filter_desc filters[NUM_FILTERS];
+   const char* type_names[FILTER_NUM_TYPES] = {"uchar", "ushort", "float"};
+   const program_image *images[FILTER_NUM_TYPES] = {
+      PROGRAM_IMAGE(filter_uchar), PROGRAM_IMAGE(filter_ushort),
+      PROGRAM_IMAGE(filter_float)
+   };
+
+   /* Image data */
+   png_bytep pixels;
+   size_t width, height, i;
+   float *src_float;
+   void *src_data[FILTER_NUM_TYPES], *output;
+   cl_mem src_buffer[FILTER_NUM_TYPES], dst_buffer;
+   int f, t;
+
+   /* Read pixel data and convert to each channel type */
+   read_image_data(INPUT_FILE, &pixels, &width, &height);
+   src_float = (float*)malloc(width * height * sizeof(float));
+   for(t=0; t<FILTER_NUM_TYPES; t++) {
+      src_data[t] = malloc(width * height * filter_pixel_size(t));
+   }
+   for(i=0; i<width*height; i++) {
+      src_float[i] = pixels[i];
+      ((cl_uchar*)src_data[FILTER_UCHAR])[i] = pixels[i];
+      ((cl_ushort*)src_data[FILTER_USHORT])[i] = pixels[i];
+      ((cl_float*)src_data[FILTER_FLOAT])[i] = pixels[i];
+   }
+   output = malloc(width * height * sizeof(float));
+   init_filters(filters);
+
+   /* Create a device and context */
+   device = create_device();
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);
+   }
+
+   /* Create a command queue */
+   queue = clCreateCommandQueue(context, device,
+         CL_QUEUE_PROFILING_ENABLE, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);
+   };
+
+   /* Build the filter programs */
+   filter_engine_init(&engine, context, device, queue, images, PROGRAM_FILE);
+
+   /* Create buffers */
+   for(t=0; t<FILTER_NUM_TYPES; t++) {
+      src_buffer[t] = clCreateBuffer(context, CL_MEM_READ_ONLY |
+            CL_MEM_COPY_HOST_PTR, width * height * filter_pixel_size(t),
+            src_data[t], &err);
+      if(err < 0) {
+         perror("Couldn't create a buffer");
+         exit(1);
+      };
+   }
+   dst_buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY,
+         width * height * sizeof(float), NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);
+   };
+
+   /* Run every filter on every channel type */
+   for(f=0; f<NUM_FILTERS; f++) {
+      float row[MAX_TAPS], col[MAX_TAPS];
+      printf("%s (%s):\n", filters[f].name,
+            filter_is_separable(filters[f].coeffs, filters[f].kw,
+            filters[f].kh, row, col) ? "separable" : "tiled");
+
+      for(t=0; t<FILTER_NUM_TYPES; t++) {
+
+         filter_enqueue(&engine, t, src_buffer[t], dst_buffer, width, height,
+               filters[f].coeffs, filters[f].kw, filters[f].kh,
+               0, NULL, &prof_event);
+
+         /* Read the result */
+         err = clEnqueueReadBuffer(queue, dst_buffer, CL_TRUE, 0,
+               width * height * filter_pixel_size(t), output, 0, NULL, NULL);
+         if(err < 0) {
+            perror("Couldn't read the buffer");
+            exit(1);
+         }
+
+         /* The event covers the last pass only */
+         clGetEventProfilingInfo(prof_event, CL_PROFILING_COMMAND_START,
+               sizeof(time_start), &time_start, NULL);
+         clGetEventProfilingInfo(prof_event, CL_PROFILING_COMMAND_END,
+               sizeof(time_end), &time_end, NULL);
+         clReleaseEvent(prof_event);
+
+         printf("   %-6s: check %s, last pass %lu ns\n", type_names[t],
+               check_output(output, t, src_float, width, height, &filters[f]) ?
+               "passed" : "failed", (unsigned long)(time_end - time_start));
+
+         /* Save the Gaussian result */
+         if(f == 0 && t == FILTER_UCHAR) {
+            write_image_data(OUTPUT_FILE, (png_bytep)output, width, height);
+         }
+      }
+   }
+
+   /* Deallocate resources */
+   free(pixels);
+   free(src_float);
+   free(output);
+   for(t=0; t<FILTER_NUM_TYPES; t++) {
+      free(src_data[t]);
+      clReleaseMemObject(src_buffer[t]);
+   }
+   clReleaseMemObject(dst_buffer);
+   filter_engine_release(&engine);
+   clReleaseCommandQueue(queue);
+   clReleaseContext(context);
+   return 0;
+}
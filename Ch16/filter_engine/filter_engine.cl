@@ -0,0 +1,144 @@
+/* PIXEL is set by the host: uchar, ushort or float */
+#ifndef PIXEL
+#define PIXEL uchar
+#define PIXEL_UCHAR
+#endif
+
+/* Convert a filtered value back to the pixel type */
+#if defined(PIXEL_FLOAT)
+#define TO_PIXEL(x) (x)
+#elif defined(PIXEL_USHORT)
+#define TO_PIXEL(x) convert_ushort_sat_rte(x)
+#else
+#define TO_PIXEL(x) convert_uchar_sat_rte(x)
+#endif
+
+/* Horizontal pass of a separable filter from src to an OUT buffer,
+   converting each sum with CONVERT */
+#define FILTER_ROWS(name, OUT, CONVERT)                                    \
+__kernel void name(__global PIXEL* src, __global OUT* dst,                 \
+                   __constant float* coeffs, int len, int anchor,          \
+                   int width, int height, __local float* tile) {           \
+                                                                           \
+   int lx = get_local_id(0);                                               \
+   int ly = get_local_id(1);                                               \
+   int lw = get_local_size(0);                                             \
+   int x = get_global_id(0);                                               \
+   int y = min((int)get_global_id(1), height-1);                           \
+   int tile_w = lw + len - 1;                                              \
+   int x0 = get_group_id(0) * lw - anchor;                                 \
+   float sum = 0.0f;                                                       \
+                                                                           \
+   /* Load the row segment and its halo, clamping to the image edge */     \
+   for(int i=lx; i<tile_w; i+=lw) {                                        \
+      tile[ly*tile_w + i] = src[y*width + clamp(x0 + i, 0, width-1)];      \
+   }                                                                       \
+   barrier(CLK_LOCAL_MEM_FENCE);                                           \
+                                                                           \
+   /* Compute one-dimensional dot product */                               \
+   for(int i=0; i<len; i++) {                                              \
+      sum += coeffs[i] * tile[ly*tile_w + lx + i];                         \
+   }                                                                       \
+                                                                           \
+   if(x < width && get_global_id(1) < height) {                            \
+      dst[y*width + x] = CONVERT(sum);                                     \
+   }                                                                       \
+}
+
+/* Vertical pass of a separable filter from an IN buffer to dst */
+#define FILTER_COLS(name, IN)                                              \
+__kernel void name(__global IN* src, __global PIXEL* dst,                  \
+                   __constant float* coeffs, int len, int anchor,          \
+                   int width, int height, __local float* tile) {           \
+                                                                           \
+   int lx = get_local_id(0);                                               \
+   int ly = get_local_id(1);                                               \
+   int lw = get_local_size(0);                                             \
+   int lh = get_local_size(1);                                             \
+   int x = min((int)get_global_id(0), width-1);                            \
+   int y = get_global_id(1);                                               \
+   int tile_h = lh + len - 1;                                              \
+   int y0 = get_group_id(1) * lh - anchor;                                 \
+   float sum = 0.0f;                                                       \
+                                                                           \
+   /* Load the column segment and its halo, clamping to the image edge */  \
+   for(int i=ly; i<tile_h; i+=lh) {                                        \
+      tile[i*lw + lx] = src[clamp(y0 + i, 0, height-1)*width + x];         \
+   }                                                                       \
+   barrier(CLK_LOCAL_MEM_FENCE);                                           \
+                                                                           \
+   for(int i=0; i<len; i++) {                                              \
+      sum += coeffs[i] * tile[(ly + i)*lw + lx];                           \
+   }                                                                       \
+                                                                           \
+   if(get_global_id(0) < width && y < height) {                            \
+      dst[y*width + x] = TO_PIXEL(sum);                                    \
+   }                                                                       \
+}
+
+/* Two passes go through an intermediate float image */
+FILTER_ROWS(filter_rows, float, )
+FILTER_COLS(filter_cols, float)
+
+/* A kernel of one row or one column takes a single pass */
+FILTER_ROWS(filter_row_only, PIXEL, TO_PIXEL)
+FILTER_COLS(filter_col_only, PIXEL)
+
+/* Non-separable filter using a local tile with a halo on every side */
+__kernel void filter_tiled(__global PIXEL* src, __global PIXEL* dst,
+                           __constant float* coeffs, int kw, int kh,
+                           int width, int height, __local float* tile) {
+
+   int lx = get_local_id(0);
+   int ly = get_local_id(1);
+   int lw = get_local_size(0);
+   int lh = get_local_size(1);
+   int tile_w = lw + kw - 1;
+   int tile_h = lh + kh - 1;
+   int x0 = get_group_id(0) * lw - kw/2;
+   int y0 = get_group_id(1) * lh - kh/2;
+   int x = get_global_id(0);
+   int y = get_global_id(1);
+   float sum = 0.0f;
+
+   /* Cooperatively load the tile */
+   for(int j=ly; j<tile_h; j+=lh) {
+      int row = clamp(y0 + j, 0, height-1) * width;
+      for(int i=lx; i<tile_w; i+=lw) {
+         tile[j*tile_w + i] = src[row + clamp(x0 + i, 0, width-1)];
+      }
+   }
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   /* Compute two-dimensional dot product */
+   for(int j=0; j<kh; j++) {
+      for(int i=0; i<kw; i++) {
+         sum += coeffs[j*kw + i] * tile[(ly + j)*tile_w + lx + i];
+      }
+   }
+
+   if(x < width && y < height) {
+      dst[y*width + x] = TO_PIXEL(sum);
+   }
+}
+
+/* Non-separable filter for kernels whose tile won't fit in local memory */
+__kernel void filter_direct(__global PIXEL* src, __global PIXEL* dst,
+                            __constant float* coeffs, int kw, int kh,
+                            int width, int height) {
+
+   int x = get_global_id(0);
+   int y = get_global_id(1);
+   float sum = 0.0f;
+
+   if(x >= width || y >= height)
+      return;
+
+   for(int j=0; j<kh; j++) {
+      int row = clamp(y + j - kh/2, 0, height-1) * width;
+      for(int i=0; i<kw; i++) {
+         sum += coeffs[j*kw + i] * src[row + clamp(x + i - kw/2, 0, width-1)];
+      }
+   }
+   dst[y*width + x] = TO_PIXEL(sum);
+}
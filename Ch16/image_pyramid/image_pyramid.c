@@ -0,0 +1,182 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "image_pyramid.cl"
+#define INPUT_FILE "../texture_filter/input.png"
+
+#define NUM_LEVELS 8
+
+#define PNG_DEBUG 3
+#include <png.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pyramid.h"
+
+/* The kernels compiled for this machine by the Makefile */
+#ifdef PRECOMPILED
+#include "image_pyramid_binaries.h"
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   }
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);
+   }
+
+   return dev;
+}
+
+void read_image_data(const char* filename, png_bytep* data, size_t* w, size_t* h) {
+
+   int i;
+
+   /* Open input file */
+   FILE *png_input;
+   if((png_input = fopen(filename, "rb")) == NULL) {
+      perror("Can't read input image file");
+      exit(1);
+   }
+
+   /* Read image data */
+   png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+   png_infop info_ptr = png_create_info_struct(png_ptr);
+   png_init_io(png_ptr, png_input);
+   png_read_info(png_ptr, info_ptr);
+
+   *w = png_get_image_width(png_ptr, info_ptr);
+   *h = png_get_image_height(png_ptr, info_ptr);
+
+   /* Allocate memory and read image data */
+   *data = malloc(*h * png_get_rowbytes(png_ptr, info_ptr));
+   for(i=0; i<*h; i++) {
+      png_read_row(png_ptr, *data + i * png_get_rowbytes(png_ptr, info_ptr), NULL);
+   }
+
+   /* Close input file */
+   png_read_end(png_ptr, info_ptr);
+   png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
+   fclose(png_input);
+}
+
+int main() {
+
+   /* Host/device data structures */
+   cl_device_id device;
+   cl_context context;
+   cl_command_queue queue;
+   cl_event build_event, collapse_event;
+   cl_int err;
+   pyramid_engine engine;
+   image_pyramid pyr;
+
+   /* Image data */
+   png_bytep pixels;
+   float *input, *output, max_error;
+   cl_mem input_image, output_image;
+   size_t width, height, i, origin[3], region[3];
+
+   /* Read pixel data and convert to float */
+   read_image_data(INPUT_FILE, &pixels, &width, &height);
+   input = (float*)malloc(width * height * sizeof(float));
+   output = (float*)malloc(width * height * sizeof(float));
+   for(i=0; i<width*height; i++) {
+      input[i] = pixels[i]/255.0f;
+   }
+
+   /* Create a device and context */
+   device = create_device();
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);
+   }
+
+   /* Create a command queue */
+   queue = clCreateCommandQueue(context, device, 0, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);
+   };
+
+   /* Build the program and allocate the levels */
+   pyramid_engine_init(&engine, context, device, queue,
+         PROGRAM_IMAGE(image_pyramid), PROGRAM_FILE);
+   pyramid_create(&engine, &pyr, width, height, NUM_LEVELS, 1);
+
+   /* Create input and output images */
+   input_image = clCreateImage2D(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+         &engine.format, width, height, 0, input, &err);
+   if(err < 0) {
+      perror("Couldn't create the image object");
+      exit(1);
+   };
+   output_image = clCreateImage2D(context, CL_MEM_WRITE_ONLY,
+         &engine.format, width, height, 0, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create the image object");
+      exit(1);
+   };
+
+   /* Build Gaussian and Laplacian pyramids, then collapse the Laplacian
+      one - the only host transfer is the final read */
+   pyramid_enqueue_build(&engine, &pyr, input_image, 0, NULL, &build_event);
+   pyramid_enqueue_collapse(&engine, &pyr, output_image, 1, &build_event,
+         &collapse_event);
+   origin[0] = 0; origin[1] = 0; origin[2] = 0;
+   region[0] = width; region[1] = height; region[2] = 1;
+   err = clEnqueueReadImage(queue, output_image, CL_TRUE, origin,
+         region, 0, 0, output, 1, &collapse_event, NULL);
+   if(err < 0) {
+      perror("Couldn't read from the image object");
+      exit(1);
+   }
+
+   /* Display level sizes */
+   for(i=0; i<pyr.num_levels; i++) {
+      printf("Level %zu: %zu x %zu\n", i, pyr.width[i], pyr.height[i]);
+   }
+
+   /* The Laplacian pyramid must reconstruct the input */
+   max_error = 0.0f;
+   for(i=0; i<width*height; i++) {
+      if(fabs(output[i] - input[i]) > max_error)
+         max_error = fabs(output[i] - input[i]);
+   }
+   if(max_error < 1.0e-4f)
+      printf("Check passed.\n");
+   else
+      printf("Check failed: max error %g\n", max_error);
+
+   /* Deallocate resources */
+   free(pixels);
+   free(input);
+   free(output);
+   clReleaseEvent(build_event);
+   clReleaseEvent(collapse_event);
+   clReleaseMemObject(input_image);
+   clReleaseMemObject(output_image);
+   pyramid_release(&pyr);
+   pyramid_engine_release(&engine);
+   clReleaseCommandQueue(queue);
+   clReleaseContext(context);
+   return 0;
+}
@@ -0,0 +1,53 @@
+constant sampler_t linear = CLK_NORMALIZED_COORDS_FALSE
+   | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_LINEAR;
+
+/* The 5-tap binomial [1 4 6 4 1]/16 is applied with three linear fetches
+   per axis: the outer pairs (1, 4) become one fetch of weight 5/16 placed
+   1.2 pixels from the center */
+#define OUTER_OFFSET 1.2f
+#define OUTER_WEIGHT 0.3125f
+#define CENTER_WEIGHT 0.375f
+
+/* Blur and decimate: one coarse pixel per work-item */
+__kernel void pyr_down(read_only image2d_t fine, write_only image2d_t coarse) {
+
+   int2 coord = (int2)(get_global_id(0), get_global_id(1));
+   float2 center = (float2)(2*coord.x + 0.5f, 2*coord.y + 0.5f);
+   float w[3] = {OUTER_WEIGHT, CENTER_WEIGHT, OUTER_WEIGHT};
+   float4 sum = (float4)(0.0f);
+
+   for(int j=0; j<3; j++) {
+      for(int i=0; i<3; i++) {
+         sum += w[i] * w[j] * read_imagef(fine, linear,
+               center + (float2)((i-1)*OUTER_OFFSET, (j-1)*OUTER_OFFSET));
+      }
+   }
+   write_imagef(coarse, coord, sum);
+}
+
+/* Interpolate the coarse level at fine pixel (x, y). Coarse pixel i
+   was centered on fine pixel 2i */
+float4 expand(read_only image2d_t coarse, int2 coord) {
+   return read_imagef(coarse, linear,
+         (float2)(coord.x * 0.5f + 0.5f, coord.y * 0.5f + 0.5f));
+}
+
+/* Laplacian level: fine - expand(coarse) */
+__kernel void pyr_up_sub(read_only image2d_t fine, read_only image2d_t coarse,
+                         write_only image2d_t laplace) {
+
+   int2 coord = (int2)(get_global_id(0), get_global_id(1));
+   write_imagef(laplace, coord,
+         read_imagef(fine, linear, (float2)(coord.x + 0.5f, coord.y + 0.5f)) -
+         expand(coarse, coord));
+}
+
+/* Collapse one level: laplace + expand(coarse) */
+__kernel void pyr_up_add(read_only image2d_t laplace, read_only image2d_t coarse,
+                         write_only image2d_t fine) {
+
+   int2 coord = (int2)(get_global_id(0), get_global_id(1));
+   write_imagef(fine, coord,
+         read_imagef(laplace, linear, (float2)(coord.x + 0.5f, coord.y + 0.5f)) +
+         expand(coarse, coord));
+}
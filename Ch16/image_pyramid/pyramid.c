@@ -0,0 +1,195 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "pyramid.h"
+
+void pyramid_engine_init(pyramid_engine *engine, cl_context ctx,
+      cl_device_id dev, cl_command_queue queue, const program_image *image,
+      const char* program_file) {
+
+   int err;
+
+   engine->context = ctx;
+   engine->device = dev;
+   engine->queue = queue;
+   engine->format.image_channel_order = CL_R;
+   engine->format.image_channel_data_type = CL_FLOAT;
+   engine->program = program_load(ctx, dev, image, program_file, NULL, NULL);
+
+   engine->down = clCreateKernel(engine->program, "pyr_down", &err);
+   if(err < 0) {
+      printf("Couldn't create a kernel: %d", err);
+      exit(1);
+   };
+   engine->up_sub = clCreateKernel(engine->program, "pyr_up_sub", &err);
+   if(err < 0) {
+      printf("Couldn't create a kernel: %d", err);
+      exit(1);
+   };
+   engine->up_add = clCreateKernel(engine->program, "pyr_up_add", &err);
+   if(err < 0) {
+      printf("Couldn't create a kernel: %d", err);
+      exit(1);
+   };
+}
+
+static cl_mem create_level(pyramid_engine *engine, size_t width, size_t height) {
+
+   cl_mem image;
+   int err;
+
+   image = clCreateImage2D(engine->context, CL_MEM_READ_WRITE,
+         &engine->format, width, height, 0, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create the image object");
+      exit(1);
+   };
+   return image;
+}
+
+void pyramid_create(pyramid_engine *engine, image_pyramid *pyr,
+      size_t width, size_t height, int num_levels, int laplacian) {
+
+   int i;
+
+   memset(pyr, 0, sizeof(image_pyramid));
+   if(num_levels > PYRAMID_MAX_LEVELS)
+      num_levels = PYRAMID_MAX_LEVELS;
+
+   pyr->width[0] = width;
+   pyr->height[0] = height;
+   pyr->num_levels = 1;
+   for(i=1; i<num_levels; i++) {
+      pyr->width[i] = (pyr->width[i-1] + 1)/2;
+      pyr->height[i] = (pyr->height[i-1] + 1)/2;
+      if(pyr->width[i] < 2 || pyr->height[i] < 2)
+         break;
+      pyr->gauss[i] = create_level(engine, pyr->width[i], pyr->height[i]);
+      pyr->num_levels++;
+   }
+
+   /* The coarsest Laplacian level is the coarsest Gaussian level */
+   if(laplacian) {
+      for(i=0; i<pyr->num_levels-1; i++) {
+         pyr->laplace[i] = create_level(engine, pyr->width[i], pyr->height[i]);
+      }
+   }
+}
+
+/* Launch one level kernel. Only the first command of a chain waits on
+   the caller's events and only the last one signals */
+static void enqueue_level(pyramid_engine *engine, cl_kernel kernel,
+      cl_mem a, cl_mem b, cl_mem c, size_t width, size_t height,
+      cl_uint num_events, const cl_event *wait_list, cl_event *event) {
+
+   size_t global_size[2];
+   int err;
+
+   err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &a);
+   err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &b);
+   if(c != NULL)
+      err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &c);
+   if(err < 0) {
+      printf("Couldn't set a kernel argument");
+      exit(1);
+   };
+
+   global_size[0] = width; global_size[1] = height;
+   err = clEnqueueNDRangeKernel(engine->queue, kernel, 2, NULL, global_size,
+         NULL, num_events, wait_list, event);
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);
+   }
+}
+
+void pyramid_enqueue_build(pyramid_engine *engine, image_pyramid *pyr,
+      cl_mem src, cl_uint num_events, const cl_event *wait_list,
+      cl_event *event) {
+
+   int i, last, laplacian = pyr->laplace[0] != NULL;
+
+   if(pyr->gauss[0] != NULL)
+      clReleaseMemObject(pyr->gauss[0]);
+   pyr->gauss[0] = src;
+   clRetainMemObject(src);
+
+   if(pyr->num_levels == 1) {
+      clEnqueueMarkerWithWaitList(engine->queue, num_events, wait_list, event);
+      return;
+   }
+
+   /* Gaussian levels */
+   last = pyr->num_levels - 1;
+   for(i=1; i<pyr->num_levels; i++) {
+      enqueue_level(engine, engine->down, pyr->gauss[i-1], pyr->gauss[i], NULL,
+            pyr->width[i], pyr->height[i],
+            i == 1 ? num_events : 0, i == 1 ? wait_list : NULL,
+            (i == last && !laplacian) ? event : NULL);
+   }
+
+   /* Laplacian levels */
+   if(laplacian) {
+      for(i=0; i<last; i++) {
+         enqueue_level(engine, engine->up_sub, pyr->gauss[i], pyr->gauss[i+1],
+               pyr->laplace[i], pyr->width[i], pyr->height[i],
+               0, NULL, i == last-1 ? event : NULL);
+      }
+      if(pyr->laplace[last] == NULL) {
+         pyr->laplace[last] = pyr->gauss[last];
+         clRetainMemObject(pyr->laplace[last]);
+      }
+   }
+}
+
+void pyramid_enqueue_collapse(pyramid_engine *engine, image_pyramid *pyr,
+      cl_mem dst, cl_uint num_events, const cl_event *wait_list,
+      cl_event *event) {
+
+   int i, last = pyr->num_levels - 1;
+   size_t origin[3] = {0, 0, 0}, region[3];
+
+   /* A single-level pyramid is just the source */
+   if(last == 0) {
+      region[0] = pyr->width[0]; region[1] = pyr->height[0]; region[2] = 1;
+      clEnqueueCopyImage(engine->queue, pyr->gauss[0], dst, origin, origin,
+            region, num_events, wait_list, event);
+      return;
+   }
+
+   /* Collapsing needs the Laplacian levels */
+   if(pyr->laplace[0] == NULL) {
+      printf("Can't collapse a pyramid created without Laplacian levels\n");
+      exit(1);
+   }
+
+   /* Each reconstructed level overwrites its Gaussian level, which holds
+      the same values, and feeds the next finer level */
+   for(i=last-1; i>=0; i--) {
+      enqueue_level(engine, engine->up_add, pyr->laplace[i], pyr->gauss[i+1],
+            i == 0 ? dst : pyr->gauss[i], pyr->width[i], pyr->height[i],
+            i == last-1 ? num_events : 0, i == last-1 ? wait_list : NULL,
+            i == 0 ? event : NULL);
+   }
+}
+
+void pyramid_release(image_pyramid *pyr) {
+
+   int i;
+
+   for(i=0; i<pyr->num_levels; i++) {
+      if(pyr->gauss[i])
+         clReleaseMemObject(pyr->gauss[i]);
+      if(pyr->laplace[i])
+         clReleaseMemObject(pyr->laplace[i]);
+   }
+}
+
+void pyramid_engine_release(pyramid_engine *engine) {
+   clReleaseKernel(engine->down);
+   clReleaseKernel(engine->up_sub);
+   clReleaseKernel(engine->up_add);
+   clReleaseProgram(engine->program);
+}
@@ -0,0 +1,58 @@
+#ifndef PYRAMID_H
+#define PYRAMID_H
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "program_binary.h"
+
+#define PYRAMID_MAX_LEVELS 16
+
+typedef struct {
+   cl_context context;
+   cl_device_id device;
+   cl_command_queue queue;
+   cl_program program;
+   cl_kernel down, up_sub, up_add;
+   cl_image_format format;
+} pyramid_engine;
+
+/* Device-resident levels. gauss[0] is the source image and
+   laplace[num_levels-1] aliases the coarsest Gaussian level */
+typedef struct {
+   int num_levels;
+   size_t width[PYRAMID_MAX_LEVELS], height[PYRAMID_MAX_LEVELS];
+   cl_mem gauss[PYRAMID_MAX_LEVELS];
+   cl_mem laplace[PYRAMID_MAX_LEVELS];
+} image_pyramid;
+
+/* Load the pyramid program from image, or build it from program_file if
+   image is NULL or doesn't load. Levels are single-channel float images */
+void pyramid_engine_init(pyramid_engine *engine, cl_context ctx,
+      cl_device_id dev, cl_command_queue queue, const program_image *image,
+      const char* program_file);
+
+/* Allocate up to num_levels levels for a width x height source,
+   stopping once a level would be smaller than 2x2 */
+void pyramid_create(pyramid_engine *engine, image_pyramid *pyr,
+      size_t width, size_t height, int num_levels, int laplacian);
+
+/* Enqueue every level in one chain. No host synchronization is needed
+   between levels; event (if not NULL) completes with the last one */
+void pyramid_enqueue_build(pyramid_engine *engine, image_pyramid *pyr,
+      cl_mem src, cl_uint num_events, const cl_event *wait_list,
+      cl_event *event);
+
+/* Reconstruct the source from the Laplacian levels into dst. The pyramid
+   must have been created with laplacian set */
+void pyramid_enqueue_collapse(pyramid_engine *engine, image_pyramid *pyr,
+      cl_mem dst, cl_uint num_events, const cl_event *wait_list,
+      cl_event *event);
+
+void pyramid_release(image_pyramid *pyr);
+void pyramid_engine_release(pyramid_engine *engine);
+
+#endif
@@ -0,0 +1,338 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "device_set.h"
+
+/* Pages are assumed to be no smaller than this */
+#define TOUCH_STRIDE 4096
+
+static const char touch_source[] =
+   "__kernel void first_touch(__global uchar *data) {\n"
+   "   data[get_global_id(0) * 4096] = 0;\n"
+   "}\n";
+
+static void add_slot(device_set *set, cl_device_id dev, int sub_device) {
+
+   device_slot *slot;
+
+   if(set->num_slots == DEVICE_SET_MAX) {
+      printf("Too many devices, ignoring the rest\n");
+      return;
+   }
+   slot = &set->slots[set->num_slots++];
+   slot->device = dev;
+   slot->queue = NULL;
+   slot->context = set->num_contexts;
+   slot->sub_device = sub_device;
+   clGetDeviceInfo(dev, CL_DEVICE_TYPE, sizeof(slot->type), &slot->type, NULL);
+   clGetDeviceInfo(dev, CL_DEVICE_NAME, sizeof(slot->name), slot->name, NULL);
+}
+
+void device_set_init(device_set *set, cl_device_type type,
+      cpu_partition partition, cl_uint parts) {
+
+   cl_platform_id platforms[DEVICE_SET_MAX];
+   cl_device_id devices[DEVICE_SET_MAX], subs[DEVICE_SET_MAX];
+   cl_device_id ctx_devices[DEVICE_SET_MAX];
+   cl_device_partition_property props[3];
+   cl_device_type dev_type;
+   cl_uint num_platforms, num_devices, num_subs, units, i, j, k;
+   int first, s;
+   cl_int err;
+
+   set->num_slots = 0;
+   set->num_contexts = 0;
+
+   err = clGetPlatformIDs(DEVICE_SET_MAX, platforms, &num_platforms);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   }
+   if(num_platforms > DEVICE_SET_MAX)
+      num_platforms = DEVICE_SET_MAX;
+
+   for(i=0; i<num_platforms; i++) {
+
+      /* Platforms without devices of this type are skipped */
+      err = clGetDeviceIDs(platforms[i], type, DEVICE_SET_MAX,
+            devices, &num_devices);
+      if(err < 0 || num_devices == 0)
+         continue;
+      if(num_devices > DEVICE_SET_MAX)
+         num_devices = DEVICE_SET_MAX;
+
+      first = set->num_slots;
+      for(j=0; j<num_devices; j++) {
+
+         /* Split a CPU into groups of compute units or into NUMA
+            nodes. If the device can't be partitioned, it takes part whole */
+         num_subs = 0;
+         clGetDeviceInfo(devices[j], CL_DEVICE_TYPE,
+               sizeof(dev_type), &dev_type, NULL);
+         props[0] = 0;
+         if((dev_type & CL_DEVICE_TYPE_CPU) && partition == CPU_EQUALLY &&
+               parts > 1) {
+            clGetDeviceInfo(devices[j], CL_DEVICE_MAX_COMPUTE_UNITS,
+                  sizeof(units), &units, NULL);
+            props[0] = CL_DEVICE_PARTITION_EQUALLY;
+            props[1] = units/parts;
+            props[2] = 0;
+         }
+         else if((dev_type & CL_DEVICE_TYPE_CPU) && partition == CPU_NUMA) {
+            props[0] = CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN;
+            props[1] = CL_DEVICE_AFFINITY_DOMAIN_NUMA;
+            props[2] = 0;
+         }
+         if(props[0] != 0 && props[1] != 0 &&
+               clCreateSubDevices(devices[j], props,
+               DEVICE_SET_MAX, subs, &num_subs) < 0)
+            num_subs = 0;
+
+         if(num_subs > 0) {
+            for(k=0; k<num_subs; k++)
+               add_slot(set, subs[k], 1);
+         }
+         else
+            add_slot(set, devices[j], 0);
+      }
+      if(set->num_slots == first)
+         continue;
+
+      /* One context for the platform's devices */
+      for(s=first; s<set->num_slots; s++)
+         ctx_devices[s-first] = set->slots[s].device;
+      set->contexts[set->num_contexts] = clCreateContext(NULL,
+            set->num_slots - first, ctx_devices, NULL, NULL, &err);
+      if(err < 0) {
+         perror("Couldn't create a context");
+         exit(1);
+      }
+      set->programs[set->num_contexts] = NULL;
+      set->touch_kernels[set->num_contexts] = NULL;
+
+      for(s=first; s<set->num_slots; s++) {
+         set->slots[s].queue = clCreateCommandQueue(
+               set->contexts[set->num_contexts], set->slots[s].device,
+               CL_QUEUE_PROFILING_ENABLE, &err);
+         if(err < 0) {
+            perror("Couldn't create a command queue");
+            exit(1);
+         };
+      }
+      set->num_contexts++;
+   }
+
+   if(set->num_slots == 0) {
+      perror("Couldn't access any devices");
+      exit(1);
+   }
+}
+
+void device_set_build(device_set *set, const char *filename,
+      const char *options) {
+
+   FILE *program_handle;
+   char *program_buffer, *program_log;
+   size_t program_size, log_size;
+   int c, s;
+   cl_int err;
+
+   /* Read program file and place content into buffer */
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   for(c=0; c<set->num_contexts; c++) {
+      if(set->programs[c] != NULL)
+         clReleaseProgram(set->programs[c]);
+      set->programs[c] = clCreateProgramWithSource(set->contexts[c], 1,
+            (const char**)&program_buffer, &program_size, &err);
+      if(err < 0) {
+         perror("Couldn't create the program");
+         exit(1);
+      }
+
+      /* Build for every device in the context */
+      err = clBuildProgram(set->programs[c], 0, NULL, options, NULL, NULL);
+      if(err < 0) {
+         for(s=0; s<set->num_slots; s++) {
+            if(set->slots[s].context != c)
+               continue;
+            clGetProgramBuildInfo(set->programs[c], set->slots[s].device,
+                  CL_PROGRAM_BUILD_LOG, 0, NULL, &log_size);
+            program_log = (char*)malloc(log_size + 1);
+            program_log[log_size] = '\0';
+            clGetProgramBuildInfo(set->programs[c], set->slots[s].device,
+                  CL_PROGRAM_BUILD_LOG, log_size + 1, program_log, NULL);
+            printf("%s:\n%s\n", set->slots[s].name, program_log);
+            free(program_log);
+         }
+         exit(1);
+      }
+   }
+   free(program_buffer);
+}
+
+cl_program device_set_program(const device_set *set, int slot) {
+   return set->programs[set->slots[slot].context];
+}
+
+cl_mem device_set_buffer(device_set *set, int slot, size_t size) {
+
+   device_slot *s = &set->slots[slot];
+   cl_context context = set->contexts[s->context];
+   cl_program program;
+   const char *source = touch_source;
+   size_t num_pages = (size + TOUCH_STRIDE - 1)/TOUCH_STRIDE;
+   cl_mem buffer;
+   cl_int err;
+
+   buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, size, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);
+   }
+   if(!s->sub_device)
+      return buffer;
+
+   /* One first_touch kernel per context, created on first use */
+   if(set->touch_kernels[s->context] == NULL) {
+      program = clCreateProgramWithSource(context, 1, &source, NULL, &err);
+      if(err < 0) {
+         perror("Couldn't create the program");
+         exit(1);
+      }
+      err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't build the first_touch program");
+         exit(1);
+      }
+      set->touch_kernels[s->context] = clCreateKernel(program,
+            "first_touch", &err);
+      if(err < 0) {
+         perror("Couldn't create a kernel");
+         exit(1);
+      };
+      clReleaseProgram(program);
+   }
+
+   err = clSetKernelArg(set->touch_kernels[s->context], 0,
+         sizeof(cl_mem), &buffer);
+   err |= clEnqueueNDRangeKernel(s->queue, set->touch_kernels[s->context],
+         1, NULL, &num_pages, NULL, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't enqueue the first_touch kernel");
+      exit(1);
+   }
+   return buffer;
+}
+
+void device_set_split(const device_set *set, const double *rates,
+      size_t total, size_t granularity, size_t *counts) {
+
+   double weights[DEVICE_SET_MAX], sum = 0.0, diff, best_diff = 0.0;
+   size_t units = total/granularity, given = 0;
+   int i, best, measured = 1;
+
+   for(i=0; i<set->num_slots; i++)
+      if(rates[i] <= 0.0)
+         measured = 0;
+   for(i=0; i<set->num_slots; i++) {
+      weights[i] = measured ? rates[i] : 1.0;
+      sum += weights[i];
+   }
+
+   /* Round every share down, keeping at least one unit per slot so
+      that each slot's rate stays up to date */
+   for(i=0; i<set->num_slots; i++) {
+      counts[i] = (size_t)(units * weights[i]/sum);
+      if(counts[i] == 0 && units >= (size_t)set->num_slots)
+         counts[i] = 1;
+      given += counts[i];
+   }
+
+   /* Move single units until the counts add up, taking from the slot
+      furthest above its share or giving to the one furthest below */
+   while(given != units) {
+      best = -1;
+      for(i=0; i<set->num_slots; i++) {
+         diff = units * weights[i]/sum - counts[i];
+         if(given > units) {
+            if(counts[i] > 1 && (best < 0 || diff < best_diff)) {
+               best = i;
+               best_diff = diff;
+            }
+         }
+         else if(best < 0 || diff > best_diff) {
+            best = i;
+            best_diff = diff;
+         }
+      }
+      if(given > units) {
+         counts[best]--;
+         given--;
+      }
+      else {
+         counts[best]++;
+         given++;
+      }
+   }
+
+   for(i=0; i<set->num_slots; i++)
+      counts[i] *= granularity;
+}
+
+void device_set_record(const device_set *set, double *rates,
+      const size_t *counts, const double *seconds) {
+
+   double rate;
+   int i;
+
+   for(i=0; i<set->num_slots; i++) {
+      if(counts[i] == 0 || seconds[i] <= 0.0)
+         continue;
+      rate = counts[i]/seconds[i];
+      rates[i] = rates[i] > 0.0 ? 0.5 * (rates[i] + rate) : rate;
+   }
+}
+
+double device_set_elapsed(cl_event first, cl_event last) {
+
+   cl_ulong start, end;
+
+   clGetEventProfilingInfo(first, CL_PROFILING_COMMAND_START,
+         sizeof(start), &start, NULL);
+   clGetEventProfilingInfo(last, CL_PROFILING_COMMAND_END,
+         sizeof(end), &end, NULL);
+   return (end - start) * 1.0e-9;
+}
+
+void device_set_release(device_set *set) {
+
+   int i;
+
+   for(i=0; i<set->num_slots; i++) {
+      clReleaseCommandQueue(set->slots[i].queue);
+      if(set->slots[i].sub_device)
+         clReleaseDevice(set->slots[i].device);
+   }
+   for(i=0; i<set->num_contexts; i++) {
+      if(set->programs[i] != NULL)
+         clReleaseProgram(set->programs[i]);
+      if(set->touch_kernels[i] != NULL)
+         clReleaseKernel(set->touch_kernels[i]);
+      clReleaseContext(set->contexts[i]);
+   }
+   set->num_slots = 0;
+   set->num_contexts = 0;
+}
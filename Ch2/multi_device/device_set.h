@@ -0,0 +1,81 @@
+#ifndef DEVICE_SET_H
+#define DEVICE_SET_H
+
+#include <stddef.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#define DEVICE_SET_MAX 32
+
+/* How device_set_init divides a CPU device */
+typedef enum cpu_partition {
+   CPU_WHOLE,              /* One slot for the whole device */
+   CPU_EQUALLY,            /* Sub-devices with equal compute units */
+   CPU_NUMA                /* One sub-device per NUMA node */
+} cpu_partition;
+
+/* One device that takes part in a split. Sub-devices of a partitioned
+   CPU get a slot each */
+typedef struct device_slot {
+   cl_device_id device;
+   cl_command_queue queue;    /* In-order, with profiling enabled */
+   int context;               /* Index into the set's contexts */
+   cl_device_type type;
+   int sub_device;
+   char name[128];
+} device_slot;
+
+/* Every device of every platform. The devices of a platform share
+   one context and one program */
+typedef struct device_set {
+   device_slot slots[DEVICE_SET_MAX];
+   int num_slots;
+   cl_context contexts[DEVICE_SET_MAX];
+   cl_program programs[DEVICE_SET_MAX];
+   cl_kernel touch_kernels[DEVICE_SET_MAX];
+   int num_contexts;
+} device_set;
+
+/* Find the devices of the given type on every platform. CPUs are
+   divided as partition says, into parts sub-devices for CPU_EQUALLY or
+   by CL_DEVICE_AFFINITY_DOMAIN_NUMA for CPU_NUMA. A CPU that can't be
+   divided that way takes part whole */
+void device_set_init(device_set *set, cl_device_type type,
+      cpu_partition partition, cl_uint parts);
+
+/* Build the file for every context, replacing any earlier program.
+   Exits with the build log on failure */
+void device_set_build(device_set *set, const char *filename,
+      const char *options);
+
+cl_program device_set_program(const device_set *set, int slot);
+
+/* A read-write buffer for the slot. On a sub-device, a kernel on the
+   slot's queue writes one byte of every page before anything else can,
+   so a first-touch operating system places the pages on the sub-device's
+   node. Enqueue the buffer's transfers on the same queue */
+cl_mem device_set_buffer(device_set *set, int slot, size_t size);
+
+/* Divide total items among the slots in proportion to rates, which
+   holds each slot's items per second for one workload, 0 until measured.
+   The split is equal until every slot has been measured. Counts are
+   multiples of granularity, which must divide total, and every slot
+   gets at least one unit while there are enough to go around */
+void device_set_split(const device_set *set, const double *rates,
+      size_t total, size_t granularity, size_t *counts);
+
+/* Update rates from the items each slot processed and the seconds it
+   took. New measurements are averaged with the old ones */
+void device_set_record(const device_set *set, double *rates,
+      const size_t *counts, const double *seconds);
+
+/* Seconds from the start of first to the end of last */
+double device_set_elapsed(cl_event first, cl_event last);
+
+void device_set_release(device_set *set);
+
+#endif
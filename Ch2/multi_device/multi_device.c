@@ -0,0 +1,447 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define M_PI 3.14159265358979323846
+#define REDUCTION_FILE "../../Ch10/reduction/reduction.cl"
+#define SEARCH_FILE "../../Ch11/string_search/string_search.cl"
+#define TEXT_FILE "../../Ch11/string_search/kafka.txt"
+#define FFT_FILE "../../Ch14/fft/fft.cl"
+
+/* fft.cl includes device_lib.h and reduction.cl accumulate.h, both from
+   Ch2/program_link */
+#define DEVICE_LIB_OPTION "-I../../Ch2/program_link"
+
+/* Reduction: float4 vectors, split in units of whole work-groups */
+#define NUM_VECTORS (1 << 22)
+#define VECTORS_PER_UNIT 256
+
+/* String search: copies of the text, split in units of work-groups */
+#define TEXT_COPIES 64
+#define CHARS_PER_ITEM 256
+#define ITEMS_PER_UNIT 64
+#define CHARS_PER_UNIT (CHARS_PER_ITEM * ITEMS_PER_UNIT)
+
+/* Batched FFT: whole transforms, split in units of one transform */
+#define FFT_POINTS 16384
+#define NUM_TRANSFORMS 256
+
+#define ROUNDS 5
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "device_set.h"
+
+/* What one slot was given in a round */
+typedef struct slot_job {
+   cl_kernel kernel, stage_kernel;
+   cl_mem input, output;
+   cl_event first, last;
+   float *partial_sums, *points;
+   int counts[4];
+   size_t num_groups;
+} slot_job;
+
+/* The largest power-of-two work-group up to max the kernel can use */
+static size_t group_size(cl_kernel kernel, cl_device_id dev, size_t max) {
+
+   size_t wg_size, size = max;
+
+   clGetKernelWorkGroupInfo(kernel, dev, CL_KERNEL_WORK_GROUP_SIZE,
+         sizeof(wg_size), &wg_size, NULL);
+   while(size > wg_size)
+      size /= 2;
+   return size;
+}
+
+static void check_err(cl_int err, const char *msg) {
+   if(err < 0) {
+      perror(msg);
+      exit(1);
+   }
+}
+
+/* Time each slot's commands, update the rates and print the split.
+   The round takes as long as the slowest slot */
+static void finish_round(device_set *set, double *rates, slot_job *jobs,
+      const size_t *counts, size_t total, int round) {
+
+   double seconds[DEVICE_SET_MAX], round_time = 0.0;
+   int i;
+
+   for(i=0; i<set->num_slots; i++)
+      clFinish(set->slots[i].queue);
+
+   printf("Round %d:", round);
+   for(i=0; i<set->num_slots; i++) {
+      seconds[i] = 0.0;
+      if(counts[i] > 0) {
+         seconds[i] = device_set_elapsed(jobs[i].first, jobs[i].last);
+         clReleaseEvent(jobs[i].first);
+         clReleaseEvent(jobs[i].last);
+      }
+      if(seconds[i] > round_time)
+         round_time = seconds[i];
+      printf(" %5.1f%%", 100.0 * counts[i]/total);
+   }
+   printf("  %8.3f ms\n", round_time * 1.0e3);
+   device_set_record(set, rates, counts, seconds);
+}
+
+/* Sum NUM_VECTORS float4s, each slot reducing its own range */
+static int reduce_round(device_set *set, double *rates, const float *data,
+      double expected, int round) {
+
+   slot_job jobs[DEVICE_SET_MAX];
+   size_t counts[DEVICE_SET_MAX], offset = 0, local_size;
+   double sum = 0.0;
+   cl_context context;
+   cl_int err;
+   int i;
+   size_t j;
+
+   device_set_split(set, rates, NUM_VECTORS, VECTORS_PER_UNIT, counts);
+
+   /* Enqueue and flush every slot before waiting on any of them */
+   for(i=0; i<set->num_slots; i++) {
+      if(counts[i] == 0)
+         continue;
+      context = set->contexts[set->slots[i].context];
+      jobs[i].kernel = clCreateKernel(device_set_program(set, i),
+            "reduction_vector", &err);
+      check_err(err, "Couldn't create a kernel");
+      local_size = group_size(jobs[i].kernel, set->slots[i].device,
+            VECTORS_PER_UNIT);
+      jobs[i].num_groups = counts[i]/local_size;
+
+      jobs[i].input = device_set_buffer(set, i, counts[i] * 4 * sizeof(float));
+      jobs[i].output = clCreateBuffer(context, CL_MEM_WRITE_ONLY,
+            jobs[i].num_groups * sizeof(float), NULL, &err);
+      check_err(err, "Couldn't create a buffer");
+      jobs[i].partial_sums = (float*)malloc(jobs[i].num_groups * sizeof(float));
+
+      err = clSetKernelArg(jobs[i].kernel, 0, sizeof(cl_mem), &jobs[i].input);
+      err |= clSetKernelArg(jobs[i].kernel, 1,
+            local_size * 4 * sizeof(float), NULL);
+      err |= clSetKernelArg(jobs[i].kernel, 2, sizeof(cl_mem), &jobs[i].output);
+      check_err(err, "Couldn't set a kernel argument");
+
+      err = clEnqueueWriteBuffer(set->slots[i].queue, jobs[i].input, CL_FALSE,
+            0, counts[i] * 4 * sizeof(float), data + 4 * offset,
+            0, NULL, &jobs[i].first);
+      err |= clEnqueueNDRangeKernel(set->slots[i].queue, jobs[i].kernel, 1,
+            NULL, &counts[i], &local_size, 0, NULL, NULL);
+      err |= clEnqueueReadBuffer(set->slots[i].queue, jobs[i].output, CL_FALSE,
+            0, jobs[i].num_groups * sizeof(float), jobs[i].partial_sums,
+            0, NULL, &jobs[i].last);
+      check_err(err, "Couldn't enqueue the reduction");
+      clFlush(set->slots[i].queue);
+      offset += counts[i];
+   }
+
+   finish_round(set, rates, jobs, counts, NUM_VECTORS, round);
+
+   for(i=0; i<set->num_slots; i++) {
+      if(counts[i] == 0)
+         continue;
+      for(j=0; j<jobs[i].num_groups; j++)
+         sum += jobs[i].partial_sums[j];
+      free(jobs[i].partial_sums);
+      clReleaseMemObject(jobs[i].input);
+      clReleaseMemObject(jobs[i].output);
+      clReleaseKernel(jobs[i].kernel);
+   }
+   return fabs(sum - expected) <= 1.0e-6 * expected;
+}
+
+/* Count the four words in text_size characters, each slot searching
+   its own range. A range's buffer runs 15 characters past its end so
+   matches that start inside it are found */
+static int search_round(device_set *set, double *rates, const char *text,
+      size_t text_size, const int *expected, int round) {
+
+   slot_job jobs[DEVICE_SET_MAX];
+   size_t counts[DEVICE_SET_MAX], offset = 0, global_size, local_size;
+   char pattern[16] = {'t','h','a','t','w','i','t','h',
+                       'h','a','v','e','f','r','o','m'};
+   int chars_per_item = CHARS_PER_ITEM, totals[4] = {0, 0, 0, 0};
+   const int zeros[4] = {0, 0, 0, 0};
+   cl_context context;
+   cl_int err;
+   int i, k;
+
+   device_set_split(set, rates, text_size, CHARS_PER_UNIT, counts);
+
+   for(i=0; i<set->num_slots; i++) {
+      if(counts[i] == 0)
+         continue;
+      context = set->contexts[set->slots[i].context];
+      jobs[i].kernel = clCreateKernel(device_set_program(set, i),
+            "string_search", &err);
+      check_err(err, "Couldn't create a kernel");
+      local_size = group_size(jobs[i].kernel, set->slots[i].device,
+            ITEMS_PER_UNIT);
+      global_size = counts[i]/CHARS_PER_ITEM;
+
+      jobs[i].input = device_set_buffer(set, i, counts[i] + 15);
+      jobs[i].output = clCreateBuffer(context, CL_MEM_READ_WRITE,
+            4 * sizeof(int), NULL, &err);
+      check_err(err, "Couldn't create a buffer");
+
+      err = clSetKernelArg(jobs[i].kernel, 0, sizeof(pattern), pattern);
+      err |= clSetKernelArg(jobs[i].kernel, 1, sizeof(cl_mem), &jobs[i].input);
+      err |= clSetKernelArg(jobs[i].kernel, 2, sizeof(chars_per_item),
+            &chars_per_item);
+      err |= clSetKernelArg(jobs[i].kernel, 3, 4 * sizeof(int), NULL);
+      err |= clSetKernelArg(jobs[i].kernel, 4, sizeof(cl_mem), &jobs[i].output);
+      check_err(err, "Couldn't set a kernel argument");
+
+      err = clEnqueueWriteBuffer(set->slots[i].queue, jobs[i].input, CL_FALSE,
+            0, counts[i] + 15, text + offset, 0, NULL, &jobs[i].first);
+      err |= clEnqueueWriteBuffer(set->slots[i].queue, jobs[i].output,
+            CL_FALSE, 0, sizeof(zeros), zeros, 0, NULL, NULL);
+      err |= clEnqueueNDRangeKernel(set->slots[i].queue, jobs[i].kernel, 1,
+            NULL, &global_size, &local_size, 0, NULL, NULL);
+      err |= clEnqueueReadBuffer(set->slots[i].queue, jobs[i].output, CL_FALSE,
+            0, sizeof(jobs[i].counts), jobs[i].counts,
+            0, NULL, &jobs[i].last);
+      check_err(err, "Couldn't enqueue the search");
+      clFlush(set->slots[i].queue);
+      offset += counts[i];
+   }
+
+   finish_round(set, rates, jobs, counts, text_size, round);
+
+   for(i=0; i<set->num_slots; i++) {
+      if(counts[i] == 0)
+         continue;
+      for(k=0; k<4; k++)
+         totals[k] += jobs[i].counts[k];
+      clReleaseMemObject(jobs[i].input);
+      clReleaseMemObject(jobs[i].output);
+      clReleaseKernel(jobs[i].kernel);
+   }
+   return memcmp(totals, expected, sizeof(totals)) == 0;
+}
+
+/* Forward transforms of NUM_TRANSFORMS signals of FFT_POINTS points,
+   each slot transforming whole signals in place. Signal t is a complex
+   exponential of frequency t % FFT_POINTS, so its transform is
+   FFT_POINTS at that frequency and zero elsewhere */
+static int fft_round(device_set *set, double *rates, const float *signals,
+      int round) {
+
+   slot_job jobs[DEVICE_SET_MAX];
+   size_t counts[DEVICE_SET_MAX], offset = 0, global_size, local_size;
+   size_t bytes, n, k;
+   cl_ulong local_mem_size;
+   cl_uint size = FFT_POINTS, points_per_group, stage;
+   cl_int dir = 1, err;
+   double re, im, error = 0.0;
+   int i;
+
+   device_set_split(set, rates, NUM_TRANSFORMS, 1, counts);
+
+   for(i=0; i<set->num_slots; i++) {
+      if(counts[i] == 0)
+         continue;
+      jobs[i].kernel = clCreateKernel(device_set_program(set, i),
+            "fft_init", &err);
+      check_err(err, "Couldn't create a kernel");
+      jobs[i].stage_kernel = clCreateKernel(device_set_program(set, i),
+            "fft_stage", &err);
+      check_err(err, "Couldn't create a kernel");
+
+      /* A power of two of points per group that fits in local memory,
+         with at least four per work-item */
+      clGetDeviceInfo(set->slots[i].device, CL_DEVICE_LOCAL_MEM_SIZE,
+            sizeof(local_mem_size), &local_mem_size, NULL);
+      for(points_per_group = FFT_POINTS; points_per_group * 2 *
+            sizeof(float) > local_mem_size; points_per_group >>= 1);
+      local_size = group_size(jobs[i].kernel, set->slots[i].device,
+            points_per_group/4);
+      global_size = counts[i] * FFT_POINTS/points_per_group * local_size;
+
+      bytes = counts[i] * FFT_POINTS * 2 * sizeof(float);
+      jobs[i].input = device_set_buffer(set, i, bytes);
+      jobs[i].points = (float*)malloc(bytes);
+
+      err = clSetKernelArg(jobs[i].kernel, 0, sizeof(cl_mem), &jobs[i].input);
+      err |= clSetKernelArg(jobs[i].kernel, 1,
+            points_per_group * 2 * sizeof(float), NULL);
+      err |= clSetKernelArg(jobs[i].kernel, 2, sizeof(cl_uint),
+            &points_per_group);
+      err |= clSetKernelArg(jobs[i].kernel, 3, sizeof(cl_uint), &size);
+      err |= clSetKernelArg(jobs[i].kernel, 4, sizeof(cl_int), &dir);
+      err |= clSetKernelArg(jobs[i].stage_kernel, 0, sizeof(cl_mem),
+            &jobs[i].input);
+      err |= clSetKernelArg(jobs[i].stage_kernel, 2, sizeof(cl_uint),
+            &points_per_group);
+      err |= clSetKernelArg(jobs[i].stage_kernel, 3, sizeof(cl_int), &dir);
+      check_err(err, "Couldn't set a kernel argument");
+
+      /* The stages pair points within blocks no larger than one
+         transform, so every transform in the batch goes in one launch */
+      err = clEnqueueWriteBuffer(set->slots[i].queue, jobs[i].input, CL_FALSE,
+            0, bytes, signals + 2 * offset * FFT_POINTS,
+            0, NULL, &jobs[i].first);
+      err |= clEnqueueNDRangeKernel(set->slots[i].queue, jobs[i].kernel, 1,
+            NULL, &global_size, &local_size, 0, NULL, NULL);
+      for(stage = 2; stage <= FFT_POINTS/points_per_group; stage <<= 1) {
+         err |= clSetKernelArg(jobs[i].stage_kernel, 1, sizeof(stage), &stage);
+         err |= clEnqueueNDRangeKernel(set->slots[i].queue,
+               jobs[i].stage_kernel, 1, NULL, &global_size, &local_size,
+               0, NULL, NULL);
+      }
+      err |= clEnqueueReadBuffer(set->slots[i].queue, jobs[i].input, CL_FALSE,
+            0, bytes, jobs[i].points, 0, NULL, &jobs[i].last);
+      check_err(err, "Couldn't enqueue the FFT");
+      clFlush(set->slots[i].queue);
+      offset += counts[i];
+   }
+
+   finish_round(set, rates, jobs, counts, NUM_TRANSFORMS, round);
+
+   /* Largest error relative to the peak */
+   offset = 0;
+   for(i=0; i<set->num_slots; i++) {
+      if(counts[i] == 0)
+         continue;
+      for(n=0; n<counts[i]; n++) {
+         for(k=0; k<FFT_POINTS; k++) {
+            re = jobs[i].points[2 * (n * FFT_POINTS + k)];
+            im = jobs[i].points[2 * (n * FFT_POINTS + k) + 1];
+            if(k == (offset + n) % FFT_POINTS)
+               re -= FFT_POINTS;
+            if(fabs(re) + fabs(im) > error)
+               error = fabs(re) + fabs(im);
+         }
+      }
+      offset += counts[i];
+      free(jobs[i].points);
+      clReleaseMemObject(jobs[i].input);
+      clReleaseKernel(jobs[i].kernel);
+      clReleaseKernel(jobs[i].stage_kernel);
+   }
+   return error <= 1.0e-3 * FFT_POINTS;
+}
+
+static void print_slots(const device_set *set) {
+
+   int i;
+
+   for(i=0; i<set->num_slots; i++)
+      printf("Slot %d: %s%s%s\n", i, set->slots[i].name,
+            (set->slots[i].type & CL_DEVICE_TYPE_GPU) ? " (GPU)" : "",
+            set->slots[i].sub_device ? " (sub-device)" : "");
+   printf("\n");
+}
+
+int main(int argc, char **argv) {
+
+   device_set set;
+   cl_device_type type = CL_DEVICE_TYPE_ALL;
+   cpu_partition partition = CPU_WHOLE;
+   cl_uint cpu_parts = 1;
+   double rates[DEVICE_SET_MAX], expected_sum = 0.0;
+   float *data, *signals;
+   char *text;
+   FILE *text_handle;
+   size_t file_size, text_size, i, n;
+   int expected_counts[4] = {0, 0, 0, 0}, check = 1, round, k;
+   const char *words[4] = {"that", "with", "have", "from"};
+
+   for(k=1; k<argc; k++) {
+      if(strcmp(argv[k], "-gpu") == 0)
+         type = CL_DEVICE_TYPE_GPU;
+      else if(strcmp(argv[k], "-cpu") == 0)
+         type = CL_DEVICE_TYPE_CPU;
+      else if(strcmp(argv[k], "-split") == 0 && k+1 < argc) {
+         partition = CPU_EQUALLY;
+         cpu_parts = (cl_uint)atoi(argv[++k]);
+      }
+      else if(strcmp(argv[k], "-numa") == 0)
+         partition = CPU_NUMA;
+      else {
+         printf("Usage: %s [-gpu|-cpu] [-split parts | -numa]\n", argv[0]);
+         exit(1);
+      }
+   }
+
+   device_set_init(&set, type, partition, cpu_parts);
+   print_slots(&set);
+
+   /* Small integers keep every partial sum exact */
+   data = (float*)malloc(NUM_VECTORS * 4 * sizeof(float));
+   for(i=0; i<NUM_VECTORS * 4; i++) {
+      data[i] = (float)(i % 8);
+      expected_sum += data[i];
+   }
+
+   device_set_build(&set, REDUCTION_FILE, DEVICE_LIB_OPTION);
+   printf("Reduction of %d floats\n", NUM_VECTORS * 4);
+   for(k=0; k<set.num_slots; k++)
+      rates[k] = 0.0;
+   for(round=0; round<ROUNDS; round++)
+      check &= reduce_round(&set, rates, data, expected_sum, round);
+   free(data);
+
+   /* Repeat the text, padded with zeros to a whole number of units */
+   text_handle = fopen(TEXT_FILE, "rb");
+   if(text_handle == NULL) {
+      perror("Couldn't find the text file");
+      exit(1);
+   }
+   fseek(text_handle, 0, SEEK_END);
+   file_size = ftell(text_handle);
+   rewind(text_handle);
+   text_size = file_size * TEXT_COPIES;
+   text_size = (text_size + CHARS_PER_UNIT - 1)/CHARS_PER_UNIT * CHARS_PER_UNIT;
+   text = (char*)calloc(text_size + 16, sizeof(char));
+   fread(text, sizeof(char), file_size, text_handle);
+   fclose(text_handle);
+   for(i=1; i<TEXT_COPIES; i++)
+      memcpy(text + i * file_size, text, file_size);
+
+   for(i=0; i<text_size; i++)
+      for(k=0; k<4; k++)
+         if(memcmp(text + i, words[k], 4) == 0)
+            expected_counts[k]++;
+
+   device_set_build(&set, SEARCH_FILE, NULL);
+   printf("\nString search of %lu characters\n", (unsigned long)text_size);
+   for(k=0; k<set.num_slots; k++)
+      rates[k] = 0.0;
+   for(round=0; round<ROUNDS; round++)
+      check &= search_round(&set, rates, text, text_size,
+            expected_counts, round);
+   free(text);
+
+   /* Signal t is exp(2*pi*i*t*n/FFT_POINTS) */
+   signals = (float*)malloc(NUM_TRANSFORMS * FFT_POINTS * 2 * sizeof(float));
+   for(i=0; i<NUM_TRANSFORMS; i++) {
+      for(n=0; n<FFT_POINTS; n++) {
+         signals[2 * (i * FFT_POINTS + n)] =
+               (float)cos(2 * M_PI * ((i * n) % FFT_POINTS)/FFT_POINTS);
+         signals[2 * (i * FFT_POINTS + n) + 1] =
+               (float)sin(2 * M_PI * ((i * n) % FFT_POINTS)/FFT_POINTS);
+      }
+   }
+
+   device_set_build(&set, FFT_FILE, DEVICE_LIB_OPTION);
+   printf("\nBatched FFT of %d transforms of %d points\n",
+         NUM_TRANSFORMS, FFT_POINTS);
+   for(k=0; k<set.num_slots; k++)
+      rates[k] = 0.0;
+   for(round=0; round<ROUNDS; round++)
+      check &= fft_round(&set, rates, signals, round);
+   free(signals);
+
+   if(check)
+      printf("Check passed.\n");
+   else
+      printf("Check failed.\n");
+
+   device_set_release(&set);
+   return 0;
+}
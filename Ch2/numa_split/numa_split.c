@@ -0,0 +1,373 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define REDUCTION_FILE "../../Ch10/reduction_complete/reduction_complete.cl"
+#define BSORT_FILE "../../Ch11/bsort/bsort.cl"
+
+/* bsort.cl includes the device library's header */
+#define DEVICE_LIB_OPTION "-I../../Ch2/program_link"
+
+/* Multi-pass reduction: independent blocks of float4 vectors */
+#define NUM_BLOCKS 64
+#define BLOCK_VECTORS (1 << 16)
+
+/* Bitonic sort: independent runs of floats */
+#define NUM_RUNS 32
+#define RUN_SIZE (1 << 18)
+
+#define ROUNDS 3
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "device_set.h"
+
+/* The blocks or runs one slot was given in a round */
+typedef struct slot_job {
+   cl_kernel kernels[5];
+   cl_mem buffers[NUM_BLOCKS], sums[NUM_BLOCKS];
+   cl_event first, last;
+   size_t first_unit, num_units;
+} slot_job;
+
+static void check_err(cl_int err, const char *msg) {
+   if(err < 0) {
+      perror(msg);
+      exit(1);
+   }
+}
+
+/* The largest power-of-two work-group up to max the kernel can use */
+static size_t group_size(cl_kernel kernel, cl_device_id dev, size_t max) {
+
+   size_t wg_size, size = max;
+
+   clGetKernelWorkGroupInfo(kernel, dev, CL_KERNEL_WORK_GROUP_SIZE,
+         sizeof(wg_size), &wg_size, NULL);
+   while(size > wg_size)
+      size /= 2;
+   return size;
+}
+
+/* Split units among the slots, counting from the first unit */
+static void assign_units(device_set *set, const double *rates,
+      size_t total_units, slot_job *jobs, size_t *counts) {
+
+   size_t next = 0;
+   int i;
+
+   device_set_split(set, rates, total_units, 1, counts);
+   for(i=0; i<set->num_slots; i++) {
+      jobs[i].first_unit = next;
+      jobs[i].num_units = counts[i];
+      next += counts[i];
+   }
+}
+
+/* Wait for every slot, update the rates and print the split */
+static void finish_round(device_set *set, double *rates, slot_job *jobs,
+      size_t *counts, size_t total_units, int round) {
+
+   double seconds[DEVICE_SET_MAX], round_time = 0.0;
+   int i;
+
+   for(i=0; i<set->num_slots; i++)
+      clFinish(set->slots[i].queue);
+
+   printf("Round %d:", round);
+   for(i=0; i<set->num_slots; i++) {
+      seconds[i] = 0.0;
+      if(counts[i] > 0) {
+         seconds[i] = device_set_elapsed(jobs[i].first, jobs[i].last);
+         clReleaseEvent(jobs[i].first);
+         clReleaseEvent(jobs[i].last);
+      }
+      if(seconds[i] > round_time)
+         round_time = seconds[i];
+      printf(" %3lu", (unsigned long)counts[i]);
+   }
+   printf(" of %lu  %8.3f ms\n", (unsigned long)total_units,
+         round_time * 1.0e3);
+   device_set_record(set, rates, counts, seconds);
+}
+
+/* Sum each block on its slot with the passes of Ch10/reduction_complete.
+   Each block's buffer is placed on the slot's node before it's written */
+static int reduce_round(device_set *set, double *rates, const float *data,
+      int round) {
+
+   slot_job jobs[DEVICE_SET_MAX];
+   size_t counts[DEVICE_SET_MAX], local_size, global_size, b;
+   float sums[NUM_BLOCKS], expected;
+   cl_command_queue queue;
+   cl_event *event;
+   cl_int err;
+   int i, check = 1;
+
+   assign_units(set, rates, NUM_BLOCKS, jobs, counts);
+   for(i=0; i<set->num_slots; i++) {
+      if(counts[i] == 0)
+         continue;
+      queue = set->slots[i].queue;
+      jobs[i].kernels[0] = clCreateKernel(device_set_program(set, i),
+            "reduction_vector", &err);
+      check_err(err, "Couldn't create a kernel");
+      jobs[i].kernels[1] = clCreateKernel(device_set_program(set, i),
+            "reduction_complete", &err);
+      check_err(err, "Couldn't create a kernel");
+      local_size = group_size(jobs[i].kernels[0], set->slots[i].device, 256);
+      local_size = group_size(jobs[i].kernels[1], set->slots[i].device,
+            local_size);
+      err = clSetKernelArg(jobs[i].kernels[0], 1,
+            local_size * 4 * sizeof(float), NULL);
+      err |= clSetKernelArg(jobs[i].kernels[1], 1,
+            local_size * 4 * sizeof(float), NULL);
+      check_err(err, "Couldn't set a kernel argument");
+
+      for(b=jobs[i].first_unit; b<jobs[i].first_unit + counts[i]; b++) {
+         jobs[i].buffers[b] = device_set_buffer(set, i,
+               BLOCK_VECTORS * 4 * sizeof(float));
+         jobs[i].sums[b] = device_set_buffer(set, i, sizeof(float));
+
+         event = (b == jobs[i].first_unit) ? &jobs[i].first : NULL;
+         err = clEnqueueWriteBuffer(queue, jobs[i].buffers[b], CL_FALSE, 0,
+               BLOCK_VECTORS * 4 * sizeof(float),
+               data + b * BLOCK_VECTORS * 4, 0, NULL, event);
+         check_err(err, "Couldn't write a block");
+
+         /* Reduce in place until one work-group can finish the block */
+         err = clSetKernelArg(jobs[i].kernels[0], 0, sizeof(cl_mem),
+               &jobs[i].buffers[b]);
+         err |= clSetKernelArg(jobs[i].kernels[1], 0, sizeof(cl_mem),
+               &jobs[i].buffers[b]);
+         err |= clSetKernelArg(jobs[i].kernels[1], 2, sizeof(cl_mem),
+               &jobs[i].sums[b]);
+         check_err(err, "Couldn't set a kernel argument");
+         global_size = BLOCK_VECTORS;
+         err = clEnqueueNDRangeKernel(queue, jobs[i].kernels[0], 1, NULL,
+               &global_size, &local_size, 0, NULL, NULL);
+         while(global_size/local_size > local_size) {
+            global_size = global_size/local_size;
+            err |= clEnqueueNDRangeKernel(queue, jobs[i].kernels[0], 1, NULL,
+                  &global_size, &local_size, 0, NULL, NULL);
+         }
+         global_size = global_size/local_size;
+         err |= clEnqueueNDRangeKernel(queue, jobs[i].kernels[1], 1, NULL,
+               &global_size, &global_size, 0, NULL, NULL);
+         check_err(err, "Couldn't enqueue the reduction");
+
+         event = (b == jobs[i].first_unit + counts[i] - 1) ?
+               &jobs[i].last : NULL;
+         err = clEnqueueReadBuffer(queue, jobs[i].sums[b], CL_FALSE, 0,
+               sizeof(float), &sums[b], 0, NULL, event);
+         check_err(err, "Couldn't read a sum");
+      }
+      clFlush(queue);
+   }
+
+   finish_round(set, rates, jobs, counts, NUM_BLOCKS, round);
+
+   /* Every block holds the same repeating values */
+   expected = 3.5f * BLOCK_VECTORS * 4;
+   for(i=0; i<set->num_slots; i++) {
+      if(counts[i] == 0)
+         continue;
+      for(b=jobs[i].first_unit; b<jobs[i].first_unit + counts[i]; b++) {
+         if(sums[b] != expected)
+            check = 0;
+         clReleaseMemObject(jobs[i].buffers[b]);
+         clReleaseMemObject(jobs[i].sums[b]);
+      }
+      clReleaseKernel(jobs[i].kernels[0]);
+      clReleaseKernel(jobs[i].kernels[1]);
+   }
+   return check;
+}
+
+/* Enqueue the Ch11/bsort launch sequence for one run */
+static void enqueue_bsort(cl_command_queue queue, cl_kernel *kernels,
+      cl_mem buffer, size_t local_size) {
+
+   size_t global_size = RUN_SIZE/8;
+   cl_uint stage, high_stage, num_stages;
+   int i;
+   cl_int err = 0;
+
+   for(i=0; i<5; i++)
+      err |= clSetKernelArg(kernels[i], 0, sizeof(cl_mem), &buffer);
+   err |= clEnqueueNDRangeKernel(queue, kernels[0], 1, NULL, &global_size,
+         &local_size, 0, NULL, NULL);
+
+   num_stages = (cl_uint)(global_size/local_size);
+   for(high_stage = 2; high_stage < num_stages; high_stage <<= 1) {
+      err |= clSetKernelArg(kernels[1], 2, sizeof(int), &high_stage);
+      err |= clSetKernelArg(kernels[2], 3, sizeof(int), &high_stage);
+      for(stage = high_stage; stage > 1; stage >>= 1) {
+         err |= clSetKernelArg(kernels[2], 2, sizeof(int), &stage);
+         err |= clEnqueueNDRangeKernel(queue, kernels[2], 1, NULL,
+               &global_size, &local_size, 0, NULL, NULL);
+      }
+      err |= clEnqueueNDRangeKernel(queue, kernels[1], 1, NULL,
+            &global_size, &local_size, 0, NULL, NULL);
+   }
+
+   for(stage = num_stages; stage > 1; stage >>= 1) {
+      err |= clSetKernelArg(kernels[3], 2, sizeof(int), &stage);
+      err |= clEnqueueNDRangeKernel(queue, kernels[3], 1, NULL,
+            &global_size, &local_size, 0, NULL, NULL);
+   }
+   err |= clEnqueueNDRangeKernel(queue, kernels[4], 1, NULL,
+         &global_size, &local_size, 0, NULL, NULL);
+   check_err(err, "Couldn't enqueue the sort");
+}
+
+static int compare_floats(const void *a, const void *b) {
+   float x = *(const float*)a, y = *(const float*)b;
+   return (x > y) - (x < y);
+}
+
+/* Sort each run on its slot */
+static int sort_round(device_set *set, double *rates, const float *data,
+      const float *sorted, float *result, int round) {
+
+   const char *names[5] = {"bsort_init", "bsort_stage_0", "bsort_stage_n",
+                           "bsort_merge", "bsort_merge_last"};
+   slot_job jobs[DEVICE_SET_MAX];
+   size_t counts[DEVICE_SET_MAX], local_size, local_mem, r;
+   cl_command_queue queue;
+   cl_event *event;
+   cl_ulong mem_size;
+   int i, k, direction = 0;
+   cl_int err;
+
+   assign_units(set, rates, NUM_RUNS, jobs, counts);
+   for(i=0; i<set->num_slots; i++) {
+      if(counts[i] == 0)
+         continue;
+      queue = set->slots[i].queue;
+      for(k=0; k<5; k++) {
+         jobs[i].kernels[k] = clCreateKernel(device_set_program(set, i),
+               names[k], &err);
+         check_err(err, "Couldn't create a kernel");
+      }
+
+      /* Every work-item sorts eight floats in local memory */
+      clGetDeviceInfo(set->slots[i].device, CL_DEVICE_LOCAL_MEM_SIZE,
+            sizeof(mem_size), &mem_size, NULL);
+      local_size = group_size(jobs[i].kernels[0], set->slots[i].device,
+            RUN_SIZE/8);
+      while(8 * local_size * sizeof(float) > mem_size)
+         local_size /= 2;
+      local_mem = 8 * local_size * sizeof(float);
+      err = 0;
+      for(k=0; k<5; k++)
+         err |= clSetKernelArg(jobs[i].kernels[k], 1, local_mem, NULL);
+      err |= clSetKernelArg(jobs[i].kernels[3], 3, sizeof(int), &direction);
+      err |= clSetKernelArg(jobs[i].kernels[4], 2, sizeof(int), &direction);
+      check_err(err, "Couldn't set a kernel argument");
+
+      for(r=jobs[i].first_unit; r<jobs[i].first_unit + counts[i]; r++) {
+         jobs[i].buffers[r] = device_set_buffer(set, i,
+               RUN_SIZE * sizeof(float));
+         event = (r == jobs[i].first_unit) ? &jobs[i].first : NULL;
+         err = clEnqueueWriteBuffer(queue, jobs[i].buffers[r], CL_FALSE, 0,
+               RUN_SIZE * sizeof(float), data + r * RUN_SIZE, 0, NULL, event);
+         check_err(err, "Couldn't write a run");
+
+         enqueue_bsort(queue, jobs[i].kernels, jobs[i].buffers[r], local_size);
+
+         event = (r == jobs[i].first_unit + counts[i] - 1) ?
+               &jobs[i].last : NULL;
+         err = clEnqueueReadBuffer(queue, jobs[i].buffers[r], CL_FALSE, 0,
+               RUN_SIZE * sizeof(float), result + r * RUN_SIZE,
+               0, NULL, event);
+         check_err(err, "Couldn't read a run");
+      }
+      clFlush(queue);
+   }
+
+   finish_round(set, rates, jobs, counts, NUM_RUNS, round);
+
+   for(i=0; i<set->num_slots; i++) {
+      if(counts[i] == 0)
+         continue;
+      for(r=jobs[i].first_unit; r<jobs[i].first_unit + counts[i]; r++)
+         clReleaseMemObject(jobs[i].buffers[r]);
+      for(k=0; k<5; k++)
+         clReleaseKernel(jobs[i].kernels[k]);
+   }
+   return memcmp(result, sorted, NUM_RUNS * RUN_SIZE * sizeof(float)) == 0;
+}
+
+int main(int argc, char **argv) {
+
+   device_set set;
+   cpu_partition partition = CPU_NUMA;
+   cl_uint parts = 0;
+   double rates[DEVICE_SET_MAX];
+   float *data, *sorted, *result;
+   size_t i;
+   int check = 1, round, k;
+
+   for(k=1; k<argc; k++) {
+      if(strcmp(argv[k], "-whole") == 0)
+         partition = CPU_WHOLE;
+      else if(strcmp(argv[k], "-numa") == 0)
+         partition = CPU_NUMA;
+      else if(strcmp(argv[k], "-equal") == 0 && k+1 < argc) {
+         partition = CPU_EQUALLY;
+         parts = (cl_uint)atoi(argv[++k]);
+      }
+      else {
+         printf("Usage: %s [-numa | -equal parts | -whole]\n", argv[0]);
+         exit(1);
+      }
+   }
+
+   device_set_init(&set, CL_DEVICE_TYPE_CPU, partition, parts);
+   for(k=0; k<set.num_slots; k++)
+      printf("Slot %d: %s%s\n", k, set.slots[k].name,
+            set.slots[k].sub_device ? " (sub-device)" : "");
+
+   /* Small integers keep every partial sum exact */
+   data = (float*)malloc(NUM_BLOCKS * BLOCK_VECTORS * 4 * sizeof(float));
+   for(i=0; i<NUM_BLOCKS * BLOCK_VECTORS * 4; i++)
+      data[i] = (float)(i % 8);
+
+   device_set_build(&set, REDUCTION_FILE, NULL);
+   printf("\nReduction of %d blocks of %d floats\n",
+         NUM_BLOCKS, BLOCK_VECTORS * 4);
+   for(k=0; k<set.num_slots; k++)
+      rates[k] = 0.0;
+   for(round=0; round<ROUNDS; round++)
+      check &= reduce_round(&set, rates, data, round);
+   free(data);
+
+   /* Sort every run on the host for the check */
+   data = (float*)malloc(NUM_RUNS * RUN_SIZE * sizeof(float));
+   sorted = (float*)malloc(NUM_RUNS * RUN_SIZE * sizeof(float));
+   result = (float*)malloc(NUM_RUNS * RUN_SIZE * sizeof(float));
+   srand(0);
+   for(i=0; i<NUM_RUNS * RUN_SIZE; i++)
+      data[i] = (float)rand()/RAND_MAX;
+   memcpy(sorted, data, NUM_RUNS * RUN_SIZE * sizeof(float));
+   for(i=0; i<NUM_RUNS; i++)
+      qsort(sorted + i * RUN_SIZE, RUN_SIZE, sizeof(float), compare_floats);
+
+   device_set_build(&set, BSORT_FILE, DEVICE_LIB_OPTION);
+   printf("\nBitonic sort of %d runs of %d floats\n", NUM_RUNS, RUN_SIZE);
+   for(k=0; k<set.num_slots; k++)
+      rates[k] = 0.0;
+   for(round=0; round<ROUNDS; round++)
+      check &= sort_round(&set, rates, data, sorted, result, round);
+   free(data);
+   free(sorted);
+   free(result);
+
+   if(check)
+      printf("Check passed.\n");
+   else
+      printf("Check failed.\n");
+
+   device_set_release(&set);
+   return 0;
+}
@@ -0,0 +1,91 @@
+#ifndef ACCUMULATE_H
+#define ACCUMULATE_H
+
+/* Accumulation modes for sums and dot products, chosen at build time
+   with the options precision_mode.h gives the hosts:
+
+   PRECISION_DOUBLE  sums in double, which needs cl_khr_fp64
+   PRECISION_KAHAN   sums in float with a second float carrying the
+                     rounding error of every addition and product
+   neither           plain float sums
+
+   acc_t is the type of a running sum and real_t the type of a finished
+   one, double in the first mode and float otherwise. The Kahan mode
+   depends on the compiler keeping (a - (s - b)) as written, so programs
+   including this mustn't be built with -cl-fast-relaxed-math or
+   -cl-unsafe-math-optimizations
+
+   acc_add(a, x)             a + x
+   acc_add_product(a, x, y)  a + x*y
+   acc_product(x, y)         x*y as a sum of its own
+   acc_merge(a, b)           a + b for two running sums
+   acc_value(a)              a as a real_t */
+
+#if defined(PRECISION_DOUBLE)
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+
+typedef double acc_t;
+typedef double real_t;
+#define ACC_ZERO 0.0
+#define acc_add(a, x) ((a) + (double)(x))
+#define acc_add_product(a, x, y) ((a) + (double)(x) * (double)(y))
+#define acc_merge(a, b) ((a) + (b))
+#define acc_value(a) (a)
+
+#elif defined(PRECISION_KAHAN)
+
+/* .s0 is the sum, .s1 the error it hasn't absorbed yet */
+typedef float2 acc_t;
+typedef float real_t;
+#define ACC_ZERO ((float2)(0.0f))
+
+/* Add x to the sum, keeping the exact rounding error (TwoSum) */
+float2 acc_add(float2 a, float x) {
+
+   float s = a.s0 + x;
+   float b = s - a.s0;
+   float err = (a.s0 - (s - b)) + (x - b);
+
+   return (float2)(s, a.s1 + err);
+}
+
+/* The product's rounding error, which fma gives exactly, is
+   compensated as well */
+float2 acc_add_product(float2 a, float x, float y) {
+
+   float p = x * y;
+
+   a = acc_add(a, p);
+   a.s1 += fma(x, y, -p);
+   return a;
+}
+
+float2 acc_merge(float2 a, float2 b) {
+
+   a = acc_add(a, b.s0);
+   a.s1 += b.s1;
+   return a;
+}
+#define acc_value(a) ((a).s0 + (a).s1)
+
+#else
+
+typedef float acc_t;
+typedef float real_t;
+#define ACC_ZERO 0.0f
+#define acc_add(a, x) ((a) + (x))
+#define acc_add_product(a, x, y) ((a) + (x) * (y))
+#define acc_merge(a, b) ((a) + (b))
+#define acc_value(a) (a)
+
+#endif
+
+#define acc_product(x, y) acc_add_product(ACC_ZERO, x, y)
+
+/* Compensated sums can't be handed to sub_group_reduce_add, so kernels
+   only sum with subgroup functions when ACC_SUB_GROUPS is defined */
+#if defined(HAS_SUBGROUPS) && !defined(PRECISION_KAHAN)
+#define ACC_SUB_GROUPS
+#endif
+
+#endif
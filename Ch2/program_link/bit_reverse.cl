@@ -0,0 +1,14 @@
+#include "device_lib.h"
+
+/* Copy data into bit-reversed order, the first step of an FFT */
+__kernel void bit_reverse_copy(__global float2 *input,
+      __global float2 *output, uint size) {
+
+   uint4 index = (uint4)(0, 1, 2, 3) + get_global_id(0) * 4;
+   uint4 br = bit_reverse4(index, size);
+
+   output[br.s0] = input[index.s0];
+   output[br.s1] = input[index.s1];
+   output[br.s2] = input[index.s2];
+   output[br.s3] = input[index.s3];
+}
@@ -0,0 +1,130 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cl_library.h"
+
+/* Create an unbuilt program from a file */
+static cl_program create_program(cl_context ctx, const char *filename) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer;
+   size_t program_size;
+   int err;
+
+   /* Read program file and place content into buffer */
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   program = clCreateProgramWithSource(ctx, 1,
+      (const char**)&program_buffer, &program_size, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   free(program_buffer);
+   return program;
+}
+
+static void print_log(cl_program program, cl_device_id dev,
+      const char *what) {
+
+   char *program_log;
+   size_t log_size;
+
+   clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG,
+         0, NULL, &log_size);
+   program_log = (char*) malloc(log_size + 1);
+   program_log[log_size] = '\0';
+   clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG,
+         log_size + 1, program_log, NULL);
+   printf("Couldn't %s:\n%s\n", what, program_log);
+   free(program_log);
+}
+
+/* Compile a file against the library's header */
+static cl_program compile_file(cl_library *lib, cl_context ctx,
+      cl_device_id dev, const char *filename, const char *options) {
+
+   cl_program program;
+   char all_options[1024];
+   cl_int err;
+
+   if(options != NULL && strlen(options) + 12 >= sizeof(all_options)) {
+      printf("Build options are too long\n");
+      exit(1);
+   }
+   sprintf(all_options, "-DCL_LIBRARY %s", options != NULL ? options : "");
+
+   program = create_program(ctx, filename);
+   err = clCompileProgram(program, 1, &dev, all_options, 1, &lib->header,
+         &lib->header_name, NULL, NULL);
+   if(err < 0) {
+      print_log(program, dev, "compile the program");
+      exit(1);
+   }
+   return program;
+}
+
+void cl_library_create(cl_library *lib, cl_context ctx, cl_device_id dev,
+      const char *source_file, const char *header_file,
+      const char *header_name, const char *options) {
+
+   cl_program object;
+   cl_int err;
+
+   lib->header = create_program(ctx, header_file);
+   lib->header_name = header_name;
+
+   /* Compile, then link on its own as a library */
+   object = compile_file(lib, ctx, dev, source_file, options);
+   lib->library = clLinkProgram(ctx, 1, &dev, "-create-library", 1,
+         &object, NULL, NULL, &err);
+   if(err < 0) {
+      if(lib->library != NULL)
+         print_log(lib->library, dev, "create the library");
+      else
+         printf("Couldn't create the library: error %d\n", err);
+      exit(1);
+   }
+   clReleaseProgram(object);
+}
+
+cl_program cl_library_link(cl_library *lib, cl_context ctx,
+      cl_device_id dev, const char *source_file, const char *options) {
+
+   cl_program objects[2], program;
+   cl_int err;
+
+   objects[0] = compile_file(lib, ctx, dev, source_file, options);
+   objects[1] = lib->library;
+   program = clLinkProgram(ctx, 1, &dev, NULL, 2, objects,
+         NULL, NULL, &err);
+   if(err < 0) {
+      if(program != NULL)
+         print_log(program, dev, "link the program");
+      else
+         printf("Couldn't link the program: error %d\n", err);
+      exit(1);
+   }
+   clReleaseProgram(objects[0]);
+   return program;
+}
+
+void cl_library_release(cl_library *lib) {
+   clReleaseProgram(lib->library);
+   clReleaseProgram(lib->header);
+}
@@ -0,0 +1,35 @@
+#ifndef CL_LIBRARY_H
+#define CL_LIBRARY_H
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* A device library: compiled once with clCompileProgram, then linked
+   into programs with clLinkProgram. Programs include its header by
+   name, and the header is handed to the compiler instead of being
+   looked up on disk. Everything is compiled with -DCL_LIBRARY, so the
+   header can tell a linked build from one that needs the source */
+typedef struct cl_library {
+   cl_program header;
+   const char *header_name;
+   cl_program library;
+} cl_library;
+
+/* Compile source_file into a library. header_file is included as
+   header_name by the library and by programs linked with it. Prints the
+   log and exits on failure */
+void cl_library_create(cl_library *lib, cl_context ctx, cl_device_id dev,
+      const char *source_file, const char *header_file,
+      const char *header_name, const char *options);
+
+/* Compile source_file and link it with the library into an executable
+   program. Prints the log and exits on failure */
+cl_program cl_library_link(cl_library *lib, cl_context ctx,
+      cl_device_id dev, const char *source_file, const char *options);
+
+void cl_library_release(cl_library *lib);
+
+#endif
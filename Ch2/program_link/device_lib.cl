@@ -0,0 +1,74 @@
+/* Included by device_lib.h in builds without the library, which may
+   also have included this file first */
+#ifndef DEVICE_LIB_CL
+#define DEVICE_LIB_CL
+
+#include "device_lib.h"
+
+uint4 bit_reverse4(uint4 index, uint size) {
+
+   uint mask_left = size/2;
+   uint mask_right = 1;
+   uint shift_pos = 30 - clz(size);
+   uint4 br;
+
+   br = (index << shift_pos) & mask_left;
+   br |= (index >> shift_pos) & mask_right;
+   while(shift_pos > 1) {
+      shift_pos -= 2;
+      mask_left >>= 1;
+      mask_right <<= 1;
+      br |= (index << shift_pos) & mask_left;
+      br |= (index >> shift_pos) & mask_right;
+   }
+   return br;
+}
+
+uint bit_reverse(uint index, uint size) {
+   return bit_reverse4((uint4)(index), size).s0;
+}
+
+float group_reduce_sum(float value, __local float *scratch) {
+
+   uint lid = get_local_id(0);
+
+   scratch[lid] = value;
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   for(uint i = get_local_size(0)/2; i>0; i >>= 1) {
+      if(lid < i) {
+         scratch[lid] += scratch[lid + i];
+      }
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+
+   /* Read before anyone reuses scratch */
+   value = scratch[0];
+   barrier(CLK_LOCAL_MEM_FENCE);
+   return value;
+}
+
+float4 vector_sort(float4 input, int dir) {
+
+   uint4 mask1 = (uint4)(1, 0, 3, 2);
+   uint4 mask2 = (uint4)(2, 3, 0, 1);
+   int4 add1 = (int4)(1, 1, 3, 3);
+   int4 add2 = (int4)(2, 3, 2, 3);
+   int4 comp;
+
+   VECTOR_SORT(input, dir);
+   return input;
+}
+
+void vector_swap(float4 *input1, float4 *input2, int dir) {
+
+   int4 add3 = (int4)(4, 5, 6, 7);
+   float4 a = *input1, b = *input2, temp;
+   int4 comp;
+
+   VECTOR_SWAP(a, b, dir);
+   *input1 = a;
+   *input2 = b;
+}
+
+#endif
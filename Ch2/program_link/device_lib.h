@@ -0,0 +1,47 @@
+#ifndef DEVICE_LIB_H
+#define DEVICE_LIB_H
+
+/* Helpers shared by the examples' kernels. device_lib.cl is compiled
+   once into a library and linked into each program, and programs
+   include this header. A program built from source on its own, without
+   cl_library, gets the library's source from here as well, so it needs
+   -I with this directory */
+
+/* Reverse the low log2(size) bits of index, as fft_init does for its
+   addresses. size is a power of two of at least 2 */
+uint bit_reverse(uint index, uint size);
+uint4 bit_reverse4(uint4 index, uint size);
+
+/* Sum of value over a work-group whose size is a power of two. scratch
+   holds a float per work-item. Every work-item must call it, and every
+   work-item gets the sum */
+float group_reduce_sum(float value, __local float *scratch);
+
+/* Sort a bitonic float4, upward if dir is 0 and downward if it's -1 */
+float4 vector_sort(float4 input, int dir);
+
+/* Leave the smaller of each pair of components in input1 and the larger
+   in input2, or the other way around if dir is -1 */
+void vector_swap(float4 *input1, float4 *input2, int dir);
+
+/* The forms used in bsort's kernels, which declare comp, temp, mask1,
+   mask2, add1, add2 and add3 themselves. Macros can't be linked, so
+   they travel in this header */
+#define VECTOR_SORT(input, dir)                                   \
+   comp = input < shuffle(input, mask2) ^ dir;                    \
+   input = shuffle(input, as_uint4(comp * 2 + add2));             \
+   comp = input < shuffle(input, mask1) ^ dir;                    \
+   input = shuffle(input, as_uint4(comp + add1));                 \
+
+#define VECTOR_SWAP(input1, input2, dir)                          \
+   temp = input1;                                                 \
+   comp = (input1 < input2 ^ dir) * 4 + add3;                     \
+   input1 = shuffle2(input1, input2, as_uint4(comp));             \
+   input2 = shuffle2(input2, temp, as_uint4(comp));               \
+
+/* cl_library compiles with CL_LIBRARY, and links the library instead */
+#ifndef CL_LIBRARY
+#include "device_lib.cl"
+#endif
+
+#endif
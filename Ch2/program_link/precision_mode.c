@@ -0,0 +1,42 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "precision_mode.h"
+
+/* Hosts build from their own directory, two levels below the root */
+#define ACCUMULATE_INCLUDE "-I../../Ch2/program_link"
+
+const char *accumulate_names[NUM_MODES] = {"fp32", "kahan", "fp64"};
+
+const char *accumulate_options[NUM_MODES] = {
+   ACCUMULATE_INCLUDE,
+   ACCUMULATE_INCLUDE " -DPRECISION_KAHAN",
+   ACCUMULATE_INCLUDE " -DPRECISION_DOUBLE"
+};
+
+const size_t accumulate_sizes[NUM_MODES] = {
+   sizeof(cl_float), 2 * sizeof(cl_float), sizeof(cl_double)
+};
+
+int precision_mode_parse(int argc, char **argv, const char **names) {
+
+   int mode;
+
+   if(argc < 2)
+      return MODE_FP32;
+   for(mode=0; mode<NUM_MODES; mode++)
+      if(strcmp(argv[1], names[mode]) == 0)
+         return mode;
+   printf("Usage: %s [%s|%s|%s]\n", argv[0], names[MODE_FP32],
+         names[MODE_KAHAN], names[MODE_FP64]);
+   exit(1);
+}
@@ -0,0 +1,23 @@
+#ifndef PRECISION_MODE_H
+#define PRECISION_MODE_H
+
+#include <stddef.h>
+
+/* Precision modes, selected on the command line. Kernels that include
+   accumulate.h accumulate in fp32, Kahan-compensated fp32 or fp64. The
+   FFT keeps the first and last and has its own middle mode */
+enum {MODE_FP32, MODE_KAHAN, MODE_FP64, NUM_MODES};
+
+/* Names and build options of the accumulate.h modes. The options also
+   let the compiler find accumulate.h, so they're never NULL */
+extern const char *accumulate_names[NUM_MODES];
+extern const char *accumulate_options[NUM_MODES];
+
+/* Bytes in an acc_t in each mode */
+extern const size_t accumulate_sizes[NUM_MODES];
+
+/* The mode argv[1] names among names, or MODE_FP32 if there's no
+   argument. Prints the usage and exits if it names none of them */
+int precision_mode_parse(int argc, char **argv, const char **names);
+
+#endif
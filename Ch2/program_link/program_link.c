@@ -0,0 +1,307 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define _POSIX_C_SOURCE 200809L
+#define LIB_FILE "device_lib.cl"
+#define LIB_HEADER "device_lib.h"
+#define NUM_PROGRAMS 2
+
+#define FFT_SIZE 1024
+#define REDUCE_SIZE 4096
+#define SORT_SIZE 8192
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cl_library.h"
+
+static const char *program_files[NUM_PROGRAMS] = {
+   "bit_reverse.cl", "reduce_sort.cl"
+};
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   }
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);
+   }
+
+   return dev;
+}
+
+char* read_file(const char *filename, size_t *size) {
+
+   FILE *handle;
+   char *buffer;
+
+   handle = fopen(filename, "r");
+   if(handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(handle, 0, SEEK_END);
+   *size = ftell(handle);
+   rewind(handle);
+   buffer = (char*)malloc(*size + 1);
+   buffer[*size] = '\0';
+   *size = fread(buffer, sizeof(char), *size, handle);
+   fclose(handle);
+   return buffer;
+}
+
+/* The library's source and a program's source built together, the way
+   program_build does it */
+cl_program build_together(cl_context ctx, cl_device_id dev,
+      const char *filename) {
+
+   cl_program program;
+   char *program_buffer[2], *program_log;
+   size_t program_size[2], log_size;
+   cl_int err;
+
+   program_buffer[0] = read_file(LIB_FILE, &program_size[0]);
+   program_buffer[1] = read_file(filename, &program_size[1]);
+   program = clCreateProgramWithSource(ctx, 2,
+         (const char**)program_buffer, program_size, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   free(program_buffer[0]);
+   free(program_buffer[1]);
+
+   err = clBuildProgram(program, 1, &dev, "-I.", NULL, NULL);
+   if(err < 0) {
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG,
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG,
+            log_size + 1, program_log, NULL);
+      printf("%s\n", program_log);
+      free(program_log);
+      exit(1);
+   }
+   return program;
+}
+
+double now() {
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec + t.tv_nsec * 1.0e-9;
+}
+
+cl_kernel create_kernel(cl_program program, const char *name) {
+
+   cl_kernel kernel;
+   cl_int err;
+
+   kernel = clCreateKernel(program, name, &err);
+   if(err < 0) {
+      printf("Couldn't create the %s kernel\n", name);
+      exit(1);
+   };
+   return kernel;
+}
+
+int float_compare(const void *a, const void *b) {
+   float x = *(const float*)a, y = *(const float*)b;
+   return (x > y) - (x < y);
+}
+
+int main() {
+
+   /* Host/device data structures */
+   cl_device_id device;
+   cl_context context;
+   cl_command_queue queue;
+   cl_library lib;
+   cl_program programs[NUM_PROGRAMS], together;
+   cl_kernel kernel;
+   size_t global_size, local_size, max_size;
+   cl_int err;
+   cl_uint size = FFT_SIZE, br, bits;
+   int i, j, check = 1;
+   double start, lib_time, link_time = 0.0, together_time = 0.0;
+
+   /* Data and buffers */
+   float fft_data[2*FFT_SIZE], fft_out[2*FFT_SIZE];
+   float reduce_data[REDUCE_SIZE], sums[REDUCE_SIZE], expected;
+   float sort_data[SORT_SIZE], sorted[SORT_SIZE], chunk[8];
+   cl_mem in_buffer, out_buffer;
+
+   device = create_device();
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);
+   }
+   queue = clCreateCommandQueue(context, device, 0, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);
+   };
+
+   /* The library is compiled once and each program only compiles its
+      own source before linking */
+   start = now();
+   cl_library_create(&lib, context, device, LIB_FILE, LIB_HEADER,
+         LIB_HEADER, NULL);
+   lib_time = now() - start;
+   for(i=0; i<NUM_PROGRAMS; i++) {
+      start = now();
+      programs[i] = cl_library_link(&lib, context, device,
+            program_files[i], NULL);
+      link_time += now() - start;
+   }
+
+   /* For comparison, compile the library into every program */
+   for(i=0; i<NUM_PROGRAMS; i++) {
+      start = now();
+      together = build_together(context, device, program_files[i]);
+      together_time += now() - start;
+      clReleaseProgram(together);
+   }
+   printf("Library compiled in %.1f ms, %d programs linked in %.1f ms\n",
+         lib_time * 1.0e3, NUM_PROGRAMS, link_time * 1.0e3);
+   printf("Built with the library's source: %.1f ms\n",
+         together_time * 1.0e3);
+
+   in_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE,
+         SORT_SIZE * sizeof(float), NULL, &err);
+   out_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE,
+         SORT_SIZE * sizeof(float), NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);
+   };
+
+   /* bit_reverse4 from the library */
+   for(i=0; i<2*FFT_SIZE; i++)
+      fft_data[i] = (float)i;
+   clEnqueueWriteBuffer(queue, in_buffer, CL_TRUE, 0, sizeof(fft_data),
+         fft_data, 0, NULL, NULL);
+   kernel = create_kernel(programs[0], "bit_reverse_copy");
+   err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &in_buffer);
+   err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &out_buffer);
+   err |= clSetKernelArg(kernel, 2, sizeof(size), &size);
+   if(err < 0) {
+      perror("Couldn't set a kernel argument");
+      exit(1);
+   };
+   global_size = FFT_SIZE/4;
+   err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_size,
+         NULL, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);
+   }
+   clEnqueueReadBuffer(queue, out_buffer, CL_TRUE, 0, sizeof(fft_out),
+         fft_out, 0, NULL, NULL);
+   for(i=0; i<FFT_SIZE; i++) {
+      br = 0;
+      for(bits=1; bits<FFT_SIZE; bits<<=1)
+         br = (br << 1) | ((i & bits) != 0);
+      if(fft_out[2*br] != fft_data[2*i] ||
+            fft_out[2*br+1] != fft_data[2*i+1])
+         check = 0;
+   }
+   clReleaseKernel(kernel);
+
+   /* group_reduce_sum from the library */
+   for(i=0; i<REDUCE_SIZE; i++)
+      reduce_data[i] = (float)(i % 8);
+   clEnqueueWriteBuffer(queue, in_buffer, CL_TRUE, 0, sizeof(reduce_data),
+         reduce_data, 0, NULL, NULL);
+   kernel = create_kernel(programs[1], "group_sums");
+   clGetKernelWorkGroupInfo(kernel, device, CL_KERNEL_WORK_GROUP_SIZE,
+         sizeof(max_size), &max_size, NULL);
+   local_size = 64;
+   while(local_size > max_size)
+      local_size /= 2;
+   err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &in_buffer);
+   err |= clSetKernelArg(kernel, 1, local_size * sizeof(float), NULL);
+   err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &out_buffer);
+   if(err < 0) {
+      perror("Couldn't set a kernel argument");
+      exit(1);
+   };
+   global_size = REDUCE_SIZE;
+   err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_size,
+         &local_size, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);
+   }
+   clEnqueueReadBuffer(queue, out_buffer, CL_TRUE, 0,
+         REDUCE_SIZE/local_size * sizeof(float), sums, 0, NULL, NULL);
+   for(i=0; i<REDUCE_SIZE/local_size; i++) {
+      expected = 0.0f;
+      for(j=0; j<local_size; j++)
+         expected += reduce_data[i*local_size + j];
+      if(sums[i] != expected)
+         check = 0;
+   }
+   clReleaseKernel(kernel);
+
+   /* vector_sort, vector_swap and the VECTOR_ macros from the header */
+   srand(0);
+   for(i=0; i<SORT_SIZE; i++)
+      sort_data[i] = (float)rand()/RAND_MAX;
+   clEnqueueWriteBuffer(queue, in_buffer, CL_TRUE, 0, sizeof(sort_data),
+         sort_data, 0, NULL, NULL);
+   kernel = create_kernel(programs[1], "sort_pairs");
+   err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &in_buffer);
+   if(err < 0) {
+      perror("Couldn't set a kernel argument");
+      exit(1);
+   };
+   global_size = SORT_SIZE/8;
+   err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_size,
+         NULL, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);
+   }
+   clEnqueueReadBuffer(queue, in_buffer, CL_TRUE, 0, sizeof(sorted),
+         sorted, 0, NULL, NULL);
+   for(i=0; i<SORT_SIZE; i+=8) {
+      memcpy(chunk, sort_data + i, sizeof(chunk));
+      qsort(chunk, 8, sizeof(float), float_compare);
+      if(memcmp(chunk, sorted + i, sizeof(chunk)) != 0)
+         check = 0;
+   }
+   clReleaseKernel(kernel);
+
+   if(check)
+      printf("Check passed.\n");
+   else
+      printf("Check failed.\n");
+
+   /* Deallocate resources */
+   clReleaseMemObject(in_buffer);
+   clReleaseMemObject(out_buffer);
+   for(i=0; i<NUM_PROGRAMS; i++)
+      clReleaseProgram(programs[i]);
+   cl_library_release(&lib);
+   clReleaseCommandQueue(queue);
+   clReleaseContext(context);
+   return 0;
+}
@@ -0,0 +1,46 @@
+#include "device_lib.h"
+
+/* Each work-group writes the sum of its elements */
+__kernel void group_sums(__global float *data, __local float *scratch,
+      __global float *output) {
+
+   float sum = group_reduce_sum(data[get_global_id(0)], scratch);
+
+   if(get_local_id(0) == 0) {
+      output[get_group_id(0)] = sum;
+   }
+}
+
+/* Sorted halves, the first up and the second down, make a bitonic
+   vector */
+float4 make_bitonic(float4 v) {
+   return (float4)(min(v.s0, v.s1), max(v.s0, v.s1),
+                   max(v.s2, v.s3), min(v.s2, v.s3));
+}
+
+/* Each work-item sorts a pair of vectors: one up and one down, merged
+   with vector_swap and finished with VECTOR_SORT, as bsort_init does */
+__kernel void sort_pairs(__global float4 *data) {
+
+   float4 input1 = data[get_global_id(0) * 2];
+   float4 input2 = data[get_global_id(0) * 2 + 1];
+   float4 temp;
+   int4 comp;
+   uint4 mask1 = (uint4)(1, 0, 3, 2);
+   uint4 mask2 = (uint4)(2, 3, 0, 1);
+   int4 add1 = (int4)(1, 1, 3, 3);
+   int4 add2 = (int4)(2, 3, 2, 3);
+   int4 add3 = (int4)(4, 5, 6, 7);
+
+   /* Sort each vector, input1 up and input2 down */
+   input1 = vector_sort(make_bitonic(input1), 0);
+   input2 = vector_sort(make_bitonic(input2), -1);
+
+   /* input1 ascends and input2 descends, so together they're bitonic */
+   VECTOR_SWAP(input1, input2, 0)
+   VECTOR_SORT(input1, 0)
+   VECTOR_SORT(input2, 0)
+
+   data[get_global_id(0) * 2] = input1;
+   data[get_global_id(0) * 2 + 1] = input2;
+}
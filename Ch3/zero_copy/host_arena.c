@@ -0,0 +1,184 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
+#include "host_arena.h"
+
+static size_t round_up(size_t size, size_t multiple) {
+   return (size + multiple - 1)/multiple * multiple;
+}
+
+void host_arena_init(host_arena *arena, size_t size) {
+
+   size = round_up(size, ARENA_ALIGNMENT);
+#ifdef _WIN32
+   arena->base = (char*)_aligned_malloc(size, ARENA_ALIGNMENT);
+#else
+   if(posix_memalign((void**)&arena->base, ARENA_ALIGNMENT, size) != 0)
+      arena->base = NULL;
+#endif
+   if(arena->base == NULL) {
+      perror("Couldn't allocate the host arena");
+      exit(1);
+   }
+   arena->size = size;
+   arena->used = 0;
+}
+
+void* host_arena_alloc(host_arena *arena, size_t size) {
+
+   void *ptr;
+
+   /* Every piece starts on a page */
+   size = round_up(size, ARENA_ALIGNMENT);
+   if(size > arena->size - arena->used)
+      return NULL;
+   ptr = arena->base + arena->used;
+   arena->used += size;
+   return ptr;
+}
+
+void host_arena_reset(host_arena *arena) {
+   arena->used = 0;
+}
+
+void host_arena_release(host_arena *arena) {
+#ifdef _WIN32
+   _aligned_free(arena->base);
+#else
+   free(arena->base);
+#endif
+   arena->base = NULL;
+   arena->size = 0;
+   arena->used = 0;
+}
+
+void host_buffer_create(host_buffer *buf, host_arena *arena,
+      cl_context ctx, cl_command_queue queue, buffer_mode mode,
+      cl_mem_flags flags, size_t size) {
+
+   cl_int err;
+
+   buf->mode = mode;
+   buf->size = size;
+   buf->staging = NULL;
+   buf->map_flags = 0;
+   size = round_up(size, ARENA_SIZE_MULTIPLE);
+
+   if(mode != BUFFER_ALLOC_HOST_PTR) {
+      buf->staging = host_arena_alloc(arena, size);
+      if(buf->staging == NULL) {
+         printf("Couldn't allocate %zu bytes from the host arena\n", size);
+         exit(1);
+      }
+   }
+
+   switch(mode) {
+   case BUFFER_COPY:
+      buf->mem = clCreateBuffer(ctx, flags, size, NULL, &err);
+      break;
+   case BUFFER_USE_HOST_PTR:
+      buf->mem = clCreateBuffer(ctx, flags | CL_MEM_USE_HOST_PTR, size,
+            buf->staging, &err);
+      break;
+   default:
+      buf->mem = clCreateBuffer(ctx, flags | CL_MEM_ALLOC_HOST_PTR, size,
+            NULL, &err);
+      break;
+   }
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);
+   };
+
+   /* Copy mode fills the staging memory directly. The others map the
+      buffer, which on a zero-copy runtime returns the memory itself */
+   if(mode == BUFFER_COPY)
+      buf->host = buf->staging;
+   else
+      host_buffer_map(buf, queue, CL_MAP_WRITE);
+}
+
+void host_buffer_commit(host_buffer *buf, cl_command_queue queue) {
+
+   cl_int err;
+
+   if(buf->mode == BUFFER_COPY) {
+      err = clEnqueueWriteBuffer(queue, buf->mem, CL_TRUE, 0, buf->size,
+            buf->staging, 0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't write the buffer");
+         exit(1);
+      }
+      buf->host = NULL;
+   }
+   else {
+      host_buffer_unmap(buf, queue);
+   }
+}
+
+void* host_buffer_map(host_buffer *buf, cl_command_queue queue,
+      cl_map_flags flags) {
+
+   cl_int err;
+
+   buf->map_flags = flags;
+   if(buf->mode == BUFFER_COPY) {
+      if(flags & CL_MAP_READ) {
+         err = clEnqueueReadBuffer(queue, buf->mem, CL_TRUE, 0, buf->size,
+               buf->staging, 0, NULL, NULL);
+         if(err < 0) {
+            perror("Couldn't read the buffer");
+            exit(1);
+         }
+      }
+      buf->host = buf->staging;
+   }
+   else {
+      buf->host = clEnqueueMapBuffer(queue, buf->mem, CL_TRUE, flags,
+            0, buf->size, 0, NULL, NULL, &err);
+      if(err < 0) {
+         perror("Couldn't map the buffer to host memory");
+         exit(1);
+      }
+   }
+   return buf->host;
+}
+
+void host_buffer_unmap(host_buffer *buf, cl_command_queue queue) {
+
+   cl_int err;
+
+   if(buf->mode == BUFFER_COPY) {
+      if(buf->map_flags & CL_MAP_WRITE) {
+         err = clEnqueueWriteBuffer(queue, buf->mem, CL_TRUE, 0, buf->size,
+               buf->staging, 0, NULL, NULL);
+         if(err < 0) {
+            perror("Couldn't write the buffer");
+            exit(1);
+         }
+      }
+   }
+   else {
+      err = clEnqueueUnmapMemObject(queue, buf->mem, buf->host,
+            0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't unmap the buffer");
+         exit(1);
+      }
+   }
+   buf->host = NULL;
+   buf->map_flags = 0;
+}
+
+void host_buffer_release(host_buffer *buf) {
+   clReleaseMemObject(buf->mem);
+   buf->mem = NULL;
+   buf->host = NULL;
+}
@@ -0,0 +1,65 @@
+#ifndef HOST_ARENA_H
+#define HOST_ARENA_H
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* Page alignment and a 64-byte size multiple are what CPU and
+   integrated GPU runtimes need to use host memory without a copy */
+#define ARENA_ALIGNMENT 4096
+#define ARENA_SIZE_MULTIPLE 64
+
+/* How a host_buffer's contents reach the device */
+typedef enum {
+   BUFFER_COPY,              /* Arena staging memory, write/read copies */
+   BUFFER_USE_HOST_PTR,      /* Buffer created over arena memory */
+   BUFFER_ALLOC_HOST_PTR     /* Runtime-allocated host memory */
+} buffer_mode;
+
+/* One page-aligned block, handed out in aligned pieces */
+typedef struct {
+   char *base;
+   size_t size, used;
+} host_arena;
+
+/* A buffer with a host view. host is valid between create and commit,
+   and between map and unmap */
+typedef struct {
+   cl_mem mem;
+   void *host;
+   void *staging;
+   size_t size;
+   buffer_mode mode;
+   cl_map_flags map_flags;
+} host_buffer;
+
+void host_arena_init(host_arena *arena, size_t size);
+
+/* Returns NULL if the arena is full */
+void* host_arena_alloc(host_arena *arena, size_t size);
+
+/* Free every allocation at once. Buffers using them must be released */
+void host_arena_reset(host_arena *arena);
+void host_arena_release(host_arena *arena);
+
+/* Create a buffer and point buf->host at memory for its initial
+   contents. arena may be NULL for BUFFER_ALLOC_HOST_PTR */
+void host_buffer_create(host_buffer *buf, host_arena *arena,
+      cl_context ctx, cl_command_queue queue, buffer_mode mode,
+      cl_mem_flags flags, size_t size);
+
+/* Hand the initial contents to the device */
+void host_buffer_commit(host_buffer *buf, cl_command_queue queue);
+
+/* Block until the device's contents are visible at the returned
+   pointer. Only BUFFER_COPY copies them */
+void* host_buffer_map(host_buffer *buf, cl_command_queue queue,
+      cl_map_flags flags);
+void host_buffer_unmap(host_buffer *buf, cl_command_queue queue);
+
+void host_buffer_release(host_buffer *buf);
+
+#endif
@@ -0,0 +1,206 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define _POSIX_C_SOURCE 200809L
+#define PROGRAM_FILE "zero_copy.cl"
+#define KERNEL_FUNC "zero_copy"
+
+/* 64M floats: 256 MB per array */
+#define NUM_FLOATS 67108864
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "host_arena.h"
+#include "program_binary.h"
+
+/* The kernels compiled for this machine by the Makefile */
+#ifdef PRECOMPILED
+#include "zero_copy_binaries.h"
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   }
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);
+   }
+
+   return dev;
+}
+
+double elapsed_ms(struct timespec *start) {
+
+   struct timespec now;
+
+   clock_gettime(CLOCK_MONOTONIC, &now);
+   return (now.tv_sec - start->tv_sec) * 1.0e3 +
+          (now.tv_nsec - start->tv_nsec) * 1.0e-6;
+}
+
+int main(int argc, char **argv) {
+
+   /* OpenCL structures */
+   cl_device_id device;
+   cl_context context;
+   cl_command_queue queue;
+   cl_program program;
+   cl_kernel kernel;
+   cl_int err;
+   size_t n, i, global_size;
+
+   /* Data and buffers */
+   buffer_mode mode = BUFFER_USE_HOST_PTR;
+   host_arena arena;
+   host_buffer x_buf, y_buf, z_buf;
+   float a = 2.0f, *x, *y, *z;
+   int check;
+
+   /* Timing */
+   struct timespec start;
+   double fill_time, commit_time, kernel_time, map_time;
+
+   /* Usage: zero_copy [copy|use|alloc] [num_floats] */
+   if(argc > 1) {
+      if(!strcmp(argv[1], "copy"))
+         mode = BUFFER_COPY;
+      else if(!strcmp(argv[1], "alloc"))
+         mode = BUFFER_ALLOC_HOST_PTR;
+      else if(strcmp(argv[1], "use")) {
+         printf("Usage: zero_copy [copy|use|alloc] [num_floats]\n");
+         exit(1);
+      }
+   }
+   n = argc > 2 ? (size_t)atol(argv[2]) : NUM_FLOATS;
+   n = (n + 3)/4 * 4;
+
+   /* Create device and context */
+   device = create_device();
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);
+   }
+
+   /* Build program and create kernel */
+   program = program_load(context, device, PROGRAM_IMAGE(zero_copy),
+         PROGRAM_FILE, NULL, NULL);
+   kernel = clCreateKernel(program, KERNEL_FUNC, &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+
+   /* Create a command queue */
+   queue = clCreateCommandQueue(context, device, 0, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);
+   };
+
+   /* One arena holds all three arrays */
+   host_arena_init(&arena, 3 * (n * sizeof(float) + ARENA_ALIGNMENT));
+
+   /* Write inputs straight into the buffers' host memory */
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   host_buffer_create(&x_buf, &arena, context, queue, mode,
+         CL_MEM_READ_ONLY, n * sizeof(float));
+   host_buffer_create(&y_buf, &arena, context, queue, mode,
+         CL_MEM_READ_ONLY, n * sizeof(float));
+   x = (float*)x_buf.host;
+   y = (float*)y_buf.host;
+   for(i=0; i<n; i++) {
+      x[i] = (float)(i % 1000);
+      y[i] = 1.0f;
+   }
+   fill_time = elapsed_ms(&start);
+
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   host_buffer_commit(&x_buf, queue);
+   host_buffer_commit(&y_buf, queue);
+   host_buffer_create(&z_buf, &arena, context, queue, mode,
+         CL_MEM_WRITE_ONLY, n * sizeof(float));
+   host_buffer_commit(&z_buf, queue);
+   clFinish(queue);
+   commit_time = elapsed_ms(&start);
+
+   /* Create kernel arguments */
+   err = clSetKernelArg(kernel, 0, sizeof(a), &a);
+   err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &x_buf.mem);
+   err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &y_buf.mem);
+   err |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &z_buf.mem);
+   if(err < 0) {
+      perror("Couldn't set a kernel argument");
+      exit(1);
+   };
+
+   /* Enqueue kernel */
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   global_size = n/4;
+   err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_size,
+         NULL, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);
+   }
+   clFinish(queue);
+   kernel_time = elapsed_ms(&start);
+
+   /* Access the result in place */
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   z = (float*)host_buffer_map(&z_buf, queue, CL_MAP_READ);
+   map_time = elapsed_ms(&start);
+
+   check = 1;
+   for(i=0; i<n; i++) {
+      if(fabs(z[i] - (2.0f * (i % 1000) + 1.0f)) > 1.0e-3f) {
+         check = 0;
+         break;
+      }
+   }
+   host_buffer_unmap(&z_buf, queue);
+
+   printf("Mode: %s, %zu floats\n", mode == BUFFER_COPY ? "copy" :
+         mode == BUFFER_USE_HOST_PTR ? "use_host_ptr" : "alloc_host_ptr", n);
+   printf("Fill: %.2f ms, commit: %.2f ms, kernel: %.2f ms, map: %.2f ms\n",
+         fill_time, commit_time, kernel_time, map_time);
+   if(check)
+      printf("Check passed.\n");
+   else
+      printf("Check failed.\n");
+
+   /* Deallocate resources */
+   host_buffer_release(&x_buf);
+   host_buffer_release(&y_buf);
+   host_buffer_release(&z_buf);
+   host_arena_release(&arena);
+   clReleaseKernel(kernel);
+   clReleaseCommandQueue(queue);
+   clReleaseProgram(program);
+   clReleaseContext(context);
+   return 0;
+}
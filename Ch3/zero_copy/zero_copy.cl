@@ -0,0 +1,6 @@
+__kernel void zero_copy(float a, __global float4 *x, __global float4 *y,
+                        __global float4 *z) {
+
+   size_t i = get_global_id(0);
+   z[i] = a * x[i] + y[i];
+}
@@ -0,0 +1,237 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define MAX_DEVICES 16
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "device_caps.h"
+
+static device_caps caps_table[MAX_DEVICES];
+static int num_caps = 0;
+
+/* Check for a whole word in a space-separated extension list */
+static int has_extension(const char *extensions, const char *name) {
+
+   size_t len = strlen(name);
+   const char *pos = extensions;
+
+   while((pos = strstr(pos, name)) != NULL) {
+      if((pos == extensions || pos[-1] == ' ') &&
+            (pos[len] == ' ' || pos[len] == '\0'))
+         return 1;
+      pos += len;
+   }
+   return 0;
+}
+
+const device_caps* device_caps_get(cl_device_id dev) {
+
+   device_caps *caps;
+   cl_device_local_mem_type mem_type;
+   char *extensions, version[128];
+   size_t ext_size;
+   int major, minor, i;
+   cl_int err;
+
+   for(i=0; i<num_caps; i++)
+      if(caps_table[i].device == dev)
+         return &caps_table[i];
+   if(num_caps == MAX_DEVICES) {
+      printf("Too many devices to specialize for\n");
+      exit(1);
+   }
+   caps = &caps_table[num_caps];
+   memset(caps, 0, sizeof(*caps));
+   caps->device = dev;
+
+   err = clGetDeviceInfo(dev, CL_DEVICE_TYPE,
+         sizeof(caps->type), &caps->type, NULL);
+   err |= clGetDeviceInfo(dev, CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT,
+         sizeof(caps->vec_width), &caps->vec_width, NULL);
+   err |= clGetDeviceInfo(dev, CL_DEVICE_PREFERRED_VECTOR_WIDTH_DOUBLE,
+         sizeof(caps->vec_width_double), &caps->vec_width_double, NULL);
+   err |= clGetDeviceInfo(dev, CL_DEVICE_LOCAL_MEM_SIZE,
+         sizeof(caps->local_mem_size), &caps->local_mem_size, NULL);
+   err |= clGetDeviceInfo(dev, CL_DEVICE_LOCAL_MEM_TYPE,
+         sizeof(mem_type), &mem_type, NULL);
+   err |= clGetDeviceInfo(dev, CL_DEVICE_MAX_WORK_GROUP_SIZE,
+         sizeof(caps->max_group_size), &caps->max_group_size, NULL);
+   err |= clGetDeviceInfo(dev, CL_DEVICE_MAX_COMPUTE_UNITS,
+         sizeof(caps->compute_units), &caps->compute_units, NULL);
+   err |= clGetDeviceInfo(dev, CL_DEVICE_OPENCL_C_VERSION,
+         sizeof(version), version, NULL);
+   err |= clGetDeviceInfo(dev, CL_DEVICE_EXTENSIONS, 0, NULL, &ext_size);
+   if(err < 0) {
+      perror("Couldn't read device capabilities");
+      exit(1);
+   }
+   extensions = (char*)malloc(ext_size + 1);
+   extensions[ext_size] = '\0';
+   clGetDeviceInfo(dev, CL_DEVICE_EXTENSIONS, ext_size, extensions, NULL);
+
+   caps->local_mem_dedicated = (mem_type == CL_LOCAL);
+   caps->fp64 = has_extension(extensions, "cl_khr_fp64");
+   caps->fp16 = has_extension(extensions, "cl_khr_fp16");
+   caps->subgroups = has_extension(extensions, "cl_khr_subgroups");
+   if(!caps->fp64)
+      caps->vec_width_double = 0;
+   free(extensions);
+
+   /* Preferred widths are powers of two, but zero has been seen */
+   if(caps->vec_width == 0)
+      caps->vec_width = 1;
+   if(caps->vec_width > 16)
+      caps->vec_width = 16;
+   if(caps->fp64 && caps->vec_width_double == 0)
+      caps->vec_width_double = 1;
+
+   /* "OpenCL C <major>.<minor> <vendor information>" */
+   if(sscanf(version, "OpenCL C %d.%d", &major, &minor) == 2)
+      caps->c_version = major * 100 + minor * 10;
+   else
+      caps->c_version = 120;
+
+   num_caps++;
+   return caps;
+}
+
+int device_caps_has_subgroups(cl_device_id dev) {
+
+   const device_caps *caps = device_caps_get(dev);
+
+   /* Subgroup functions aren't declared for OpenCL C 1.2 kernels */
+   return caps->subgroups && caps->c_version >= 200;
+}
+
+int device_caps_options(cl_device_id dev, const char *extra,
+      char *options, size_t size) {
+
+   const device_caps *caps = device_caps_get(dev);
+   const char *type_name, *std = "";
+   int len;
+
+   if(caps->type & CL_DEVICE_TYPE_GPU)
+      type_name = "GPU";
+   else if(caps->type & CL_DEVICE_TYPE_ACCELERATOR)
+      type_name = "ACCELERATOR";
+   else
+      type_name = "CPU";
+
+   if(device_caps_has_subgroups(dev))
+      std = caps->c_version >= 300 ? " -cl-std=CL3.0" : " -cl-std=CL2.0";
+
+   len = snprintf(options, size,
+         "-DDEVICE_%s -DVEC_WIDTH=%u -DLOCAL_MEM_SIZE=%lu "
+         "-DLOCAL_MEM_DEDICATED=%d -DMAX_GROUP_SIZE=%lu "
+         "-DCOMPUTE_UNITS=%u%s",
+         type_name, caps->vec_width, (unsigned long)caps->local_mem_size,
+         caps->local_mem_dedicated, (unsigned long)caps->max_group_size,
+         caps->compute_units, std);
+   if(len >= 0 && (size_t)len < size && caps->fp64)
+      len += snprintf(options + len, size - len,
+            " -DFP_64 -DVEC_WIDTH_DOUBLE=%u", caps->vec_width_double);
+   if(len >= 0 && (size_t)len < size && caps->fp16)
+      len += snprintf(options + len, size - len, " -DFP_16");
+   if(len >= 0 && (size_t)len < size && device_caps_has_subgroups(dev))
+      len += snprintf(options + len, size - len, " -DHAS_SUBGROUPS");
+   if(len >= 0 && (size_t)len < size && extra != NULL && extra[0] != '\0')
+      len += snprintf(options + len, size - len, " %s", extra);
+
+   if(len < 0 || (size_t)len >= size)
+      return -1;
+   return len;
+}
+
+/* Read a program file into a null-terminated buffer */
+static char* read_source(const char *filename) {
+
+   FILE *program_handle;
+   char *program_buffer;
+   size_t program_size;
+
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+   return program_buffer;
+}
+
+/* Create a program from source and build it for one device */
+static cl_program build_source(cl_context ctx, cl_device_id dev,
+      const char *source, const char *options) {
+
+   cl_program program;
+   char *program_log;
+   size_t log_size;
+   int err;
+
+   program = clCreateProgramWithSource(ctx, 1, &source, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+
+   /* Build for this device only */
+   err = clBuildProgram(program, 1, &dev, options, NULL, NULL);
+   if(err < 0) {
+
+      /* Find size of log and print to std output */
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG,
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG,
+            log_size + 1, program_log, NULL);
+      printf("Options: %s\n%s\n", options != NULL ? options : "",
+            program_log);
+      free(program_log);
+      exit(1);
+   }
+
+   return program;
+}
+
+cl_program device_caps_build_source(cl_context ctx, cl_device_id dev,
+      const char *source, const char *extra) {
+
+   char options[1024];
+
+   if(device_caps_options(dev, extra, options, sizeof(options)) < 0) {
+      printf("Build options are too long\n");
+      exit(1);
+   }
+   return build_source(ctx, dev, source, options);
+}
+
+cl_program device_caps_build(cl_context ctx, cl_device_id dev,
+      const char *filename, const char *extra) {
+
+   cl_program program;
+   char *program_buffer;
+
+   program_buffer = read_source(filename);
+   program = device_caps_build_source(ctx, dev, program_buffer, extra);
+   free(program_buffer);
+   return program;
+}
+
+cl_program device_caps_build_plain(cl_context ctx, cl_device_id dev,
+      const char *filename, const char *options) {
+
+   cl_program program;
+   char *program_buffer;
+
+   program_buffer = read_source(filename);
+   program = build_source(ctx, dev, program_buffer, options);
+   free(program_buffer);
+   return program;
+}
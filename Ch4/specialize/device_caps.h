@@ -0,0 +1,67 @@
+#ifndef DEVICE_CAPS_H
+#define DEVICE_CAPS_H
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* What a device can do, as far as kernel code generation cares */
+typedef struct device_caps {
+   cl_device_id device;
+   cl_device_type type;
+   cl_uint vec_width;            /* Preferred float vector width */
+   cl_uint vec_width_double;     /* 0 without fp64 */
+   int fp64;
+   int fp16;
+   int subgroups;                /* cl_khr_subgroups */
+   int c_version;                /* OpenCL C version times 100 */
+   cl_ulong local_mem_size;
+   int local_mem_dedicated;      /* CL_LOCAL rather than CL_GLOBAL */
+   size_t max_group_size;
+   cl_uint compute_units;
+} device_caps;
+
+/* Query a device's capabilities. Each device is only queried once; later
+   calls return the same record. Exits on failure */
+const device_caps* device_caps_get(cl_device_id dev);
+
+/* Whether kernels built with the capability options can use subgroup
+   functions, which is when they define HAS_SUBGROUPS */
+int device_caps_has_subgroups(cl_device_id dev);
+
+/* Write the build options for a device into options: one -D for each
+   capability, followed by extra if it isn't NULL. Returns the length,
+   or -1 if size is too small. The defines are
+
+   DEVICE_CPU, DEVICE_GPU or DEVICE_ACCELERATOR
+   VEC_WIDTH             preferred float width, 1 to 16
+   VEC_WIDTH_DOUBLE      preferred double width, with FP_64
+   FP_64, FP_16          cl_khr_fp64 and cl_khr_fp16 are available
+   HAS_SUBGROUPS         cl_khr_subgroups is available
+   LOCAL_MEM_SIZE        bytes of local memory
+   LOCAL_MEM_DEDICATED   1 if local memory is on-chip, 0 if emulated
+   MAX_GROUP_SIZE        largest work-group
+   COMPUTE_UNITS         number of compute units
+
+   A -cl-std option is added when subgroups need OpenCL C 2.0 or later */
+int device_caps_options(cl_device_id dev, const char *extra,
+      char *options, size_t size);
+
+/* Build a program for one device with its capability options and extra.
+   Prints the build log and exits on failure */
+cl_program device_caps_build(cl_context ctx, cl_device_id dev,
+      const char *filename, const char *extra);
+
+/* The same for source held in memory */
+cl_program device_caps_build_source(cl_context ctx, cl_device_id dev,
+      const char *source, const char *extra);
+
+/* Build a program from a file with options alone, which may be NULL,
+   and none of the capability defines. This is the generic build that
+   the specialized one is measured against */
+cl_program device_caps_build_plain(cl_context ctx, cl_device_id dev,
+      const char *filename, const char *options);
+
+#endif
@@ -0,0 +1,310 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "specialize.cl"
+
+#define REDUCE_SIZE (1 << 22)
+#define MATRIX_DIM 512
+#define SORT_SIZE (1 << 20)
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "device_caps.h"
+
+/* A build of specialize.cl and the settings the host needs to match */
+typedef struct variant {
+   const char *name;
+   cl_program program;
+   cl_uint vec_width;
+   int sort_block;
+} variant;
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   }
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);
+   }
+
+   return dev;
+}
+
+/* Largest power of two no greater than limit that divides total */
+size_t group_size(cl_kernel kernel, cl_device_id dev, size_t limit,
+      size_t total) {
+
+   size_t max_size, size = 1;
+
+   clGetKernelWorkGroupInfo(kernel, dev, CL_KERNEL_WORK_GROUP_SIZE,
+         sizeof(max_size), &max_size, NULL);
+   if(max_size < limit)
+      limit = max_size;
+   while(size * 2 <= limit && total % (size * 2) == 0)
+      size *= 2;
+   return size;
+}
+
+/* Run a kernel to completion and return its execution time */
+double run_kernel(cl_command_queue queue, cl_kernel kernel,
+      size_t global_size, size_t local_size) {
+
+   cl_event event;
+   cl_ulong start, end;
+   cl_int err;
+
+   err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_size,
+         &local_size, 0, NULL, &event);
+   if(err < 0) {
+      printf("Couldn't enqueue the kernel: error %d\n", err);
+      exit(1);
+   }
+   clWaitForEvents(1, &event);
+   clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START,
+         sizeof(start), &start, NULL);
+   clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END,
+         sizeof(end), &end, NULL);
+   clReleaseEvent(event);
+   return (end - start) * 1.0e-9;
+}
+
+cl_kernel create_kernel(cl_program program, const char *name) {
+
+   cl_kernel kernel;
+   cl_int err;
+
+   kernel = clCreateKernel(program, name, &err);
+   if(err < 0) {
+      printf("Couldn't create the %s kernel\n", name);
+      exit(1);
+   };
+   return kernel;
+}
+
+int float_compare(const void *a, const void *b) {
+   float x = *(const float*)a, y = *(const float*)b;
+   return (x > y) - (x < y);
+}
+
+int main() {
+
+   /* Host/device data structures */
+   cl_device_id device;
+   cl_context context;
+   cl_command_queue queue;
+   cl_kernel kernel;
+   const device_caps *caps;
+   variant variants[2];
+   size_t global_size, local_size, num_groups;
+   cl_int err;
+   int v, i, j, k, check = 1, sort_block;
+   char options[1024], extra[64];
+   double seconds, sum;
+
+   /* Data and buffers */
+   float *reduce_data, *group_sums, *a_mat, *b_mat, *c_mat, *sort_data,
+         *sorted, expected;
+   cl_mem reduce_buffer, sums_buffer, a_buffer, b_buffer, c_buffer,
+         sort_buffer;
+
+   device = create_device();
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);
+   }
+   queue = clCreateCommandQueue(context, device,
+         CL_QUEUE_PROFILING_ENABLE, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);
+   };
+
+   /* Sort blocks take at most half of local memory */
+   caps = device_caps_get(device);
+   sort_block = 256;
+   while(sort_block < 8192 &&
+         (cl_ulong)sort_block * 2 * sizeof(float) <= caps->local_mem_size/2)
+      sort_block *= 2;
+   sprintf(extra, "-DSORT_BLOCK=%d", sort_block);
+   device_caps_options(device, extra, options, sizeof(options));
+   printf("Options: %s\n", options);
+
+   /* The specialized build and one that uses the source's defaults */
+   variants[0].name = "specialized";
+   variants[0].program = device_caps_build(context, device,
+         PROGRAM_FILE, extra);
+   variants[0].vec_width = caps->vec_width;
+   variants[0].sort_block = sort_block;
+   variants[1].name = "generic";
+   variants[1].program = device_caps_build_plain(context, device,
+         PROGRAM_FILE, NULL);
+   variants[1].vec_width = 4;
+   variants[1].sort_block = 1024;
+
+   /* Initialize data */
+   reduce_data = (float*)malloc(REDUCE_SIZE * sizeof(float));
+   group_sums = (float*)malloc(REDUCE_SIZE * sizeof(float));
+   for(i=0; i<REDUCE_SIZE; i++)
+      reduce_data[i] = (float)(i % 8);
+   a_mat = (float*)malloc(MATRIX_DIM * MATRIX_DIM * sizeof(float));
+   b_mat = (float*)malloc(MATRIX_DIM * MATRIX_DIM * sizeof(float));
+   c_mat = (float*)malloc(MATRIX_DIM * MATRIX_DIM * sizeof(float));
+   for(i=0; i<MATRIX_DIM * MATRIX_DIM; i++) {
+      a_mat[i] = (float)(i % 5);
+      b_mat[i] = (float)(i % 3);
+   }
+   sort_data = (float*)malloc(SORT_SIZE * sizeof(float));
+   sorted = (float*)malloc(SORT_SIZE * sizeof(float));
+   srand(0);
+   for(i=0; i<SORT_SIZE; i++)
+      sort_data[i] = (float)rand()/RAND_MAX;
+
+   /* Create buffers */
+   reduce_buffer = clCreateBuffer(context,
+         CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+         REDUCE_SIZE * sizeof(float), reduce_data, &err);
+   sums_buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY,
+         REDUCE_SIZE * sizeof(float), NULL, &err);
+   a_buffer = clCreateBuffer(context,
+         CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+         MATRIX_DIM * MATRIX_DIM * sizeof(float), a_mat, &err);
+   b_buffer = clCreateBuffer(context,
+         CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR,
+         MATRIX_DIM * MATRIX_DIM * sizeof(float), b_mat, &err);
+   c_buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY,
+         MATRIX_DIM * MATRIX_DIM * sizeof(float), NULL, &err);
+   sort_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE,
+         SORT_SIZE * sizeof(float), NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);
+   };
+
+   for(v=0; v<2; v++) {
+      printf("\n%s build, vector width %u, sort blocks of %d\n",
+            variants[v].name, variants[v].vec_width, variants[v].sort_block);
+
+      /* Reduction: one vector per work-item */
+      kernel = create_kernel(variants[v].program, "reduction");
+      global_size = REDUCE_SIZE/variants[v].vec_width;
+      local_size = group_size(kernel, device, 256, global_size);
+      num_groups = global_size/local_size;
+      err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &reduce_buffer);
+      err |= clSetKernelArg(kernel, 1, local_size * sizeof(float), NULL);
+      err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &sums_buffer);
+      if(err < 0) {
+         perror("Couldn't set a kernel argument");
+         exit(1);
+      };
+      seconds = run_kernel(queue, kernel, global_size, local_size);
+      clEnqueueReadBuffer(queue, sums_buffer, CL_TRUE, 0,
+            num_groups * sizeof(float), group_sums, 0, NULL, NULL);
+      sum = 0.0;
+      for(i=0; i<num_groups; i++)
+         sum += group_sums[i];
+      if(sum != 3.5 * REDUCE_SIZE)
+         check = 0;
+      printf("reduction:   %8.3f ms\n", seconds * 1.0e3);
+      clReleaseKernel(kernel);
+
+      /* Matrix multiplication: one row per work-item */
+      kernel = create_kernel(variants[v].program, "matrix_mult");
+      local_size = group_size(kernel, device, 64, MATRIX_DIM);
+      err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &a_buffer);
+      err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &b_buffer);
+      err |= clSetKernelArg(kernel, 2, sizeof(cl_mem), &c_buffer);
+      if(err < 0) {
+         perror("Couldn't set a kernel argument");
+         exit(1);
+      };
+      seconds = run_kernel(queue, kernel, MATRIX_DIM, local_size);
+      clEnqueueReadBuffer(queue, c_buffer, CL_TRUE, 0,
+            MATRIX_DIM * MATRIX_DIM * sizeof(float), c_mat, 0, NULL, NULL);
+      for(i=0; i<MATRIX_DIM; i+=17) {
+         for(j=0; j<MATRIX_DIM; j+=13) {
+            expected = 0.0f;
+            for(k=0; k<MATRIX_DIM; k++)
+               expected += a_mat[i*MATRIX_DIM + k] * b_mat[j*MATRIX_DIM + k];
+            if(c_mat[i*MATRIX_DIM + j] != expected)
+               check = 0;
+         }
+      }
+      printf("matrix_mult: %8.3f ms\n", seconds * 1.0e3);
+      clReleaseKernel(kernel);
+
+      /* Block sort: one work-group per block */
+      kernel = create_kernel(variants[v].program, "bsort_local");
+      num_groups = SORT_SIZE/variants[v].sort_block;
+      local_size = group_size(kernel, device, 256,
+            variants[v].sort_block/2);
+      clEnqueueWriteBuffer(queue, sort_buffer, CL_TRUE, 0,
+            SORT_SIZE * sizeof(float), sort_data, 0, NULL, NULL);
+      i = 0;
+      err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &sort_buffer);
+      err |= clSetKernelArg(kernel, 1, sizeof(int), &i);
+      if(err < 0) {
+         perror("Couldn't set a kernel argument");
+         exit(1);
+      };
+      seconds = run_kernel(queue, kernel, num_groups * local_size,
+            local_size);
+      clEnqueueReadBuffer(queue, sort_buffer, CL_TRUE, 0,
+            SORT_SIZE * sizeof(float), sorted,
+            0, NULL, NULL);
+      for(i=0; i<num_groups; i++) {
+         k = i * variants[v].sort_block;
+         memcpy(group_sums, sort_data + k,
+               variants[v].sort_block * sizeof(float));
+         qsort(group_sums, variants[v].sort_block, sizeof(float),
+               float_compare);
+         if(memcmp(group_sums, sorted + k,
+               variants[v].sort_block * sizeof(float)) != 0)
+            check = 0;
+      }
+      printf("bsort_local: %8.3f ms\n", seconds * 1.0e3);
+      clReleaseKernel(kernel);
+   }
+
+   if(check)
+      printf("\nCheck passed.\n");
+   else
+      printf("\nCheck failed.\n");
+
+   /* Deallocate resources */
+   free(reduce_data);
+   free(group_sums);
+   free(a_mat);
+   free(b_mat);
+   free(c_mat);
+   free(sort_data);
+   free(sorted);
+   clReleaseMemObject(reduce_buffer);
+   clReleaseMemObject(sums_buffer);
+   clReleaseMemObject(a_buffer);
+   clReleaseMemObject(b_buffer);
+   clReleaseMemObject(c_buffer);
+   clReleaseMemObject(sort_buffer);
+   for(v=0; v<2; v++)
+      clReleaseProgram(variants[v].program);
+   clReleaseCommandQueue(queue);
+   clReleaseContext(context);
+   return 0;
+}
@@ -0,0 +1,185 @@
+/* Built with the options from device_caps_options. The defaults below
+   are for a build without them */
+#ifndef VEC_WIDTH
+#define VEC_WIDTH 4
+#endif
+
+#ifndef LOCAL_MEM_SIZE
+#define LOCAL_MEM_SIZE 16384
+#endif
+
+#ifndef LOCAL_MEM_DEDICATED
+#define LOCAL_MEM_DEDICATED 1
+#endif
+
+#ifdef HAS_SUBGROUPS
+#pragma OPENCL EXTENSION cl_khr_subgroups : enable
+#endif
+
+/* floatn is a float vector of the preferred width, and SUM_VEC adds
+   its components */
+#if VEC_WIDTH == 1
+typedef float floatn;
+#define SUM_VEC(v) (v)
+#elif VEC_WIDTH == 2
+typedef float2 floatn;
+#define SUM_VEC(v) ((v).x + (v).y)
+#elif VEC_WIDTH == 4
+typedef float4 floatn;
+#define SUM_VEC(v) dot((v), (float4)(1.0f))
+#elif VEC_WIDTH == 8
+typedef float8 floatn;
+#define SUM_VEC(v) dot((v).lo + (v).hi, (float4)(1.0f))
+#else
+typedef float16 floatn;
+#define SUM_VEC(v) dot((v).lo.lo + (v).lo.hi + (v).hi.lo + (v).hi.hi, \
+      (float4)(1.0f))
+#endif
+
+/* Half of local memory holds a slice of a B row, at most 2048 vectors */
+#if LOCAL_MEM_SIZE/2/(4*VEC_WIDTH) > 2048
+#define TILE_VECS 2048
+#else
+#define TILE_VECS (LOCAL_MEM_SIZE/2/(4*VEC_WIDTH))
+#endif
+
+/* Sorted blocks must fit in local memory. The host normally sets this
+   from LOCAL_MEM_SIZE */
+#ifndef SORT_BLOCK
+#define SORT_BLOCK 1024
+#endif
+
+/* Each work-item adds one vector. Work-groups reduce their sums with
+   subgroup operations where they exist and in local memory otherwise.
+   partial_sums holds a float for every work-item */
+__kernel void reduction(__global floatn *data,
+      __local float *partial_sums, __global float *output) {
+
+   float sum = SUM_VEC(data[get_global_id(0)]);
+
+#ifdef HAS_SUBGROUPS
+   uint sg_lid = get_sub_group_local_id();
+   uint i;
+
+   sum = sub_group_reduce_add(sum);
+   if(sg_lid == 0)
+      partial_sums[get_sub_group_id()] = sum;
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   /* The first subgroup adds the subgroups' sums */
+   if(get_sub_group_id() == 0) {
+      sum = 0.0f;
+      for(i=sg_lid; i<get_num_sub_groups(); i+=get_sub_group_size())
+         sum += partial_sums[i];
+      sum = sub_group_reduce_add(sum);
+      if(sg_lid == 0)
+         output[get_group_id(0)] = sum;
+   }
+#else
+   int lid = get_local_id(0);
+
+   partial_sums[lid] = sum;
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   for(int i = get_local_size(0)/2; i>0; i >>= 1) {
+      if(lid < i) {
+         partial_sums[lid] += partial_sums[lid + i];
+      }
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+
+   if(lid == 0) {
+      output[get_group_id(0)] = partial_sums[0];
+   }
+#endif
+}
+
+/* Each work-item computes a row of C = A * B^T, with one work-item per
+   row. b_mat holds the rows of B^T, so both operands are read along
+   rows. Where local memory is on-chip, each work-group copies slices of
+   the B row into it once instead of every work-item reading global
+   memory. The global size must be a multiple of VEC_WIDTH */
+__kernel void matrix_mult(__global floatn *a_mat,
+      __global floatn *b_mat, __global float *c_mat) {
+
+   float sum;
+
+   int num_rows = get_global_size(0);
+   int vectors_per_row = num_rows/VEC_WIDTH;
+   int start = get_global_id(0) * vectors_per_row;
+   a_mat += start;
+   c_mat += get_global_id(0) * num_rows;
+
+#if LOCAL_MEM_DEDICATED
+   __local floatn b_tile[TILE_VECS];
+   int lid = get_local_id(0);
+   int group_size = get_local_size(0);
+   int base, count;
+
+   for(int i=0; i<num_rows; i++) {
+      sum = 0.0f;
+      for(base=0; base<vectors_per_row; base+=TILE_VECS) {
+         count = min(TILE_VECS, vectors_per_row - base);
+         barrier(CLK_LOCAL_MEM_FENCE);
+         for(int j=lid; j<count; j+=group_size) {
+            b_tile[j] = b_mat[i * vectors_per_row + base + j];
+         }
+         barrier(CLK_LOCAL_MEM_FENCE);
+         for(int j=0; j<count; j++) {
+            sum += SUM_VEC(a_mat[base + j] * b_tile[j]);
+         }
+      }
+      c_mat[i] = sum;
+   }
+#else
+   for(int i=0; i<num_rows; i++) {
+      sum = 0.0f;
+      for(int j=0; j<vectors_per_row; j++) {
+         sum += SUM_VEC(a_mat[j] * b_mat[i * vectors_per_row + j]);
+      }
+      c_mat[i] = sum;
+   }
+#endif
+}
+
+/* Each work-group sorts SORT_BLOCK floats in local memory with a bitonic
+   network, upward if dir is 0 and downward otherwise. This is the first
+   stage of a bitonic sort, with the block as large as the device allows */
+__kernel void bsort_local(__global float *data, int dir) {
+
+   __local float block[SORT_BLOCK];
+   uint lid = get_local_id(0);
+   uint group_size = get_local_size(0);
+   uint size, stride, i, pos;
+   float a, b;
+   int up;
+
+   data += get_group_id(0) * SORT_BLOCK;
+   for(i=lid; i<SORT_BLOCK; i+=group_size) {
+      block[i] = data[i];
+   }
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   for(size=2; size<=SORT_BLOCK; size<<=1) {
+      for(stride=size/2; stride>0; stride>>=1) {
+
+         /* Compare pos with pos + stride. Pairs in alternating runs of
+            size elements are sorted in opposite directions */
+         for(i=lid; i<SORT_BLOCK/2; i+=group_size) {
+            pos = 2*i - (i & (stride-1));
+            up = ((pos & size) == 0) != (dir != 0);
+            a = block[pos];
+            b = block[pos + stride];
+            if((a > b) == up) {
+               block[pos] = b;
+               block[pos + stride] = a;
+            }
+         }
+         barrier(CLK_LOCAL_MEM_FENCE);
+      }
+   }
+
+   for(i=lid; i<SORT_BLOCK; i+=group_size) {
+      data[i] = block[i];
+   }
+}
@@ -0,0 +1,297 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kernel_templates.h"
+#include "device_caps.h"
+
+static const char *type_names[KT_NUM_TYPES] = {
+   "int", "uint", "float", "double", "half"
+};
+static const size_t type_sizes[KT_NUM_TYPES] = {
+   sizeof(cl_int), sizeof(cl_uint), sizeof(cl_float), sizeof(cl_double),
+   sizeof(cl_half)
+};
+static const char *template_names[KT_NUM_ALGORITHMS] = {
+   "reduce", "scan", "sort"
+};
+static const char *kernel_names[KT_NUM_ALGORITHMS][2] = {
+   {"reduce", NULL}, {"scan_groups", "scan_add"},
+   {"sort_step", "sort_step_scalar"}
+};
+
+static int width_index(int width) {
+
+   switch(width) {
+      case 1: return 0;
+      case 2: return 1;
+      case 4: return 2;
+      case 8: return 3;
+      case 16: return 4;
+   }
+   return -1;
+}
+
+void kt_init(kt_cache *cache, cl_context ctx, cl_device_id dev,
+      cl_command_queue queue) {
+
+   memset(cache, 0, sizeof(*cache));
+   cache->context = ctx;
+   cache->device = dev;
+   cache->queue = queue;
+}
+
+int kt_supported(kt_cache *cache, kt_type type) {
+
+   const device_caps *caps = device_caps_get(cache->device);
+
+   if(type == KT_DOUBLE)
+      return caps->fp64;
+   if(type == KT_HALF)
+      return caps->fp16;
+   return 1;
+}
+
+const char* kt_type_name(kt_type type) {
+   return type_names[type];
+}
+
+size_t kt_type_size(kt_type type) {
+   return type_sizes[type];
+}
+
+kt_type kt_accumulator(kt_type type) {
+   return type == KT_HALF ? KT_FLOAT : type;
+}
+
+int kt_options(kt_type type, int width, char *options, size_t size) {
+
+   int len;
+
+   len = snprintf(options, size, "-I%s -DT=%s -DACC=%s -DWIDTH=%d",
+         KT_TEMPLATE_DIR, type_names[type],
+         type_names[kt_accumulator(type)], width);
+   if(len < 0 || (size_t)len >= size)
+      return -1;
+   return len;
+}
+
+const kt_instance* kt_get(kt_cache *cache, kt_algorithm alg, kt_type type,
+      int width) {
+
+   kt_instance *inst;
+   char file_name[256], options[256];
+   size_t max_size, group_size;
+   int w = width_index(width), k;
+   cl_int err;
+
+   if(w < 0) {
+      printf("Templates can't be instantiated with width %d\n", width);
+      exit(1);
+   }
+   inst = &cache->instances[alg][type][w];
+   if(inst->program != NULL)
+      return inst;
+
+   if(!kt_supported(cache, type)) {
+      printf("The device doesn't support %s\n", type_names[type]);
+      exit(1);
+   }
+   sprintf(file_name, "%s/template_%s.cl", KT_TEMPLATE_DIR,
+         template_names[alg]);
+   kt_options(type, width, options, sizeof(options));
+   inst->program = device_caps_build(cache->context, cache->device,
+         file_name, options);
+
+   /* Work-groups are the largest power of two, up to 256, that every
+      kernel of the instance accepts */
+   group_size = 256;
+   for(k=0; k<2 && kernel_names[alg][k] != NULL; k++) {
+      inst->kernels[k] = clCreateKernel(inst->program, kernel_names[alg][k],
+            &err);
+      if(err < 0) {
+         printf("Couldn't create the %s kernel\n", kernel_names[alg][k]);
+         exit(1);
+      };
+      clGetKernelWorkGroupInfo(inst->kernels[k], cache->device,
+            CL_KERNEL_WORK_GROUP_SIZE, sizeof(max_size), &max_size, NULL);
+      while(group_size > max_size)
+         group_size /= 2;
+   }
+   inst->group_size = group_size;
+   cache->num_builds++;
+   return inst;
+}
+
+cl_int kt_reduce(kt_cache *cache, kt_type type, int width, cl_mem data,
+      size_t count, void *result) {
+
+   const kt_instance *inst = kt_get(cache, KT_REDUCE, type, width);
+   const kt_instance *last = kt_get(cache, KT_REDUCE,
+         kt_accumulator(type), 1);
+   kt_type acc = kt_accumulator(type);
+   size_t acc_size = type_sizes[acc], local_size, global_size, num_groups;
+   cl_mem partial_buffer, result_buffer;
+   cl_uint n = (cl_uint)count, num_partial;
+   cl_int err;
+
+   /* First pass: up to 1024 work-groups, each leaving one sum */
+   local_size = inst->group_size;
+   num_groups = (count/width + local_size - 1)/local_size;
+   if(num_groups == 0)
+      num_groups = 1;
+   if(num_groups > 1024)
+      num_groups = 1024;
+   global_size = num_groups * local_size;
+   num_partial = (cl_uint)num_groups;
+
+   partial_buffer = clCreateBuffer(cache->context, CL_MEM_READ_WRITE,
+         num_groups * acc_size, NULL, &err);
+   if(err < 0)
+      return err;
+   result_buffer = clCreateBuffer(cache->context, CL_MEM_READ_WRITE,
+         acc_size, NULL, &err);
+   if(err < 0) {
+      clReleaseMemObject(partial_buffer);
+      return err;
+   }
+
+   err = clSetKernelArg(inst->kernels[0], 0, sizeof(cl_mem), &data);
+   err |= clSetKernelArg(inst->kernels[0], 1, sizeof(n), &n);
+   err |= clSetKernelArg(inst->kernels[0], 2, local_size * acc_size, NULL);
+   err |= clSetKernelArg(inst->kernels[0], 3, sizeof(cl_mem),
+         &partial_buffer);
+   if(err == CL_SUCCESS)
+      err = clEnqueueNDRangeKernel(cache->queue, inst->kernels[0], 1, NULL,
+            &global_size, &local_size, 0, NULL, NULL);
+
+   /* Second pass: one work-group adds the sums */
+   if(err == CL_SUCCESS) {
+      local_size = last->group_size;
+      err = clSetKernelArg(last->kernels[0], 0, sizeof(cl_mem),
+            &partial_buffer);
+      err |= clSetKernelArg(last->kernels[0], 1, sizeof(num_partial),
+            &num_partial);
+      err |= clSetKernelArg(last->kernels[0], 2, local_size * acc_size,
+            NULL);
+      err |= clSetKernelArg(last->kernels[0], 3, sizeof(cl_mem),
+            &result_buffer);
+   }
+   if(err == CL_SUCCESS)
+      err = clEnqueueNDRangeKernel(cache->queue, last->kernels[0], 1, NULL,
+            &local_size, &local_size, 0, NULL, NULL);
+   if(err == CL_SUCCESS)
+      err = clEnqueueReadBuffer(cache->queue, result_buffer, CL_TRUE, 0,
+            acc_size, result, 0, NULL, NULL);
+
+   clReleaseMemObject(partial_buffer);
+   clReleaseMemObject(result_buffer);
+   return err;
+}
+
+cl_int kt_scan(kt_cache *cache, kt_type type, int width, cl_mem data,
+      size_t count) {
+
+   const kt_instance *inst = kt_get(cache, KT_SCAN, type, width);
+   size_t size = type_sizes[type], local_size, global_size, num_groups;
+   cl_mem sums_buffer;
+   cl_uint n = (cl_uint)count;
+   cl_int err;
+
+   if(count == 0)
+      return CL_SUCCESS;
+   local_size = inst->group_size;
+   num_groups = ((count + width - 1)/width + local_size - 1)/local_size;
+   global_size = num_groups * local_size;
+
+   sums_buffer = clCreateBuffer(cache->context, CL_MEM_READ_WRITE,
+         num_groups * size, NULL, &err);
+   if(err < 0)
+      return err;
+
+   /* Scan within work-groups */
+   err = clSetKernelArg(inst->kernels[0], 0, sizeof(cl_mem), &data);
+   err |= clSetKernelArg(inst->kernels[0], 1, sizeof(n), &n);
+   err |= clSetKernelArg(inst->kernels[0], 2, local_size * size, NULL);
+   err |= clSetKernelArg(inst->kernels[0], 3, sizeof(cl_mem), &sums_buffer);
+   if(err == CL_SUCCESS)
+      err = clEnqueueNDRangeKernel(cache->queue, inst->kernels[0], 1, NULL,
+            &global_size, &local_size, 0, NULL, NULL);
+
+   /* Scan the groups' totals the same way and add them back */
+   if(err == CL_SUCCESS && num_groups > 1) {
+      err = kt_scan(cache, type, width, sums_buffer, num_groups);
+      if(err == CL_SUCCESS) {
+         err = clSetKernelArg(inst->kernels[1], 0, sizeof(cl_mem), &data);
+         err |= clSetKernelArg(inst->kernels[1], 1, sizeof(n), &n);
+         err |= clSetKernelArg(inst->kernels[1], 2, sizeof(cl_mem),
+               &sums_buffer);
+      }
+      if(err == CL_SUCCESS)
+         err = clEnqueueNDRangeKernel(cache->queue, inst->kernels[1], 1,
+               NULL, &global_size, &local_size, 0, NULL, NULL);
+   }
+
+   /* Freed once the queued kernels are done with it */
+   clReleaseMemObject(sums_buffer);
+   return err;
+}
+
+cl_int kt_sort(kt_cache *cache, kt_type type, int width, cl_mem data,
+      size_t count, int descending) {
+
+   const kt_instance *inst = kt_get(cache, KT_SORT, type, width);
+   cl_kernel kernel;
+   size_t global_size, local_size;
+   cl_uint size, stride;
+   cl_int err = CL_SUCCESS;
+
+   if(count & (count - 1))
+      return CL_INVALID_VALUE;
+
+   /* Strides of at least the width compare whole vectors */
+   for(size=2; size<=count && err == CL_SUCCESS; size<<=1) {
+      for(stride=size/2; stride>0 && err == CL_SUCCESS; stride>>=1) {
+         if(stride >= (cl_uint)width) {
+            kernel = inst->kernels[0];
+            global_size = count/2/width;
+         }
+         else {
+            kernel = inst->kernels[1];
+            global_size = count/2;
+         }
+         local_size = inst->group_size < global_size ?
+               inst->group_size : global_size;
+         err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &data);
+         err |= clSetKernelArg(kernel, 1, sizeof(size), &size);
+         err |= clSetKernelArg(kernel, 2, sizeof(stride), &stride);
+         err |= clSetKernelArg(kernel, 3, sizeof(int), &descending);
+         if(err == CL_SUCCESS)
+            err = clEnqueueNDRangeKernel(cache->queue, kernel, 1, NULL,
+                  &global_size, &local_size, 0, NULL, NULL);
+      }
+   }
+   return err;
+}
+
+void kt_release(kt_cache *cache) {
+
+   kt_instance *inst;
+   int a, t, w, k;
+
+   for(a=0; a<KT_NUM_ALGORITHMS; a++) {
+      for(t=0; t<KT_NUM_TYPES; t++) {
+         for(w=0; w<KT_NUM_WIDTHS; w++) {
+            inst = &cache->instances[a][t][w];
+            for(k=0; k<2; k++)
+               if(inst->kernels[k] != NULL)
+                  clReleaseKernel(inst->kernels[k]);
+            if(inst->program != NULL)
+               clReleaseProgram(inst->program);
+         }
+      }
+   }
+   memset(cache->instances, 0, sizeof(cache->instances));
+}
@@ -0,0 +1,85 @@
+#ifndef KERNEL_TEMPLATES_H
+#define KERNEL_TEMPLATES_H
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* Directory holding template_prelude.h, template_reduce.cl,
+   template_scan.cl and template_sort.cl */
+#ifndef KT_TEMPLATE_DIR
+#define KT_TEMPLATE_DIR "."
+#endif
+
+typedef enum kt_type {
+   KT_INT, KT_UINT, KT_FLOAT, KT_DOUBLE, KT_HALF, KT_NUM_TYPES
+} kt_type;
+
+typedef enum kt_algorithm {
+   KT_REDUCE, KT_SCAN, KT_SORT, KT_NUM_ALGORITHMS
+} kt_algorithm;
+
+/* Vector widths 1, 2, 4, 8 and 16 */
+#define KT_NUM_WIDTHS 5
+
+/* A compiled instance of a template and its kernels */
+typedef struct kt_instance {
+   cl_program program;
+   cl_kernel kernels[2];
+   size_t group_size;
+} kt_instance;
+
+/* Instances are compiled the first time they're used and kept until
+   kt_release */
+typedef struct kt_cache {
+   cl_context context;
+   cl_device_id device;
+   cl_command_queue queue;
+   kt_instance instances[KT_NUM_ALGORITHMS][KT_NUM_TYPES][KT_NUM_WIDTHS];
+   int num_builds;
+} kt_cache;
+
+void kt_init(kt_cache *cache, cl_context ctx, cl_device_id dev,
+      cl_command_queue queue);
+
+/* Whether the device can run a type: double needs cl_khr_fp64 and half
+   needs cl_khr_fp16 */
+int kt_supported(kt_cache *cache, kt_type type);
+
+const char* kt_type_name(kt_type type);
+size_t kt_type_size(kt_type type);
+
+/* Sums are accumulated in float for half and in the type itself
+   otherwise */
+kt_type kt_accumulator(kt_type type);
+
+/* Write the build options that instantiate a template for a type and
+   width: the include path of template_prelude.h and its T, ACC and
+   WIDTH. Returns the length, or -1 if size is too small */
+int kt_options(kt_type type, int width, char *options, size_t size);
+
+/* Find or build an instance. Exits if the width isn't 1, 2, 4, 8 or 16,
+   the type isn't supported or the build fails */
+const kt_instance* kt_get(kt_cache *cache, kt_algorithm alg, kt_type type,
+      int width);
+
+/* Sum count elements of data into result, which holds one element of
+   kt_accumulator(type). Blocks until the result has been read */
+cl_int kt_reduce(kt_cache *cache, kt_type type, int width, cl_mem data,
+      size_t count, void *result);
+
+/* Replace count elements of data with their inclusive prefix sums. The
+   kernels are enqueued on the cache's queue without waiting */
+cl_int kt_scan(kt_cache *cache, kt_type type, int width, cl_mem data,
+      size_t count);
+
+/* Sort count elements of data, a power of two, upward or downward.
+   Also returns once the kernels are enqueued */
+cl_int kt_sort(kt_cache *cache, kt_type type, int width, cl_mem data,
+      size_t count, int descending);
+
+void kt_release(kt_cache *cache);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef TEMPLATE_PRELUDE_H
+#define TEMPLATE_PRELUDE_H
+
+/* Type definitions for the templates, included by each of them. An
+   instance is chosen with build options, as kt_options in
+   kernel_templates.c and template_options in oclia/templates.py write
+   them:
+
+   T       element type: int, uint, float, double or half
+   ACC     type sums are accumulated in: T, or float for half
+   WIDTH   elements per vector: 1, 2, 4, 8 or 16
+
+   From these it defines TN and ACCN, the vector types, and LOADN,
+   STOREN, TO_ACCN and SUM_VEC. Scalars get the same macros as vectors,
+   so templates never test WIDTH */
+
+#ifdef cl_khr_fp64
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#endif
+#ifdef cl_khr_fp16
+#pragma OPENCL EXTENSION cl_khr_fp16 : enable
+#endif
+
+/* Paste after expanding, so T and WIDTH become float and 4 */
+#define KT_PASTE(a, b) a ## b
+#define KT_CAT(a, b) KT_PASTE(a, b)
+
+#if WIDTH == 1
+
+#define TN T
+#define ACCN ACC
+#define LOADN(p) (*(p))
+#define STOREN(v, p) (*(p) = (v))
+#define TO_ACCN(v) ((ACC)(v))
+#define SUM_VEC(v) (v)
+
+#else
+
+#define TN KT_CAT(T, WIDTH)
+#define ACCN KT_CAT(ACC, WIDTH)
+#define LOADN(p) KT_CAT(vload, WIDTH)(0, p)
+#define STOREN(v, p) KT_CAT(vstore, WIDTH)(v, 0, p)
+#define TO_ACCN(v) KT_CAT(convert_, ACCN)(v)
+
+/* Components are added in order, as a scalar loop would */
+#if WIDTH == 2
+#define SUM_VEC(v) ((v).s0 + (v).s1)
+#elif WIDTH == 4
+#define SUM_VEC(v) ((v).s0 + (v).s1 + (v).s2 + (v).s3)
+#elif WIDTH == 8
+#define SUM_VEC(v) ((v).s0 + (v).s1 + (v).s2 + (v).s3 + (v).s4 + \
+      (v).s5 + (v).s6 + (v).s7)
+#else
+#define SUM_VEC(v) ((v).s0 + (v).s1 + (v).s2 + (v).s3 + (v).s4 + \
+      (v).s5 + (v).s6 + (v).s7 + (v).s8 + (v).s9 + (v).sa + (v).sb + \
+      (v).sc + (v).sd + (v).se + (v).sf)
+#endif
+
+#endif
+
+#endif
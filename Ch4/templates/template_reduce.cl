@@ -0,0 +1,35 @@
+#include "template_prelude.h"
+
+/* Sum of count elements of type T, read WIDTH at a time. Each work-group
+   writes the sum of its work-items' elements to output */
+__kernel void reduce(__global const T *data, uint count,
+      __local ACC *partial_sums, __global ACC *output) {
+
+   uint gid = get_global_id(0);
+   uint lid = get_local_id(0);
+   uint num_vecs = count/WIDTH;
+   ACC sum = (ACC)0;
+
+   /* Whole vectors, strided by the global size, then the last few
+      elements one at a time */
+   for(uint i=gid; i<num_vecs; i+=get_global_size(0)) {
+      sum += SUM_VEC(TO_ACCN(LOADN(data + i*WIDTH)));
+   }
+   if(gid < count - num_vecs*WIDTH) {
+      sum += (ACC)data[num_vecs*WIDTH + gid];
+   }
+
+   partial_sums[lid] = sum;
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   for(uint i = get_local_size(0)/2; i>0; i >>= 1) {
+      if(lid < i) {
+         partial_sums[lid] += partial_sums[lid + i];
+      }
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+
+   if(lid == 0) {
+      output[get_group_id(0)] = partial_sums[0];
+   }
+}
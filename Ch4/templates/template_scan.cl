@@ -0,0 +1,73 @@
+#include "template_prelude.h"
+
+/* Inclusive prefix sum of count elements of type T, in place */
+
+/* Each work-item scans WIDTH elements and each work-group scans its
+   work-items' totals in local memory. The group's total goes to
+   group_sums, to be scanned and added back by scan_add */
+__kernel void scan_groups(__global T *data, uint count,
+      __local T *sums, __global T *group_sums) {
+
+   uint lid = get_local_id(0);
+   uint base = get_global_id(0) * WIDTH;
+   uint offset, k;
+   T x[WIDTH], t;
+
+   if(base + WIDTH <= count) {
+      STOREN(LOADN(data + base), x);
+   }
+   else {
+      for(k=0; k<WIDTH; k++) {
+         x[k] = base + k < count ? data[base + k] : (T)0;
+      }
+   }
+   for(k=1; k<WIDTH; k++) {
+      x[k] += x[k-1];
+   }
+
+   /* Hillis-Steele scan of the work-items' totals */
+   sums[lid] = x[WIDTH-1];
+   barrier(CLK_LOCAL_MEM_FENCE);
+   for(offset=1; offset<get_local_size(0); offset<<=1) {
+      t = lid >= offset ? sums[lid - offset] : (T)0;
+      barrier(CLK_LOCAL_MEM_FENCE);
+      sums[lid] += t;
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+
+   t = lid > 0 ? sums[lid - 1] : (T)0;
+   if(base + WIDTH <= count) {
+      STOREN(LOADN(x) + (TN)t, data + base);
+   }
+   else {
+      for(k=0; k<WIDTH && base + k < count; k++) {
+         data[base + k] = x[k] + t;
+      }
+   }
+   if(lid == get_local_size(0) - 1) {
+      group_sums[get_group_id(0)] = sums[lid];
+   }
+}
+
+/* Add the scanned totals of the groups before each group */
+__kernel void scan_add(__global T *data, uint count,
+      __global const T *group_sums) {
+
+   uint base = get_global_id(0) * WIDTH;
+   uint group = get_group_id(0);
+   uint k;
+   T t;
+
+   if(group == 0) {
+      return;
+   }
+   t = group_sums[group - 1];
+   if(base + WIDTH <= count) {
+      STOREN(LOADN(data + base) + (TN)t, data + base);
+   }
+   else {
+      for(k=0; k<WIDTH && base + k < count; k++) {
+         data[base + k] += t;
+      }
+   }
+}
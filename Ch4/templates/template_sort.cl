@@ -0,0 +1,44 @@
+#include "template_prelude.h"
+
+/* Steps of a bitonic sort of a power-of-two number of elements of type
+   T. The host runs one step for every size and stride */
+
+/* Each work-item compares WIDTH consecutive elements with the WIDTH
+   elements stride places on. stride must be at least WIDTH, so the
+   elements are contiguous and all sorted in the same direction */
+__kernel void sort_step(__global T *data, uint size, uint stride,
+      int descending) {
+
+   uint i = get_global_id(0) * WIDTH;
+   uint pos = 2*i - (i & (stride-1));
+   int up = ((pos & size) == 0) != (descending != 0);
+   TN a = LOADN(data + pos);
+   TN b = LOADN(data + pos + stride);
+   TN lo = min(a, b);
+   TN hi = max(a, b);
+
+   if(up) {
+      STOREN(lo, data + pos);
+      STOREN(hi, data + pos + stride);
+   }
+   else {
+      STOREN(hi, data + pos);
+      STOREN(lo, data + pos + stride);
+   }
+}
+
+/* One pair per work-item, for strides below WIDTH */
+__kernel void sort_step_scalar(__global T *data, uint size, uint stride,
+      int descending) {
+
+   uint i = get_global_id(0);
+   uint pos = 2*i - (i & (stride-1));
+   int up = ((pos & size) == 0) != (descending != 0);
+   T a = data[pos];
+   T b = data[pos + stride];
+
+   if((a > b) == up) {
+      data[pos] = b;
+      data[pos + stride] = a;
+   }
+}
@@ -0,0 +1,213 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define COUNT (1 << 16)
+#define HALF_COUNT 2048
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "kernel_templates.h"
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   }
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);
+   }
+
+   return dev;
+}
+
+/* Halfs for the small integers used here. Only zero and normal numbers
+   are converted */
+cl_half float_to_half(float f) {
+
+   cl_uint bits;
+   memcpy(&bits, &f, sizeof(bits));
+   if((bits & 0x7fffffff) == 0)
+      return (cl_half)((bits >> 16) & 0x8000);
+   return (cl_half)(((bits >> 16) & 0x8000) |
+         ((((bits >> 23) & 0xff) - 127 + 15) << 10) |
+         ((bits >> 13) & 0x3ff));
+}
+
+float half_to_float(cl_half h) {
+
+   cl_uint bits;
+   float f;
+
+   if((h & 0x7fff) == 0)
+      bits = (cl_uint)(h & 0x8000) << 16;
+   else
+      bits = ((cl_uint)(h & 0x8000) << 16) |
+            ((((h >> 10) & 0x1f) - 15 + 127) << 23) |
+            ((cl_uint)(h & 0x3ff) << 13);
+   memcpy(&f, &bits, sizeof(f));
+   return f;
+}
+
+/* Element i of an array of type */
+double get_value(kt_type type, const void *data, size_t i) {
+
+   switch(type) {
+      case KT_INT: return ((const cl_int*)data)[i];
+      case KT_UINT: return ((const cl_uint*)data)[i];
+      case KT_FLOAT: return ((const cl_float*)data)[i];
+      case KT_DOUBLE: return ((const cl_double*)data)[i];
+      default: return half_to_float(((const cl_half*)data)[i]);
+   }
+}
+
+void set_value(kt_type type, void *data, size_t i, int value) {
+
+   switch(type) {
+      case KT_INT: ((cl_int*)data)[i] = value; break;
+      case KT_UINT: ((cl_uint*)data)[i] = value; break;
+      case KT_FLOAT: ((cl_float*)data)[i] = (float)value; break;
+      case KT_DOUBLE: ((cl_double*)data)[i] = value; break;
+      default: ((cl_half*)data)[i] = float_to_half((float)value); break;
+   }
+}
+
+int main() {
+
+   /* Host/device data structures */
+   cl_device_id device;
+   cl_context context;
+   cl_command_queue queue;
+   kt_cache cache;
+   cl_int err;
+   int t, w, width, pass, check = 1, ok;
+   size_t count, i;
+   double sum, expected;
+
+   /* Data and buffers */
+   void *input, *output;
+   char result[sizeof(cl_double)];
+   cl_mem buffer;
+
+   device = create_device();
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);
+   }
+   queue = clCreateCommandQueue(context, device, 0, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);
+   };
+   kt_init(&cache, context, device, queue);
+
+   input = malloc(COUNT * sizeof(cl_double));
+   output = malloc(COUNT * sizeof(cl_double));
+   buffer = clCreateBuffer(context, CL_MEM_READ_WRITE,
+         COUNT * sizeof(cl_double), NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);
+   };
+
+   /* The second pass finds every instance in the cache */
+   for(pass=0; pass<2; pass++) {
+      for(t=0; t<KT_NUM_TYPES; t++) {
+         if(!kt_supported(&cache, (kt_type)t)) {
+            if(pass == 0)
+               printf("%-6s not supported\n", kt_type_name((kt_type)t));
+            continue;
+         }
+
+         /* Sums of half stay exact up to 2048 */
+         count = t == KT_HALF ? HALF_COUNT : COUNT;
+         for(w=0; w<KT_NUM_WIDTHS; w++) {
+            width = 1 << w;
+            ok = 1;
+
+            /* Reduction and scan of small integers */
+            srand(t * 16 + w);
+            for(i=0; i<count; i++)
+               set_value((kt_type)t, input, i,
+                     t == KT_HALF ? rand() % 2 : rand() % 4);
+            clEnqueueWriteBuffer(queue, buffer, CL_TRUE, 0,
+                  count * kt_type_size((kt_type)t), input, 0, NULL, NULL);
+            err = kt_reduce(&cache, (kt_type)t, width, buffer, count, result);
+            sum = 0.0;
+            for(i=0; i<count; i++)
+               sum += get_value((kt_type)t, input, i);
+            if(err < 0 || get_value(kt_accumulator((kt_type)t),
+                  result, 0) != sum)
+               ok = 0;
+
+            err = kt_scan(&cache, (kt_type)t, width, buffer, count);
+            clEnqueueReadBuffer(queue, buffer, CL_TRUE, 0,
+                  count * kt_type_size((kt_type)t), output, 0, NULL, NULL);
+            expected = 0.0;
+            for(i=0; i<count; i++) {
+               expected += get_value((kt_type)t, input, i);
+               if(get_value((kt_type)t, output, i) != expected)
+                  ok = 0;
+            }
+            if(err < 0)
+               ok = 0;
+
+            /* Sort upward and check the order and the total */
+            for(i=0; i<count; i++)
+               set_value((kt_type)t, input, i, rand() % 2048);
+            clEnqueueWriteBuffer(queue, buffer, CL_TRUE, 0,
+                  count * kt_type_size((kt_type)t), input, 0, NULL, NULL);
+            err = kt_sort(&cache, (kt_type)t, width, buffer, count, 0);
+            clEnqueueReadBuffer(queue, buffer, CL_TRUE, 0,
+                  count * kt_type_size((kt_type)t), output, 0, NULL, NULL);
+            sum = 0.0;
+            expected = 0.0;
+            for(i=0; i<count; i++) {
+               sum += get_value((kt_type)t, output, i);
+               expected += get_value((kt_type)t, input, i);
+               if(i > 0 && get_value((kt_type)t, output, i) <
+                     get_value((kt_type)t, output, i-1))
+                  ok = 0;
+            }
+            if(err < 0 || sum != expected)
+               ok = 0;
+
+            if(pass == 0)
+               printf("%-6s x %-2d reduce, scan, sort: %s\n",
+                     kt_type_name((kt_type)t), width, ok ? "ok" : "wrong");
+            check &= ok;
+         }
+      }
+      printf("%d instances built after pass %d\n", cache.num_builds,
+            pass + 1);
+   }
+
+   if(check)
+      printf("Check passed.\n");
+   else
+      printf("Check failed.\n");
+
+   /* Deallocate resources */
+   kt_release(&cache);
+   free(input);
+   free(output);
+   clReleaseMemObject(buffer);
+   clReleaseCommandQueue(queue);
+   clReleaseContext(context);
+   return 0;
+}
@@ -0,0 +1,335 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define M_PI 3.14159265358979323846
+
+#define PROGRAM_FILE "batch_math.cl"
+
+#define NUM_ELEMENTS 1048576
+#define VECTOR_WIDTH 8
+#define NUM_CHECKS 1000
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "program_binary.h"
+
+/* The kernels compiled for this machine by the Makefile */
+#ifdef PRECOMPILED
+#include "batch_math_binaries.h"
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   }
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);
+   }
+
+   return dev;
+}
+
+cl_mem create_buffer(cl_context ctx, cl_mem_flags flags, size_t size, void *data) {
+
+   cl_mem buffer;
+   int err;
+
+   buffer = clCreateBuffer(ctx, flags | (data ? CL_MEM_COPY_HOST_PTR : 0),
+         size, data, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);
+   };
+   return buffer;
+}
+
+cl_kernel create_kernel(cl_program program, const char* name) {
+
+   cl_kernel kernel;
+   int err;
+
+   kernel = clCreateKernel(program, name, &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   return kernel;
+}
+
+/* Run a 1D kernel to completion and return its execution time */
+cl_ulong run_kernel(cl_command_queue queue, cl_kernel kernel, size_t global_size) {
+
+   cl_event prof_event;
+   cl_ulong time_start, time_end;
+   int err;
+
+   err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_size,
+         NULL, 0, NULL, &prof_event);
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);
+   }
+   clWaitForEvents(1, &prof_event);
+   clGetEventProfilingInfo(prof_event, CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(prof_event, CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+   clReleaseEvent(prof_event);
+   return time_end - time_start;
+}
+
+void read_buffer(cl_command_queue queue, cl_mem buffer, size_t size, void *data) {
+
+   int err;
+
+   err = clEnqueueReadBuffer(queue, buffer, CL_TRUE, 0, size, data, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't read the buffer");
+      exit(1);
+   }
+}
+
+void report(const char* name, cl_ulong ns, size_t bytes, int check) {
+   printf("%-15s %10.3f ms %8.2f GB/s  Check %s.\n", name, ns * 1.0e-6,
+         (double)bytes/ns, check ? "passed" : "failed");
+}
+
+int main(int argc, char **argv) {
+
+   /* Host/device data structures */
+   cl_device_id device;
+   cl_context context;
+   cl_command_queue queue;
+   cl_program program;
+   cl_kernel kernel;
+   cl_int err;
+   char options[32];
+   size_t n, width, i, k, idx;
+   cl_uint plane;
+   cl_ulong ns;
+   int check;
+
+   /* Data and buffers */
+   float *polar, *rect, *r, *angle, *x, *y;
+   float *mat_aos, *vec_aos, *res_aos, *mat_soa, *vec_soa, *res_soa;
+   float transform[16], expected;
+   cl_mem in1, in2, out1, out2;
+
+   /* Round the batch up to a whole number of vectors */
+   n = argc > 1 ? (size_t)atol(argv[1]) : NUM_ELEMENTS;
+   width = argc > 2 ? (size_t)atol(argv[2]) : VECTOR_WIDTH;
+   if(width != 1 && width != 2 && width != 4 && width != 8 && width != 16) {
+      printf("The vector width must be 1, 2, 4, 8 or 16\n");
+      exit(1);
+   }
+   n = (n + width - 1)/width * width;
+   plane = (cl_uint)(n/width);
+   printf("%zu elements, vector width %zu\n", n, width);
+
+   /* Create a device, context and profiling queue */
+   device = create_device();
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);
+   }
+   queue = clCreateCommandQueue(context, device,
+         CL_QUEUE_PROFILING_ENABLE, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);
+   };
+   sprintf(options, "-DWIDTH=%zu", width);
+   program = program_load(context, device, PROGRAM_IMAGE(batch_math),
+         PROGRAM_FILE, options, NULL);
+
+   /* Polar coordinates in both layouts */
+   polar = (float*)malloc(2 * n * sizeof(float));
+   rect = (float*)malloc(2 * n * sizeof(float));
+   r = (float*)malloc(n * sizeof(float));
+   angle = (float*)malloc(n * sizeof(float));
+   x = (float*)malloc(n * sizeof(float));
+   y = (float*)malloc(n * sizeof(float));
+   srand(1);
+   for(i=0; i<n; i++) {
+      r[i] = polar[2*i] = 10.0f * rand()/RAND_MAX;
+      angle[i] = polar[2*i+1] = (float)(2*M_PI*rand()/RAND_MAX);
+   }
+
+   /* Array of structures */
+   kernel = create_kernel(program, "polar_rect_aos");
+   in1 = create_buffer(context, CL_MEM_READ_ONLY, 2*n*sizeof(float), polar);
+   out1 = create_buffer(context, CL_MEM_WRITE_ONLY, 2*n*sizeof(float), NULL);
+   clSetKernelArg(kernel, 0, sizeof(cl_mem), &in1);
+   clSetKernelArg(kernel, 1, sizeof(cl_mem), &out1);
+   ns = run_kernel(queue, kernel, n);
+   read_buffer(queue, out1, 2*n*sizeof(float), rect);
+   check = 1;
+   for(i=0; i<NUM_CHECKS; i++) {
+      idx = i * (n/NUM_CHECKS);
+      if(fabs(rect[2*idx] - r[idx]*cos(angle[idx])) > 1.0e-3 ||
+         fabs(rect[2*idx+1] - r[idx]*sin(angle[idx])) > 1.0e-3)
+         check = 0;
+   }
+   report("polar_rect_aos", ns, 4*n*sizeof(float), check);
+   clReleaseMemObject(in1);
+   clReleaseMemObject(out1);
+   clReleaseKernel(kernel);
+
+   /* Structure of arrays */
+   kernel = create_kernel(program, "polar_rect_soa");
+   in1 = create_buffer(context, CL_MEM_READ_ONLY, n*sizeof(float), r);
+   in2 = create_buffer(context, CL_MEM_READ_ONLY, n*sizeof(float), angle);
+   out1 = create_buffer(context, CL_MEM_WRITE_ONLY, n*sizeof(float), NULL);
+   out2 = create_buffer(context, CL_MEM_WRITE_ONLY, n*sizeof(float), NULL);
+   clSetKernelArg(kernel, 0, sizeof(cl_mem), &in1);
+   clSetKernelArg(kernel, 1, sizeof(cl_mem), &in2);
+   clSetKernelArg(kernel, 2, sizeof(cl_mem), &out1);
+   clSetKernelArg(kernel, 3, sizeof(cl_mem), &out2);
+   ns = run_kernel(queue, kernel, n/width);
+   read_buffer(queue, out1, n*sizeof(float), x);
+   read_buffer(queue, out2, n*sizeof(float), y);
+   check = 1;
+   for(i=0; i<NUM_CHECKS; i++) {
+      idx = i * (n/NUM_CHECKS);
+      if(fabs(x[idx] - r[idx]*cos(angle[idx])) > 1.0e-3 ||
+         fabs(y[idx] - r[idx]*sin(angle[idx])) > 1.0e-3)
+         check = 0;
+   }
+   report("polar_rect_soa", ns, 4*n*sizeof(float), check);
+   clReleaseMemObject(in1);
+   clReleaseMemObject(in2);
+   clReleaseMemObject(out1);
+   clReleaseMemObject(out2);
+   clReleaseKernel(kernel);
+   free(polar); free(rect); free(r); free(angle); free(x); free(y);
+
+   /* Batched 4x4 matrices and vectors in both layouts */
+   mat_aos = (float*)malloc(16 * n * sizeof(float));
+   vec_aos = (float*)malloc(4 * n * sizeof(float));
+   res_aos = (float*)malloc(4 * n * sizeof(float));
+   mat_soa = (float*)malloc(16 * n * sizeof(float));
+   vec_soa = (float*)malloc(4 * n * sizeof(float));
+   res_soa = (float*)malloc(4 * n * sizeof(float));
+   for(i=0; i<n; i++) {
+      for(k=0; k<16; k++) {
+         mat_aos[16*i + k] = mat_soa[k*n + i] = (float)rand()/RAND_MAX;
+      }
+      for(k=0; k<4; k++) {
+         vec_aos[4*i + k] = vec_soa[k*n + i] = (float)rand()/RAND_MAX;
+      }
+   }
+
+   kernel = create_kernel(program, "matvec_aos");
+   in1 = create_buffer(context, CL_MEM_READ_ONLY, 16*n*sizeof(float), mat_aos);
+   in2 = create_buffer(context, CL_MEM_READ_ONLY, 4*n*sizeof(float), vec_aos);
+   out1 = create_buffer(context, CL_MEM_WRITE_ONLY, 4*n*sizeof(float), NULL);
+   clSetKernelArg(kernel, 0, sizeof(cl_mem), &in1);
+   clSetKernelArg(kernel, 1, sizeof(cl_mem), &in2);
+   clSetKernelArg(kernel, 2, sizeof(cl_mem), &out1);
+   ns = run_kernel(queue, kernel, n);
+   read_buffer(queue, out1, 4*n*sizeof(float), res_aos);
+   clReleaseMemObject(in1);
+   clReleaseMemObject(in2);
+   clReleaseMemObject(out1);
+   clReleaseKernel(kernel);
+   check = 1;
+   for(i=0; i<NUM_CHECKS; i++) {
+      idx = i * (n/NUM_CHECKS);
+      for(k=0; k<4; k++) {
+         expected = mat_aos[16*idx + 4*k] * vec_aos[4*idx] +
+                    mat_aos[16*idx + 4*k + 1] * vec_aos[4*idx + 1] +
+                    mat_aos[16*idx + 4*k + 2] * vec_aos[4*idx + 2] +
+                    mat_aos[16*idx + 4*k + 3] * vec_aos[4*idx + 3];
+         if(fabs(res_aos[4*idx + k] - expected) > 1.0e-4)
+            check = 0;
+      }
+   }
+   report("matvec_aos", ns, 24*n*sizeof(float), check);
+
+   kernel = create_kernel(program, "matvec_soa");
+   in1 = create_buffer(context, CL_MEM_READ_ONLY, 16*n*sizeof(float), mat_soa);
+   in2 = create_buffer(context, CL_MEM_READ_ONLY, 4*n*sizeof(float), vec_soa);
+   out1 = create_buffer(context, CL_MEM_WRITE_ONLY, 4*n*sizeof(float), NULL);
+   clSetKernelArg(kernel, 0, sizeof(cl_mem), &in1);
+   clSetKernelArg(kernel, 1, sizeof(cl_mem), &in2);
+   clSetKernelArg(kernel, 2, sizeof(cl_mem), &out1);
+   clSetKernelArg(kernel, 3, sizeof(cl_uint), &plane);
+   ns = run_kernel(queue, kernel, n/width);
+   read_buffer(queue, out1, 4*n*sizeof(float), res_soa);
+   clReleaseMemObject(in1);
+   clReleaseMemObject(in2);
+   clReleaseMemObject(out1);
+   clReleaseKernel(kernel);
+   check = 1;
+   for(i=0; i<NUM_CHECKS; i++) {
+      idx = i * (n/NUM_CHECKS);
+      for(k=0; k<4; k++) {
+         if(fabs(res_soa[k*n + idx] - res_aos[4*idx + k]) > 1.0e-4)
+            check = 0;
+      }
+   }
+   report("matvec_soa", ns, 24*n*sizeof(float), check);
+
+   /* One shared transform applied to x, y, z planes */
+   for(k=0; k<16; k++) {
+      transform[k] = (float)rand()/RAND_MAX;
+   }
+   kernel = create_kernel(program, "transform_soa");
+   in1 = create_buffer(context, CL_MEM_READ_ONLY, sizeof(transform), transform);
+   in2 = create_buffer(context, CL_MEM_READ_ONLY, 3*n*sizeof(float), vec_soa);
+   out1 = create_buffer(context, CL_MEM_WRITE_ONLY, 3*n*sizeof(float), NULL);
+   clSetKernelArg(kernel, 0, sizeof(cl_mem), &in1);
+   clSetKernelArg(kernel, 1, sizeof(cl_mem), &in2);
+   clSetKernelArg(kernel, 2, sizeof(cl_mem), &out1);
+   clSetKernelArg(kernel, 3, sizeof(cl_uint), &plane);
+   ns = run_kernel(queue, kernel, n/width);
+   read_buffer(queue, out1, 3*n*sizeof(float), res_soa);
+   clReleaseMemObject(in1);
+   clReleaseMemObject(in2);
+   clReleaseMemObject(out1);
+   clReleaseKernel(kernel);
+   check = 1;
+   for(i=0; i<NUM_CHECKS; i++) {
+      idx = i * (n/NUM_CHECKS);
+      for(k=0; k<3; k++) {
+         expected = transform[4*k] * vec_soa[idx] +
+                    transform[4*k + 1] * vec_soa[n + idx] +
+                    transform[4*k + 2] * vec_soa[2*n + idx] + transform[4*k + 3];
+         if(fabs(res_soa[k*n + idx] - expected) > 1.0e-4)
+            check = 0;
+      }
+   }
+   report("transform_soa", ns, 6*n*sizeof(float), check);
+
+   /* Deallocate resources */
+   free(mat_aos); free(vec_aos); free(res_aos);
+   free(mat_soa); free(vec_soa); free(res_soa);
+   clReleaseCommandQueue(queue);
+   clReleaseProgram(program);
+   clReleaseContext(context);
+   return 0;
+}
@@ -0,0 +1,79 @@
+/* WIDTH is set by the host to 1, 2, 4, 8 or 16 */
+#ifndef WIDTH
+#define WIDTH 8
+#endif
+
+#define CAT(a, b) a##b
+#define XCAT(a, b) CAT(a, b)
+
+/* Each lane of a VEC holds an independent element */
+#if WIDTH == 1
+#define VEC float
+#else
+#define VEC XCAT(float, WIDTH)
+#endif
+
+/* Polar to rectangular, array of structures: one (r, angle) per item */
+__kernel void polar_rect_aos(__global float2 *polar, __global float2 *rect) {
+
+   float2 p = polar[get_global_id(0)];
+   float c, s;
+
+   s = sincos(p.y, &c);
+   rect[get_global_id(0)] = (float2)(p.x * c, p.x * s);
+}
+
+/* Polar to rectangular, structure of arrays: WIDTH points per item */
+__kernel void polar_rect_soa(__global VEC *r_vals, __global VEC *angles,
+                             __global VEC *x_coords, __global VEC *y_coords) {
+
+   size_t i = get_global_id(0);
+   VEC r = r_vals[i], c, s;
+
+   s = sincos(angles[i], &c);
+   x_coords[i] = r * c;
+   y_coords[i] = r * s;
+}
+
+/* One 4x4 row-major matrix times one vector per item */
+__kernel void matvec_aos(__global float16 *matrices, __global float4 *vectors,
+                         __global float4 *results) {
+
+   size_t i = get_global_id(0);
+   float16 m = matrices[i];
+   float4 v = vectors[i];
+
+   results[i] = (float4)(dot(m.s0123, v), dot(m.s4567, v),
+                         dot(m.s89ab, v), dot(m.scdef, v));
+}
+
+/* Matrix element (row, col) of every batch entry is stored in its own
+   plane, as are the vector and result components. plane is the number
+   of VECs per plane */
+__kernel void matvec_soa(__global VEC *matrices, __global VEC *vectors,
+                         __global VEC *results, uint plane) {
+
+   size_t i = get_global_id(0);
+   VEC v0 = vectors[i], v1 = vectors[plane + i],
+       v2 = vectors[2*plane + i], v3 = vectors[3*plane + i];
+
+   for(int row=0; row<4; row++) {
+      __global VEC *m = matrices + 4*row*plane + i;
+      results[row*plane + i] = m[0] * v0 + m[plane] * v1 +
+                               m[2*plane] * v2 + m[3*plane] * v3;
+   }
+}
+
+/* Transform every point by one shared 4x4 row-major matrix, w = 1.
+   Points are stored as x, y and z planes */
+__kernel void transform_soa(__constant float *matrix, __global VEC *points,
+                            __global VEC *results, uint plane) {
+
+   size_t i = get_global_id(0);
+   VEC x = points[i], y = points[plane + i], z = points[2*plane + i];
+
+   for(int row=0; row<3; row++) {
+      results[row*plane + i] = matrix[4*row] * x + matrix[4*row + 1] * y +
+                               matrix[4*row + 2] * z + matrix[4*row + 3];
+   }
+}
@@ -0,0 +1,156 @@
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "resample.h"
+
+static const char* filter_names[RESAMPLE_NUM_FILTERS] = {
+   "resample_bilinear", "resample_bicubic", "resample_lanczos"
+};
+
+void resample_engine_init(resample_engine *engine, cl_context ctx,
+      cl_device_id dev, cl_command_queue queue, const program_image *image,
+      const char* program_file, const cl_image_format *format) {
+
+   int i, err;
+
+   engine->context = ctx;
+   engine->device = dev;
+   engine->queue = queue;
+   engine->format = *format;
+   engine->program = program_load(ctx, dev, image, program_file, NULL, NULL);
+
+   for(i=0; i<RESAMPLE_NUM_FILTERS; i++) {
+      engine->filter[i] = clCreateKernel(engine->program, filter_names[i], &err);
+      if(err < 0) {
+         printf("Couldn't create a kernel: %d", err);
+         exit(1);
+      };
+   }
+   engine->downsample = clCreateKernel(engine->program, "downsample", &err);
+   if(err < 0) {
+      printf("Couldn't create a kernel: %d", err);
+      exit(1);
+   };
+}
+
+cl_mem resample_create_image(resample_engine *engine, cl_mem_flags flags,
+      size_t width, size_t height, void *host_ptr) {
+
+   cl_mem image;
+   int err;
+
+   image = clCreateImage2D(engine->context, flags, &engine->format,
+         width, height, 0, host_ptr, &err);
+   if(err < 0) {
+      perror("Couldn't create the image object");
+      exit(1);
+   };
+   return image;
+}
+
+/* Set the three arguments shared by every kernel and launch it */
+static void enqueue_image_kernel(resample_engine *engine, cl_kernel kernel,
+      cl_mem src, cl_mem dst, cl_float *param, size_t dst_width,
+      size_t dst_height, cl_uint num_events, const cl_event *wait_list,
+      cl_event *event) {
+
+   size_t global_size[2];
+   int err;
+
+   err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &src);
+   err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &dst);
+   err |= clSetKernelArg(kernel, 2, 2*sizeof(cl_float), param);
+   if(err < 0) {
+      printf("Couldn't set a kernel argument");
+      exit(1);
+   };
+
+   global_size[0] = dst_width; global_size[1] = dst_height;
+   err = clEnqueueNDRangeKernel(engine->queue, kernel, 2, NULL, global_size,
+         NULL, num_events, wait_list, event);
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);
+   }
+}
+
+void resample_enqueue_downsample(resample_engine *engine,
+      cl_mem src, cl_mem dst, size_t dst_width, size_t dst_height,
+      int halve_x, int halve_y,
+      cl_uint num_events, const cl_event *wait_list, cl_event *event) {
+
+   cl_float factor[2];
+
+   factor[0] = halve_x ? 2.0f : 1.0f;
+   factor[1] = halve_y ? 2.0f : 1.0f;
+   enqueue_image_kernel(engine, engine->downsample, src, dst, factor,
+         dst_width, dst_height, num_events, wait_list, event);
+}
+
+void resample_enqueue(resample_engine *engine, resample_filter filter,
+      cl_mem src, size_t src_width, size_t src_height,
+      cl_mem dst, size_t dst_width, size_t dst_height,
+      cl_uint num_events, const cl_event *wait_list, cl_event *event) {
+
+   cl_mem level, next;
+   cl_event level_event, next_event;
+   cl_float inv_scale[2];
+   size_t w = src_width, h = src_height, next_w, next_h;
+   int halve_x, halve_y, have_event = 0;
+
+   /* Prefilter: halve every axis that still shrinks by 2x or more */
+   level = src;
+   clRetainMemObject(level);
+   for(;;) {
+      halve_x = w >= 2*dst_width;
+      halve_y = h >= 2*dst_height;
+      if(!halve_x && !halve_y)
+         break;
+      next_w = halve_x ? (w + 1)/2 : w;
+      next_h = halve_y ? (h + 1)/2 : h;
+      next = resample_create_image(engine, CL_MEM_READ_WRITE, next_w, next_h, NULL);
+      if(have_event) {
+         resample_enqueue_downsample(engine, level, next, next_w, next_h,
+               halve_x, halve_y, 1, &level_event, &next_event);
+         clReleaseEvent(level_event);
+      }
+      else {
+         resample_enqueue_downsample(engine, level, next, next_w, next_h,
+               halve_x, halve_y, num_events, wait_list, &next_event);
+         have_event = 1;
+      }
+
+      /* The level is freed once the commands using it complete */
+      clReleaseMemObject(level);
+      level = next;
+      level_event = next_event;
+      w = next_w; h = next_h;
+   }
+
+   /* Final reconstruction, one output pixel per work-item */
+   inv_scale[0] = (cl_float)w/dst_width;
+   inv_scale[1] = (cl_float)h/dst_height;
+   if(have_event) {
+      enqueue_image_kernel(engine, engine->filter[filter], level, dst,
+            inv_scale, dst_width, dst_height, 1, &level_event, event);
+      clReleaseEvent(level_event);
+   }
+   else {
+      enqueue_image_kernel(engine, engine->filter[filter], level, dst,
+            inv_scale, dst_width, dst_height, num_events, wait_list, event);
+   }
+   clReleaseMemObject(level);
+}
+
+void resample_engine_release(resample_engine *engine) {
+
+   int i;
+
+   for(i=0; i<RESAMPLE_NUM_FILTERS; i++) {
+      clReleaseKernel(engine->filter[i]);
+   }
+   clReleaseKernel(engine->downsample);
+   clReleaseProgram(engine->program);
+}
@@ -0,0 +1,57 @@
+#ifndef RESAMPLE_H
+#define RESAMPLE_H
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "program_binary.h"
+
+/* Reconstruction filters */
+typedef enum {
+   RESAMPLE_BILINEAR,
+   RESAMPLE_BICUBIC,
+   RESAMPLE_LANCZOS,
+   RESAMPLE_NUM_FILTERS
+} resample_filter;
+
+typedef struct {
+   cl_context context;
+   cl_device_id device;
+   cl_command_queue queue;
+   cl_program program;
+   cl_kernel filter[RESAMPLE_NUM_FILTERS];
+   cl_kernel downsample;
+   cl_image_format format;
+} resample_engine;
+
+/* Load the resampling program from image, or build it from program_file
+   if image is NULL or doesn't load. All images share one format */
+void resample_engine_init(resample_engine *engine, cl_context ctx,
+      cl_device_id dev, cl_command_queue queue, const program_image *image,
+      const char* program_file, const cl_image_format *format);
+
+/* Create a 2D image in the engine's format */
+cl_mem resample_create_image(resample_engine *engine, cl_mem_flags flags,
+      size_t width, size_t height, void *host_ptr);
+
+/* Halve each axis flagged in halve_x/halve_y. dst must be
+   ceil(src/2) along the halved axes */
+void resample_enqueue_downsample(resample_engine *engine,
+      cl_mem src, cl_mem dst, size_t dst_width, size_t dst_height,
+      int halve_x, int halve_y,
+      cl_uint num_events, const cl_event *wait_list, cl_event *event);
+
+/* Resample src (src_width x src_height) into dst (dst_width x dst_height).
+   Axes shrinking by 2x or more are first prefiltered by repeated
+   halving so the final filter never spans more than twice its radius */
+void resample_enqueue(resample_engine *engine, resample_filter filter,
+      cl_mem src, size_t src_width, size_t src_height,
+      cl_mem dst, size_t dst_width, size_t dst_height,
+      cl_uint num_events, const cl_event *wait_list, cl_event *event);
+
+void resample_engine_release(resample_engine *engine);
+
+#endif
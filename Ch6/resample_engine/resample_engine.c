@@ -0,0 +1,245 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "resample_engine.cl"
+
+#define SCALE_X 2.5f
+#define SCALE_Y 2.5f
+
+#define CHECK_WIDTH 1000
+#define CHECK_HEIGHT 600
+
+#define PNG_DEBUG 3
+#include <png.h>
+
+#define INPUT_FILE "../interp/input.png"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "resample.h"
+
+/* The kernels compiled for this machine by the Makefile */
+#ifdef PRECOMPILED
+#include "resample_engine_binaries.h"
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   }
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);
+   }
+
+   return dev;
+}
+
+void read_image_data(const char* filename, png_bytep* data, size_t* w, size_t* h) {
+
+   int i;
+
+   /* Open input file */
+   FILE *png_input;
+   if((png_input = fopen(filename, "rb")) == NULL) {
+      perror("Can't read input image file");
+      exit(1);
+   }
+
+   /* Read image data */
+   png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+   png_infop info_ptr = png_create_info_struct(png_ptr);
+   png_init_io(png_ptr, png_input);
+   png_read_info(png_ptr, info_ptr);
+   *w = png_get_image_width(png_ptr, info_ptr);
+   *h = png_get_image_height(png_ptr, info_ptr);
+
+   /* PNG stores 16-bit samples big-endian */
+   png_set_swap(png_ptr);
+   png_read_update_info(png_ptr, info_ptr);
+
+   /* Allocate memory and read image data */
+   *data = malloc(*h * png_get_rowbytes(png_ptr, info_ptr));
+   for(i=0; i<*h; i++) {
+      png_read_row(png_ptr, *data + i * png_get_rowbytes(png_ptr, info_ptr), NULL);
+   }
+
+   /* Close input file */
+   png_read_end(png_ptr, info_ptr);
+   png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp)NULL);
+   fclose(png_input);
+}
+
+void write_image_data(const char* filename, png_bytep data, size_t w, size_t h) {
+
+   int i;
+
+   /* Open output file */
+   FILE *png_output;
+   if((png_output = fopen(filename, "wb")) == NULL) {
+      perror("Create output image file");
+      exit(1);
+   }
+
+   /* Write image data */
+   png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+   png_infop info_ptr = png_create_info_struct(png_ptr);
+   png_init_io(png_ptr, png_output);
+   png_set_IHDR(png_ptr, info_ptr, w, h, 16,
+         PNG_COLOR_TYPE_GRAY, PNG_INTERLACE_NONE,
+         PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
+   png_write_info(png_ptr, info_ptr);
+   png_set_swap(png_ptr);
+   for(i=0; i<h; i++) {
+      png_write_row(png_ptr, data + i * png_get_rowbytes(png_ptr, info_ptr));
+   }
+
+   /* Close file */
+   png_write_end(png_ptr, NULL);
+   png_destroy_write_struct(&png_ptr, &info_ptr);
+   fclose(png_output);
+}
+
+/* Read an image object into a host array */
+void read_image(cl_command_queue queue, cl_mem image, size_t w, size_t h, void *data) {
+
+   size_t origin[3], region[3];
+   int err;
+
+   origin[0] = 0; origin[1] = 0; origin[2] = 0;
+   region[0] = w; region[1] = h; region[2] = 1;
+   err = clEnqueueReadImage(queue, image, CL_TRUE, origin,
+         region, 0, 0, data, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't read from the image object");
+      exit(1);
+   }
+}
+
+int main(int argc, char **argv) {
+
+   /* Host/device data structures */
+   cl_device_id device;
+   cl_context context;
+   cl_command_queue queue;
+   cl_int err;
+   resample_engine engine;
+   const char* names[RESAMPLE_NUM_FILTERS] = {"bilinear", "bicubic", "lanczos"};
+   char output_file[64];
+
+   /* Image data */
+   cl_image_format png_format;
+   cl_mem input_image, output_image;
+   png_bytep input_pixels;
+   cl_ushort *output_pixels, *check_pixels;
+   size_t width, height, out_width, out_height, i;
+   float scale_x, scale_y, check_scales[2] = {0.07f, 2.3f};
+   int f, s, check;
+
+   scale_x = argc > 1 ? (float)atof(argv[1]) : SCALE_X;
+   scale_y = argc > 2 ? (float)atof(argv[2]) : (argc > 1 ? scale_x : SCALE_Y);
+
+   /* Open input file and read image data */
+   read_image_data(INPUT_FILE, &input_pixels, &width, &height);
+   out_width = (size_t)(width * scale_x + 0.5f);
+   out_height = (size_t)(height * scale_y + 0.5f);
+   if(out_width < 1) out_width = 1;
+   if(out_height < 1) out_height = 1;
+   output_pixels = (cl_ushort*)malloc(out_width * out_height * sizeof(cl_ushort));
+
+   /* Create a device and context */
+   device = create_device();
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);
+   }
+
+   /* Create a command queue */
+   queue = clCreateCommandQueue(context, device, 0, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);
+   };
+
+   /* Build the resampling program */
+   png_format.image_channel_order = CL_LUMINANCE;
+   png_format.image_channel_data_type = CL_UNORM_INT16;
+   resample_engine_init(&engine, context, device, queue,
+         PROGRAM_IMAGE(resample_engine), PROGRAM_FILE, &png_format);
+
+   /* Resample the input with every filter */
+   input_image = resample_create_image(&engine,
+         CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, width, height, input_pixels);
+   output_image = resample_create_image(&engine,
+         CL_MEM_WRITE_ONLY, out_width, out_height, NULL);
+   for(f=0; f<RESAMPLE_NUM_FILTERS; f++) {
+      resample_enqueue(&engine, f, input_image, width, height,
+            output_image, out_width, out_height, 0, NULL, NULL);
+      read_image(queue, output_image, out_width, out_height, output_pixels);
+      sprintf(output_file, "output_%s.png", names[f]);
+      write_image_data(output_file, (png_bytep)output_pixels, out_width, out_height);
+      printf("%s: %zux%zu -> %zux%zu, wrote %s\n", names[f],
+            width, height, out_width, out_height, output_file);
+   }
+   clReleaseMemObject(input_image);
+   clReleaseMemObject(output_image);
+
+   /* A constant image must stay constant at any scale */
+   out_width = (size_t)(CHECK_WIDTH * check_scales[1]);
+   out_height = (size_t)(CHECK_HEIGHT * check_scales[1]);
+   check_pixels = (cl_ushort*)malloc(out_width * out_height * sizeof(cl_ushort));
+   for(i=0; i<CHECK_WIDTH * CHECK_HEIGHT; i++) {
+      check_pixels[i] = 32768;
+   }
+   input_image = resample_create_image(&engine, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, CHECK_WIDTH, CHECK_HEIGHT, check_pixels);
+   check = 1;
+   for(s=0; s<2; s++) {
+      out_width = (size_t)(CHECK_WIDTH * check_scales[s]);
+      out_height = (size_t)(CHECK_HEIGHT * check_scales[s]);
+      output_image = resample_create_image(&engine,
+            CL_MEM_WRITE_ONLY, out_width, out_height, NULL);
+      for(f=0; f<RESAMPLE_NUM_FILTERS; f++) {
+         resample_enqueue(&engine, f, input_image, CHECK_WIDTH, CHECK_HEIGHT,
+               output_image, out_width, out_height, 0, NULL, NULL);
+         read_image(queue, output_image, out_width, out_height, check_pixels);
+         for(i=0; i<out_width * out_height; i++) {
+            if(abs(check_pixels[i] - 32768) > 2) {
+               check = 0;
+               break;
+            }
+         }
+      }
+      clReleaseMemObject(output_image);
+   }
+   if(check)
+      printf("Check passed.\n");
+   else
+      printf("Check failed.\n");
+
+   /* Deallocate resources */
+   free(input_pixels);
+   free(output_pixels);
+   free(check_pixels);
+   clReleaseMemObject(input_image);
+   resample_engine_release(&engine);
+   clReleaseCommandQueue(queue);
+   clReleaseContext(context);
+   return 0;
+}
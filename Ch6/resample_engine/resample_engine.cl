@@ -0,0 +1,130 @@
+#define BILINEAR 0
+#define BICUBIC 1
+#define LANCZOS 2
+
+/* Largest footprint per axis: Lanczos-3 widened 2x, plus rounding */
+#define MAX_TAPS 16
+
+constant sampler_t nearest = CLK_NORMALIZED_COORDS_FALSE
+   | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_NEAREST;
+
+constant sampler_t linear = CLK_NORMALIZED_COORDS_FALSE
+   | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_LINEAR;
+
+/* Filter radius in source pixels at a scale of 1 */
+float filter_radius(int filter) {
+   return filter == BILINEAR ? 1.0f : (filter == BICUBIC ? 2.0f : 3.0f);
+}
+
+/* Filter weight at distance x */
+float filter_weight(int filter, float x) {
+
+   x = fabs(x);
+   if(filter == BILINEAR) {
+      return max(0.0f, 1.0f - x);
+   }
+   else if(filter == BICUBIC) {
+
+      /* Catmull-Rom spline, a = -0.5 */
+      if(x < 1.0f)
+         return (1.5f*x - 2.5f)*x*x + 1.0f;
+      if(x < 2.0f)
+         return ((-0.5f*x + 2.5f)*x - 4.0f)*x + 2.0f;
+      return 0.0f;
+   }
+   else {
+
+      /* Lanczos-3 */
+      if(x < 1.0e-5f)
+         return 1.0f;
+      if(x >= 3.0f)
+         return 0.0f;
+      return 3.0f * sinpi(x) * sinpi(x/3.0f) / (M_PI_F*M_PI_F*x*x);
+   }
+}
+
+/* Compute one output pixel. inv_scale is source pixels per output pixel.
+   For downscaling the filter is widened by inv_scale so every source
+   pixel under the footprint contributes. */
+float4 resample_pixel(read_only image2d_t src, int filter, float2 inv_scale) {
+
+   float wx[MAX_TAPS];
+   float2 center, support, radius;
+   float4 sum = (float4)(0.0f);
+   float wy, weight_sum = 0.0f, wx_sum = 0.0f;
+   int x0, y0, nx, ny, i, j;
+
+   center = ((float2)(get_global_id(0), get_global_id(1)) + 0.5f) * inv_scale;
+   support = fmax(inv_scale, (float2)(1.0f));
+   radius = filter_radius(filter) * support;
+
+   /* Range of source pixels whose centers fall inside the footprint */
+   x0 = (int)floor(center.x - radius.x - 0.5f) + 1;
+   y0 = (int)floor(center.y - radius.y - 0.5f) + 1;
+   nx = min((int)floor(center.x + radius.x - 0.5f) - x0 + 1, MAX_TAPS);
+   ny = min((int)floor(center.y + radius.y - 0.5f) - y0 + 1, MAX_TAPS);
+
+   /* Horizontal weights are shared by every row */
+   for(i=0; i<nx; i++) {
+      wx[i] = filter_weight(filter, (x0 + i + 0.5f - center.x)/support.x);
+      wx_sum += wx[i];
+   }
+
+   for(j=0; j<ny; j++) {
+      wy = filter_weight(filter, (y0 + j + 0.5f - center.y)/support.y);
+      for(i=0; i<nx; i++) {
+         sum += wx[i] * wy * read_imagef(src, nearest, (int2)(x0 + i, y0 + j));
+      }
+      weight_sum += wy;
+   }
+
+   /* Normalize so the weights sum to one */
+   return sum / (weight_sum * wx_sum);
+}
+
+__kernel void resample_bilinear(read_only image2d_t src_image,
+                                write_only image2d_t dst_image,
+                                float2 inv_scale) {
+
+   int2 coord = (int2)(get_global_id(0), get_global_id(1));
+   float4 pixel;
+
+   /* Upscaling only needs one hardware-filtered fetch */
+   if(inv_scale.x <= 1.0f && inv_scale.y <= 1.0f)
+      pixel = read_imagef(src_image, linear,
+            ((float2)(coord.x, coord.y) + 0.5f) * inv_scale);
+   else
+      pixel = resample_pixel(src_image, BILINEAR, inv_scale);
+
+   write_imagef(dst_image, coord, pixel);
+}
+
+__kernel void resample_bicubic(read_only image2d_t src_image,
+                               write_only image2d_t dst_image,
+                               float2 inv_scale) {
+
+   int2 coord = (int2)(get_global_id(0), get_global_id(1));
+   write_imagef(dst_image, coord,
+         resample_pixel(src_image, BICUBIC, inv_scale));
+}
+
+__kernel void resample_lanczos(read_only image2d_t src_image,
+                               write_only image2d_t dst_image,
+                               float2 inv_scale) {
+
+   int2 coord = (int2)(get_global_id(0), get_global_id(1));
+   write_imagef(dst_image, coord,
+         resample_pixel(src_image, LANCZOS, inv_scale));
+}
+
+/* Mip-style prefilter: halve each axis whose factor is 2 by averaging
+   pixel pairs with a single linear fetch between their centers */
+__kernel void downsample(read_only image2d_t src_image,
+                         write_only image2d_t dst_image,
+                         float2 factor) {
+
+   int2 coord = (int2)(get_global_id(0), get_global_id(1));
+   float2 src_coord = ((float2)(coord.x, coord.y) + 0.5f) * factor;
+
+   write_imagef(dst_image, coord, read_imagef(src_image, linear, src_coord));
+}
@@ -0,0 +1,451 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "bench.cl"
+
+#define PEAK_ITERATIONS 256
+#define PEAK_COPY_SIZE (64 * 1048576)
+#define PEAK_ITEMS 1048576
+#define MAX_PLATFORMS 8
+
+#define NUM_WARMUPS 3
+#define NUM_REPETITIONS 20
+
+/* The kernels include device_lib.h or accumulate.h from Ch2/program_link */
+#define DEVICE_LIB_OPTION "-I../../Ch2/program_link"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+/* Find a device of the given type on any platform. With type 0, take a
+   GPU if there is one and a CPU otherwise */
+cl_device_id create_device(cl_device_type type) {
+
+   cl_platform_id platforms[MAX_PLATFORMS];
+   cl_device_id dev;
+   cl_uint num_platforms, i;
+   int err;
+
+   /* Identify the platforms */
+   err = clGetPlatformIDs(MAX_PLATFORMS, platforms, &num_platforms);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   }
+   if(num_platforms > MAX_PLATFORMS)
+      num_platforms = MAX_PLATFORMS;
+
+   /* Access a device */
+   for(i=0; i<num_platforms; i++) {
+      err = clGetDeviceIDs(platforms[i], type ? type : CL_DEVICE_TYPE_GPU,
+            1, &dev, NULL);
+      if(err == CL_SUCCESS)
+         return dev;
+   }
+   for(i=0; i<num_platforms && !type; i++) {
+      err = clGetDeviceIDs(platforms[i], CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+      if(err == CL_SUCCESS)
+         return dev;
+   }
+   perror("Couldn't access any devices");
+   exit(1);
+}
+
+/* Create program from a file and compile it. Returns NULL if the
+   program doesn't build for this device */
+cl_program build_program(cl_context ctx, cl_device_id dev,
+      const char* filename, const char* options) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer, *program_log;
+   size_t program_size, log_size;
+   int err;
+
+   /* Read program file and place content into buffer */
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   /* Create program from file */
+   program = clCreateProgramWithSource(ctx, 1,
+      (const char**)&program_buffer, &program_size, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   free(program_buffer);
+
+   /* Build program */
+   err = clBuildProgram(program, 0, NULL, options, NULL, NULL);
+   if(err < 0) {
+
+      /* Find size of log and print to std output */
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG,
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG,
+            log_size + 1, program_log, NULL);
+      printf("%s\n", program_log);
+      free(program_log);
+      clReleaseProgram(program);
+      return NULL;
+   }
+
+   return program;
+}
+
+void bench_kernel(bench_run *run, cl_kernel kernel, cl_uint dim,
+      const size_t *global_size, const size_t *local_size) {
+
+   cl_event event;
+   cl_int err;
+
+   err = clEnqueueNDRangeKernel(run->queue, kernel, dim, NULL, global_size,
+         local_size, 0, NULL, &event);
+   if(err < 0) {
+      printf("Couldn't enqueue the kernel: %d\n", err);
+      exit(1);
+   }
+
+   /* Only the first and last events are needed */
+   if(run->first == NULL) {
+      run->first = event;
+   }
+   else {
+      if(run->last != NULL)
+         clReleaseEvent(run->last);
+      run->last = event;
+   }
+}
+
+static int compare_times(const void *a, const void *b) {
+   double x = *(const double*)a, y = *(const double*)b;
+   return (x > y) - (x < y);
+}
+
+/* Time warmups + reps repetitions of a case and sort the times, in
+   milliseconds */
+static void time_case(const bench_case *c, void *state, cl_command_queue queue,
+      int warmups, int reps, double *times) {
+
+   bench_run run;
+   cl_ulong time_start, time_end;
+   int i;
+
+   run.queue = queue;
+   for(i=0; i<warmups + reps; i++) {
+      if(c->prepare != NULL) {
+         c->prepare(state, queue);
+      }
+      clFinish(queue);
+
+      run.first = NULL;
+      run.last = NULL;
+      c->run(state, &run);
+      clFinish(queue);
+
+      clGetEventProfilingInfo(run.first, CL_PROFILING_COMMAND_START,
+            sizeof(time_start), &time_start, NULL);
+      clGetEventProfilingInfo(run.last ? run.last : run.first,
+            CL_PROFILING_COMMAND_END, sizeof(time_end), &time_end, NULL);
+      clReleaseEvent(run.first);
+      if(run.last != NULL)
+         clReleaseEvent(run.last);
+
+      if(i >= warmups)
+         times[i - warmups] = (time_end - time_start) * 1.0e-6;
+   }
+   qsort(times, reps, sizeof(double), compare_times);
+}
+
+/* Nearest-rank percentile of sorted times */
+static double percentile(const double *times, int reps, double p) {
+   int rank = (int)ceil(p * reps) - 1;
+   return times[rank < 0 ? 0 : rank];
+}
+
+/* Peak bandwidth in GB/s and peak arithmetic in GFLOP/s, both
+   measured with the kernels in bench.cl */
+static void measure_peaks(const bench_env *env, int warmups, int reps,
+      double *peak_gbps, double *peak_gflops) {
+
+   cl_program program;
+   cl_kernel copy_kernel, mad_kernel;
+   cl_mem src_buffer, dst_buffer;
+   cl_ulong max_alloc;
+   size_t copy_size, global_size;
+   char options[64];
+   double *times;
+   float a = 0.999f, b = 0.001f;
+   bench_run run;
+   cl_ulong time_start, time_end;
+   int i, k;
+   cl_int err;
+
+   sprintf(options, "-DPEAK_ITERATIONS=%d", PEAK_ITERATIONS);
+   program = build_program(env->context, env->device, PROGRAM_FILE, options);
+   if(program == NULL) {
+      exit(1);
+   }
+   copy_kernel = clCreateKernel(program, "peak_copy", &err);
+   if(err == CL_SUCCESS)
+      mad_kernel = clCreateKernel(program, "peak_mad", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+
+   clGetDeviceInfo(env->device, CL_DEVICE_MAX_MEM_ALLOC_SIZE,
+         sizeof(max_alloc), &max_alloc, NULL);
+   copy_size = PEAK_COPY_SIZE;
+   while(copy_size > max_alloc)
+      copy_size /= 2;
+   src_buffer = clCreateBuffer(env->context, CL_MEM_READ_WRITE,
+         copy_size, NULL, &err);
+   dst_buffer = clCreateBuffer(env->context, CL_MEM_READ_WRITE,
+         copy_size > PEAK_ITEMS * 16 ? copy_size : PEAK_ITEMS * 16, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);
+   };
+
+   err = clSetKernelArg(copy_kernel, 0, sizeof(cl_mem), &src_buffer);
+   err |= clSetKernelArg(copy_kernel, 1, sizeof(cl_mem), &dst_buffer);
+   err |= clSetKernelArg(mad_kernel, 0, sizeof(cl_mem), &dst_buffer);
+   err |= clSetKernelArg(mad_kernel, 1, sizeof(float), &a);
+   err |= clSetKernelArg(mad_kernel, 2, sizeof(float), &b);
+   if(err < 0) {
+      printf("Couldn't set a kernel argument");
+      exit(1);
+   };
+
+   /* Best of the repetitions for each kernel */
+   times = (double*)malloc(reps * sizeof(double));
+   run.queue = env->queue;
+   for(k=0; k<2; k++) {
+      global_size = k == 0 ? copy_size/16 : PEAK_ITEMS;
+      for(i=0; i<warmups + reps; i++) {
+         run.first = NULL;
+         run.last = NULL;
+         bench_kernel(&run, k == 0 ? copy_kernel : mad_kernel, 1,
+               &global_size, NULL);
+         clFinish(env->queue);
+         clGetEventProfilingInfo(run.first, CL_PROFILING_COMMAND_START,
+               sizeof(time_start), &time_start, NULL);
+         clGetEventProfilingInfo(run.first, CL_PROFILING_COMMAND_END,
+               sizeof(time_end), &time_end, NULL);
+         clReleaseEvent(run.first);
+         if(i >= warmups)
+            times[i - warmups] = (time_end - time_start) * 1.0e-9;
+      }
+      qsort(times, reps, sizeof(double), compare_times);
+      if(k == 0)
+         *peak_gbps = 2.0 * copy_size / times[0] * 1.0e-9;
+      else
+         *peak_gflops = 32.0 * PEAK_ITERATIONS * PEAK_ITEMS / times[0] * 1.0e-9;
+   }
+
+   free(times);
+   clReleaseMemObject(src_buffer);
+   clReleaseMemObject(dst_buffer);
+   clReleaseKernel(copy_kernel);
+   clReleaseKernel(mad_kernel);
+   clReleaseProgram(program);
+}
+
+/* Write a string as a JSON value */
+static void json_string(FILE *f, const char *s) {
+   fputc('"', f);
+   for(; *s; s++) {
+      if(*s == '"' || *s == '\\')
+         fputc('\\', f);
+      if((unsigned char)*s >= ' ')
+         fputc(*s, f);
+   }
+   fputc('"', f);
+}
+
+static void usage(void) {
+   printf("Usage: bench [-cpu | -gpu] [-k kernel] [-r repetitions] "
+          "[-w warmups] [-q] [-j file.json]\n");
+   printf("  -q runs only the three smallest sizes of each kernel\n");
+   exit(1);
+}
+
+int main(int argc, char **argv) {
+
+   /* Host/device data structures */
+   bench_env env;
+   cl_device_type type = 0;
+   cl_program program;
+   cl_int err;
+   char device_name[256], driver_version[256];
+
+   /* Options */
+   const char *only_kernel = NULL, *json_file = NULL;
+   int warmups = NUM_WARMUPS, reps = NUM_REPETITIONS, quick = 0;
+
+   /* Results */
+   const bench_case *c;
+   bench_work work;
+   void *state;
+   FILE *json = NULL;
+   double *times, peak_gbps, peak_gflops, median, gbps, gflops, bound;
+   int i, j, first_result = 1;
+
+   for(i=1; i<argc; i++) {
+      if(!strcmp(argv[i], "-cpu"))
+         type = CL_DEVICE_TYPE_CPU;
+      else if(!strcmp(argv[i], "-gpu"))
+         type = CL_DEVICE_TYPE_GPU;
+      else if(!strcmp(argv[i], "-q"))
+         quick = 1;
+      else if(!strcmp(argv[i], "-k") && i+1 < argc)
+         only_kernel = argv[++i];
+      else if(!strcmp(argv[i], "-r") && i+1 < argc)
+         reps = atoi(argv[++i]);
+      else if(!strcmp(argv[i], "-w") && i+1 < argc)
+         warmups = atoi(argv[++i]);
+      else if(!strcmp(argv[i], "-j") && i+1 < argc)
+         json_file = argv[++i];
+      else
+         usage();
+   }
+   if(reps < 1 || warmups < 0)
+      usage();
+
+   /* Create a device, context and profiling queue */
+   env.device = create_device(type);
+   env.context = clCreateContext(NULL, 1, &env.device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);
+   }
+   env.queue = clCreateCommandQueue(env.context, env.device,
+         CL_QUEUE_PROFILING_ENABLE, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);
+   };
+   clGetDeviceInfo(env.device, CL_DEVICE_NAME,
+         sizeof(device_name), device_name, NULL);
+   clGetDeviceInfo(env.device, CL_DRIVER_VERSION,
+         sizeof(driver_version), driver_version, NULL);
+
+   measure_peaks(&env, warmups, reps, &peak_gbps, &peak_gflops);
+   printf("Device: %s (driver %s)\n", device_name, driver_version);
+   printf("Peak: %.1f GB/s, %.1f GFLOP/s\n\n", peak_gbps, peak_gflops);
+   printf("%-16s %10s %-7s %10s %10s %9s %9s %7s\n", "kernel", "size",
+         "unit", "median ms", "p99 ms", "GB/s", "GFLOP/s", "roof %");
+
+   if(json_file != NULL) {
+      json = fopen(json_file, "w");
+      if(json == NULL) {
+         perror("Couldn't open the JSON file");
+         exit(1);
+      }
+      fprintf(json, "{\n  \"device\": ");
+      json_string(json, device_name);
+      fprintf(json, ",\n  \"driver\": ");
+      json_string(json, driver_version);
+      fprintf(json, ",\n  \"warmups\": %d,\n  \"repetitions\": %d,\n",
+            warmups, reps);
+      fprintf(json, "  \"peak_gbps\": %.3f,\n  \"peak_gflops\": %.3f,\n",
+            peak_gbps, peak_gflops);
+      fprintf(json, "  \"results\": [");
+   }
+
+   times = (double*)malloc(reps * sizeof(double));
+   for(i=0; i<bench_num_cases; i++) {
+      c = &bench_cases[i];
+      if(only_kernel != NULL && strcmp(only_kernel, c->name))
+         continue;
+
+      program = build_program(env.context, env.device, c->program_file,
+            DEVICE_LIB_OPTION);
+      if(program == NULL) {
+         printf("%-16s couldn't build %s, skipped\n", c->name, c->program_file);
+         continue;
+      }
+
+      for(j=0; j<BENCH_MAX_SIZES && c->sizes[j] && !(quick && j >= 3); j++) {
+         if(json != NULL) {
+            fprintf(json, "%s\n    {\"kernel\": \"%s\", \"size\": %zu, "
+                  "\"unit\": \"%s\", ", first_result ? "" : ",",
+                  c->name, c->sizes[j], c->size_unit);
+            first_result = 0;
+         }
+
+         state = c->setup(&env, program, c->sizes[j], &work);
+         if(state == NULL) {
+            printf("%-16s %10zu %-7s not supported on this device\n",
+                  c->name, c->sizes[j], c->size_unit);
+            if(json != NULL)
+               fprintf(json, "\"skipped\": true}");
+            continue;
+         }
+         time_case(c, state, env.queue, warmups, reps, times);
+         c->release(state);
+
+         /* Roofline: the lower of the compute and bandwidth ceilings
+            at this arithmetic intensity */
+         median = percentile(times, reps, 0.5);
+         gbps = work.bytes / median * 1.0e-6;
+         gflops = work.flops / median * 1.0e-6;
+         if(work.flops > 0) {
+            bound = work.flops/work.bytes * peak_gbps;
+            if(bound > peak_gflops)
+               bound = peak_gflops;
+            bound = gflops/bound;
+         }
+         else {
+            bound = gbps/peak_gbps;
+         }
+
+         printf("%-16s %10zu %-7s %10.3f %10.3f %9.2f ", c->name,
+               c->sizes[j], c->size_unit, median,
+               percentile(times, reps, 0.99), gbps);
+         if(work.flops > 0)
+            printf("%9.2f %7.1f\n", gflops, 100.0 * bound);
+         else
+            printf("%9s %7.1f\n", "-", 100.0 * bound);
+
+         if(json != NULL) {
+            fprintf(json, "\"min_ms\": %.6f, \"median_ms\": %.6f, "
+                  "\"p99_ms\": %.6f, \"bytes\": %.0f, \"flops\": %.0f, "
+                  "\"gbps\": %.3f, ", times[0], median,
+                  percentile(times, reps, 0.99), work.bytes, work.flops, gbps);
+            if(work.flops > 0)
+               fprintf(json, "\"gflops\": %.3f, ", gflops);
+            else
+               fprintf(json, "\"gflops\": null, ");
+            fprintf(json, "\"roofline\": %.4f}", bound);
+         }
+      }
+      clReleaseProgram(program);
+   }
+
+   if(json != NULL) {
+      fprintf(json, "\n  ]\n}\n");
+      fclose(json);
+   }
+
+   /* Deallocate resources */
+   free(times);
+   clReleaseCommandQueue(env.queue);
+   clReleaseContext(env.context);
+   return 0;
+}
@@ -0,0 +1,24 @@
+/* PEAK_ITERATIONS is set by the host */
+#ifndef PEAK_ITERATIONS
+#define PEAK_ITERATIONS 256
+#endif
+
+/* Device bandwidth: read and write every element once */
+__kernel void peak_copy(__global float4 *src, __global float4 *dst) {
+   dst[get_global_id(0)] = src[get_global_id(0)];
+}
+
+/* Device arithmetic: four independent chains of float4 mads */
+__kernel void peak_mad(__global float4 *out, float a, float b) {
+
+   float4 x = (float4)(get_global_id(0));
+   float4 y = x + 1.0f, z = x + 2.0f, w = x + 3.0f;
+
+   for(int i=0; i<PEAK_ITERATIONS; i++) {
+      x = mad(x, a, b);
+      y = mad(y, a, b);
+      z = mad(z, a, b);
+      w = mad(w, a, b);
+   }
+   out[get_global_id(0)] = x + y + z + w;
+}
@@ -0,0 +1,60 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#define BENCH_MAX_SIZES 16
+
+/* The device the cases run on */
+typedef struct bench_env {
+   cl_context context;
+   cl_device_id device;
+   cl_command_queue queue;
+} bench_env;
+
+/* Commands enqueued by one repetition. Its time runs from the start
+   of the first command to the end of the last */
+typedef struct bench_run {
+   cl_command_queue queue;
+   cl_event first, last;
+} bench_run;
+
+/* Memory traffic and arithmetic of one repetition. flops is 0 for
+   kernels that don't do floating-point work, such as the sorts */
+typedef struct bench_work {
+   double bytes;
+   double flops;
+} bench_work;
+
+typedef struct bench_case {
+   const char *name;
+   const char *program_file;
+   const char *size_unit;
+   size_t sizes[BENCH_MAX_SIZES];         /* Zero-terminated */
+
+   /* Create buffers and kernels for size n and fill in work.
+      Returns NULL if the size can't run on this device */
+   void* (*setup)(const bench_env *env, cl_program program,
+                  size_t n, bench_work *work);
+
+   /* Untimed, before every repetition. May be NULL */
+   void (*prepare)(void *state, cl_command_queue queue);
+
+   /* Enqueue one repetition with bench_kernel */
+   void (*run)(void *state, bench_run *run);
+
+   void (*release)(void *state);
+} bench_case;
+
+extern const bench_case bench_cases[];
+extern const int bench_num_cases;
+
+/* Enqueue a kernel as part of a timed repetition */
+void bench_kernel(bench_run *run, cl_kernel kernel, cl_uint dim,
+      const size_t *global_size, const size_t *local_size);
+
+#endif
@@ -0,0 +1,823 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define TEXT_FILE "../../Ch11/string_search/kafka.txt"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+
+static void check_err(cl_int err, const char *msg) {
+   if(err < 0) {
+      printf("%s: %d\n", msg, err);
+      exit(1);
+   }
+}
+
+static cl_kernel create_kernel(cl_program program, const char *name) {
+
+   cl_kernel kernel;
+   cl_int err;
+
+   kernel = clCreateKernel(program, name, &err);
+   if(err < 0) {
+      printf("Couldn't create the %s kernel: %d\n", name, err);
+      exit(1);
+   }
+   return kernel;
+}
+
+static cl_mem create_buffer(const bench_env *env, cl_mem_flags flags,
+      size_t size, void *host_ptr) {
+
+   cl_mem buffer;
+   cl_int err;
+
+   buffer = clCreateBuffer(env->context, flags, size, host_ptr, &err);
+   check_err(err, "Couldn't create a buffer");
+   return buffer;
+}
+
+static void write_buffer(cl_command_queue queue, cl_mem buffer,
+      size_t size, const void *data) {
+   check_err(clEnqueueWriteBuffer(queue, buffer, CL_TRUE, 0, size, data,
+         0, NULL, NULL), "Couldn't write the buffer");
+}
+
+/* Largest work-group size the kernel supports, rounded down to a
+   power of two */
+static size_t kernel_group_size(const bench_env *env, cl_kernel kernel) {
+
+   size_t size, p = 1;
+
+   check_err(clGetKernelWorkGroupInfo(kernel, env->device,
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(size), &size, NULL),
+         "Couldn't read the work-group size");
+   while(2*p <= size)
+      p *= 2;
+   return p;
+}
+
+static cl_ulong local_mem_size(const bench_env *env) {
+
+   cl_ulong size;
+
+   clGetDeviceInfo(env->device, CL_DEVICE_LOCAL_MEM_SIZE,
+         sizeof(size), &size, NULL);
+   return size;
+}
+
+static float* random_floats(size_t n) {
+
+   float *data = (float*)malloc(n * sizeof(float));
+   size_t i;
+
+   for(i=0; i<n; i++) {
+      data[i] = 2.0f * rand()/RAND_MAX - 1.0f;
+   }
+   return data;
+}
+
+/* reduction: one partial sum per work-group */
+
+typedef struct reduction_state {
+   cl_kernel kernel;
+   cl_mem data_buffer, sum_buffer;
+   size_t global_size, local_size;
+} reduction_state;
+
+static void* reduction_setup(const bench_env *env, cl_program program,
+      size_t n, bench_work *work, int vector) {
+
+   reduction_state *s = (reduction_state*)malloc(sizeof(reduction_state));
+   float *data;
+   size_t width = vector ? 4 : 1, num_groups;
+   cl_int err;
+
+   s->kernel = create_kernel(program,
+         vector ? "reduction_vector" : "reduction_scalar");
+   s->global_size = n/width;
+   s->local_size = kernel_group_size(env, s->kernel);
+   while(s->local_size * width * sizeof(float) > local_mem_size(env))
+      s->local_size /= 2;
+   if(s->local_size > s->global_size)
+      s->local_size = s->global_size;
+   num_groups = s->global_size/s->local_size;
+
+   data = random_floats(n);
+   s->data_buffer = create_buffer(env, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, n * sizeof(float), data);
+   s->sum_buffer = create_buffer(env, CL_MEM_READ_WRITE,
+         num_groups * sizeof(float), NULL);
+   free(data);
+
+   err = clSetKernelArg(s->kernel, 0, sizeof(cl_mem), &s->data_buffer);
+   err |= clSetKernelArg(s->kernel, 1,
+         s->local_size * width * sizeof(float), NULL);
+   err |= clSetKernelArg(s->kernel, 2, sizeof(cl_mem), &s->sum_buffer);
+   check_err(err, "Couldn't set a kernel argument");
+
+   work->bytes = (n + num_groups) * sizeof(float);
+   work->flops = n;
+   return s;
+}
+
+static void* reduction_scalar_setup(const bench_env *env, cl_program program,
+      size_t n, bench_work *work) {
+   return reduction_setup(env, program, n, work, 0);
+}
+
+static void* reduction_vector_setup(const bench_env *env, cl_program program,
+      size_t n, bench_work *work) {
+   return reduction_setup(env, program, n, work, 1);
+}
+
+static void reduction_run(void *state, bench_run *run) {
+   reduction_state *s = (reduction_state*)state;
+   bench_kernel(run, s->kernel, 1, &s->global_size, &s->local_size);
+}
+
+static void reduction_release(void *state) {
+   reduction_state *s = (reduction_state*)state;
+   clReleaseMemObject(s->data_buffer);
+   clReleaseMemObject(s->sum_buffer);
+   clReleaseKernel(s->kernel);
+   free(s);
+}
+
+/* bsort: the same launch sequence as Ch11/bsort */
+
+typedef struct bsort_state {
+   cl_kernel init, stage_0, stage_n, merge, merge_last;
+   cl_mem data_buffer;
+   float *data;
+   size_t n, global_size, local_size;
+} bsort_state;
+
+static void* bsort_setup(const bench_env *env, cl_program program,
+      size_t n, bench_work *work) {
+
+   bsort_state *s = (bsort_state*)malloc(sizeof(bsort_state));
+   cl_kernel kernels[5];
+   cl_uint stage, high_stage, num_stages, launches;
+   int i, direction = 0;
+   cl_int err = 0;
+
+   s->init = kernels[0] = create_kernel(program, "bsort_init");
+   s->stage_0 = kernels[1] = create_kernel(program, "bsort_stage_0");
+   s->stage_n = kernels[2] = create_kernel(program, "bsort_stage_n");
+   s->merge = kernels[3] = create_kernel(program, "bsort_merge");
+   s->merge_last = kernels[4] = create_kernel(program, "bsort_merge_last");
+
+   s->n = n;
+   s->global_size = n/8;
+   s->local_size = kernel_group_size(env, s->init);
+   while(8 * s->local_size * sizeof(float) > local_mem_size(env))
+      s->local_size /= 2;
+   if(s->global_size < s->local_size)
+      s->local_size = s->global_size;
+
+   s->data = random_floats(n);
+   s->data_buffer = create_buffer(env, CL_MEM_READ_WRITE,
+         n * sizeof(float), NULL);
+
+   for(i=0; i<5; i++) {
+      err |= clSetKernelArg(kernels[i], 0, sizeof(cl_mem), &s->data_buffer);
+      err |= clSetKernelArg(kernels[i], 1,
+            8 * s->local_size * sizeof(float), NULL);
+   }
+   err |= clSetKernelArg(s->merge, 3, sizeof(int), &direction);
+   err |= clSetKernelArg(s->merge_last, 2, sizeof(int), &direction);
+   check_err(err, "Couldn't set a kernel argument");
+
+   /* Every launch reads and writes the whole array */
+   num_stages = (cl_uint)(s->global_size/s->local_size);
+   launches = 2;
+   for(high_stage = 2; high_stage < num_stages; high_stage <<= 1) {
+      for(stage = high_stage; stage > 1; stage >>= 1)
+         launches++;
+      launches++;
+   }
+   for(stage = num_stages; stage > 1; stage >>= 1)
+      launches++;
+   work->bytes = 2.0 * launches * n * sizeof(float);
+   work->flops = 0;
+   return s;
+}
+
+static void bsort_prepare(void *state, cl_command_queue queue) {
+   bsort_state *s = (bsort_state*)state;
+   write_buffer(queue, s->data_buffer, s->n * sizeof(float), s->data);
+}
+
+static void bsort_run(void *state, bench_run *run) {
+
+   bsort_state *s = (bsort_state*)state;
+   cl_uint stage, high_stage, num_stages;
+
+   bench_kernel(run, s->init, 1, &s->global_size, &s->local_size);
+
+   num_stages = (cl_uint)(s->global_size/s->local_size);
+   for(high_stage = 2; high_stage < num_stages; high_stage <<= 1) {
+      clSetKernelArg(s->stage_0, 2, sizeof(int), &high_stage);
+      clSetKernelArg(s->stage_n, 3, sizeof(int), &high_stage);
+      for(stage = high_stage; stage > 1; stage >>= 1) {
+         clSetKernelArg(s->stage_n, 2, sizeof(int), &stage);
+         bench_kernel(run, s->stage_n, 1, &s->global_size, &s->local_size);
+      }
+      bench_kernel(run, s->stage_0, 1, &s->global_size, &s->local_size);
+   }
+
+   for(stage = num_stages; stage > 1; stage >>= 1) {
+      clSetKernelArg(s->merge, 2, sizeof(int), &stage);
+      bench_kernel(run, s->merge, 1, &s->global_size, &s->local_size);
+   }
+   bench_kernel(run, s->merge_last, 1, &s->global_size, &s->local_size);
+}
+
+static void bsort_release(void *state) {
+   bsort_state *s = (bsort_state*)state;
+   clReleaseMemObject(s->data_buffer);
+   clReleaseKernel(s->init);
+   clReleaseKernel(s->stage_0);
+   clReleaseKernel(s->stage_n);
+   clReleaseKernel(s->merge);
+   clReleaseKernel(s->merge_last);
+   free(s->data);
+   free(s);
+}
+
+/* radix_sort8: one ushort8 per work-item */
+
+typedef struct radix_state {
+   cl_kernel kernel;
+   cl_mem data_buffer;
+   cl_ushort *data;
+   size_t n, global_size;
+} radix_state;
+
+static void* radix_setup(const bench_env *env, cl_program program,
+      size_t n, bench_work *work) {
+
+   radix_state *s = (radix_state*)malloc(sizeof(radix_state));
+   size_t i;
+
+   s->kernel = create_kernel(program, "radix_sort8");
+   s->n = n;
+   s->global_size = n/8;
+   s->data = (cl_ushort*)malloc(n * sizeof(cl_ushort));
+   for(i=0; i<n; i++) {
+      s->data[i] = (cl_ushort)(rand() & 7);
+   }
+   s->data_buffer = create_buffer(env, CL_MEM_READ_WRITE,
+         n * sizeof(cl_ushort), NULL);
+   check_err(clSetKernelArg(s->kernel, 0, sizeof(cl_mem), &s->data_buffer),
+         "Couldn't set a kernel argument");
+
+   work->bytes = 2.0 * n * sizeof(cl_ushort);
+   work->flops = 0;
+   return s;
+}
+
+static void radix_prepare(void *state, cl_command_queue queue) {
+   radix_state *s = (radix_state*)state;
+   write_buffer(queue, s->data_buffer, s->n * sizeof(cl_ushort), s->data);
+}
+
+static void radix_run(void *state, bench_run *run) {
+   radix_state *s = (radix_state*)state;
+   bench_kernel(run, s->kernel, 1, &s->global_size, NULL);
+}
+
+static void radix_release(void *state) {
+   radix_state *s = (radix_state*)state;
+   clReleaseMemObject(s->data_buffer);
+   clReleaseKernel(s->kernel);
+   free(s->data);
+   free(s);
+}
+
+/* string_search: Kafka's text repeated to n characters */
+
+typedef struct search_state {
+   cl_kernel kernel;
+   cl_mem text_buffer, result_buffer;
+   size_t global_size, local_size;
+} search_state;
+
+static void* search_setup(const bench_env *env, cl_program program,
+      size_t n, bench_work *work) {
+
+   search_state *s = (search_state*)malloc(sizeof(search_state));
+   char pattern[16] = "thatwithhavefrom", *source, *text;
+   FILE *text_handle;
+   size_t source_size, text_size, i;
+   cl_uint num_units;
+   int chars_per_item;
+   cl_int err;
+
+   s->kernel = create_kernel(program, "string_search");
+
+   /* Same execution parameters as Ch11/string_search */
+   clGetDeviceInfo(env->device, CL_DEVICE_MAX_COMPUTE_UNITS,
+         sizeof(num_units), &num_units, NULL);
+   s->local_size = kernel_group_size(env, s->kernel);
+   s->global_size = num_units * s->local_size;
+   chars_per_item = (int)(n/s->global_size + 1);
+
+   text_handle = fopen(TEXT_FILE, "r");
+   if(text_handle == NULL) {
+      perror("Couldn't find the text file");
+      exit(1);
+   }
+   fseek(text_handle, 0, SEEK_END);
+   source_size = ftell(text_handle);
+   rewind(text_handle);
+   source = (char*)malloc(source_size);
+   source_size = fread(source, sizeof(char), source_size, text_handle);
+   fclose(text_handle);
+
+   /* The last work-item reads 16 characters past its range */
+   text_size = s->global_size * chars_per_item + 16;
+   text = (char*)calloc(text_size, sizeof(char));
+   for(i=0; i<n; i++) {
+      text[i] = source[i % source_size];
+   }
+   free(source);
+
+   s->text_buffer = create_buffer(env, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, text_size, text);
+   s->result_buffer = create_buffer(env, CL_MEM_READ_WRITE,
+         4 * sizeof(int), NULL);
+   free(text);
+
+   err = clSetKernelArg(s->kernel, 0, sizeof(pattern), pattern);
+   err |= clSetKernelArg(s->kernel, 1, sizeof(cl_mem), &s->text_buffer);
+   err |= clSetKernelArg(s->kernel, 2, sizeof(chars_per_item), &chars_per_item);
+   err |= clSetKernelArg(s->kernel, 3, 4 * sizeof(int), NULL);
+   err |= clSetKernelArg(s->kernel, 4, sizeof(cl_mem), &s->result_buffer);
+   check_err(err, "Couldn't set a kernel argument");
+
+   work->bytes = (double)n;
+   work->flops = 0;
+   return s;
+}
+
+static void search_prepare(void *state, cl_command_queue queue) {
+   search_state *s = (search_state*)state;
+   int result[4] = {0, 0, 0, 0};
+   write_buffer(queue, s->result_buffer, sizeof(result), result);
+}
+
+static void search_run(void *state, bench_run *run) {
+   search_state *s = (search_state*)state;
+   bench_kernel(run, s->kernel, 1, &s->global_size, &s->local_size);
+}
+
+static void search_release(void *state) {
+   search_state *s = (search_state*)state;
+   clReleaseMemObject(s->text_buffer);
+   clReleaseMemObject(s->result_buffer);
+   clReleaseKernel(s->kernel);
+   free(s);
+}
+
+/* matrix_mult: one row of C per work-item, B already transposed */
+
+typedef struct mult_state {
+   cl_kernel kernel;
+   cl_mem a_buffer, b_buffer, c_buffer;
+   size_t global_size;
+} mult_state;
+
+static void* mult_setup(const bench_env *env, cl_program program,
+      size_t n, bench_work *work) {
+
+   mult_state *s = (mult_state*)malloc(sizeof(mult_state));
+   float *a_mat, *b_mat;
+   cl_int err;
+
+   s->kernel = create_kernel(program, "matrix_mult");
+   s->global_size = n;
+
+   a_mat = random_floats(n*n);
+   b_mat = random_floats(n*n);
+   s->a_buffer = create_buffer(env, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, n * n * sizeof(float), a_mat);
+   s->b_buffer = create_buffer(env, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, n * n * sizeof(float), b_mat);
+   s->c_buffer = create_buffer(env, CL_MEM_WRITE_ONLY,
+         n * n * sizeof(float), NULL);
+   free(a_mat);
+   free(b_mat);
+
+   err = clSetKernelArg(s->kernel, 0, sizeof(cl_mem), &s->a_buffer);
+   err |= clSetKernelArg(s->kernel, 1, sizeof(cl_mem), &s->b_buffer);
+   err |= clSetKernelArg(s->kernel, 2, sizeof(cl_mem), &s->c_buffer);
+   check_err(err, "Couldn't set a kernel argument");
+
+   work->bytes = 3.0 * n * n * sizeof(float);
+   work->flops = 2.0 * n * n * n;
+   return s;
+}
+
+static void mult_run(void *state, bench_run *run) {
+   mult_state *s = (mult_state*)state;
+   bench_kernel(run, s->kernel, 1, &s->global_size, NULL);
+}
+
+static void mult_release(void *state) {
+   mult_state *s = (mult_state*)state;
+   clReleaseMemObject(s->a_buffer);
+   clReleaseMemObject(s->b_buffer);
+   clReleaseMemObject(s->c_buffer);
+   clReleaseKernel(s->kernel);
+   free(s);
+}
+
+/* transpose: in place, one 4x4 block pair per work-item */
+
+typedef struct transpose_state {
+   cl_kernel kernel;
+   cl_mem data_buffer;
+   size_t global_size;
+} transpose_state;
+
+static void* transpose_setup(const bench_env *env, cl_program program,
+      size_t n, bench_work *work) {
+
+   transpose_state *s = (transpose_state*)malloc(sizeof(transpose_state));
+   float *data;
+   cl_uint matrix_dim = (cl_uint)(n/4);
+   cl_int err;
+
+   s->kernel = create_kernel(program, "transpose");
+   s->global_size = (n/4 * (n/4 + 1))/2;
+
+   data = random_floats(n*n);
+   s->data_buffer = create_buffer(env, CL_MEM_READ_WRITE |
+         CL_MEM_COPY_HOST_PTR, n * n * sizeof(float), data);
+   free(data);
+
+   err = clSetKernelArg(s->kernel, 0, sizeof(cl_mem), &s->data_buffer);
+   err |= clSetKernelArg(s->kernel, 1, (size_t)local_mem_size(env), NULL);
+   err |= clSetKernelArg(s->kernel, 2, sizeof(matrix_dim), &matrix_dim);
+   check_err(err, "Couldn't set a kernel argument");
+
+   work->bytes = 2.0 * n * n * sizeof(float);
+   work->flops = 0;
+   return s;
+}
+
+static void transpose_run(void *state, bench_run *run) {
+   transpose_state *s = (transpose_state*)state;
+   bench_kernel(run, s->kernel, 1, &s->global_size, NULL);
+}
+
+static void transpose_release(void *state) {
+   transpose_state *s = (transpose_state*)state;
+   clReleaseMemObject(s->data_buffer);
+   clReleaseKernel(s->kernel);
+   free(s);
+}
+
+/* fft: forward transform, same launch sequence as Ch14/fft */
+
+typedef struct fft_state {
+   cl_kernel init, stage;
+   cl_mem data_buffer;
+   float *data;
+   cl_uint num_points, points_per_group;
+   size_t global_size, local_size;
+} fft_state;
+
+static void* fft_setup(const bench_env *env, cl_program program,
+      size_t n, bench_work *work) {
+
+   fft_state *s = (fft_state*)malloc(sizeof(fft_state));
+   cl_uint launches = 1, stage;
+   int direction = 1;
+   cl_int err;
+
+   s->init = create_kernel(program, "fft_init");
+   s->stage = create_kernel(program, "fft_stage");
+   s->num_points = (cl_uint)n;
+
+   /* Powers of two, at least four points per work-item */
+   s->points_per_group = 1;
+   while(2 * s->points_per_group * 2 * sizeof(float) <= local_mem_size(env))
+      s->points_per_group *= 2;
+   if(s->points_per_group > s->num_points)
+      s->points_per_group = s->num_points;
+   s->local_size = kernel_group_size(env, s->init);
+   if(s->local_size > s->points_per_group/4)
+      s->local_size = s->points_per_group/4;
+   s->global_size = (s->num_points/s->points_per_group) * s->local_size;
+
+   s->data = random_floats(2*n);
+   s->data_buffer = create_buffer(env, CL_MEM_READ_WRITE,
+         2 * n * sizeof(float), NULL);
+
+   err = clSetKernelArg(s->init, 0, sizeof(cl_mem), &s->data_buffer);
+   err |= clSetKernelArg(s->init, 1,
+         2 * s->points_per_group * sizeof(float), NULL);
+   err |= clSetKernelArg(s->init, 2, sizeof(cl_uint), &s->points_per_group);
+   err |= clSetKernelArg(s->init, 3, sizeof(cl_uint), &s->num_points);
+   err |= clSetKernelArg(s->init, 4, sizeof(int), &direction);
+   err |= clSetKernelArg(s->stage, 0, sizeof(cl_mem), &s->data_buffer);
+   err |= clSetKernelArg(s->stage, 2, sizeof(cl_uint), &s->points_per_group);
+   err |= clSetKernelArg(s->stage, 3, sizeof(int), &direction);
+   check_err(err, "Couldn't set a kernel argument");
+
+   for(stage = 2; stage <= s->num_points/s->points_per_group; stage <<= 1)
+      launches++;
+   work->bytes = 2.0 * launches * n * 2 * sizeof(float);
+   work->flops = 5.0 * n * log2((double)n);
+   return s;
+}
+
+static void fft_prepare(void *state, cl_command_queue queue) {
+   fft_state *s = (fft_state*)state;
+   write_buffer(queue, s->data_buffer,
+         2 * s->num_points * sizeof(float), s->data);
+}
+
+static void fft_run(void *state, bench_run *run) {
+
+   fft_state *s = (fft_state*)state;
+   cl_uint stage;
+
+   bench_kernel(run, s->init, 1, &s->global_size, &s->local_size);
+   for(stage = 2; stage <= s->num_points/s->points_per_group; stage <<= 1) {
+      clSetKernelArg(s->stage, 1, sizeof(stage), &stage);
+      bench_kernel(run, s->stage, 1, &s->global_size, &s->local_size);
+   }
+}
+
+static void fft_release(void *state) {
+   fft_state *s = (fft_state*)state;
+   clReleaseMemObject(s->data_buffer);
+   clReleaseKernel(s->init);
+   clReleaseKernel(s->stage);
+   free(s->data);
+   free(s);
+}
+
+/* rdft: N/2+1 work-items in a single work-group */
+
+typedef struct rdft_state {
+   cl_kernel kernel;
+   cl_mem data_buffer;
+   float *data;
+   size_t n, global_size;
+} rdft_state;
+
+static void* rdft_setup(const bench_env *env, cl_program program,
+      size_t n, bench_work *work) {
+
+   rdft_state *s = (rdft_state*)malloc(sizeof(rdft_state));
+   size_t max_size;
+
+   s->kernel = create_kernel(program, "rdft");
+   clGetKernelWorkGroupInfo(s->kernel, env->device,
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(max_size), &max_size, NULL);
+   if(n/2 + 1 > max_size) {
+      clReleaseKernel(s->kernel);
+      free(s);
+      return NULL;
+   }
+   s->n = n;
+   s->global_size = n/2 + 1;
+
+   s->data = random_floats(n);
+   s->data_buffer = create_buffer(env, CL_MEM_READ_WRITE,
+         n * sizeof(float), NULL);
+   check_err(clSetKernelArg(s->kernel, 0, sizeof(cl_mem), &s->data_buffer),
+         "Couldn't set a kernel argument");
+
+   /* Trigonometric functions aren't counted */
+   work->bytes = 2.0 * n * sizeof(float);
+   work->flops = 4.0 * s->global_size * n;
+   return s;
+}
+
+static void rdft_prepare(void *state, cl_command_queue queue) {
+   rdft_state *s = (rdft_state*)state;
+   write_buffer(queue, s->data_buffer, s->n * sizeof(float), s->data);
+}
+
+static void rdft_run(void *state, bench_run *run) {
+   rdft_state *s = (rdft_state*)state;
+   bench_kernel(run, s->kernel, 1, &s->global_size, &s->global_size);
+}
+
+static void rdft_release(void *state) {
+   rdft_state *s = (rdft_state*)state;
+   clReleaseMemObject(s->data_buffer);
+   clReleaseKernel(s->kernel);
+   free(s->data);
+   free(s);
+}
+
+/* conj_grad: tridiagonal SPD system solved by one work-group */
+
+typedef struct cg_state {
+   cl_kernel kernel;
+   cl_mem rows_buffer, cols_buffer, values_buffer, b_buffer, result_buffer;
+   size_t global_size;
+} cg_state;
+
+static void* cg_setup(const bench_env *env, cl_program program,
+      size_t n, bench_work *work) {
+
+   cg_state *s = (cg_state*)malloc(sizeof(cg_state));
+   int *rows, *cols, dim = (int)n, num_values = 3*(int)n - 2, i, j;
+   float *values, *b_vec, result[2];
+   size_t max_size;
+   cl_int err;
+
+   s->kernel = create_kernel(program, "conj_grad");
+   clGetKernelWorkGroupInfo(s->kernel, env->device,
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(max_size), &max_size, NULL);
+   if(n > max_size || 5 * n * sizeof(float) > local_mem_size(env)) {
+      clReleaseKernel(s->kernel);
+      free(s);
+      return NULL;
+   }
+   s->global_size = n;
+
+   /* 4 on the diagonal, -1 beside it, sorted by row */
+   rows = (int*)malloc(num_values * sizeof(int));
+   cols = (int*)malloc(num_values * sizeof(int));
+   values = (float*)malloc(num_values * sizeof(float));
+   for(i=0, j=0; i<dim; i++) {
+      if(i > 0) {
+         rows[j] = i; cols[j] = i-1; values[j++] = -1.0f;
+      }
+      rows[j] = i; cols[j] = i; values[j++] = 4.0f;
+      if(i < dim-1) {
+         rows[j] = i; cols[j] = i+1; values[j++] = -1.0f;
+      }
+   }
+   b_vec = random_floats(n);
+
+   s->rows_buffer = create_buffer(env, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, num_values * sizeof(int), rows);
+   s->cols_buffer = create_buffer(env, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, num_values * sizeof(int), cols);
+   s->values_buffer = create_buffer(env, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, num_values * sizeof(float), values);
+   s->b_buffer = create_buffer(env, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, n * sizeof(float), b_vec);
+   s->result_buffer = create_buffer(env, CL_MEM_WRITE_ONLY,
+         2 * sizeof(float), NULL);
+   free(rows);
+   free(cols);
+   free(values);
+   free(b_vec);
+
+   err = clSetKernelArg(s->kernel, 0, sizeof(dim), &dim);
+   err |= clSetKernelArg(s->kernel, 1, sizeof(num_values), &num_values);
+   for(i=2; i<6; i++) {
+      err |= clSetKernelArg(s->kernel, i, n * sizeof(float), NULL);
+   }
+   err |= clSetKernelArg(s->kernel, 6, sizeof(cl_mem), &s->rows_buffer);
+   err |= clSetKernelArg(s->kernel, 7, sizeof(cl_mem), &s->cols_buffer);
+   err |= clSetKernelArg(s->kernel, 8, sizeof(cl_mem), &s->values_buffer);
+   err |= clSetKernelArg(s->kernel, 9, sizeof(cl_mem), &s->b_buffer);
+   err |= clSetKernelArg(s->kernel, 10, sizeof(cl_mem), &s->result_buffer);
+   err |= clSetKernelArg(s->kernel, 11, n * sizeof(float), NULL);
+   check_err(err, "Couldn't set a kernel argument");
+
+   /* The iteration count depends only on the system, so run once to
+      find it */
+   check_err(clEnqueueNDRangeKernel(env->queue, s->kernel, 1, NULL,
+         &s->global_size, &s->global_size, 0, NULL, NULL),
+         "Couldn't enqueue the kernel");
+   check_err(clEnqueueReadBuffer(env->queue, s->result_buffer, CL_TRUE, 0,
+         sizeof(result), result, 0, NULL, NULL), "Couldn't read the buffer");
+
+   /* Matrix entries are read from global memory every iteration */
+   work->bytes = result[0] * num_values * (2*sizeof(int) + sizeof(float)) +
+         2.0 * n * sizeof(float);
+   work->flops = result[0] * (2.0 * num_values + 10.0 * n);
+   return s;
+}
+
+static void cg_run(void *state, bench_run *run) {
+   cg_state *s = (cg_state*)state;
+   bench_kernel(run, s->kernel, 1, &s->global_size, &s->global_size);
+}
+
+static void cg_release(void *state) {
+   cg_state *s = (cg_state*)state;
+   clReleaseMemObject(s->rows_buffer);
+   clReleaseMemObject(s->cols_buffer);
+   clReleaseMemObject(s->values_buffer);
+   clReleaseMemObject(s->b_buffer);
+   clReleaseMemObject(s->result_buffer);
+   clReleaseKernel(s->kernel);
+   free(s);
+}
+
+/* texture_filter: n x n single-channel image to a byte buffer */
+
+typedef struct texture_state {
+   cl_kernel kernel;
+   cl_mem in_texture, out_buffer;
+   size_t global_size[2];
+} texture_state;
+
+static void* texture_setup(const bench_env *env, cl_program program,
+      size_t n, bench_work *work) {
+
+   texture_state *s;
+   cl_image_format format;
+   cl_bool image_support;
+   unsigned char *pixels;
+   size_t i;
+   cl_int err;
+
+   clGetDeviceInfo(env->device, CL_DEVICE_IMAGE_SUPPORT,
+         sizeof(image_support), &image_support, NULL);
+   if(!image_support)
+      return NULL;
+
+   s = (texture_state*)malloc(sizeof(texture_state));
+   s->kernel = create_kernel(program, "texture_filter");
+   s->global_size[0] = n;
+   s->global_size[1] = n;
+
+   pixels = (unsigned char*)malloc(n * n);
+   for(i=0; i<n*n; i++) {
+      pixels[i] = (unsigned char)rand();
+   }
+   format.image_channel_order = CL_R;
+   format.image_channel_data_type = CL_UNSIGNED_INT8;
+   s->in_texture = clCreateImage2D(env->context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, &format, n, n, 0, pixels, &err);
+   check_err(err, "Couldn't create the image object");
+   s->out_buffer = create_buffer(env, CL_MEM_WRITE_ONLY, n * n, NULL);
+   free(pixels);
+
+   err = clSetKernelArg(s->kernel, 0, sizeof(cl_mem), &s->in_texture);
+   err |= clSetKernelArg(s->kernel, 1, sizeof(cl_mem), &s->out_buffer);
+   check_err(err, "Couldn't set a kernel argument");
+
+   /* The filter is integer arithmetic */
+   work->bytes = 2.0 * n * n;
+   work->flops = 0;
+   return s;
+}
+
+static void texture_run(void *state, bench_run *run) {
+   texture_state *s = (texture_state*)state;
+   bench_kernel(run, s->kernel, 2, s->global_size, NULL);
+}
+
+static void texture_release(void *state) {
+   texture_state *s = (texture_state*)state;
+   clReleaseMemObject(s->in_texture);
+   clReleaseMemObject(s->out_buffer);
+   clReleaseKernel(s->kernel);
+   free(s);
+}
+
+const bench_case bench_cases[] = {
+   {"reduction_scalar", "../../Ch10/reduction/reduction.cl", "floats",
+    {1<<16, 1<<18, 1<<20, 1<<22, 1<<24, 1<<26},
+    reduction_scalar_setup, NULL, reduction_run, reduction_release},
+   {"reduction_vector", "../../Ch10/reduction/reduction.cl", "floats",
+    {1<<16, 1<<18, 1<<20, 1<<22, 1<<24, 1<<26},
+    reduction_vector_setup, NULL, reduction_run, reduction_release},
+   {"bsort", "../../Ch11/bsort/bsort.cl", "floats",
+    {1<<12, 1<<14, 1<<16, 1<<18, 1<<20, 1<<22},
+    bsort_setup, bsort_prepare, bsort_run, bsort_release},
+   {"radix_sort8", "../../Ch11/radix_sort8/radix_sort8.cl", "shorts",
+    {1<<12, 1<<16, 1<<20, 1<<24},
+    radix_setup, radix_prepare, radix_run, radix_release},
+   {"string_search", "../../Ch11/string_search/string_search.cl", "chars",
+    {1<<16, 1<<18, 1<<20, 1<<22, 1<<24, 1<<26},
+    search_setup, search_prepare, search_run, search_release},
+   {"matrix_mult", "../../Ch12/matrix_mult/matrix_mult.cl", "rows",
+    {64, 128, 256, 512, 1024},
+    mult_setup, NULL, mult_run, mult_release},
+   {"transpose", "../../Ch12/transpose/transpose.cl", "rows",
+    {64, 256, 1024, 2048, 4096},
+    transpose_setup, NULL, transpose_run, transpose_release},
+   {"fft", "../../Ch14/fft/fft.cl", "points",
+    {1<<12, 1<<14, 1<<16, 1<<18, 1<<20, 1<<22},
+    fft_setup, fft_prepare, fft_run, fft_release},
+   {"rdft", "../../Ch14/rdft/rdft.cl", "points",
+    {64, 128, 256, 512, 1024, 2048},
+    rdft_setup, rdft_prepare, rdft_run, rdft_release},
+   {"conj_grad", "../../Ch13/conj_grad/conj_grad.cl", "rows",
+    {64, 128, 256, 512, 1024},
+    cg_setup, NULL, cg_run, cg_release},
+   {"texture_filter", "../../Ch16/texture_filter/texture_filter.cl", "width",
+    {256, 512, 1024, 2048, 4096},
+    texture_setup, NULL, texture_run, texture_release},
+};
+
+const int bench_num_cases = sizeof(bench_cases)/sizeof(bench_cases[0]);
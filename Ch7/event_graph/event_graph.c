@@ -0,0 +1,237 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "event_graph.cl"
+
+#define NUM_CHUNKS 8
+#define CHUNK_FLOATS 262144
+#define NUM_LAUNCHES 2
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "task_graph.h"
+#include "program_binary.h"
+
+/* The kernels compiled for this machine by the Makefile */
+#ifdef PRECOMPILED
+#include "event_graph_binaries.h"
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   }
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);
+   }
+
+   return dev;
+}
+
+/* One chunk's data and the result of its check */
+typedef struct {
+   int index;
+   float *input, *output;
+   int passed;
+} chunk;
+
+/* Host node: runs once the chunk's read has completed */
+void check_chunk(void *data) {
+
+   chunk *c = (chunk*)data;
+   int i;
+
+   c->passed = 1;
+   for(i=0; i<CHUNK_FLOATS; i++) {
+      if(c->output[i] != 2.0f * c->input[i] + c->index) {
+         c->passed = 0;
+         break;
+      }
+   }
+}
+
+/* Host node: runs once every chunk has been checked */
+void report(void *data) {
+
+   chunk *chunks = (chunk*)data;
+   int i, passed = 0;
+
+   for(i=0; i<NUM_CHUNKS; i++) {
+      passed += chunks[i].passed;
+   }
+   printf("%d of %d chunks checked.\n", passed, NUM_CHUNKS);
+}
+
+int main(int argc, char **argv) {
+
+   /* OpenCL structures */
+   cl_device_id device;
+   cl_context context;
+   cl_command_queue queues[2];
+   cl_command_queue_properties props;
+   cl_program program;
+   cl_kernel scale_kernel, offset_kernel;
+   cl_int err;
+   int num_queues, out_of_order, launch;
+
+   /* Graph */
+   task_graph graph;
+   int i, j, write, scale, offset, read, check[NUM_CHUNKS], done;
+   size_t global_size = CHUNK_FLOATS;
+   float factor = 2.0f, value;
+
+   /* Data and buffers */
+   chunk chunks[NUM_CHUNKS];
+   cl_mem buffers[NUM_CHUNKS];
+   int all_passed;
+
+   /* Create device and context */
+   device = create_device();
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);
+   }
+
+   /* Use one out-of-order queue if asked for and supported. Otherwise
+      transfers go to one in-order queue and kernels to another */
+   clGetDeviceInfo(device, CL_DEVICE_QUEUE_PROPERTIES,
+         sizeof(props), &props, NULL);
+   out_of_order = argc > 1 && !strcmp(argv[1], "-ooo") &&
+         (props & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE);
+   if(out_of_order) {
+      queues[0] = clCreateCommandQueue(context, device,
+            CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, &err);
+      num_queues = 1;
+   }
+   else {
+      queues[0] = clCreateCommandQueue(context, device, 0, &err);
+      queues[1] = clCreateCommandQueue(context, device, 0, &err);
+      num_queues = 2;
+   }
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);
+   };
+
+   /* Build program and create kernels */
+   program = program_load(context, device, PROGRAM_IMAGE(event_graph),
+         PROGRAM_FILE, NULL, NULL);
+   scale_kernel = clCreateKernel(program, "scale", &err);
+   if(err == CL_SUCCESS)
+      offset_kernel = clCreateKernel(program, "offset", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+
+   /* Initialize data and create buffers */
+   for(i=0; i<NUM_CHUNKS; i++) {
+      chunks[i].index = i;
+      chunks[i].input = (float*)malloc(CHUNK_FLOATS * sizeof(float));
+      chunks[i].output = (float*)malloc(CHUNK_FLOATS * sizeof(float));
+      for(j=0; j<CHUNK_FLOATS; j++) {
+         chunks[i].input[j] = (float)(j % 256);
+      }
+      buffers[i] = clCreateBuffer(context, CL_MEM_READ_WRITE,
+            CHUNK_FLOATS * sizeof(float), NULL, &err);
+      if(err < 0) {
+         perror("Couldn't create a buffer");
+         exit(1);
+      };
+   }
+
+   /* Per chunk: write -> scale -> offset -> read -> check. Chunks are
+      independent, so one chunk's kernels overlap the next's transfers */
+   task_graph_init(&graph, context, queues, num_queues);
+   for(i=0; i<NUM_CHUNKS; i++) {
+      write = task_add_write(&graph, 0, buffers[i], 0,
+            CHUNK_FLOATS * sizeof(float), chunks[i].input);
+
+      scale = task_add_kernel(&graph, num_queues - 1, scale_kernel, 1,
+            &global_size, NULL);
+      task_kernel_arg(&graph, scale, 0, sizeof(cl_mem), &buffers[i]);
+      task_kernel_arg(&graph, scale, 1, sizeof(float), &factor);
+      task_depends(&graph, scale, write);
+
+      value = (float)i;
+      offset = task_add_kernel(&graph, num_queues - 1, offset_kernel, 1,
+            &global_size, NULL);
+      task_kernel_arg(&graph, offset, 0, sizeof(cl_mem), &buffers[i]);
+      task_kernel_arg(&graph, offset, 1, sizeof(float), &value);
+      task_depends(&graph, offset, scale);
+
+      read = task_add_read(&graph, 0, buffers[i], 0,
+            CHUNK_FLOATS * sizeof(float), chunks[i].output);
+      task_depends(&graph, read, offset);
+
+      check[i] = task_add_host(&graph, check_chunk, &chunks[i]);
+      task_depends(&graph, check[i], read);
+   }
+   done = task_add_host(&graph, report, chunks);
+   for(i=0; i<NUM_CHUNKS; i++) {
+      task_depends(&graph, done, check[i]);
+   }
+
+   /* The same graph runs once per launch */
+   all_passed = 1;
+   for(launch=0; launch<NUM_LAUNCHES; launch++) {
+      for(i=0; i<NUM_CHUNKS; i++) {
+         chunks[i].passed = 0;
+      }
+      task_graph_launch(&graph);
+      err = task_graph_wait(&graph);
+      if(err < 0) {
+         printf("Task graph failed: %d\n", err);
+         exit(1);
+      }
+      for(i=0; i<NUM_CHUNKS; i++) {
+         all_passed &= chunks[i].passed;
+      }
+   }
+
+   printf("%s, %d launches\n", out_of_order ?
+         "One out-of-order queue" : "Two in-order queues", NUM_LAUNCHES);
+   if(all_passed)
+      printf("Check passed.\n");
+   else
+      printf("Check failed.\n");
+
+   /* Deallocate resources */
+   task_graph_release(&graph);
+   for(i=0; i<NUM_CHUNKS; i++) {
+      clReleaseMemObject(buffers[i]);
+      free(chunks[i].input);
+      free(chunks[i].output);
+   }
+   clReleaseKernel(scale_kernel);
+   clReleaseKernel(offset_kernel);
+   for(i=0; i<num_queues; i++) {
+      clReleaseCommandQueue(queues[i]);
+   }
+   clReleaseProgram(program);
+   clReleaseContext(context);
+   return 0;
+}
@@ -0,0 +1,7 @@
+__kernel void scale(__global float *data, float factor) {
+   data[get_global_id(0)] *= factor;
+}
+
+__kernel void offset(__global float *data, float value) {
+   data[get_global_id(0)] += value;
+}
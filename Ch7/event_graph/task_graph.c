@@ -0,0 +1,278 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "task_graph.h"
+
+void task_graph_init(task_graph *graph, cl_context ctx,
+      cl_command_queue *queues, int num_queues) {
+
+   if(num_queues < 1 || num_queues > TASK_MAX_QUEUES) {
+      printf("A task graph needs 1 to %d queues\n", TASK_MAX_QUEUES);
+      exit(1);
+   }
+   graph->context = ctx;
+   memcpy(graph->queues, queues, num_queues * sizeof(cl_command_queue));
+   graph->num_queues = num_queues;
+   graph->nodes = NULL;
+   graph->num_nodes = 0;
+   graph->capacity = 0;
+   pthread_mutex_init(&graph->lock, NULL);
+}
+
+static task_node* add_node(task_graph *graph, task_type type, int queue) {
+
+   task_node *node;
+
+   if(queue < 0 || queue >= graph->num_queues) {
+      printf("Task graph has no queue %d\n", queue);
+      exit(1);
+   }
+   if(graph->num_nodes == graph->capacity) {
+      graph->capacity = graph->capacity ? 2 * graph->capacity : 16;
+      graph->nodes = (task_node*)realloc(graph->nodes,
+            graph->capacity * sizeof(task_node));
+   }
+   node = &graph->nodes[graph->num_nodes++];
+   memset(node, 0, sizeof(task_node));
+   node->graph = graph;
+   node->type = type;
+   node->queue = queue;
+   return node;
+}
+
+int task_add_kernel(task_graph *graph, int queue, cl_kernel kernel,
+      cl_uint work_dim, const size_t *global_size, const size_t *local_size) {
+
+   task_node *node = add_node(graph, TASK_KERNEL, queue);
+
+   node->kernel = kernel;
+   node->work_dim = work_dim;
+   memcpy(node->global_size, global_size, work_dim * sizeof(size_t));
+   if(local_size != NULL) {
+      memcpy(node->local_size, local_size, work_dim * sizeof(size_t));
+      node->has_local_size = 1;
+   }
+   return graph->num_nodes - 1;
+}
+
+int task_add_write(task_graph *graph, int queue, cl_mem buffer,
+      size_t offset, size_t size, const void *host_ptr) {
+
+   task_node *node = add_node(graph, TASK_WRITE, queue);
+
+   node->buffer = buffer;
+   node->offset = offset;
+   node->size = size;
+   node->host_ptr = (void*)host_ptr;
+   return graph->num_nodes - 1;
+}
+
+int task_add_read(task_graph *graph, int queue, cl_mem buffer,
+      size_t offset, size_t size, void *host_ptr) {
+
+   task_node *node = add_node(graph, TASK_READ, queue);
+
+   node->buffer = buffer;
+   node->offset = offset;
+   node->size = size;
+   node->host_ptr = host_ptr;
+   return graph->num_nodes - 1;
+}
+
+int task_add_copy(task_graph *graph, int queue, cl_mem src, cl_mem dst,
+      size_t src_offset, size_t dst_offset, size_t size) {
+
+   task_node *node = add_node(graph, TASK_COPY, queue);
+
+   node->buffer = src;
+   node->dst_buffer = dst;
+   node->offset = src_offset;
+   node->dst_offset = dst_offset;
+   node->size = size;
+   return graph->num_nodes - 1;
+}
+
+int task_add_host(task_graph *graph, task_host_func func, void *data) {
+
+   task_node *node = add_node(graph, TASK_HOST, 0);
+
+   node->func = func;
+   node->data = data;
+   return graph->num_nodes - 1;
+}
+
+void task_kernel_arg(task_graph *graph, int node, cl_uint index,
+      size_t size, const void *value) {
+
+   task_node *n = &graph->nodes[node];
+   task_arg *arg;
+
+   if(n->type != TASK_KERNEL || n->num_args == TASK_MAX_ARGS ||
+         (value != NULL && size > TASK_MAX_ARG_SIZE)) {
+      printf("Couldn't set argument %u of task %d\n", index, node);
+      exit(1);
+   }
+   arg = &n->args[n->num_args++];
+   arg->index = index;
+   arg->size = size;
+   arg->is_local = (value == NULL);
+   if(value != NULL)
+      memcpy(arg->value, value, size);
+}
+
+void task_depends(task_graph *graph, int node, int dep) {
+
+   task_node *n = &graph->nodes[node];
+
+   if(dep < 0 || dep >= node || n->num_deps == TASK_MAX_DEPS) {
+      printf("Task %d can't depend on task %d\n", node, dep);
+      exit(1);
+   }
+   n->deps[n->num_deps++] = dep;
+}
+
+/* Run a host node whose dependencies are done and release its waiters */
+static void finish_host(task_node *node) {
+   if(node->status == CL_SUCCESS)
+      node->func(node->data);
+   clSetUserEventStatus(node->event,
+         node->status == CL_SUCCESS ? CL_COMPLETE : node->status);
+}
+
+/* Called once per dependency of a host node. The last one runs it */
+static void CL_CALLBACK dep_complete(cl_event e, cl_int status, void *data) {
+
+   task_node *node = (task_node*)data;
+   int ready;
+
+   pthread_mutex_lock(&node->graph->lock);
+   if(status < 0 && node->status == CL_SUCCESS)
+      node->status = status;
+   ready = (--node->pending == 0);
+   pthread_mutex_unlock(&node->graph->lock);
+
+   if(ready)
+      finish_host(node);
+}
+
+void task_graph_launch(task_graph *graph) {
+
+   task_node *node;
+   cl_event wait_list[TASK_MAX_DEPS];
+   cl_command_queue queue;
+   cl_int err;
+   int i, j;
+
+   for(i=0; i<graph->num_nodes; i++) {
+      node = &graph->nodes[i];
+      queue = graph->queues[node->queue];
+      if(node->event != NULL) {
+         clReleaseEvent(node->event);
+         node->event = NULL;
+      }
+      for(j=0; j<node->num_deps; j++) {
+         wait_list[j] = graph->nodes[node->deps[j]].event;
+      }
+
+      switch(node->type) {
+      case TASK_KERNEL:
+         err = CL_SUCCESS;
+         for(j=0; j<node->num_args; j++) {
+            err |= clSetKernelArg(node->kernel, node->args[j].index,
+                  node->args[j].size,
+                  node->args[j].is_local ? NULL : node->args[j].value);
+         }
+         if(err < 0) {
+            printf("Couldn't set a kernel argument of task %d\n", i);
+            exit(1);
+         }
+         err = clEnqueueNDRangeKernel(queue, node->kernel, node->work_dim,
+               NULL, node->global_size,
+               node->has_local_size ? node->local_size : NULL,
+               node->num_deps, node->num_deps ? wait_list : NULL,
+               &node->event);
+         break;
+      case TASK_WRITE:
+         err = clEnqueueWriteBuffer(queue, node->buffer, CL_FALSE,
+               node->offset, node->size, node->host_ptr,
+               node->num_deps, node->num_deps ? wait_list : NULL,
+               &node->event);
+         break;
+      case TASK_READ:
+         err = clEnqueueReadBuffer(queue, node->buffer, CL_FALSE,
+               node->offset, node->size, node->host_ptr,
+               node->num_deps, node->num_deps ? wait_list : NULL,
+               &node->event);
+         break;
+      case TASK_COPY:
+         err = clEnqueueCopyBuffer(queue, node->buffer, node->dst_buffer,
+               node->offset, node->dst_offset, node->size,
+               node->num_deps, node->num_deps ? wait_list : NULL,
+               &node->event);
+         break;
+      default:
+
+         /* Host nodes complete a user event from dependency callbacks,
+            so no host thread waits for them */
+         node->event = clCreateUserEvent(graph->context, &err);
+         if(err < 0)
+            break;
+         node->status = CL_SUCCESS;
+         node->pending = node->num_deps;
+         if(node->num_deps == 0) {
+            finish_host(node);
+         }
+         for(j=0; j<node->num_deps && err == CL_SUCCESS; j++) {
+            err = clSetEventCallback(wait_list[j], CL_COMPLETE,
+                  dep_complete, node);
+         }
+         break;
+      }
+      if(err < 0) {
+         printf("Couldn't enqueue task %d: %d\n", i, err);
+         exit(1);
+      }
+   }
+
+   /* Start the work without waiting for it */
+   for(i=0; i<graph->num_queues; i++) {
+      clFlush(graph->queues[i]);
+   }
+}
+
+cl_int task_graph_wait(task_graph *graph) {
+
+   cl_int status, result = CL_SUCCESS;
+   int i;
+
+   for(i=0; i<graph->num_nodes; i++) {
+      if(graph->nodes[i].event == NULL)
+         continue;
+      clWaitForEvents(1, &graph->nodes[i].event);
+      clGetEventInfo(graph->nodes[i].event,
+            CL_EVENT_COMMAND_EXECUTION_STATUS, sizeof(status), &status, NULL);
+      if(status < 0 && result == CL_SUCCESS)
+         result = status;
+   }
+   return result;
+}
+
+cl_event task_event(task_graph *graph, int node) {
+   return graph->nodes[node].event;
+}
+
+void task_graph_release(task_graph *graph) {
+
+   int i;
+
+   for(i=0; i<graph->num_nodes; i++) {
+      if(graph->nodes[i].event != NULL)
+         clReleaseEvent(graph->nodes[i].event);
+   }
+   free(graph->nodes);
+   graph->nodes = NULL;
+   graph->num_nodes = 0;
+   graph->capacity = 0;
+   pthread_mutex_destroy(&graph->lock);
+}
@@ -0,0 +1,118 @@
+#ifndef TASK_GRAPH_H
+#define TASK_GRAPH_H
+
+#include <pthread.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#define TASK_MAX_QUEUES 8
+#define TASK_MAX_DEPS 16
+#define TASK_MAX_ARGS 16
+#define TASK_MAX_ARG_SIZE 64
+
+typedef enum {
+   TASK_KERNEL,
+   TASK_WRITE,
+   TASK_READ,
+   TASK_COPY,
+   TASK_HOST
+} task_type;
+
+/* Host work. Runs on the OpenCL runtime's callback thread once every
+   dependency has completed, so it should be short and must not block */
+typedef void (*task_host_func)(void *data);
+
+/* A kernel argument captured when the node is added. value is unused
+   for __local arguments, which pass NULL */
+typedef struct {
+   cl_uint index;
+   size_t size;
+   int is_local;
+   unsigned char value[TASK_MAX_ARG_SIZE];
+} task_arg;
+
+typedef struct task_graph task_graph;
+
+typedef struct {
+   task_graph *graph;
+   task_type type;
+   int queue;
+
+   /* TASK_KERNEL */
+   cl_kernel kernel;
+   cl_uint work_dim;
+   size_t global_size[3], local_size[3];
+   int has_local_size;
+   task_arg args[TASK_MAX_ARGS];
+   int num_args;
+
+   /* TASK_WRITE, TASK_READ and TASK_COPY */
+   cl_mem buffer, dst_buffer;
+   size_t offset, dst_offset, size;
+   void *host_ptr;
+
+   /* TASK_HOST */
+   task_host_func func;
+   void *data;
+   int pending;
+   cl_int status;
+
+   int deps[TASK_MAX_DEPS];
+   int num_deps;
+   cl_event event;
+} task_node;
+
+/* Nodes are enqueued in the order they were added, and a node can only
+   depend on nodes added before it, so the graph is always acyclic.
+   Device nodes go to queues[queue]. An edge between nodes becomes an
+   event wait list entry, which orders work across several in-order
+   queues or within one out-of-order queue */
+struct task_graph {
+   cl_context context;
+   cl_command_queue queues[TASK_MAX_QUEUES];
+   int num_queues;
+   task_node *nodes;
+   int num_nodes, capacity;
+   pthread_mutex_t lock;
+};
+
+void task_graph_init(task_graph *graph, cl_context ctx,
+      cl_command_queue *queues, int num_queues);
+
+/* Each returns the new node's index */
+int task_add_kernel(task_graph *graph, int queue, cl_kernel kernel,
+      cl_uint work_dim, const size_t *global_size, const size_t *local_size);
+int task_add_write(task_graph *graph, int queue, cl_mem buffer,
+      size_t offset, size_t size, const void *host_ptr);
+int task_add_read(task_graph *graph, int queue, cl_mem buffer,
+      size_t offset, size_t size, void *host_ptr);
+int task_add_copy(task_graph *graph, int queue, cl_mem src, cl_mem dst,
+      size_t src_offset, size_t dst_offset, size_t size);
+int task_add_host(task_graph *graph, task_host_func func, void *data);
+
+/* Set an argument of a kernel node. Nodes may share a cl_kernel: the
+   arguments are applied when the node is enqueued */
+void task_kernel_arg(task_graph *graph, int node, cl_uint index,
+      size_t size, const void *value);
+
+/* node runs after dep. dep must have been added before node */
+void task_depends(task_graph *graph, int node, int dep);
+
+/* Enqueue every node and flush the queues without blocking. A graph
+   can be launched again after task_graph_wait */
+void task_graph_launch(task_graph *graph);
+
+/* Block until every node has completed. Returns CL_SUCCESS or the
+   first negative execution status */
+cl_int task_graph_wait(task_graph *graph);
+
+/* The node's event from the last launch */
+cl_event task_event(task_graph *graph, int node);
+
+void task_graph_release(task_graph *graph);
+
+#endif
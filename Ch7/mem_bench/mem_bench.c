@@ -0,0 +1,355 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "mem_bench.cl"
+#define KERNEL_FUNC "empty"
+
+#define MIN_BYTES 4096
+#define MAX_BYTES 1073741824
+#define ROW_BYTES 4096
+#define NUM_REPETITIONS 20
+#define NUM_LARGE_REPETITIONS 5
+#define NUM_LAUNCHES 1000
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "program_binary.h"
+
+/* The kernels compiled for this machine by the Makefile */
+#ifdef PRECOMPILED
+#include "mem_bench_binaries.h"
+#endif
+
+/* Transfers timed at every size */
+enum {
+   WRITE_PAGEABLE, WRITE_PINNED, READ_PAGEABLE, READ_PINNED,
+   MAP_READ, MAP_WRITE, MAP_HOST_PTR, COPY, COPY_RECT, READ_RECT,
+   NUM_TESTS
+};
+
+const char *test_names[NUM_TESTS] = {
+   "write_pageable", "write_pinned", "read_pageable", "read_pinned",
+   "map_read", "map_write", "map_host_ptr", "copy", "copy_rect", "read_rect"
+};
+
+/* Memory used by the transfer tests */
+typedef struct mem_set {
+   cl_mem src, dst;          /* Device buffers */
+   cl_mem pinned;            /* CL_MEM_ALLOC_HOST_PTR buffer */
+   void *pinned_ptr;         /* Host mapping of the pinned buffer */
+   void *pageable;           /* Ordinary malloc'd memory */
+} mem_set;
+
+/* Find a GPU or CPU associated with the first available platform.
+   With cpu set, only a CPU will do */
+cl_device_id create_device(int cpu) {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   }
+
+   /* Access a device */
+   err = CL_DEVICE_NOT_FOUND;
+   if(!cpu)
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);
+   }
+
+   return dev;
+}
+
+/* Time between two profiling points of an event, in seconds.
+   Releases the event */
+double event_time(cl_event event, cl_profiling_info from, cl_profiling_info to) {
+
+   cl_ulong time_start, time_end;
+
+   clGetEventProfilingInfo(event, from, sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(event, to, sizeof(time_end), &time_end, NULL);
+   clReleaseEvent(event);
+   return (time_end - time_start) * 1.0e-9;
+}
+
+double command_time(cl_event event) {
+   return event_time(event, CL_PROFILING_COMMAND_START, CL_PROFILING_COMMAND_END);
+}
+
+int compare_times(const void *a, const void *b) {
+   double x = *(const double*)a, y = *(const double*)b;
+   return (x > y) - (x < y);
+}
+
+/* Run one transfer of size bytes and return its device time.
+   Map tests include the unmap */
+double run_test(cl_command_queue queue, mem_set *mem, int test, size_t size) {
+
+   cl_event event, unmap_event;
+   cl_int err;
+   void *mapped;
+   double time;
+
+   /* Rect tests move the left half of each ROW_BYTES row */
+   size_t row_bytes = size < ROW_BYTES ? size : ROW_BYTES;
+   size_t src_origin[3] = {0, 0, 0};
+   size_t dst_origin[3] = {0, 0, 0};
+   size_t region[3];
+   region[0] = row_bytes/2;
+   region[1] = size/row_bytes;
+   region[2] = 1;
+   dst_origin[0] = row_bytes/2;
+
+   switch(test) {
+   case WRITE_PAGEABLE:
+   case WRITE_PINNED:
+      err = clEnqueueWriteBuffer(queue, mem->src, CL_TRUE, 0, size,
+            test == WRITE_PINNED ? mem->pinned_ptr : mem->pageable,
+            0, NULL, &event);
+      break;
+   case READ_PAGEABLE:
+   case READ_PINNED:
+      err = clEnqueueReadBuffer(queue, mem->src, CL_TRUE, 0, size,
+            test == READ_PINNED ? mem->pinned_ptr : mem->pageable,
+            0, NULL, &event);
+      break;
+   case MAP_READ:
+   case MAP_WRITE:
+   case MAP_HOST_PTR:
+      mapped = clEnqueueMapBuffer(queue,
+            test == MAP_HOST_PTR ? mem->pinned : mem->src, CL_TRUE,
+            test == MAP_WRITE ? CL_MAP_WRITE : CL_MAP_READ, 0, size,
+            0, NULL, &event, &err);
+      if(err < 0)
+         break;
+      err = clEnqueueUnmapMemObject(queue,
+            test == MAP_HOST_PTR ? mem->pinned : mem->src, mapped,
+            0, NULL, &unmap_event);
+      if(err < 0)
+         break;
+      clFinish(queue);
+      time = command_time(event);
+      return time + command_time(unmap_event);
+   case COPY:
+      err = clEnqueueCopyBuffer(queue, mem->src, mem->dst, 0, 0, size,
+            0, NULL, &event);
+      break;
+   case COPY_RECT:
+      err = clEnqueueCopyBufferRect(queue, mem->src, mem->dst, src_origin,
+            dst_origin, region, row_bytes, 0, row_bytes, 0, 0, NULL, &event);
+      break;
+   default:
+      err = clEnqueueReadBufferRect(queue, mem->src, CL_TRUE, src_origin,
+            dst_origin, region, row_bytes, 0, row_bytes, 0, mem->pageable,
+            0, NULL, &event);
+      break;
+   }
+   if(err < 0) {
+      printf("Couldn't run %s: %d\n", test_names[test], err);
+      exit(1);
+   }
+   clFinish(queue);
+   return command_time(event);
+}
+
+/* Bytes a test moves */
+size_t test_bytes(int test, size_t size) {
+   return (test == COPY_RECT || test == READ_RECT) ? size/2 : size;
+}
+
+int main(int argc, char **argv) {
+
+   /* OpenCL data structures */
+   cl_device_id device;
+   cl_context context;
+   cl_command_queue queue;
+   cl_program program;
+   cl_kernel kernel;
+   cl_event *events;
+   cl_int err;
+   cl_ulong max_alloc, global_mem, time_start, time_end;
+   size_t max_bytes, size, global_size = 1;
+
+   /* Options and results */
+   int i, t, reps, csv = 0, cpu = 0;
+   double times[NUM_REPETITIONS], median;
+   mem_set mem;
+
+   for(i=1; i<argc; i++) {
+      if(!strcmp(argv[i], "-csv"))
+         csv = 1;
+      else if(!strcmp(argv[i], "-cpu"))
+         cpu = 1;
+      else {
+         printf("Usage: mem_bench [-cpu] [-csv]\n");
+         exit(1);
+      }
+   }
+
+   /* Create a device and context */
+   device = create_device(cpu);
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);
+   }
+
+   /* Build the program and create a kernel */
+   program = program_load(context, device, PROGRAM_IMAGE(mem_bench),
+         PROGRAM_FILE, NULL, NULL);
+   kernel = clCreateKernel(program, KERNEL_FUNC, &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+
+   /* Create a command queue */
+   queue = clCreateCommandQueue(context, device,
+         CL_QUEUE_PROFILING_ENABLE, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);
+   };
+
+   /* The largest size must fit in one allocation, and the three
+      buffers must fit on the device together */
+   clGetDeviceInfo(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE,
+         sizeof(max_alloc), &max_alloc, NULL);
+   clGetDeviceInfo(device, CL_DEVICE_GLOBAL_MEM_SIZE,
+         sizeof(global_mem), &global_mem, NULL);
+   max_bytes = MAX_BYTES;
+   while(max_bytes > max_alloc || 4 * (cl_ulong)max_bytes > global_mem)
+      max_bytes /= 4;
+
+   mem.src = clCreateBuffer(context, CL_MEM_READ_WRITE, max_bytes, NULL, &err);
+   if(err == CL_SUCCESS)
+      mem.dst = clCreateBuffer(context, CL_MEM_READ_WRITE, max_bytes, NULL, &err);
+   if(err == CL_SUCCESS)
+      mem.pinned = clCreateBuffer(context, CL_MEM_READ_WRITE |
+            CL_MEM_ALLOC_HOST_PTR, max_bytes, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);
+   };
+
+   /* Map the ALLOC_HOST_PTR buffer once to get pinned host memory */
+   mem.pinned_ptr = clEnqueueMapBuffer(queue, mem.pinned, CL_TRUE,
+         CL_MAP_READ | CL_MAP_WRITE, 0, max_bytes, 0, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't map the buffer to host memory");
+      exit(1);
+   }
+   mem.pageable = malloc(max_bytes);
+   memset(mem.pageable, 1, max_bytes);
+   memset(mem.pinned_ptr, 1, max_bytes);
+
+   if(csv)
+      printf("test,bytes,median_us,gbps\n");
+   else
+      printf("%-16s %12s %12s %10s\n", "test", "bytes", "median us", "GB/s");
+
+   for(t=0; t<NUM_TESTS; t++) {
+      for(size = MIN_BYTES; size <= max_bytes; size *= 4) {
+
+         /* Large transfers are steady, and slow */
+         reps = size >= 64*1048576 ? NUM_LARGE_REPETITIONS : NUM_REPETITIONS;
+
+         run_test(queue, &mem, t, size);
+         for(i=0; i<reps; i++) {
+            times[i] = run_test(queue, &mem, t, size);
+         }
+         qsort(times, reps, sizeof(double), compare_times);
+         median = times[reps/2];
+
+         if(csv)
+            printf("%s,%zu,%.3f,%.3f\n", test_names[t], size,
+                  median * 1.0e6, test_bytes(t, size) / median * 1.0e-9);
+         else
+            printf("%-16s %12zu %12.3f %10.3f\n", test_names[t], size,
+                  median * 1.0e6, test_bytes(t, size) / median * 1.0e-9);
+      }
+   }
+
+   /* Launch overhead: a single empty work-item */
+   err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &mem.src);
+   if(err < 0) {
+      perror("Couldn't set a kernel argument");
+      exit(1);
+   };
+   events = (cl_event*)malloc(NUM_LAUNCHES * sizeof(cl_event));
+   for(i=0; i<NUM_LAUNCHES; i++) {
+      err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_size,
+            NULL, 0, NULL, &events[i]);
+      if(err < 0) {
+         perror("Couldn't enqueue the kernel");
+         exit(1);
+      }
+   }
+   clFinish(queue);
+
+   /* Back-to-back interval: first start to last end over all launches */
+   clGetEventProfilingInfo(events[0], CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(events[NUM_LAUNCHES-1], CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+
+   /* Single launches: queued to end, with the queue otherwise idle */
+   for(i=0; i<NUM_REPETITIONS; i++) {
+      clReleaseEvent(events[i]);
+      err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_size,
+            NULL, 0, NULL, &events[i]);
+      if(err < 0) {
+         perror("Couldn't enqueue the kernel");
+         exit(1);
+      }
+      clFinish(queue);
+      times[i] = event_time(events[i], CL_PROFILING_COMMAND_QUEUED,
+            CL_PROFILING_COMMAND_END);
+   }
+   for(i=NUM_REPETITIONS; i<NUM_LAUNCHES; i++) {
+      clReleaseEvent(events[i]);
+   }
+   qsort(times, NUM_REPETITIONS, sizeof(double), compare_times);
+
+   if(csv) {
+      printf("launch_latency,0,%.3f,0\n", times[NUM_REPETITIONS/2] * 1.0e6);
+      printf("launch_interval,0,%.3f,0\n",
+            (time_end - time_start) * 1.0e-3 / NUM_LAUNCHES);
+   }
+   else {
+      printf("\nEmpty kernel, queued to end: %.3f us\n",
+            times[NUM_REPETITIONS/2] * 1.0e6);
+      printf("Empty kernel, back-to-back:  %.3f us per launch\n",
+            (time_end - time_start) * 1.0e-3 / NUM_LAUNCHES);
+   }
+
+   /* Deallocate resources */
+   clEnqueueUnmapMemObject(queue, mem.pinned, mem.pinned_ptr, 0, NULL, NULL);
+   clFinish(queue);
+   free(events);
+   free(mem.pageable);
+   clReleaseMemObject(mem.src);
+   clReleaseMemObject(mem.dst);
+   clReleaseMemObject(mem.pinned);
+   clReleaseKernel(kernel);
+   clReleaseCommandQueue(queue);
+   clReleaseProgram(program);
+   clReleaseContext(context);
+   return 0;
+}
@@ -0,0 +1,2 @@
+__kernel void empty(__global float *a) {
+}
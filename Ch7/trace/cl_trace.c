@@ -0,0 +1,390 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define CL_TRACE_IMPL
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "cl_trace.h"
+
+#define TRACE_DEFAULT_FILE "trace.json"
+#define TRACE_MAX_QUEUES 64
+#define TRACE_MAX_ARGS 32
+
+/* One enqueued command */
+typedef struct {
+   cl_event event;
+   char name[64];
+   const char* category;
+   int queue;
+   cl_uint dims;
+   size_t global_size[3], local_size[3];
+   size_t bytes;
+} trace_record;
+
+/* Bytes referenced by each buffer argument of a kernel */
+typedef struct {
+   cl_kernel kernel;
+   size_t arg_bytes[TRACE_MAX_ARGS];
+} trace_kernel;
+
+/* Size of every buffer created through the wrappers */
+typedef struct {
+   cl_mem mem;
+   size_t size;
+} trace_mem;
+
+static trace_record *records;
+static size_t num_records, max_records;
+static trace_kernel *kernels;
+static size_t num_kernels, max_kernels;
+static trace_mem *mems;
+static size_t num_mems, max_mems;
+static cl_command_queue queues[TRACE_MAX_QUEUES];
+static int num_queues, registered;
+
+/* Grow a dynamic array by doubling */
+static void* grow(void *array, size_t *max, size_t elem_size) {
+   *max = *max ? 2 * *max : 256;
+   array = realloc(array, *max * elem_size);
+   if(array == NULL) {
+      perror("Couldn't allocate trace memory");
+      exit(1);
+   }
+   return array;
+}
+
+static int queue_index(cl_command_queue queue) {
+   int i;
+   for(i=0; i<num_queues; i++) {
+      if(queues[i] == queue)
+         return i;
+   }
+   if(num_queues < TRACE_MAX_QUEUES)
+      queues[num_queues++] = queue;
+   return i;
+}
+
+static size_t mem_size(cl_mem mem) {
+   size_t i;
+   for(i=0; i<num_mems; i++) {
+      if(mems[i].mem == mem)
+         return mems[i].size;
+   }
+   return 0;
+}
+
+static void add_mem(cl_mem mem, size_t size) {
+   if(mem == NULL)
+      return;
+   if(num_mems == max_mems)
+      mems = grow(mems, &max_mems, sizeof(trace_mem));
+   mems[num_mems].mem = mem;
+   mems[num_mems].size = size;
+   num_mems++;
+}
+
+static trace_kernel* find_kernel(cl_kernel kernel) {
+   size_t i;
+   for(i=0; i<num_kernels; i++) {
+      if(kernels[i].kernel == kernel)
+         return &kernels[i];
+   }
+   if(num_kernels == max_kernels)
+      kernels = grow(kernels, &max_kernels, sizeof(trace_kernel));
+   memset(&kernels[num_kernels], 0, sizeof(trace_kernel));
+   kernels[num_kernels].kernel = kernel;
+   return &kernels[num_kernels++];
+}
+
+/* Start a record. The caller's event is retained, or a private event
+   is requested when the caller passed NULL */
+static trace_record* add_record(cl_command_queue queue, const char* category,
+      const char* name, size_t bytes) {
+
+   trace_record *rec;
+
+   if(!registered) {
+      atexit(trace_write);
+      registered = 1;
+   }
+   if(num_records == max_records)
+      records = grow(records, &max_records, sizeof(trace_record));
+   rec = &records[num_records];
+   memset(rec, 0, sizeof(trace_record));
+   rec->category = category;
+   rec->queue = queue_index(queue);
+   rec->bytes = bytes;
+   strncpy(rec->name, name, sizeof(rec->name) - 1);
+   return rec;
+}
+
+/* Keep the record if the command was enqueued */
+static void commit_record(trace_record *rec, cl_int err, cl_event *user_event) {
+   if(err < 0) {
+      if(rec->event && user_event == NULL)
+         clReleaseEvent(rec->event);
+      return;
+   }
+   if(user_event != NULL) {
+      rec->event = *user_event;
+      clRetainEvent(rec->event);
+   }
+   num_records++;
+}
+
+cl_command_queue trace_clCreateCommandQueue(cl_context ctx, cl_device_id dev,
+      cl_command_queue_properties props, cl_int *err) {
+   return clCreateCommandQueue(ctx, dev, props | CL_QUEUE_PROFILING_ENABLE, err);
+}
+
+cl_mem trace_clCreateBuffer(cl_context ctx, cl_mem_flags flags, size_t size,
+      void *host_ptr, cl_int *err) {
+   cl_mem mem = clCreateBuffer(ctx, flags, size, host_ptr, err);
+   add_mem(mem, size);
+   return mem;
+}
+
+cl_mem trace_clCreateSubBuffer(cl_mem buffer, cl_mem_flags flags,
+      cl_buffer_create_type type, const void *info, cl_int *err) {
+   cl_mem mem = clCreateSubBuffer(buffer, flags, type, info, err);
+   add_mem(mem, ((const cl_buffer_region*)info)->size);
+   return mem;
+}
+
+cl_mem trace_clCreateImage2D(cl_context ctx, cl_mem_flags flags,
+      const cl_image_format *format, size_t width, size_t height,
+      size_t row_pitch, void *host_ptr, cl_int *err) {
+   size_t elem_size = 0;
+   cl_mem mem = clCreateImage2D(ctx, flags, format, width, height,
+         row_pitch, host_ptr, err);
+   if(mem != NULL) {
+      clGetImageInfo(mem, CL_IMAGE_ELEMENT_SIZE, sizeof(elem_size), &elem_size, NULL);
+      add_mem(mem, elem_size * width * height);
+   }
+   return mem;
+}
+
+/* Remember the size of buffer arguments to estimate kernel traffic */
+cl_int trace_clSetKernelArg(cl_kernel kernel, cl_uint index, size_t size,
+      const void *value) {
+   trace_kernel *k;
+   if(index < TRACE_MAX_ARGS) {
+      k = find_kernel(kernel);
+      k->arg_bytes[index] = (size == sizeof(cl_mem) && value != NULL) ?
+            mem_size(*(const cl_mem*)value) : 0;
+   }
+   return clSetKernelArg(kernel, index, size, value);
+}
+
+cl_int trace_clEnqueueNDRangeKernel(cl_command_queue queue, cl_kernel kernel,
+      cl_uint dims, const size_t *offset, const size_t *global_size,
+      const size_t *local_size, cl_uint num_events, const cl_event *wait_list,
+      cl_event *event) {
+
+   trace_record *rec;
+   trace_kernel *k;
+   char name[64];
+   size_t bytes = 0;
+   cl_uint i;
+   cl_int err;
+
+   name[0] = '\0';
+   clGetKernelInfo(kernel, CL_KERNEL_FUNCTION_NAME, sizeof(name), name, NULL);
+   k = find_kernel(kernel);
+   for(i=0; i<TRACE_MAX_ARGS; i++) {
+      bytes += k->arg_bytes[i];
+   }
+
+   rec = add_record(queue, "kernel", name, bytes);
+   rec->dims = dims;
+   for(i=0; i<dims && i<3; i++) {
+      rec->global_size[i] = global_size[i];
+      rec->local_size[i] = local_size ? local_size[i] : 0;
+   }
+   err = clEnqueueNDRangeKernel(queue, kernel, dims, offset, global_size,
+         local_size, num_events, wait_list, event ? event : &rec->event);
+   commit_record(rec, err, event);
+   return err;
+}
+
+cl_int trace_clEnqueueTask(cl_command_queue queue, cl_kernel kernel,
+      cl_uint num_events, const cl_event *wait_list, cl_event *event) {
+   size_t one = 1;
+   return trace_clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &one, &one,
+         num_events, wait_list, event);
+}
+
+cl_int trace_clEnqueueReadBuffer(cl_command_queue queue, cl_mem buffer,
+      cl_bool blocking, size_t offset, size_t size, void *ptr,
+      cl_uint num_events, const cl_event *wait_list, cl_event *event) {
+   trace_record *rec = add_record(queue, "transfer", "read_buffer", size);
+   cl_int err = clEnqueueReadBuffer(queue, buffer, blocking, offset, size, ptr,
+         num_events, wait_list, event ? event : &rec->event);
+   commit_record(rec, err, event);
+   return err;
+}
+
+cl_int trace_clEnqueueWriteBuffer(cl_command_queue queue, cl_mem buffer,
+      cl_bool blocking, size_t offset, size_t size, const void *ptr,
+      cl_uint num_events, const cl_event *wait_list, cl_event *event) {
+   trace_record *rec = add_record(queue, "transfer", "write_buffer", size);
+   cl_int err = clEnqueueWriteBuffer(queue, buffer, blocking, offset, size, ptr,
+         num_events, wait_list, event ? event : &rec->event);
+   commit_record(rec, err, event);
+   return err;
+}
+
+cl_int trace_clEnqueueCopyBuffer(cl_command_queue queue, cl_mem src, cl_mem dst,
+      size_t src_offset, size_t dst_offset, size_t size,
+      cl_uint num_events, const cl_event *wait_list, cl_event *event) {
+   trace_record *rec = add_record(queue, "transfer", "copy_buffer", 2*size);
+   cl_int err = clEnqueueCopyBuffer(queue, src, dst, src_offset, dst_offset,
+         size, num_events, wait_list, event ? event : &rec->event);
+   commit_record(rec, err, event);
+   return err;
+}
+
+void* trace_clEnqueueMapBuffer(cl_command_queue queue, cl_mem buffer,
+      cl_bool blocking, cl_map_flags flags, size_t offset, size_t size,
+      cl_uint num_events, const cl_event *wait_list, cl_event *event,
+      cl_int *err) {
+   cl_int map_err;
+   trace_record *rec = add_record(queue, "transfer", "map_buffer", size);
+   void *ptr = clEnqueueMapBuffer(queue, buffer, blocking, flags, offset, size,
+         num_events, wait_list, event ? event : &rec->event, &map_err);
+   commit_record(rec, map_err, event);
+   if(err)
+      *err = map_err;
+   return ptr;
+}
+
+cl_int trace_clEnqueueUnmapMemObject(cl_command_queue queue, cl_mem mem,
+      void *ptr, cl_uint num_events, const cl_event *wait_list, cl_event *event) {
+   trace_record *rec = add_record(queue, "transfer", "unmap", 0);
+   cl_int err = clEnqueueUnmapMemObject(queue, mem, ptr,
+         num_events, wait_list, event ? event : &rec->event);
+   commit_record(rec, err, event);
+   return err;
+}
+
+cl_int trace_clEnqueueReadImage(cl_command_queue queue, cl_mem image,
+      cl_bool blocking, const size_t *origin, const size_t *region,
+      size_t row_pitch, size_t slice_pitch, void *ptr,
+      cl_uint num_events, const cl_event *wait_list, cl_event *event) {
+   size_t elem_size = 0;
+   trace_record *rec;
+   cl_int err;
+
+   clGetImageInfo(image, CL_IMAGE_ELEMENT_SIZE, sizeof(elem_size), &elem_size, NULL);
+   rec = add_record(queue, "transfer", "read_image",
+         elem_size * region[0] * region[1] * region[2]);
+   err = clEnqueueReadImage(queue, image, blocking, origin, region, row_pitch,
+         slice_pitch, ptr, num_events, wait_list, event ? event : &rec->event);
+   commit_record(rec, err, event);
+   return err;
+}
+
+cl_int trace_clEnqueueWriteImage(cl_command_queue queue, cl_mem image,
+      cl_bool blocking, const size_t *origin, const size_t *region,
+      size_t row_pitch, size_t slice_pitch, const void *ptr,
+      cl_uint num_events, const cl_event *wait_list, cl_event *event) {
+   size_t elem_size = 0;
+   trace_record *rec;
+   cl_int err;
+
+   clGetImageInfo(image, CL_IMAGE_ELEMENT_SIZE, sizeof(elem_size), &elem_size, NULL);
+   rec = add_record(queue, "transfer", "write_image",
+         elem_size * region[0] * region[1] * region[2]);
+   err = clEnqueueWriteImage(queue, image, blocking, origin, region, row_pitch,
+         slice_pitch, ptr, num_events, wait_list, event ? event : &rec->event);
+   commit_record(rec, err, event);
+   return err;
+}
+
+void trace_write(void) {
+
+   FILE *handle;
+   const char *filename;
+   trace_record *rec;
+   cl_ulong queued, submit, start, end, base = (cl_ulong)-1;
+   size_t i, j;
+   int first = 1;
+
+   if(num_records == 0)
+      return;
+
+   /* Find the earliest timestamp */
+   for(i=0; i<num_records; i++) {
+      clWaitForEvents(1, &records[i].event);
+      if(clGetEventProfilingInfo(records[i].event, CL_PROFILING_COMMAND_QUEUED,
+            sizeof(queued), &queued, NULL) == CL_SUCCESS && queued < base)
+         base = queued;
+   }
+
+   filename = getenv("CL_TRACE_FILE");
+   if(filename == NULL)
+      filename = TRACE_DEFAULT_FILE;
+   if((handle = fopen(filename, "w")) == NULL) {
+      perror("Couldn't create the trace file");
+      return;
+   }
+
+   /* Name the tracks: even tids execute, odd tids wait in the queue */
+   fprintf(handle, "{\"traceEvents\":[\n");
+   for(i=0; i<(size_t)num_queues; i++) {
+      fprintf(handle, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+            "\"tid\":%zu,\"args\":{\"name\":\"queue %zu\"}},\n"
+            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,"
+            "\"tid\":%zu,\"args\":{\"name\":\"queue %zu wait\"}}",
+            first ? "" : ",\n", 2*i, i, 2*i + 1, i);
+      first = 0;
+   }
+
+   for(i=0; i<num_records; i++) {
+      rec = &records[i];
+      if(clGetEventProfilingInfo(rec->event, CL_PROFILING_COMMAND_QUEUED,
+            sizeof(queued), &queued, NULL) != CL_SUCCESS)
+         continue;
+      clGetEventProfilingInfo(rec->event, CL_PROFILING_COMMAND_SUBMIT,
+            sizeof(submit), &submit, NULL);
+      clGetEventProfilingInfo(rec->event, CL_PROFILING_COMMAND_START,
+            sizeof(start), &start, NULL);
+      clGetEventProfilingInfo(rec->event, CL_PROFILING_COMMAND_END,
+            sizeof(end), &end, NULL);
+
+      /* Time spent waiting between enqueue and execution */
+      fprintf(handle, ",\n{\"name\":\"%s\",\"cat\":\"wait\",\"ph\":\"X\","
+            "\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+            rec->name, 2*rec->queue + 1, (queued - base) * 1.0e-3,
+            (start - queued) * 1.0e-3);
+
+      /* Execution */
+      fprintf(handle, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\","
+            "\"pid\":0,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,\"args\":{"
+            "\"queued_ns\":%llu,\"submit_ns\":%llu,\"start_ns\":%llu,"
+            "\"end_ns\":%llu,\"bytes\":%zu",
+            rec->name, rec->category, 2*rec->queue, (start - base) * 1.0e-3,
+            (end - start) * 1.0e-3, (unsigned long long)queued,
+            (unsigned long long)submit, (unsigned long long)start,
+            (unsigned long long)end, rec->bytes);
+      if(rec->dims > 0) {
+         fprintf(handle, ",\"global_size\":[");
+         for(j=0; j<rec->dims; j++)
+            fprintf(handle, "%s%zu", j ? "," : "", rec->global_size[j]);
+         fprintf(handle, "],\"local_size\":[");
+         for(j=0; j<rec->dims; j++)
+            fprintf(handle, "%s%zu", j ? "," : "", rec->local_size[j]);
+         fprintf(handle, "]");
+      }
+      fprintf(handle, "}}");
+   }
+   fprintf(handle, "\n]}\n");
+   fclose(handle);
+   printf("Wrote %zu commands to %s\n", num_records, filename);
+
+   /* Release the events so a second call starts a new trace */
+   for(i=0; i<num_records; i++) {
+      clReleaseEvent(records[i].event);
+   }
+   num_records = 0;
+}
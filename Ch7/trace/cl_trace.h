@@ -0,0 +1,71 @@
+#ifndef CL_TRACE_H
+#define CL_TRACE_H
+
+/* Command tracing. Include this header after CL/cl.h and link cl_trace.c.
+   Every enqueue below is routed through a wrapper that records the
+   command's queued/submit/start/end times, its kernel name and
+   work sizes or the number of bytes it moves. Queues are created with
+   profiling enabled. At exit, or on trace_write(), the records are
+   written as Chrome trace JSON to $CL_TRACE_FILE (default trace.json),
+   which chrome://tracing and Perfetto both load.
+
+   The wrappers are not thread-safe: trace one host thread per process. */
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+cl_command_queue trace_clCreateCommandQueue(cl_context, cl_device_id,
+      cl_command_queue_properties, cl_int*);
+cl_mem trace_clCreateBuffer(cl_context, cl_mem_flags, size_t, void*, cl_int*);
+cl_mem trace_clCreateSubBuffer(cl_mem, cl_mem_flags, cl_buffer_create_type,
+      const void*, cl_int*);
+cl_mem trace_clCreateImage2D(cl_context, cl_mem_flags, const cl_image_format*,
+      size_t, size_t, size_t, void*, cl_int*);
+cl_int trace_clSetKernelArg(cl_kernel, cl_uint, size_t, const void*);
+cl_int trace_clEnqueueNDRangeKernel(cl_command_queue, cl_kernel, cl_uint,
+      const size_t*, const size_t*, const size_t*, cl_uint, const cl_event*,
+      cl_event*);
+cl_int trace_clEnqueueTask(cl_command_queue, cl_kernel, cl_uint,
+      const cl_event*, cl_event*);
+cl_int trace_clEnqueueReadBuffer(cl_command_queue, cl_mem, cl_bool, size_t,
+      size_t, void*, cl_uint, const cl_event*, cl_event*);
+cl_int trace_clEnqueueWriteBuffer(cl_command_queue, cl_mem, cl_bool, size_t,
+      size_t, const void*, cl_uint, const cl_event*, cl_event*);
+cl_int trace_clEnqueueCopyBuffer(cl_command_queue, cl_mem, cl_mem, size_t,
+      size_t, size_t, cl_uint, const cl_event*, cl_event*);
+void* trace_clEnqueueMapBuffer(cl_command_queue, cl_mem, cl_bool, cl_map_flags,
+      size_t, size_t, cl_uint, const cl_event*, cl_event*, cl_int*);
+cl_int trace_clEnqueueUnmapMemObject(cl_command_queue, cl_mem, void*, cl_uint,
+      const cl_event*, cl_event*);
+cl_int trace_clEnqueueReadImage(cl_command_queue, cl_mem, cl_bool,
+      const size_t*, const size_t*, size_t, size_t, void*, cl_uint,
+      const cl_event*, cl_event*);
+cl_int trace_clEnqueueWriteImage(cl_command_queue, cl_mem, cl_bool,
+      const size_t*, const size_t*, size_t, size_t, const void*, cl_uint,
+      const cl_event*, cl_event*);
+
+/* Wait for every recorded command and write the trace file.
+   Called automatically at exit */
+void trace_write(void);
+
+#ifndef CL_TRACE_IMPL
+#define clCreateCommandQueue trace_clCreateCommandQueue
+#define clCreateBuffer trace_clCreateBuffer
+#define clCreateSubBuffer trace_clCreateSubBuffer
+#define clCreateImage2D trace_clCreateImage2D
+#define clSetKernelArg trace_clSetKernelArg
+#define clEnqueueNDRangeKernel trace_clEnqueueNDRangeKernel
+#define clEnqueueTask trace_clEnqueueTask
+#define clEnqueueReadBuffer trace_clEnqueueReadBuffer
+#define clEnqueueWriteBuffer trace_clEnqueueWriteBuffer
+#define clEnqueueCopyBuffer trace_clEnqueueCopyBuffer
+#define clEnqueueMapBuffer trace_clEnqueueMapBuffer
+#define clEnqueueUnmapMemObject trace_clEnqueueUnmapMemObject
+#define clEnqueueReadImage trace_clEnqueueReadImage
+#define clEnqueueWriteImage trace_clEnqueueWriteImage
+#endif
+
+#endif
@@ -0,0 +1,176 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "trace.cl"
+#define KERNEL_FUNC "trace"
+
+#define NUM_CHUNKS 8
+#define CHUNK_FLOATS 1048576
+#define NUM_ITERATIONS 64
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "cl_trace.h"
+#include "program_binary.h"
+
+/* The kernels compiled for this machine by the Makefile */
+#ifdef PRECOMPILED
+#include "trace_binaries.h"
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   }
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);
+   }
+
+   return dev;
+}
+
+int main() {
+
+   /* Host/device data structures */
+   cl_device_id device;
+   cl_context context;
+   cl_command_queue transfer_queue, compute_queue;
+   cl_program program;
+   cl_kernel kernel;
+   cl_event write_event[NUM_CHUNKS], kernel_event[NUM_CHUNKS];
+   cl_int err;
+   cl_uint iterations = NUM_ITERATIONS;
+   size_t global_size = CHUNK_FLOATS/4;
+   int i, j, check;
+
+   /* Data and buffers */
+   float *data;
+   cl_mem chunk_buffer[NUM_CHUNKS];
+
+   data = (float*)malloc(NUM_CHUNKS * CHUNK_FLOATS * sizeof(float));
+   for(i=0; i<NUM_CHUNKS * CHUNK_FLOATS; i++) {
+      data[i] = 1.0f;
+   }
+
+   /* Create a device and context */
+   device = create_device();
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);
+   }
+
+   /* Transfers and kernels go to separate queues so they can overlap */
+   transfer_queue = clCreateCommandQueue(context, device, 0, &err);
+   compute_queue = clCreateCommandQueue(context, device, 0, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);
+   };
+
+   program = program_load(context, device, PROGRAM_IMAGE(trace),
+         PROGRAM_FILE, NULL, NULL);
+   kernel = clCreateKernel(program, KERNEL_FUNC, &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+
+   for(i=0; i<NUM_CHUNKS; i++) {
+      chunk_buffer[i] = clCreateBuffer(context, CL_MEM_READ_WRITE,
+            CHUNK_FLOATS * sizeof(float), NULL, &err);
+      if(err < 0) {
+         perror("Couldn't create a buffer");
+         exit(1);
+      };
+   }
+
+   /* write -> kernel -> read for each chunk */
+   for(i=0; i<NUM_CHUNKS; i++) {
+      err = clEnqueueWriteBuffer(transfer_queue, chunk_buffer[i], CL_FALSE, 0,
+            CHUNK_FLOATS * sizeof(float), data + i*CHUNK_FLOATS,
+            0, NULL, &write_event[i]);
+      if(err < 0) {
+         perror("Couldn't write the buffer");
+         exit(1);
+      }
+
+      err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &chunk_buffer[i]);
+      err |= clSetKernelArg(kernel, 1, sizeof(cl_uint), &iterations);
+      if(err < 0) {
+         perror("Couldn't set a kernel argument");
+         exit(1);
+      };
+      err = clEnqueueNDRangeKernel(compute_queue, kernel, 1, NULL, &global_size,
+            NULL, 1, &write_event[i], &kernel_event[i]);
+      if(err < 0) {
+         perror("Couldn't enqueue the kernel");
+         exit(1);
+      }
+
+      err = clEnqueueReadBuffer(transfer_queue, chunk_buffer[i], CL_FALSE, 0,
+            CHUNK_FLOATS * sizeof(float), data + i*CHUNK_FLOATS,
+            1, &kernel_event[i], NULL);
+      if(err < 0) {
+         perror("Couldn't read the buffer");
+         exit(1);
+      }
+      clFlush(transfer_queue);
+      clFlush(compute_queue);
+   }
+   clFinish(transfer_queue);
+   clFinish(compute_queue);
+
+   /* x stays 1 under x = 0.999x + 0.001 */
+   check = 1;
+   for(j=0; j<NUM_CHUNKS * CHUNK_FLOATS; j++) {
+      if(fabs(data[j] - 1.0f) > 1.0e-4f) {
+         check = 0;
+         break;
+      }
+   }
+   if(check)
+      printf("Check passed.\n");
+   else
+      printf("Check failed.\n");
+
+   /* Write the trace now rather than at exit */
+   trace_write();
+
+   /* Deallocate resources */
+   for(i=0; i<NUM_CHUNKS; i++) {
+      clReleaseEvent(write_event[i]);
+      clReleaseEvent(kernel_event[i]);
+      clReleaseMemObject(chunk_buffer[i]);
+   }
+   free(data);
+   clReleaseKernel(kernel);
+   clReleaseCommandQueue(transfer_queue);
+   clReleaseCommandQueue(compute_queue);
+   clReleaseProgram(program);
+   clReleaseContext(context);
+   return 0;
+}
@@ -0,0 +1,10 @@
+__kernel void trace(__global float4 *data, uint iterations) {
+
+   float4 x = data[get_global_id(0)];
+
+   /* Enough arithmetic per element to make compute visible */
+   for(uint i=0; i<iterations; i++) {
+      x = mad(x, (float4)(0.999f), (float4)(0.001f));
+   }
+   data[get_global_id(0)] = x;
+}
@@ -0,0 +1,241 @@
+#define _POSIX_C_SOURCE 200809L
+#define TEXT_FILE "../../Ch11/string_search/kafka.txt"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "worker_client.h"
+
+static const char *job_names[NUM_JOBS] = {
+   "sort", "reduce", "search", "fft", "solve"
+};
+
+static double now(void) {
+   struct timespec t;
+   clock_gettime(CLOCK_MONOTONIC, &t);
+   return t.tv_sec + t.tv_nsec * 1.0e-9;
+}
+
+/* Submit one job, exiting if the worker can't be reached or the job
+   fails. Adds the round trip and the worker's own time to the totals */
+static void submit(int sock, const worker_request *req, int fd,
+      worker_reply *reply, double *round_trip, double *worker_time) {
+
+   double start = now();
+
+   if(worker_submit(sock, req, fd, reply) < 0) {
+      perror("Lost the connection to the worker");
+      exit(1);
+   }
+   if(reply->status < 0) {
+      printf("The %s job failed: error %d\n", job_names[req->job],
+            reply->status);
+      exit(1);
+   }
+   *round_trip += now() - start;
+   *worker_time += reply->seconds;
+}
+
+/* Write the job's input into shared memory */
+static void fill(worker_request *req, void *data, const char *text,
+      size_t text_size) {
+
+   float *f = (float*)data;
+   int *rows, *cols, dim, i, j;
+   size_t k;
+
+   switch(req->job) {
+      case JOB_SORT:
+         for(k=0; k<req->count; k++)
+            f[k] = (float)rand()/RAND_MAX;
+         break;
+      case JOB_REDUCE:
+         for(k=0; k<req->count; k++)
+            f[k] = (float)(k % 8);
+         break;
+      case JOB_SEARCH:
+         memcpy(data, text, req->count);
+         break;
+      case JOB_FFT:
+         for(k=0; k<2*req->count; k++)
+            f[k] = (float)rand()/RAND_MAX;
+         break;
+
+      /* The tridiagonal system 4x[i] - x[i-1] - x[i+1] = 1 */
+      case JOB_SOLVE:
+         dim = (int)req->count;
+         rows = (int*)data;
+         cols = rows + req->num_values;
+         f = (float*)(cols + req->num_values);
+         for(i=0, j=0; i<dim; i++) {
+            if(i > 0) {
+               rows[j] = i; cols[j] = i-1; f[j++] = -1.0f;
+            }
+            rows[j] = i; cols[j] = i; f[j++] = 4.0f;
+            if(i < dim-1) {
+               rows[j] = i; cols[j] = i+1; f[j++] = -1.0f;
+            }
+         }
+         for(i=0; i<dim; i++)
+            f[req->num_values + i] = 1.0f;
+         break;
+   }
+}
+
+int main(int argc, char **argv) {
+
+   worker_request req;
+   worker_reply reply;
+   const char *path = WORKER_SOCKET;
+   char *text = NULL;
+   FILE *text_handle;
+   size_t text_size = 0, k;
+   unsigned long n = 0;
+   double round_trip = 0.0, worker_time = 0.0, sum, error;
+   float *data, *original = NULL;
+   void *shared;
+   int sock, fd, reps = 100, rep, i, expected, check = 1;
+
+   if(argc < 2) {
+      printf("Usage: %s sort|reduce|search|fft|solve [n] "
+            "[-r reps] [-s socket]\n", argv[0]);
+      exit(1);
+   }
+   memset(&req, 0, sizeof(req));
+   req.job = -1;
+   for(i=0; i<NUM_JOBS; i++)
+      if(strcmp(argv[1], job_names[i]) == 0)
+         req.job = i;
+   if(req.job < 0) {
+      printf("Unknown job %s\n", argv[1]);
+      exit(1);
+   }
+   for(i=2; i<argc; i++) {
+      if(strcmp(argv[i], "-r") == 0 && i+1 < argc)
+         reps = atoi(argv[++i]);
+      else if(strcmp(argv[i], "-s") == 0 && i+1 < argc)
+         path = argv[++i];
+      else
+         n = strtoul(argv[i], NULL, 10);
+   }
+
+   /* Sizes the worker accepts for each job */
+   switch(req.job) {
+      case JOB_SORT:
+      case JOB_REDUCE:
+         req.count = n ? n : 1 << 20;
+         break;
+      case JOB_FFT:
+         req.count = n ? n : 1 << 16;
+         req.direction = 1;
+         break;
+      case JOB_SOLVE:
+         req.count = n ? n : 64;
+         req.num_values = 3 * req.count - 2;
+         break;
+      case JOB_SEARCH:
+         text_handle = fopen(TEXT_FILE, "rb");
+         if(text_handle == NULL) {
+            perror("Couldn't find the text file");
+            exit(1);
+         }
+         fseek(text_handle, 0, SEEK_END);
+         text_size = ftell(text_handle);
+         rewind(text_handle);
+         text = (char*)malloc(text_size);
+         fread(text, sizeof(char), text_size, text_handle);
+         fclose(text_handle);
+         req.count = (n && n < text_size) ? n : text_size;
+         memcpy(req.pattern, "thatwithhavefrom", 16);
+         break;
+   }
+   req.size = worker_job_size(&req);
+
+   sock = worker_connect(path);
+   if(sock < 0) {
+      perror("Couldn't connect to the worker");
+      exit(1);
+   }
+   fd = worker_shared(req.size, &shared);
+   if(fd < 0) {
+      perror("Couldn't create shared memory");
+      exit(1);
+   }
+   data = (float*)shared;
+   if(req.job == JOB_FFT)
+      original = (float*)malloc(req.size);
+
+   /* The inputs are rewritten every time, since sort and fft work in
+      place. An fft repetition is a forward and an inverse transform */
+   srand(0);
+   for(rep=0; rep<reps; rep++) {
+      fill(&req, shared, text, text_size);
+      if(req.job == JOB_FFT) {
+         memcpy(original, data, req.size);
+         req.direction = 1;
+         submit(sock, &req, fd, &reply, &round_trip, &worker_time);
+         req.direction = -1;
+      }
+      submit(sock, &req, fd, &reply, &round_trip, &worker_time);
+   }
+
+   /* Check the last repetition */
+   switch(req.job) {
+      case JOB_SORT:
+         for(k=1; k<req.count; k++)
+            if(data[k] < data[k-1])
+               check = 0;
+         break;
+      case JOB_REDUCE:
+         sum = 0.0;
+         for(k=0; k<req.count; k++)
+            sum += data[k];
+         check = fabs(reply.values[0] - sum) <= 1.0e-6 * sum;
+         printf("Sum: %.1f\n", reply.values[0]);
+         break;
+      case JOB_SEARCH:
+         for(i=0; i<4; i++) {
+            expected = 0;
+            for(k=0; k+4<=req.count; k++)
+               if(memcmp(text + k, req.pattern + 4*i, 4) == 0)
+                  expected++;
+            printf("%.4s: %d\n", req.pattern + 4*i, reply.counts[i]);
+            if(reply.counts[i] != expected)
+               check = 0;
+         }
+         break;
+      case JOB_FFT:
+         error = 0.0;
+         for(k=0; k<2*req.count; k++)
+            error = fmax(error, fabs(data[k] - original[k]));
+         check = error < 1.0e-3;
+         break;
+      case JOB_SOLVE:
+         printf("Iterations: %.0f, residual: %f\n",
+               reply.values[0], reply.values[1]);
+         check = reply.values[0] < 1000.0f && reply.values[1] < 0.01f;
+         break;
+   }
+
+   if(req.job == JOB_FFT)
+      reps *= 2;
+   printf("%d %s jobs of %u: %.1f us round trip, %.1f us in the worker\n",
+         reps, job_names[req.job], req.count,
+         round_trip * 1.0e6/reps, worker_time * 1.0e6/reps);
+   if(check)
+      printf("Check passed.\n");
+   else
+      printf("Check failed.\n");
+
+   munmap(shared, req.size);
+   close(fd);
+   close(sock);
+   free(text);
+   free(original);
+   return 0;
+}
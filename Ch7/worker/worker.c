@@ -0,0 +1,218 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#define MAX_CLIENTS 64
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "worker_jobs.h"
+
+static volatile sig_atomic_t stopping = 0;
+
+static void stop(int sig) {
+   stopping = 1;
+}
+
+/* Read a request and the descriptor sent with it. Returns 1 for a
+   request, 0 when the client has closed, -1 on error */
+static int receive_request(int sock, worker_request *req, int *fd) {
+
+   union {
+      char buf[CMSG_SPACE(sizeof(int))];
+      struct cmsghdr align;
+   } control;
+   struct msghdr msg;
+   struct iovec iov;
+   struct cmsghdr *cmsg;
+   size_t received = 0;
+   ssize_t n;
+
+   *fd = -1;
+   memset(&msg, 0, sizeof(msg));
+   iov.iov_base = req;
+   iov.iov_len = sizeof(*req);
+   msg.msg_iov = &iov;
+   msg.msg_iovlen = 1;
+   msg.msg_control = control.buf;
+   msg.msg_controllen = sizeof(control.buf);
+
+   n = recvmsg(sock, &msg, 0);
+   if(n <= 0)
+      return (int)n;
+   for(cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL;
+         cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+         memcpy(fd, CMSG_DATA(cmsg), sizeof(int));
+   }
+
+   /* The rest of a request split by the stream */
+   received = n;
+   while(received < sizeof(*req)) {
+      n = recv(sock, (char*)req + received, sizeof(*req) - received, 0);
+      if(n <= 0) {
+         if(*fd >= 0)
+            close(*fd);
+         return -1;
+      }
+      received += n;
+   }
+   return 1;
+}
+
+static int send_reply(int sock, const worker_reply *reply) {
+
+   size_t sent = 0;
+   ssize_t n;
+
+   while(sent < sizeof(*reply)) {
+      n = send(sock, (const char*)reply + sent, sizeof(*reply) - sent, 0);
+      if(n < 0)
+         return -1;
+      sent += n;
+   }
+   return 0;
+}
+
+/* Map the job's shared memory, run it and reply. Returns -1 if the
+   connection should be closed */
+static int serve_job(worker_state *w, int sock) {
+
+   worker_request req;
+   worker_reply reply;
+   struct timespec start, end;
+   struct stat st;
+   void *data;
+   int fd, result;
+
+   result = receive_request(sock, &req, &fd);
+   if(result <= 0)
+      return -1;
+
+   memset(&reply, 0, sizeof(reply));
+   clock_gettime(CLOCK_MONOTONIC, &start);
+   if(fd < 0 || req.job < 0 || req.job >= NUM_JOBS)
+      reply.status = CL_INVALID_VALUE;
+   else if(fstat(fd, &st) < 0 || req.size == 0 ||
+         (unsigned long)st.st_size < req.size ||
+         req.size < worker_job_size(&req))
+      reply.status = CL_INVALID_BUFFER_SIZE;
+   else {
+      data = mmap(NULL, req.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if(data == MAP_FAILED)
+         reply.status = CL_OUT_OF_HOST_MEMORY;
+      else {
+         worker_run(w, &req, data, &reply);
+         munmap(data, req.size);
+      }
+   }
+   if(fd >= 0)
+      close(fd);
+   clock_gettime(CLOCK_MONOTONIC, &end);
+   reply.seconds = (end.tv_sec - start.tv_sec) +
+         (end.tv_nsec - start.tv_nsec) * 1.0e-9;
+
+   return send_reply(sock, &reply);
+}
+
+int main(int argc, char **argv) {
+
+   worker_state w;
+   struct sockaddr_un addr;
+   struct pollfd fds[MAX_CLIENTS + 1];
+   struct sigaction action;
+   const char *path = WORKER_SOCKET;
+   int listener, num_fds = 1, cpu = 0, i, client;
+
+   for(i=1; i<argc; i++) {
+      if(strcmp(argv[i], "-cpu") == 0)
+         cpu = 1;
+      else if(argv[i][0] != '-')
+         path = argv[i];
+      else {
+         printf("Usage: %s [-cpu] [socket]\n", argv[0]);
+         exit(1);
+      }
+   }
+
+   /* Device, context, queue and every program, built once */
+   worker_init(&w, cpu);
+
+   listener = socket(AF_UNIX, SOCK_STREAM, 0);
+   if(listener < 0) {
+      perror("Couldn't create the socket");
+      exit(1);
+   }
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+   unlink(path);
+   if(bind(listener, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+         listen(listener, 16) < 0) {
+      perror("Couldn't listen on the socket");
+      exit(1);
+   }
+
+   /* Stop cleanly on SIGINT or SIGTERM. A client that goes away while
+      it's owed a reply must not kill the worker */
+   memset(&action, 0, sizeof(action));
+   action.sa_handler = stop;
+   sigaction(SIGINT, &action, NULL);
+   sigaction(SIGTERM, &action, NULL);
+   signal(SIGPIPE, SIG_IGN);
+
+   printf("Worker on %s ready, running on %s with %d of %d programs "
+         "precompiled\n", path, w.device_name, w.num_precompiled, NUM_JOBS);
+   fflush(stdout);
+
+   /* Clients stay connected and send one job at a time. Jobs run in
+      the order they arrive */
+   fds[0].fd = listener;
+   fds[0].events = POLLIN;
+   while(!stopping) {
+      if(poll(fds, num_fds, -1) < 0) {
+         if(errno == EINTR)
+            continue;
+         perror("Couldn't poll the sockets");
+         break;
+      }
+
+      for(i=1; i<num_fds; i++) {
+         if(fds[i].revents == 0)
+            continue;
+         if(!(fds[i].revents & POLLIN) || serve_job(&w, fds[i].fd) < 0) {
+            close(fds[i].fd);
+            fds[i--] = fds[--num_fds];
+         }
+      }
+
+      if(fds[0].revents & POLLIN) {
+         client = accept(listener, NULL, NULL);
+         if(client >= 0 && num_fds == MAX_CLIENTS + 1)
+            close(client);
+         else if(client >= 0) {
+            fds[num_fds].fd = client;
+            fds[num_fds].events = POLLIN;
+            fds[num_fds].revents = 0;
+            num_fds++;
+         }
+      }
+   }
+
+   for(i=1; i<num_fds; i++)
+      close(fds[i].fd);
+   close(listener);
+   unlink(path);
+   worker_release(&w);
+   return 0;
+}
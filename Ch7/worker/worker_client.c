@@ -0,0 +1,95 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "worker_client.h"
+
+int worker_connect(const char *path) {
+
+   struct sockaddr_un addr;
+   int sock;
+
+   sock = socket(AF_UNIX, SOCK_STREAM, 0);
+   if(sock < 0)
+      return -1;
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+   if(connect(sock, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+      close(sock);
+      return -1;
+   }
+   return sock;
+}
+
+int worker_shared(size_t size, void **data) {
+
+   static int count = 0;
+   char name[64];
+   int fd;
+
+   /* Unlink the name at once, the descriptor is all that's needed */
+   snprintf(name, sizeof(name), "/cl_worker_%ld_%d", (long)getpid(), count++);
+   fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+   if(fd < 0)
+      return -1;
+   shm_unlink(name);
+
+   if(ftruncate(fd, size) < 0) {
+      close(fd);
+      return -1;
+   }
+   *data = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if(*data == MAP_FAILED) {
+      close(fd);
+      return -1;
+   }
+   return fd;
+}
+
+int worker_submit(int sock, const worker_request *req, int shm_fd,
+      worker_reply *reply) {
+
+   union {
+      char buf[CMSG_SPACE(sizeof(int))];
+      struct cmsghdr align;
+   } control;
+   struct msghdr msg;
+   struct iovec iov;
+   struct cmsghdr *cmsg;
+   size_t received = 0;
+   ssize_t n;
+
+   /* The descriptor rides along with the request */
+   memset(&msg, 0, sizeof(msg));
+   memset(&control, 0, sizeof(control));
+   iov.iov_base = (void*)req;
+   iov.iov_len = sizeof(*req);
+   msg.msg_iov = &iov;
+   msg.msg_iovlen = 1;
+   msg.msg_control = control.buf;
+   msg.msg_controllen = sizeof(control.buf);
+   cmsg = CMSG_FIRSTHDR(&msg);
+   cmsg->cmsg_level = SOL_SOCKET;
+   cmsg->cmsg_type = SCM_RIGHTS;
+   cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+   memcpy(CMSG_DATA(cmsg), &shm_fd, sizeof(int));
+
+   if(sendmsg(sock, &msg, 0) != (ssize_t)sizeof(*req))
+      return -1;
+
+   while(received < sizeof(*reply)) {
+      n = recv(sock, (char*)reply + received, sizeof(*reply) - received, 0);
+      if(n <= 0)
+         return -1;
+      received += n;
+   }
+   return 0;
+}
@@ -0,0 +1,21 @@
+#ifndef WORKER_CLIENT_H
+#define WORKER_CLIENT_H
+
+#include <stddef.h>
+
+#include "worker_protocol.h"
+
+/* Connect to a worker. Returns the socket, or -1 */
+int worker_connect(const char *path);
+
+/* Create size bytes of shared memory and map them at *data. Returns
+   its descriptor, or -1. The memory has no name, so it goes away once
+   the descriptor is closed and the memory unmapped */
+int worker_shared(size_t size, void **data);
+
+/* Send a job with its shared memory and wait for the reply. Returns 0,
+   or -1 if the connection failed. The job's status is in the reply */
+int worker_submit(int sock, const worker_request *req, int shm_fd,
+      worker_reply *reply);
+
+#endif
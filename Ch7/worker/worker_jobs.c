@@ -0,0 +1,561 @@
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "worker_jobs.h"
+#include "program_binary.h"
+
+#define CHARS_PER_ITEM 256
+
+/* The kernels include device_lib.h or accumulate.h from Ch2/program_link */
+#define DEVICE_LIB_OPTION "-I../../Ch2/program_link"
+
+/* One program per job, from the examples that introduced it */
+static const char *program_files[NUM_JOBS] = {
+   "../../Ch11/bsort/bsort.cl",
+   "../../Ch10/reduction/reduction.cl",
+   "../../Ch11/string_search/string_search.cl",
+   "../../Ch14/fft/fft.cl",
+   "../../Ch13/conj_grad/conj_grad.cl"
+};
+
+/* Embedded by the Makefile, compiled for the device the worker was
+   built for */
+#ifdef PRECOMPILED
+#include "worker_binaries.h"
+#endif
+
+static const program_image *program_images[NUM_JOBS] = {
+   PROGRAM_IMAGE(bsort), PROGRAM_IMAGE(reduction),
+   PROGRAM_IMAGE(string_search), PROGRAM_IMAGE(fft),
+   PROGRAM_IMAGE(conj_grad)
+};
+
+static const struct {
+   const char *name;
+   int program;
+} kernel_table[NUM_KERNELS] = {
+   {"bsort_init", JOB_SORT}, {"bsort_stage_0", JOB_SORT},
+   {"bsort_stage_n", JOB_SORT}, {"bsort_merge", JOB_SORT},
+   {"bsort_merge_last", JOB_SORT}, {"reduction_vector", JOB_REDUCE},
+   {"string_search", JOB_SEARCH}, {"fft_init", JOB_FFT},
+   {"fft_stage", JOB_FFT}, {"fft_scale", JOB_FFT},
+   {"conj_grad", JOB_SOLVE}
+};
+
+/* Find a GPU or CPU associated with the first available platform.
+   With cpu set, only a CPU will do */
+static cl_device_id create_device(int cpu) {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   }
+
+   /* Access a device */
+   err = CL_DEVICE_NOT_FOUND;
+   if(!cpu)
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);
+   }
+
+   return dev;
+}
+
+static size_t pow2_floor(size_t x) {
+   size_t p = 1;
+   while(2 * p <= x)
+      p *= 2;
+   return p;
+}
+
+static int size_class(size_t size) {
+   int c = 12;
+   while(((size_t)1 << c) < size)
+      c++;
+   return c;
+}
+
+/* A buffer of at least size bytes, reused from an earlier job if one
+   of its class is free */
+static cl_mem pool_acquire(worker_state *w, size_t size, cl_int *err) {
+
+   int c = size_class(size);
+
+   *err = CL_SUCCESS;
+   if(c >= POOL_CLASSES) {
+      *err = CL_INVALID_BUFFER_SIZE;
+      return NULL;
+   }
+   if(w->pool_count[c] > 0)
+      return w->pool[c][--w->pool_count[c]];
+   return clCreateBuffer(w->context, CL_MEM_READ_WRITE,
+         (size_t)1 << c, NULL, err);
+}
+
+static void pool_release(worker_state *w, cl_mem buffer) {
+
+   size_t size;
+   int c;
+
+   if(buffer == NULL)
+      return;
+   clGetMemObjectInfo(buffer, CL_MEM_SIZE, sizeof(size), &size, NULL);
+   c = size_class(size);
+   if(w->pool_count[c] < POOL_DEPTH)
+      w->pool[c][w->pool_count[c]++] = buffer;
+   else
+      clReleaseMemObject(buffer);
+}
+
+void worker_init(worker_state *w, int cpu) {
+
+   cl_int err;
+   int i, precompiled;
+
+   w->device = create_device(cpu);
+   clGetDeviceInfo(w->device, CL_DEVICE_NAME, sizeof(w->device_name),
+         w->device_name, NULL);
+   clGetDeviceInfo(w->device, CL_DEVICE_LOCAL_MEM_SIZE,
+         sizeof(w->local_mem), &w->local_mem, NULL);
+   w->context = clCreateContext(NULL, 1, &w->device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);
+   }
+   w->queue = clCreateCommandQueue(w->context, w->device, 0, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);
+   };
+
+   /* Build once, here, instead of once per job. Precompiled programs
+      only need loading */
+   w->num_precompiled = 0;
+   for(i=0; i<NUM_JOBS; i++) {
+      w->programs[i] = program_load(w->context, w->device,
+            program_images[i], program_files[i], DEVICE_LIB_OPTION,
+            &precompiled);
+      w->num_precompiled += precompiled;
+   }
+   for(i=0; i<NUM_KERNELS; i++) {
+      w->kernels[i] = clCreateKernel(w->programs[kernel_table[i].program],
+            kernel_table[i].name, &err);
+      if(err < 0) {
+         printf("Couldn't create the %s kernel\n", kernel_table[i].name);
+         exit(1);
+      }
+      clGetKernelWorkGroupInfo(w->kernels[i], w->device,
+            CL_KERNEL_WORK_GROUP_SIZE, sizeof(w->group_sizes[i]),
+            &w->group_sizes[i], NULL);
+   }
+
+   for(i=0; i<POOL_CLASSES; i++)
+      w->pool_count[i] = 0;
+}
+
+/* Sort with the launch sequence of Ch11/bsort */
+static cl_int run_sort(worker_state *w, const worker_request *req,
+      float *data) {
+
+   cl_kernel *k = &w->kernels[K_BSORT_INIT];
+   size_t n = req->count, global_size = n/8, local_size;
+   cl_uint stage, high_stage, num_stages;
+   cl_mem buffer;
+   cl_int err;
+   int i, direction = req->direction;
+
+   if(n < 8 || (n & (n-1)) != 0)
+      return CL_INVALID_VALUE;
+
+   /* Every work-item sorts eight floats in local memory */
+   local_size = pow2_floor(w->group_sizes[K_BSORT_INIT]);
+   while(8 * local_size * sizeof(float) > w->local_mem)
+      local_size /= 2;
+   if(local_size > global_size)
+      local_size = global_size;
+
+   buffer = pool_acquire(w, n * sizeof(float), &err);
+   if(err < 0)
+      return err;
+   err = clEnqueueWriteBuffer(w->queue, buffer, CL_FALSE, 0,
+         n * sizeof(float), data, 0, NULL, NULL);
+   for(i=0; i<5; i++) {
+      if(err == CL_SUCCESS)
+         err = clSetKernelArg(k[i], 0, sizeof(cl_mem), &buffer);
+      if(err == CL_SUCCESS)
+         err = clSetKernelArg(k[i], 1, 8 * local_size * sizeof(float), NULL);
+   }
+   if(err == CL_SUCCESS)
+      err = clSetKernelArg(k[3], 3, sizeof(int), &direction);
+   if(err == CL_SUCCESS)
+      err = clSetKernelArg(k[4], 2, sizeof(int), &direction);
+   if(err == CL_SUCCESS)
+      err = clEnqueueNDRangeKernel(w->queue, k[0], 1, NULL, &global_size,
+            &local_size, 0, NULL, NULL);
+
+   num_stages = (cl_uint)(global_size/local_size);
+   for(high_stage = 2; high_stage < num_stages; high_stage <<= 1) {
+      if(err == CL_SUCCESS)
+         err = clSetKernelArg(k[1], 2, sizeof(int), &high_stage);
+      if(err == CL_SUCCESS)
+         err = clSetKernelArg(k[2], 3, sizeof(int), &high_stage);
+      for(stage = high_stage; stage > 1; stage >>= 1) {
+         if(err == CL_SUCCESS)
+            err = clSetKernelArg(k[2], 2, sizeof(int), &stage);
+         if(err == CL_SUCCESS)
+            err = clEnqueueNDRangeKernel(w->queue, k[2], 1, NULL,
+                  &global_size, &local_size, 0, NULL, NULL);
+      }
+      if(err == CL_SUCCESS)
+         err = clEnqueueNDRangeKernel(w->queue, k[1], 1, NULL,
+               &global_size, &local_size, 0, NULL, NULL);
+   }
+   for(stage = num_stages; stage > 1; stage >>= 1) {
+      if(err == CL_SUCCESS)
+         err = clSetKernelArg(k[3], 2, sizeof(int), &stage);
+      if(err == CL_SUCCESS)
+         err = clEnqueueNDRangeKernel(w->queue, k[3], 1, NULL,
+               &global_size, &local_size, 0, NULL, NULL);
+   }
+   if(err == CL_SUCCESS)
+      err = clEnqueueNDRangeKernel(w->queue, k[4], 1, NULL,
+            &global_size, &local_size, 0, NULL, NULL);
+
+   if(err == CL_SUCCESS)
+      err = clEnqueueReadBuffer(w->queue, buffer, CL_TRUE, 0,
+            n * sizeof(float), data, 0, NULL, NULL);
+   pool_release(w, buffer);
+   return err;
+}
+
+/* Sum with reduction_vector, padding with zeros to whole work-groups */
+static cl_int run_reduce(worker_state *w, const worker_request *req,
+      float *data, worker_reply *reply) {
+
+   size_t n = req->count, local_size, global_size, num_groups, g;
+   const float zero = 0.0f;
+   float *partial_sums;
+   double sum = 0.0;
+   cl_mem buffer, output = NULL;
+   cl_int err;
+
+   local_size = pow2_floor(w->group_sizes[K_REDUCE]);
+   if(local_size > 256)
+      local_size = 256;
+   global_size = (n + 3)/4;
+   global_size = (global_size + local_size - 1)/local_size * local_size;
+   num_groups = global_size/local_size;
+   if(n == 0)
+      return CL_INVALID_VALUE;
+
+   buffer = pool_acquire(w, global_size * 4 * sizeof(float), &err);
+   if(err == CL_SUCCESS)
+      output = pool_acquire(w, num_groups * sizeof(float), &err);
+   if(err < 0) {
+      pool_release(w, buffer);
+      return err;
+   }
+   partial_sums = (float*)malloc(num_groups * sizeof(float));
+
+   err = clEnqueueWriteBuffer(w->queue, buffer, CL_FALSE, 0,
+         n * sizeof(float), data, 0, NULL, NULL);
+   if(global_size * 4 > n)
+      if(err == CL_SUCCESS)
+         err = clEnqueueFillBuffer(w->queue, buffer, &zero, sizeof(zero),
+               n * sizeof(float), (global_size * 4 - n) * sizeof(float),
+               0, NULL, NULL);
+   if(err == CL_SUCCESS)
+      err = clSetKernelArg(w->kernels[K_REDUCE], 0, sizeof(cl_mem), &buffer);
+   if(err == CL_SUCCESS)
+      err = clSetKernelArg(w->kernels[K_REDUCE], 1,
+            local_size * 4 * sizeof(float), NULL);
+   if(err == CL_SUCCESS)
+      err = clSetKernelArg(w->kernels[K_REDUCE], 2, sizeof(cl_mem), &output);
+   if(err == CL_SUCCESS)
+      err = clEnqueueNDRangeKernel(w->queue, w->kernels[K_REDUCE], 1, NULL,
+            &global_size, &local_size, 0, NULL, NULL);
+   if(err == CL_SUCCESS)
+      err = clEnqueueReadBuffer(w->queue, output, CL_TRUE, 0,
+            num_groups * sizeof(float), partial_sums, 0, NULL, NULL);
+
+   for(g=0; g<num_groups; g++)
+      sum += partial_sums[g];
+   reply->values[0] = (float)sum;
+
+   free(partial_sums);
+   pool_release(w, buffer);
+   pool_release(w, output);
+   return err;
+}
+
+/* Count the pattern's four words with string_search. The text is
+   padded with zeros, which match nothing */
+static cl_int run_search(worker_state *w, const worker_request *req,
+      char *text, worker_reply *reply) {
+
+   size_t n = req->count, local_size, global_size, padded;
+   int chars_per_item = CHARS_PER_ITEM;
+   const int zeros[4] = {0, 0, 0, 0};
+   const char zero = 0;
+   cl_mem buffer, output = NULL;
+   cl_int err;
+
+   local_size = pow2_floor(w->group_sizes[K_SEARCH]);
+   if(local_size > 64)
+      local_size = 64;
+   global_size = (n + CHARS_PER_ITEM - 1)/CHARS_PER_ITEM;
+   global_size = (global_size + local_size - 1)/local_size * local_size;
+   padded = global_size * CHARS_PER_ITEM + 16;
+   if(n == 0)
+      return CL_INVALID_VALUE;
+
+   buffer = pool_acquire(w, padded, &err);
+   if(err == CL_SUCCESS)
+      output = pool_acquire(w, sizeof(zeros), &err);
+   if(err < 0) {
+      pool_release(w, buffer);
+      return err;
+   }
+
+   err = clEnqueueWriteBuffer(w->queue, buffer, CL_FALSE, 0, n, text,
+         0, NULL, NULL);
+   if(err == CL_SUCCESS)
+      err = clEnqueueFillBuffer(w->queue, buffer, &zero, 1, n, padded - n,
+            0, NULL, NULL);
+   if(err == CL_SUCCESS)
+      err = clEnqueueWriteBuffer(w->queue, output, CL_FALSE, 0, sizeof(zeros),
+            zeros, 0, NULL, NULL);
+   if(err == CL_SUCCESS)
+      err = clSetKernelArg(w->kernels[K_SEARCH], 0, sizeof(req->pattern),
+            req->pattern);
+   if(err == CL_SUCCESS)
+      err = clSetKernelArg(w->kernels[K_SEARCH], 1, sizeof(cl_mem), &buffer);
+   if(err == CL_SUCCESS)
+      err = clSetKernelArg(w->kernels[K_SEARCH], 2, sizeof(chars_per_item),
+            &chars_per_item);
+   if(err == CL_SUCCESS)
+      err = clSetKernelArg(w->kernels[K_SEARCH], 3, 4 * sizeof(int), NULL);
+   if(err == CL_SUCCESS)
+      err = clSetKernelArg(w->kernels[K_SEARCH], 4, sizeof(cl_mem), &output);
+   if(err == CL_SUCCESS)
+      err = clEnqueueNDRangeKernel(w->queue, w->kernels[K_SEARCH], 1, NULL,
+            &global_size, &local_size, 0, NULL, NULL);
+   if(err == CL_SUCCESS)
+      err = clEnqueueReadBuffer(w->queue, output, CL_TRUE, 0,
+            sizeof(reply->counts), reply->counts, 0, NULL, NULL);
+
+   pool_release(w, buffer);
+   pool_release(w, output);
+   return err;
+}
+
+/* Transform with the launch sequence of Ch14/fft */
+static cl_int run_fft(worker_state *w, const worker_request *req,
+      float *data) {
+
+   cl_uint num_points = req->count, points_per_group, stage;
+   size_t local_size, global_size;
+   int direction = req->direction < 0 ? -1 : 1;
+   cl_mem buffer;
+   cl_int err;
+
+   if(num_points < 4 || (num_points & (num_points-1)) != 0)
+      return CL_INVALID_VALUE;
+
+   /* Powers of two, at least four points per work-item */
+   points_per_group = 1;
+   while(2 * points_per_group * 2 * sizeof(float) <= w->local_mem)
+      points_per_group *= 2;
+   if(points_per_group > num_points)
+      points_per_group = num_points;
+   local_size = pow2_floor(w->group_sizes[K_FFT_INIT]);
+   if(local_size > points_per_group/4)
+      local_size = points_per_group/4;
+   global_size = (num_points/points_per_group) * local_size;
+
+   buffer = pool_acquire(w, num_points * 2 * sizeof(float), &err);
+   if(err < 0)
+      return err;
+   err = clEnqueueWriteBuffer(w->queue, buffer, CL_FALSE, 0,
+         num_points * 2 * sizeof(float), data, 0, NULL, NULL);
+
+   if(err == CL_SUCCESS)
+      err = clSetKernelArg(w->kernels[K_FFT_INIT], 0, sizeof(cl_mem), &buffer);
+   if(err == CL_SUCCESS)
+      err = clSetKernelArg(w->kernels[K_FFT_INIT], 1,
+            points_per_group * 2 * sizeof(float), NULL);
+   if(err == CL_SUCCESS)
+      err = clSetKernelArg(w->kernels[K_FFT_INIT], 2,
+            sizeof(points_per_group), &points_per_group);
+   if(err == CL_SUCCESS)
+      err = clSetKernelArg(w->kernels[K_FFT_INIT], 3,
+            sizeof(num_points), &num_points);
+   if(err == CL_SUCCESS)
+      err = clSetKernelArg(w->kernels[K_FFT_INIT], 4,
+            sizeof(direction), &direction);
+   if(err == CL_SUCCESS)
+      err = clEnqueueNDRangeKernel(w->queue, w->kernels[K_FFT_INIT], 1, NULL,
+            &global_size, &local_size, 0, NULL, NULL);
+
+   if(err == CL_SUCCESS)
+      err = clSetKernelArg(w->kernels[K_FFT_STAGE], 0, sizeof(cl_mem), &buffer);
+   if(err == CL_SUCCESS)
+      err = clSetKernelArg(w->kernels[K_FFT_STAGE], 2,
+            sizeof(points_per_group), &points_per_group);
+   if(err == CL_SUCCESS)
+      err = clSetKernelArg(w->kernels[K_FFT_STAGE], 3,
+            sizeof(direction), &direction);
+   for(stage = 2; stage <= num_points/points_per_group; stage <<= 1) {
+      if(err == CL_SUCCESS)
+         err = clSetKernelArg(w->kernels[K_FFT_STAGE], 1, sizeof(stage),
+               &stage);
+      if(err == CL_SUCCESS)
+         err = clEnqueueNDRangeKernel(w->queue, w->kernels[K_FFT_STAGE], 1,
+               NULL, &global_size, &local_size, 0, NULL, NULL);
+   }
+
+   /* Scale values if performing the inverse FFT */
+   if(direction < 0) {
+      if(err == CL_SUCCESS)
+         err = clSetKernelArg(w->kernels[K_FFT_SCALE], 0, sizeof(cl_mem),
+               &buffer);
+      if(err == CL_SUCCESS)
+         err = clSetKernelArg(w->kernels[K_FFT_SCALE], 1,
+               sizeof(points_per_group), &points_per_group);
+      if(err == CL_SUCCESS)
+         err = clSetKernelArg(w->kernels[K_FFT_SCALE], 2,
+               sizeof(num_points), &num_points);
+      if(err == CL_SUCCESS)
+         err = clEnqueueNDRangeKernel(w->queue, w->kernels[K_FFT_SCALE], 1,
+               NULL, &global_size, &local_size, 0, NULL, NULL);
+   }
+
+   if(err == CL_SUCCESS)
+      err = clEnqueueReadBuffer(w->queue, buffer, CL_TRUE, 0,
+            num_points * 2 * sizeof(float), data, 0, NULL, NULL);
+   pool_release(w, buffer);
+   return err;
+}
+
+/* Solve with conj_grad, one work-item per equation in one work-group */
+static cl_int run_solve(worker_state *w, const worker_request *req,
+      char *data, worker_reply *reply) {
+
+   int dim = (int)req->count, num_values = (int)req->num_values, i;
+   size_t global_size = req->count;
+   size_t sizes[4];
+   cl_mem buffers[5] = {NULL, NULL, NULL, NULL, NULL};
+   cl_int err = CL_SUCCESS;
+
+   if(dim == 0 || global_size > w->group_sizes[K_CONJ_GRAD] ||
+         5 * global_size * sizeof(float) > w->local_mem)
+      return CL_INVALID_WORK_GROUP_SIZE;
+
+   /* Rows, columns, values and b, one after the other */
+   sizes[0] = num_values * sizeof(int);
+   sizes[1] = num_values * sizeof(int);
+   sizes[2] = num_values * sizeof(float);
+   sizes[3] = dim * sizeof(float);
+   for(i=0; i<4 && err == CL_SUCCESS; i++) {
+      buffers[i] = pool_acquire(w, sizes[i], &err);
+      if(err == CL_SUCCESS)
+         err = clEnqueueWriteBuffer(w->queue, buffers[i], CL_FALSE, 0,
+               sizes[i], data, 0, NULL, NULL);
+      data += sizes[i];
+   }
+   if(err == CL_SUCCESS)
+      buffers[4] = pool_acquire(w, 2 * sizeof(float), &err);
+   if(err < 0) {
+      for(i=0; i<5; i++)
+         pool_release(w, buffers[i]);
+      return err;
+   }
+
+   err = clSetKernelArg(w->kernels[K_CONJ_GRAD], 0, sizeof(dim), &dim);
+   if(err == CL_SUCCESS)
+      err = clSetKernelArg(w->kernels[K_CONJ_GRAD], 1, sizeof(num_values),
+            &num_values);
+   for(i=2; i<6; i++)
+      if(err == CL_SUCCESS)
+         err = clSetKernelArg(w->kernels[K_CONJ_GRAD], i,
+               dim * sizeof(float), NULL);
+   for(i=0; i<5; i++)
+      if(err == CL_SUCCESS)
+         err = clSetKernelArg(w->kernels[K_CONJ_GRAD], i+6, sizeof(cl_mem),
+               &buffers[i]);
+   if(err == CL_SUCCESS)
+      err = clSetKernelArg(w->kernels[K_CONJ_GRAD], 11, dim * sizeof(float),
+            NULL);
+   if(err == CL_SUCCESS)
+      err = clEnqueueNDRangeKernel(w->queue, w->kernels[K_CONJ_GRAD], 1, NULL,
+            &global_size, &global_size, 0, NULL, NULL);
+   if(err == CL_SUCCESS)
+      err = clEnqueueReadBuffer(w->queue, buffers[4], CL_TRUE, 0,
+            2 * sizeof(float), reply->values, 0, NULL, NULL);
+
+   for(i=0; i<5; i++)
+      pool_release(w, buffers[i]);
+   return err;
+}
+
+void worker_run(worker_state *w, const worker_request *req, void *data,
+      worker_reply *reply) {
+
+   cl_int err = CL_INVALID_VALUE;
+   int i;
+
+   for(i=0; i<4; i++) {
+      reply->counts[i] = 0;
+      reply->values[i] = 0.0f;
+   }
+
+   switch(req->job) {
+      case JOB_SORT:
+         err = run_sort(w, req, (float*)data);
+         break;
+      case JOB_REDUCE:
+         err = run_reduce(w, req, (float*)data, reply);
+         break;
+      case JOB_SEARCH:
+         err = run_search(w, req, (char*)data, reply);
+         break;
+      case JOB_FFT:
+         err = run_fft(w, req, (float*)data);
+         break;
+      case JOB_SOLVE:
+         err = run_solve(w, req, (char*)data, reply);
+         break;
+   }
+
+   /* Don't leave a failed job's commands behind for the next one */
+   if(err < 0)
+      clFinish(w->queue);
+   reply->status = err < 0 ? err : 0;
+}
+
+void worker_release(worker_state *w) {
+
+   int i, j;
+
+   for(i=0; i<POOL_CLASSES; i++)
+      for(j=0; j<w->pool_count[i]; j++)
+         clReleaseMemObject(w->pool[i][j]);
+   for(i=0; i<NUM_KERNELS; i++)
+      clReleaseKernel(w->kernels[i]);
+   for(i=0; i<NUM_JOBS; i++)
+      clReleaseProgram(w->programs[i]);
+   clReleaseCommandQueue(w->queue);
+   clReleaseContext(w->context);
+}
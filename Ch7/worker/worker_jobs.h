@@ -0,0 +1,50 @@
+#ifndef WORKER_JOBS_H
+#define WORKER_JOBS_H
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "worker_protocol.h"
+
+/* Buffers are pooled by power-of-two size, from 4 KB up */
+#define POOL_CLASSES 40
+#define POOL_DEPTH 4
+
+enum {
+   K_BSORT_INIT, K_BSORT_STAGE_0, K_BSORT_STAGE_N, K_BSORT_MERGE,
+   K_BSORT_MERGE_LAST, K_REDUCE, K_SEARCH, K_FFT_INIT, K_FFT_STAGE,
+   K_FFT_SCALE, K_CONJ_GRAD, NUM_KERNELS
+};
+
+/* Everything that stays up between jobs */
+typedef struct worker_state {
+   cl_device_id device;
+   cl_context context;
+   cl_command_queue queue;
+   cl_program programs[NUM_JOBS];
+   cl_kernel kernels[NUM_KERNELS];
+   size_t group_sizes[NUM_KERNELS];     /* CL_KERNEL_WORK_GROUP_SIZE */
+   cl_ulong local_mem;
+   char device_name[128];
+   int num_precompiled;                 /* Programs loaded from binaries */
+
+   /* Released buffers, kept for the next job of the same size class */
+   cl_mem pool[POOL_CLASSES][POOL_DEPTH];
+   int pool_count[POOL_CLASSES];
+} worker_state;
+
+/* Create the context and queue and build every job's program. With cpu
+   set, only a CPU will do. Exits on failure */
+void worker_init(worker_state *w, int cpu);
+
+/* Run a job on data, the request's mapped shared memory. Failures are
+   reported in reply->status, never by exiting */
+void worker_run(worker_state *w, const worker_request *req, void *data,
+      worker_reply *reply);
+
+void worker_release(worker_state *w);
+
+#endif
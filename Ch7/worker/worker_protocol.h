@@ -0,0 +1,60 @@
+#ifndef WORKER_PROTOCOL_H
+#define WORKER_PROTOCOL_H
+
+#define WORKER_SOCKET "/tmp/cl_worker.sock"
+
+/* Jobs the worker runs. The job's data is in shared memory whose file
+   descriptor travels with the request:
+
+   JOB_SORT    count floats, sorted in place. count is a power of two
+               of at least 8. direction 0 sorts up, -1 down
+   JOB_REDUCE  count floats. The sum is returned in values[0]
+   JOB_SEARCH  count characters. counts[k] is the number of places the
+               k-th four characters of pattern occur
+   JOB_FFT     count complex floats, transformed in place. count is a
+               power of two of at least 4. direction 1 is forward,
+               -1 inverse
+   JOB_SOLVE   A symmetric positive-definite system of count equations:
+               num_values row indices, num_values column indices and
+               num_values floats sorted by row, then count floats of b.
+               values[0] is the number of iterations, values[1] the
+               residual */
+enum {
+   JOB_SORT, JOB_REDUCE, JOB_SEARCH, JOB_FFT, JOB_SOLVE, NUM_JOBS
+};
+
+typedef struct worker_request {
+   int job;
+   unsigned int count;
+   unsigned int num_values;
+   int direction;
+   char pattern[16];
+   unsigned long size;        /* Bytes of shared memory */
+} worker_request;
+
+typedef struct worker_reply {
+   int status;                /* 0, or a negative OpenCL error code */
+   int counts[4];
+   float values[4];
+   double seconds;            /* Time the worker spent on the job */
+} worker_reply;
+
+/* Bytes of shared memory a request needs */
+static inline unsigned long worker_job_size(const worker_request *req) {
+
+   switch(req->job) {
+      case JOB_SORT:
+      case JOB_REDUCE:
+         return req->count * sizeof(float);
+      case JOB_SEARCH:
+         return req->count;
+      case JOB_FFT:
+         return req->count * 2 * sizeof(float);
+      case JOB_SOLVE:
+         return req->num_values * (2 * sizeof(int) + sizeof(float)) +
+               req->count * sizeof(float);
+   }
+   return 0;
+}
+
+#endif
@@ -0,0 +1,5 @@
+__kernel void buffer_pool(__global float *data, float factor, uint n) {
+
+   if(get_global_id(0) < n)
+      data[get_global_id(0)] *= factor;
+}
@@ -0,0 +1,103 @@
+#define __CL_ENABLE_EXCEPTIONS
+#define __NO_STD_VECTOR
+#define PROGRAM_FILE "buffer_pool.cl"
+#define KERNEL_FUNC "buffer_pool"
+
+#define NUM_JOBS 10000
+#define MAX_FLOATS 16384
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+#include "device_pool.h"
+#include "program_binary.h"
+
+// The kernels compiled for this machine by the Makefile
+#ifdef PRECOMPILED
+#include "buffer_pool_binaries.h"
+#endif
+
+// Run NUM_JOBS small jobs, each with its own buffer. With a pool the
+// buffer comes from the pool, otherwise it's created and released per job
+static double runJobs(cl::Context& context, cl::CommandQueue& queue,
+      cl::Kernel& kernel, DevicePool *pool, bool& check) {
+   float data[MAX_FLOATS];
+   cl_uint n;
+
+   srand(0);
+   check = true;
+   std::chrono::steady_clock::time_point start =
+         std::chrono::steady_clock::now();
+   for(int job=0; job<NUM_JOBS; job++) {
+      n = 1 + rand() % MAX_FLOATS;
+      for(cl_uint i=0; i<n; i++)
+         data[i] = (float)i;
+
+      cl::Buffer buffer = pool ? pool->acquire(n * sizeof(float)) :
+            cl::Buffer(context, CL_MEM_READ_WRITE, n * sizeof(float));
+      queue.enqueueWriteBuffer(buffer, CL_FALSE, 0, n * sizeof(float), data);
+      kernel.setArg(0, buffer);
+      kernel.setArg(1, 2.0f);
+      kernel.setArg(2, n);
+      queue.enqueueNDRangeKernel(kernel, cl::NullRange, cl::NDRange(n));
+      queue.enqueueReadBuffer(buffer, CL_TRUE, 0, n * sizeof(float), data);
+      if(pool)
+         pool->release(buffer);
+
+      if(data[n-1] != 2.0f * (n-1))
+         check = false;
+   }
+   std::chrono::duration<double> elapsed =
+         std::chrono::steady_clock::now() - start;
+   return elapsed.count();
+}
+
+int main(void) {
+
+   cl::vector<cl::Platform> platforms;
+   cl::vector<cl::Device> devices;
+   bool checkCreate, checkPool;
+
+   try {
+      // Place the GPU devices of the first platform into a context,
+      // or its CPU devices if it has no GPU
+      cl::Platform::get(&platforms);
+      try {
+         platforms[0].getDevices(CL_DEVICE_TYPE_GPU, &devices);
+      }
+      catch(cl::Error e) {
+         platforms[0].getDevices(CL_DEVICE_TYPE_CPU, &devices);
+      }
+      cl::Context context(devices);
+
+      // Create kernel
+      cl::Program program(program_load(context(), devices[0](),
+            PROGRAM_IMAGE(buffer_pool), PROGRAM_FILE, NULL, NULL));
+      cl::Kernel kernel(program, KERNEL_FUNC);
+      cl::CommandQueue queue(context, devices[0]);
+
+      // Per-job clCreateBuffer, then the same jobs from a pool
+      DevicePool pool(context, devices[0]);
+      double createTime = runJobs(context, queue, kernel, NULL, checkCreate);
+      double poolTime = runJobs(context, queue, kernel, &pool, checkPool);
+
+      std::cout << NUM_JOBS << " jobs with clCreateBuffer: "
+            << createTime * 1.0e6/NUM_JOBS << " us per job" << std::endl;
+      std::cout << NUM_JOBS << " jobs from the pool: "
+            << poolTime * 1.0e6/NUM_JOBS << " us per job" << std::endl;
+      std::cout << "Pool: " << pool.blockCount() << " blocks, "
+            << pool.bytesReserved() << " bytes reserved, "
+            << pool.bytesInUse() << " bytes in use" << std::endl;
+
+      if(checkCreate && checkPool)
+         std::cout << "Check passed." << std::endl;
+      else
+         std::cout << "Check failed." << std::endl;
+   }
+   catch(cl::Error e) {
+      std::cout << e.what() << ": Error code " << e.err() << std::endl;
+   }
+
+   return 0;
+}
@@ -0,0 +1,73 @@
+#define __CL_ENABLE_EXCEPTIONS
+#define __NO_STD_VECTOR
+
+#include "device_pool.h"
+
+DevicePool::DevicePool(const cl::Context& context, const cl::Device& device,
+      cl_mem_flags flags, size_t blockSize) :
+      context(context), flags(flags), blockSize(blockSize),
+      blockOffset(0), reserved(0), inUseBytes(0) {
+
+   // The device reports its base address alignment in bits
+   alignment = device.getInfo<CL_DEVICE_MEM_BASE_ADDR_ALIGN>()/8;
+   if(alignment < 256)
+      alignment = 256;
+}
+
+size_t DevicePool::classSize(size_t size) const {
+   size_t c = alignment;
+   while(c < size)
+      c *= 2;
+   return c;
+}
+
+cl::Buffer DevicePool::acquire(size_t size) {
+   std::lock_guard<std::mutex> guard(lock);
+   size_t c = classSize(size);
+   cl::Buffer buffer;
+
+   // Reuse a released buffer of the same class
+   std::vector<cl::Buffer>& freeList = freeLists[c];
+   if(!freeList.empty()) {
+      buffer = freeList.back();
+      freeList.pop_back();
+   }
+
+   // Classes larger than a block get a buffer of their own
+   else if(c > blockSize) {
+      buffer = cl::Buffer(context, flags, c);
+      reserved += c;
+   }
+
+   // Carve a new sub-buffer, starting a new block if this one is full.
+   // Offsets stay aligned because every class is a multiple of alignment
+   else {
+      if(blocks.empty() || blockOffset + c > blockSize) {
+         blocks.push_back(cl::Buffer(context, flags, blockSize));
+         blockOffset = 0;
+         reserved += blockSize;
+      }
+      // Sub-buffers inherit the host pointer flags of their block and
+      // reject them if given again, so only pass the access flags
+      cl_buffer_region region = {blockOffset, c};
+      buffer = blocks.back().createSubBuffer(flags &
+            (CL_MEM_READ_WRITE | CL_MEM_READ_ONLY | CL_MEM_WRITE_ONLY),
+            CL_BUFFER_CREATE_TYPE_REGION, &region);
+      blockOffset += c;
+   }
+
+   inUse[buffer()] = c;
+   inUseBytes += c;
+   return buffer;
+}
+
+void DevicePool::release(const cl::Buffer& buffer) {
+   std::lock_guard<std::mutex> guard(lock);
+   std::map<cl_mem, size_t>::iterator it = inUse.find(buffer());
+   if(it == inUse.end())
+      return;
+
+   freeLists[it->second].push_back(buffer);
+   inUseBytes -= it->second;
+   inUse.erase(it);
+}
@@ -0,0 +1,57 @@
+#ifndef DEVICE_POOL_H
+#define DEVICE_POOL_H
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+#ifdef MAC
+#include <OpenCL/cl.hpp>
+#else
+#include <CL/cl.hpp>
+#endif
+
+// Hands out sub-buffers of a few large backing buffers. Requests are
+// rounded up to a power-of-two size class, and released sub-buffers are
+// kept on a free list per class for the next request of that class.
+// Sub-buffer origins are aligned to CL_DEVICE_MEM_BASE_ADDR_ALIGN.
+// Recycled sub-buffers keep whatever the previous job left in them.
+class DevicePool {
+public:
+   DevicePool(const cl::Context& context, const cl::Device& device,
+         cl_mem_flags flags = CL_MEM_READ_WRITE,
+         size_t blockSize = 64*1024*1024);
+
+   // A buffer of at least size bytes
+   cl::Buffer acquire(size_t size);
+
+   // Return a buffer from acquire() to the pool. The next acquire() may
+   // hand it out at once. On a single in-order queue the new owner's
+   // commands run after the old ones, but with several queues, only call
+   // release() once the commands using the buffer are complete
+   void release(const cl::Buffer& buffer);
+
+   size_t bytesReserved() const { return reserved; }
+   size_t bytesInUse() const { return inUseBytes; }
+   size_t blockCount() const { return blocks.size(); }
+
+private:
+   size_t classSize(size_t size) const;
+
+   cl::Context context;
+   cl_mem_flags flags;
+   size_t blockSize, alignment;
+
+   // Backing buffers, and the next free offset in the last one
+   std::vector<cl::Buffer> blocks;
+   size_t blockOffset;
+
+   // Free sub-buffers by class size, and the class of each buffer out
+   std::map<size_t, std::vector<cl::Buffer> > freeLists;
+   std::map<cl_mem, size_t> inUse;
+   size_t reserved, inUseBytes;
+
+   std::mutex lock;
+};
+
+#endif
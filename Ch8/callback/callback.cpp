@@ -4,9 +4,7 @@
 #define KERNEL_FUNC "blank"
 
 #include <cstdio>
-#include <fstream>
 #include <iostream>
-#include <iterator>
 
 #ifdef MAC
 #include <OpenCL/cl.hpp>
@@ -14,6 +12,13 @@
 #include <CL/cl.hpp>
 #endif
 
+#include "program_binary.h"
+
+// The kernels compiled for this machine by the Makefile
+#ifdef PRECOMPILED
+#include "callback_binaries.h"
+#endif
+
 void CL_CALLBACK checkData(cl_event event, cl_int status, void* data) {
 
    int i;
@@ -53,13 +58,8 @@ int main(void) {
       cl::Context context(devices);
       
       // Create kernel
-      std::ifstream programFile(PROGRAM_FILE);
-      std::string programString(std::istreambuf_iterator<char>(programFile),
-            (std::istreambuf_iterator<char>()));
-      cl::Program::Sources source(1, std::make_pair(programString.c_str(),
-            programString.length()+1));
-      cl::Program program(context, source);
-      program.build(devices);
+      cl::Program program(program_load(context(), devices[0](),
+            PROGRAM_IMAGE(blank), PROGRAM_FILE, NULL, NULL));
       cl::Kernel kernel(program, KERNEL_FUNC);
 
       // Create buffer and make it a kernel argument
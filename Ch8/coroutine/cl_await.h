@@ -0,0 +1,256 @@
+#ifndef CL_AWAIT_H
+#define CL_AWAIT_H
+
+#include <condition_variable>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef MAC
+#include <OpenCL/cl.hpp>
+#else
+#include <CL/cl.hpp>
+#endif
+
+// Thread pool that resumes coroutines. Event callbacks only post the
+// waiting coroutine here, so no coroutine runs on the OpenCL runtime's
+// callback thread
+class Scheduler {
+public:
+   explicit Scheduler(unsigned numThreads = std::thread::hardware_concurrency())
+         : stopping(false) {
+      if(numThreads == 0)
+         numThreads = 1;
+      for(unsigned i=0; i<numThreads; i++)
+         threads.push_back(std::thread(&Scheduler::run, this));
+   }
+
+   ~Scheduler() {
+      {
+         std::lock_guard<std::mutex> guard(lock);
+         stopping = true;
+      }
+      ready.notify_all();
+      for(size_t i=0; i<threads.size(); i++)
+         threads[i].join();
+   }
+
+   void post(std::coroutine_handle<> handle) {
+      {
+         std::lock_guard<std::mutex> guard(lock);
+         handles.push_back(handle);
+      }
+      ready.notify_one();
+   }
+
+private:
+   void run() {
+      for(;;) {
+         std::coroutine_handle<> handle;
+         {
+            std::unique_lock<std::mutex> guard(lock);
+            ready.wait(guard, [this] { return stopping || !handles.empty(); });
+            if(handles.empty())
+               return;
+            handle = handles.front();
+            handles.pop_front();
+         }
+         handle.resume();
+      }
+   }
+
+   std::mutex lock;
+   std::condition_variable ready;
+   std::deque<std::coroutine_handle<> > handles;
+   bool stopping;
+   std::vector<std::thread> threads;
+};
+
+// co_await on an enqueued command. Resumes on the scheduler once the
+// event completes, and throws cl::Error if the command failed
+class EventAwaiter {
+public:
+   EventAwaiter(const cl::Event& event, Scheduler& scheduler)
+         : event(event), scheduler(&scheduler) {}
+
+   bool await_ready() {
+      return event.getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>() == CL_COMPLETE;
+   }
+
+   // The callback may resume the coroutine before this returns, so
+   // nothing here touches the awaiter after setCallback
+   void await_suspend(std::coroutine_handle<> h) {
+      handle = h;
+      event.setCallback(CL_COMPLETE, &EventAwaiter::complete, this);
+   }
+
+   cl::Event await_resume() {
+      cl_int status = event.getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>();
+      if(status < 0)
+         throw cl::Error(status, "co_await");
+      return event;
+   }
+
+private:
+   static void CL_CALLBACK complete(cl_event e, cl_int status, void *data) {
+      EventAwaiter *awaiter = static_cast<EventAwaiter*>(data);
+      awaiter->scheduler->post(awaiter->handle);
+   }
+
+   cl::Event event;
+   Scheduler *scheduler;
+   std::coroutine_handle<> handle;
+};
+
+// A command queue whose enqueue functions return awaiters. Each command
+// is flushed so it starts without a later finish(). Arguments of a
+// cl::Kernel shared between coroutines must be set and enqueued under
+// the caller's own lock; a kernel per coroutine avoids that
+class AsyncQueue {
+public:
+   AsyncQueue(const cl::CommandQueue& queue, Scheduler& scheduler)
+         : queue(queue), scheduler(&scheduler) {}
+
+   EventAwaiter enqueue(const cl::Kernel& kernel, const cl::NDRange& global,
+         const cl::NDRange& local = cl::NullRange) {
+      cl::Event event;
+      queue.enqueueNDRangeKernel(kernel, cl::NullRange, global, local,
+            NULL, &event);
+      queue.flush();
+      return EventAwaiter(event, *scheduler);
+   }
+
+   EventAwaiter read(const cl::Buffer& buffer, size_t offset, size_t size,
+         void *ptr) {
+      cl::Event event;
+      queue.enqueueReadBuffer(buffer, CL_FALSE, offset, size, ptr,
+            NULL, &event);
+      queue.flush();
+      return EventAwaiter(event, *scheduler);
+   }
+
+   EventAwaiter write(const cl::Buffer& buffer, size_t offset, size_t size,
+         const void *ptr) {
+      cl::Event event;
+      queue.enqueueWriteBuffer(buffer, CL_FALSE, offset, size, ptr,
+            NULL, &event);
+      queue.flush();
+      return EventAwaiter(event, *scheduler);
+   }
+
+   EventAwaiter copy(const cl::Buffer& src, const cl::Buffer& dst,
+         size_t srcOffset, size_t dstOffset, size_t size) {
+      cl::Event event;
+      queue.enqueueCopyBuffer(src, dst, srcOffset, dstOffset, size,
+            NULL, &event);
+      queue.flush();
+      return EventAwaiter(event, *scheduler);
+   }
+
+   cl::CommandQueue& get() { return queue; }
+
+private:
+   cl::CommandQueue queue;
+   Scheduler *scheduler;
+};
+
+// Coroutine return type. The body starts running immediately. Another
+// coroutine can co_await a Task, and plain host code can wait() for it.
+// The destructor waits, so a Task never outlives its work
+class Task {
+public:
+   struct promise_type {
+      std::mutex lock;
+      std::condition_variable finished;
+      bool done = false;
+      std::coroutine_handle<> continuation;
+      std::exception_ptr error;
+
+      Task get_return_object() {
+         return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+      }
+      std::suspend_never initial_suspend() noexcept { return {}; }
+
+      // Mark the task done and hand control to an awaiting coroutine.
+      // The frame may be destroyed as soon as the lock is released
+      struct FinalAwaiter {
+         bool await_ready() noexcept { return false; }
+         std::coroutine_handle<> await_suspend(
+               std::coroutine_handle<promise_type> h) noexcept {
+            promise_type& p = h.promise();
+            std::coroutine_handle<> next;
+            {
+               std::lock_guard<std::mutex> guard(p.lock);
+               p.done = true;
+               next = p.continuation;
+               p.finished.notify_all();
+            }
+            return next ? next : std::noop_coroutine();
+         }
+         void await_resume() noexcept {}
+      };
+      FinalAwaiter final_suspend() noexcept { return {}; }
+
+      void return_void() {}
+      void unhandled_exception() { error = std::current_exception(); }
+   };
+
+   Task(Task&& other) noexcept : handle(other.handle) { other.handle = nullptr; }
+   Task(const Task&) = delete;
+   Task& operator=(const Task&) = delete;
+
+   ~Task() {
+      if(handle) {
+         block();
+         handle.destroy();
+      }
+   }
+
+   // Block the calling thread until the task is done. Rethrows its error
+   void wait() {
+      block();
+      if(handle.promise().error)
+         std::rethrow_exception(handle.promise().error);
+   }
+
+   // co_await resumes the awaiting coroutine on whichever thread
+   // finishes this task. Rethrows its error
+   struct Awaiter {
+      promise_type *p;
+
+      bool await_ready() {
+         std::lock_guard<std::mutex> guard(p->lock);
+         return p->done;
+      }
+
+      bool await_suspend(std::coroutine_handle<> h) {
+         std::lock_guard<std::mutex> guard(p->lock);
+         if(p->done)
+            return false;
+         p->continuation = h;
+         return true;
+      }
+
+      void await_resume() {
+         if(p->error)
+            std::rethrow_exception(p->error);
+      }
+   };
+   Awaiter operator co_await() { return Awaiter{&handle.promise()}; }
+
+private:
+   explicit Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+
+   void block() {
+      promise_type& p = handle.promise();
+      std::unique_lock<std::mutex> guard(p.lock);
+      p.finished.wait(guard, [&p] { return p.done; });
+   }
+
+   std::coroutine_handle<promise_type> handle;
+};
+
+#endif
@@ -0,0 +1,4 @@
+__kernel void coroutine(__global float *data, float factor, float offset) {
+
+   data[get_global_id(0)] = data[get_global_id(0)] * factor + offset;
+}
@@ -0,0 +1,116 @@
+#define __CL_ENABLE_EXCEPTIONS
+#define __NO_STD_VECTOR
+#define PROGRAM_FILE "coroutine.cl"
+#define KERNEL_FUNC "coroutine"
+
+#define NUM_JOBS 256
+#define NUM_FLOATS 65536
+#define NUM_THREADS 4
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "cl_await.h"
+#include "program_binary.h"
+
+// The kernels compiled for this machine by the Makefile
+#ifdef PRECOMPILED
+#include "coroutine_binaries.h"
+#endif
+
+// One job: upload, scale and offset on the device, download, check.
+// The coroutine suspends at each co_await instead of blocking a thread,
+// and resumes on a scheduler thread when the command completes
+static Task runJob(cl::Context& context, cl::Program& program,
+      AsyncQueue& queue, int job, std::atomic<int>& failures) {
+
+   std::vector<float> data(NUM_FLOATS);
+   for(int i=0; i<NUM_FLOATS; i++)
+      data[i] = (float)i;
+
+   // A kernel per job, so no other coroutine changes its arguments
+   cl::Buffer buffer(context, CL_MEM_READ_WRITE, NUM_FLOATS * sizeof(float));
+   cl::Kernel kernel(program, KERNEL_FUNC);
+   kernel.setArg(0, buffer);
+   kernel.setArg(1, 2.0f);
+   kernel.setArg(2, (float)job);
+
+   co_await queue.write(buffer, 0, NUM_FLOATS * sizeof(float), &data[0]);
+   co_await queue.enqueue(kernel, cl::NDRange(NUM_FLOATS));
+   co_await queue.read(buffer, 0, NUM_FLOATS * sizeof(float), &data[0]);
+
+   for(int i=0; i<NUM_FLOATS; i++) {
+      if(data[i] != 2.0f * i + job) {
+         failures++;
+         break;
+      }
+   }
+}
+
+// A coroutine can await other coroutines as well as events
+static Task runBatch(cl::Context& context, cl::Program& program,
+      AsyncQueue& queue, int first, int count, std::atomic<int>& failures) {
+
+   std::vector<Task> jobs;
+   jobs.reserve(count);
+   for(int job=first; job<first+count; job++)
+      jobs.push_back(runJob(context, program, queue, job, failures));
+   for(size_t i=0; i<jobs.size(); i++)
+      co_await jobs[i];
+}
+
+int main(void) {
+
+   cl::vector<cl::Platform> platforms;
+   cl::vector<cl::Device> devices;
+   std::atomic<int> failures(0);
+
+   try {
+      // Place the GPU devices of the first platform into a context,
+      // or its CPU devices if it has no GPU
+      cl::Platform::get(&platforms);
+      try {
+         platforms[0].getDevices(CL_DEVICE_TYPE_GPU, &devices);
+      }
+      catch(cl::Error e) {
+         platforms[0].getDevices(CL_DEVICE_TYPE_CPU, &devices);
+      }
+      cl::Context context(devices);
+
+      // Build program
+      cl::Program program(program_load(context(), devices[0](),
+            PROGRAM_IMAGE(coroutine), PROGRAM_FILE, NULL, NULL));
+
+      // The scheduler is declared first so it outlives every coroutine
+      Scheduler scheduler(NUM_THREADS);
+      AsyncQueue queue(cl::CommandQueue(context, devices[0]), scheduler);
+
+      // Start every job in four batches, then wait on the main thread
+      std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+      std::vector<Task> batches;
+      for(int b=0; b<4; b++)
+         batches.push_back(runBatch(context, program, queue,
+               b * NUM_JOBS/4, NUM_JOBS/4, failures));
+      for(size_t i=0; i<batches.size(); i++)
+         batches[i].wait();
+      std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+      std::cout << NUM_JOBS << " concurrent jobs on " << NUM_THREADS
+            << " scheduler threads: " << elapsed.count() * 1.0e3
+            << " ms" << std::endl;
+
+      if(failures == 0)
+         std::cout << "Check passed." << std::endl;
+      else
+         std::cout << "Check failed." << std::endl;
+   }
+   catch(cl::Error e) {
+      std::cout << e.what() << ": Error code " << e.err() << std::endl;
+   }
+
+   return 0;
+}
@@ -1,9 +1,7 @@
 #define __CL_ENABLE_EXCEPTIONS
 #define __NO_STD_VECTOR
 
-#include <fstream>
 #include <iostream>
-#include <iterator>
 
 #ifdef MAC
 #include <OpenCL/cl.hpp>
@@ -11,6 +9,13 @@
 #include <CL/cl.hpp>
 #endif
 
+#include "program_binary.h"
+
+// The kernels compiled for this machine by the Makefile
+#ifdef PRECOMPILED
+#include "create_kernels_binaries.h"
+#endif
+
 int main(void) {
    
    cl::vector<cl::Platform> platforms;
@@ -25,13 +30,8 @@ int main(void) {
       cl::Context context(devices);
       
       // Create and build program
-      std::ifstream programFile("kernels.cl");
-      std::string programString(std::istreambuf_iterator<char>(programFile),
-            (std::istreambuf_iterator<char>()));
-      cl::Program::Sources source(1, std::make_pair(programString.c_str(),
-            programString.length()+1));
-      cl::Program program(context, source);
-      program.build(devices);
+      cl::Program program(program_load(context(), devices[0](),
+            PROGRAM_IMAGE(kernels), "kernels.cl", NULL, NULL));
 
       // Create individual kernels
       cl::Kernel addKernel(program, "add");
@@ -3,9 +3,7 @@
 #define PROGRAM_FILE "sub_buffer.cl"
 #define KERNEL_FUNC "sub_buffer"
 
-#include <fstream>
 #include <iostream>
-#include <iterator>
 
 #ifdef MAC
 #include <OpenCL/cl.hpp>
@@ -13,6 +11,13 @@
 #include <CL/cl.hpp>
 #endif
 
+#include "program_binary.h"
+
+// The kernels compiled for this machine by the Makefile
+#ifdef PRECOMPILED
+#include "sub_buffer_binaries.h"
+#endif
+
 int main(void) {
    
    cl::vector<cl::Platform> platforms;
@@ -29,13 +34,8 @@ int main(void) {
       cl::Context context(devices);
       
       // Create kernel
-      std::ifstream programFile(PROGRAM_FILE);
-      std::string programString(std::istreambuf_iterator<char>(programFile),
-            (std::istreambuf_iterator<char>()));
-      cl::Program::Sources source(1, std::make_pair(programString.c_str(),
-            programString.length()+1));
-      cl::Program program(context, source);
-      program.build(devices);
+      cl::Program program(program_load(context(), devices[0](),
+            PROGRAM_IMAGE(sub_buffer), PROGRAM_FILE, NULL, NULL));
       cl::Kernel kernel(program, KERNEL_FUNC);
 
       // Create main buffer and make it the kernel's first argument
@@ -0,0 +1,31 @@
+"""The book's sort, reduce, scan, FFT, sparse solver and filter engines
+for PyOpenCL.
+
+Every function takes a pyopencl CommandQueue, so the caller's context and
+queue are shared, and data as a numpy array, any object with the buffer
+protocol or a pyopencl.array.Array. Host arrays aren't copied: they're
+wrapped with USE_HOST_PTR, which devices that share host memory use in
+place, and mapped once the kernels are done so the results are visible
+in the array.
+
+   import pyopencl as cl
+   import numpy
+   import oclia
+
+   context = cl.create_some_context()
+   queue = cl.CommandQueue(context)
+   data = numpy.random.rand(1 << 20).astype(numpy.float32)
+   total = oclia.reduce(queue, data)
+   oclia.sort(queue, data)
+
+The kernels are read from the book's example directories. Set OCLIA_ROOT
+if the package is moved out of the tree.
+"""
+
+from .templates import reduce, scan, sort
+from .fft import fft, ifft
+from .sparse import SparseMatrix, spmv, conj_grad
+from .filters import filter2d
+
+__all__ = ['reduce', 'scan', 'sort', 'fft', 'ifft', 'SparseMatrix', 'spmv',
+      'conj_grad', 'filter2d']
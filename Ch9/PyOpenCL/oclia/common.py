@@ -0,0 +1,89 @@
+import os
+import numpy
+import pyopencl as cl
+import pyopencl.array as cl_array
+
+# Top of the book's examples, where the kernels are found
+ROOT = os.environ.get('OCLIA_ROOT', os.path.join(
+      os.path.dirname(os.path.abspath(__file__)), '..', '..', '..'))
+
+# Programs are built once per context, device, source and options
+_programs = {}
+
+def source_path(*parts):
+   return os.path.join(ROOT, *parts)
+
+def build(queue, path, options=''):
+   """Build the program in path for the queue's device. Prints the build
+   log and raises if it doesn't build"""
+   key = (queue.context.int_ptr, queue.device.int_ptr, path, options)
+   program = _programs.get(key)
+   if program is not None:
+      return program
+
+   program_file = open(path, 'r')
+   program_text = program_file.read()
+   program_file.close()
+   program = cl.Program(queue.context, program_text)
+   try:
+      program.build(options=options, devices=[queue.device])
+   except cl.Error:
+      print("Build log:")
+      print(program.get_build_info(queue.device,
+            cl.program_build_info.LOG))
+      raise
+   _programs[key] = program
+   return program
+
+def max_group_size(queue, kernels, limit=256):
+   """Largest power of two, up to limit, that every kernel accepts"""
+   size = limit
+   for kernel in kernels:
+      max_size = kernel.get_work_group_info(
+            cl.kernel_work_group_info.WORK_GROUP_SIZE, queue.device)
+      while size > max_size:
+         size //= 2
+   return size
+
+def has_extension(queue, name):
+   return name in queue.device.extensions.split()
+
+class DeviceData(object):
+   """A numpy array, buffer-protocol object or pyopencl Array seen by the
+   kernels as a buffer. Host data is used in place through USE_HOST_PTR,
+   and finish() makes the kernels' results visible in it"""
+
+   def __init__(self, queue, data, dtypes=None):
+      if isinstance(data, cl_array.Array):
+         if data.offset != 0 or not data.flags.c_contiguous:
+            raise ValueError("Arrays must be contiguous and start their "
+                  "buffer")
+         self.host = None
+         self.buffer = data.data
+         self.dtype = data.dtype
+         self.shape = data.shape
+      else:
+         self.host = numpy.asarray(data)
+         if not self.host.flags.c_contiguous:
+            raise ValueError("Arrays must be contiguous: use "
+                  "numpy.ascontiguousarray")
+         self.buffer = None
+         if self.host.size > 0:
+            self.buffer = cl.Buffer(queue.context,
+                  cl.mem_flags.READ_WRITE | cl.mem_flags.USE_HOST_PTR,
+                  hostbuf=self.host)
+         self.dtype = self.host.dtype
+         self.shape = self.host.shape
+      if dtypes is not None and self.dtype not in dtypes:
+         raise TypeError("Unsupported element type %s" % self.dtype)
+      self.size = int(numpy.prod(self.shape))
+
+   def finish(self, queue):
+      """Wait for the kernels and bring host data up to date. Devices
+      that work in host memory map it without copying"""
+      if self.host is None or self.size == 0:
+         return
+      mapped, event = cl.enqueue_map_buffer(queue, self.buffer,
+            cl.map_flags.READ, 0, self.shape, self.dtype)
+      event.wait()
+      mapped.base.release(queue)
@@ -0,0 +1,55 @@
+import numpy
+import pyopencl as cl
+
+from .common import source_path, build, DeviceData
+
+FFT_FILE = source_path('Ch14', 'fft', 'fft.cl')
+
+# fft.cl includes the device library's header from Ch2/program_link
+DEVICE_LIB_OPTION = '-I' + source_path('Ch2', 'program_link')
+
+def _transform(queue, data, direction):
+   data = DeviceData(queue, data, (numpy.dtype(numpy.complex64),))
+   num_points = data.size
+   if num_points < 4 or num_points & (num_points - 1):
+      raise ValueError("FFTs need a power of two points, at least 4")
+   program = build(queue, FFT_FILE, DEVICE_LIB_OPTION)
+   init_kernel = cl.Kernel(program, 'fft_init')
+   stage_kernel = cl.Kernel(program, 'fft_stage')
+   scale_kernel = cl.Kernel(program, 'fft_scale')
+
+   # Each group transforms as many points as local memory holds and each
+   # work-item at least four of them, as in fft.c
+   local_size = init_kernel.get_work_group_info(
+         cl.kernel_work_group_info.WORK_GROUP_SIZE, queue.device)
+   local_size = 1 << (local_size.bit_length() - 1)
+   points_per_group = min(queue.device.local_mem_size//8, num_points)
+   points_per_group = 1 << (points_per_group.bit_length() - 1)
+   while local_size > 1 and points_per_group//local_size < 4:
+      local_size //= 2
+   global_size = (num_points//points_per_group * local_size,)
+   local = (local_size,)
+
+   init_kernel(queue, global_size, local, data.buffer,
+         cl.LocalMemory(points_per_group * 8), numpy.uint32(points_per_group),
+         numpy.uint32(num_points), numpy.int32(direction))
+   stage = 2
+   while stage <= num_points//points_per_group:
+      stage_kernel(queue, global_size, local, data.buffer,
+            numpy.uint32(stage), numpy.uint32(points_per_group),
+            numpy.int32(direction))
+      stage *= 2
+   if direction < 0:
+      scale_kernel(queue, global_size, local, data.buffer,
+            numpy.uint32(points_per_group), numpy.uint32(num_points))
+   data.finish(queue)
+
+def fft(queue, data):
+   """Forward FFT of complex64 data in place, with numpy.fft's sign
+   convention. The size must be a power of two"""
+   _transform(queue, data, 1)
+
+def ifft(queue, data):
+   """Inverse FFT of complex64 data in place, scaled by 1/n like
+   numpy.fft.ifft"""
+   _transform(queue, data, -1)
@@ -0,0 +1,145 @@
+import numpy
+import pyopencl as cl
+import pyopencl.array as cl_array
+
+from .common import source_path, build, max_group_size, DeviceData
+
+# The kernels of Ch16/filter_engine, chosen the way filter.c chooses them
+FILTER_FILE = source_path('Ch16', 'filter_engine', 'filter_engine.cl')
+
+TYPE_OPTIONS = {
+   numpy.dtype(numpy.uint8): '-DPIXEL=uchar -DPIXEL_UCHAR',
+   numpy.dtype(numpy.uint16): '-DPIXEL=ushort -DPIXEL_USHORT',
+   numpy.dtype(numpy.float32): '-DPIXEL=float -DPIXEL_FLOAT'
+}
+
+def separable(coeffs):
+   """The column and row whose outer product is coeffs, or None"""
+   pj, pi = numpy.unravel_index(numpy.argmax(numpy.abs(coeffs)),
+         coeffs.shape)
+   pivot = coeffs[pj, pi]
+   if pivot == 0.0:
+      return None
+   col = coeffs[:, pi].copy()
+   row = coeffs[pj, :]/pivot
+   if numpy.any(numpy.abs(coeffs - numpy.outer(col, row)) >
+         1.0e-5 * abs(pivot)):
+      return None
+   return col, row
+
+def _enqueue_2d(queue, kernel, local_size, width, height, *args):
+   global_size = ((width + local_size[0] - 1)//local_size[0] * local_size[0],
+         (height + local_size[1] - 1)//local_size[1] * local_size[1])
+   kernel(queue, global_size, local_size, *args)
+
+def _enqueue_pass(queue, kernel, local_size, local_bytes, width, height,
+      src, dst, coeffs):
+   """One horizontal or vertical pass of len(coeffs) coefficients, with
+   the arguments filter.c's enqueue_pass sets"""
+   coeff_buffer = cl.Buffer(queue.context,
+         cl.mem_flags.READ_ONLY | cl.mem_flags.COPY_HOST_PTR,
+         hostbuf=numpy.ascontiguousarray(coeffs, dtype=numpy.float32))
+   _enqueue_2d(queue, kernel, tuple(local_size), width, height,
+         src, dst, coeff_buffer, numpy.int32(len(coeffs)),
+         numpy.int32(len(coeffs)//2), numpy.int32(width),
+         numpy.int32(height), cl.LocalMemory(local_bytes))
+
+def filter2d(queue, src, coeffs, dst=None):
+   """Filter a height x width image of uint8, uint16 or float32 with a
+   kh x kw array of coefficients, centered at (kh//2, kw//2) with edges
+   clamped. dst is allocated if it isn't given and is returned"""
+   coeffs = numpy.ascontiguousarray(coeffs, dtype=numpy.float32)
+   if coeffs.ndim != 2:
+      raise ValueError("Coefficients must be two-dimensional")
+   if dst is None:
+      if isinstance(src, cl_array.Array):
+         dst = cl_array.empty_like(src)
+      else:
+         dst = numpy.empty_like(src)
+   if dst is src:
+      raise ValueError("Images can't be filtered in place")
+   src_data = DeviceData(queue, src, TYPE_OPTIONS)
+   dst_data = DeviceData(queue, dst, (src_data.dtype,))
+   if len(src_data.shape) != 2 or dst_data.shape != src_data.shape:
+      raise ValueError("Images must be two-dimensional and the same size")
+   height, width = src_data.shape
+   kh, kw = coeffs.shape
+   if src_data.size == 0:
+      return dst
+
+   program = build(queue, FILTER_FILE, TYPE_OPTIONS[src_data.dtype])
+   rows = cl.Kernel(program, 'filter_rows')
+   cols = cl.Kernel(program, 'filter_cols')
+   row_only = cl.Kernel(program, 'filter_row_only')
+   col_only = cl.Kernel(program, 'filter_col_only')
+   tiled = cl.Kernel(program, 'filter_tiled')
+   direct = cl.Kernel(program, 'filter_direct')
+   local_mem_size = queue.device.local_mem_size
+   w, h = numpy.int32(width), numpy.int32(height)
+
+   # Start from 16x16 and shrink to fit the device
+   max_size = max_group_size(queue, [rows, cols, row_only, col_only,
+         tiled])
+   local_size = [16, 16]
+   while local_size[0] * local_size[1] > max_size:
+      if local_size[1] >= local_size[0]:
+         local_size[1] //= 2
+      else:
+         local_size[0] //= 2
+
+   # A single row or column needs no factoring
+   if kh == 1 or kw == 1:
+      factors = (coeffs[:, 0], coeffs[0, :])
+   else:
+      factors = separable(coeffs)
+
+   # Narrow the work-group across the filter direction if the tile and
+   # its halo won't fit in local memory
+   row_local = list(local_size)
+   col_local = list(local_size)
+   while row_local[1] > 1 and \
+         row_local[1] * (row_local[0] + kw - 1) * 4 > local_mem_size:
+      row_local[1] //= 2
+   while col_local[0] > 1 and \
+         col_local[0] * (col_local[1] + kh - 1) * 4 > local_mem_size:
+      col_local[0] //= 2
+   row_bytes = row_local[1] * (row_local[0] + kw - 1) * 4
+   col_bytes = col_local[0] * (col_local[1] + kh - 1) * 4
+   if row_bytes > local_mem_size or col_bytes > local_mem_size:
+      factors = None
+
+   if factors is not None and kh == 1:
+
+      # Horizontal pass straight into dst
+      _enqueue_pass(queue, row_only, row_local, row_bytes, width, height,
+            src_data.buffer, dst_data.buffer, factors[1])
+   elif factors is not None and kw == 1:
+
+      # Vertical pass straight into dst
+      _enqueue_pass(queue, col_only, col_local, col_bytes, width, height,
+            src_data.buffer, dst_data.buffer, factors[0])
+   elif factors is not None:
+      col, row = factors
+      tmp = cl.Buffer(queue.context, cl.mem_flags.READ_WRITE,
+            width * height * 4)
+      _enqueue_pass(queue, rows, row_local, row_bytes, width, height,
+            src_data.buffer, tmp, row)
+      _enqueue_pass(queue, cols, col_local, col_bytes, width, height,
+            tmp, dst_data.buffer, col)
+   else:
+
+      # The tiled kernel if the tile fits in local memory
+      coeff_buffer = cl.Buffer(queue.context,
+            cl.mem_flags.READ_ONLY | cl.mem_flags.COPY_HOST_PTR,
+            hostbuf=coeffs)
+      tile_size = (local_size[0] + kw - 1) * (local_size[1] + kh - 1) * 4
+      args = [src_data.buffer, dst_data.buffer, coeff_buffer,
+            numpy.int32(kw), numpy.int32(kh), w, h]
+      if tile_size <= local_mem_size:
+         _enqueue_2d(queue, tiled, tuple(local_size), width, height,
+               *(args + [cl.LocalMemory(tile_size)]))
+      else:
+         _enqueue_2d(queue, direct, tuple(local_size), width, height, *args)
+
+   dst_data.finish(queue)
+   return dst
@@ -0,0 +1,78 @@
+/* Sparse matrix-vector product and the vector operations of the
+   conjugate gradient method. Unlike Ch13/conj_grad, which solves the
+   system in one work-group, the host runs the iterations, so systems
+   can have any number of rows */
+
+/* With HALF_STORAGE the matrix coefficients are stored as half, which
+   vload_half reads without cl_khr_fp16. The vectors stay float */
+#ifdef HALF_STORAGE
+typedef half storage_t;
+#define LOAD(p, i) vload_half(i, p)
+#else
+typedef float storage_t;
+#define LOAD(p, i) (p)[i]
+#endif
+
+/* y = A*x for a CSR matrix, one row per work-item */
+__kernel void spmv_csr(__global const int *row_start,
+      __global const int *cols, __global const storage_t *values,
+      __global const float *x, __global float *y, int num_rows) {
+
+   int row = get_global_id(0);
+   float sum = 0.0f;
+
+   if(row >= num_rows)
+      return;
+   for(int i=row_start[row]; i<row_start[row+1]; i++) {
+      sum += LOAD(values, i) * x[cols[i]];
+   }
+   y[row] = sum;
+}
+
+/* Each work-group writes its part of the dot product of a and b */
+__kernel void dot(__global const float *a, __global const float *b, int n,
+      __local float *partial_sums, __global float *output) {
+
+   int lid = get_local_id(0);
+   float sum = 0.0f;
+
+   for(int i=get_global_id(0); i<n; i+=get_global_size(0)) {
+      sum += a[i] * b[i];
+   }
+   partial_sums[lid] = sum;
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   for(int i = get_local_size(0)/2; i>0; i >>= 1) {
+      if(lid < i) {
+         partial_sums[lid] += partial_sums[lid + i];
+      }
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+   if(lid == 0) {
+      output[get_group_id(0)] = partial_sums[0];
+   }
+}
+
+/* The next guess and residual: x += alpha*p, r -= alpha*Ap */
+__kernel void cg_step(__global float *x, __global float *r,
+      __global const float *p, __global const float *A_times_p,
+      float alpha, int n) {
+
+   int i = get_global_id(0);
+
+   if(i < n) {
+      x[i] += alpha * p[i];
+      r[i] -= alpha * A_times_p[i];
+   }
+}
+
+/* The next direction: p = r + beta*p */
+__kernel void cg_direction(__global float *p, __global const float *r,
+      float beta, int n) {
+
+   int i = get_global_id(0);
+
+   if(i < n) {
+      p[i] = r[i] + beta * p[i];
+   }
+}
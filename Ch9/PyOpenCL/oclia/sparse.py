@@ -0,0 +1,140 @@
+import math
+import os
+import numpy
+import pyopencl as cl
+
+from .common import build, max_group_size, DeviceData
+
+SPARSE_FILE = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+      'sparse.cl')
+
+FLOAT = (numpy.dtype(numpy.float32),)
+
+class SparseMatrix(object):
+   """A float matrix in compressed sparse row form, copied to the device
+   once and reused by every product"""
+
+   def __init__(self, queue, row_start, cols, values, num_cols=None):
+      row_start = numpy.ascontiguousarray(row_start, dtype=numpy.int32)
+      cols = numpy.ascontiguousarray(cols, dtype=numpy.int32)
+      values = numpy.ascontiguousarray(values, dtype=numpy.float32)
+      self.num_rows = len(row_start) - 1
+      self.num_cols = num_cols if num_cols is not None else self.num_rows
+      self.num_values = len(values)
+      flags = cl.mem_flags.READ_ONLY | cl.mem_flags.COPY_HOST_PTR
+      self.row_start = cl.Buffer(queue.context, flags, hostbuf=row_start)
+      self.cols = cl.Buffer(queue.context, flags, hostbuf=cols) \
+            if len(cols) else None
+      self.values = cl.Buffer(queue.context, flags, hostbuf=values) \
+            if len(values) else None
+
+   @classmethod
+   def from_csr(cls, queue, matrix):
+      """From any CSR matrix with indptr, indices, data and shape, such as
+      scipy.sparse.csr_matrix"""
+      return cls(queue, matrix.indptr, matrix.indices, matrix.data,
+            matrix.shape[1])
+
+   @classmethod
+   def from_coo(cls, queue, rows, cols, values, shape):
+      """From zero-based coordinates, such as those of a MatrixMarket
+      file"""
+      rows = numpy.asarray(rows)
+      order = numpy.lexsort((cols, rows))
+      row_start = numpy.zeros(shape[0] + 1, dtype=numpy.int32)
+      numpy.cumsum(numpy.bincount(rows, minlength=shape[0]),
+            out=row_start[1:])
+      return cls(queue, row_start, numpy.asarray(cols)[order],
+            numpy.asarray(values)[order], shape[1])
+
+def _kernels(queue):
+   program = build(queue, SPARSE_FILE)
+   return dict((name, cl.Kernel(program, name)) for name in
+         ('spmv_csr', 'dot', 'cg_step', 'cg_direction'))
+
+def _spmv(queue, kernel, matrix, x, y):
+   local_size = max_group_size(queue, [kernel])
+   global_size = (matrix.num_rows + local_size - 1)//local_size * local_size
+   kernel(queue, (global_size,), (local_size,), matrix.row_start,
+         matrix.cols, matrix.values, x, y, numpy.int32(matrix.num_rows))
+
+def spmv(queue, matrix, x, y=None):
+   """y = matrix * x in float. y is allocated if it isn't given and is
+   returned"""
+   if y is None:
+      y = numpy.empty(matrix.num_rows, dtype=numpy.float32)
+   x_data = DeviceData(queue, x, FLOAT)
+   y_data = DeviceData(queue, y, FLOAT)
+   if x_data.size != matrix.num_cols or y_data.size != matrix.num_rows:
+      raise ValueError("Vector sizes don't match the matrix")
+   if matrix.num_rows == 0:
+      return y
+   if matrix.num_values == 0:
+      y.fill(0)
+      return y
+   _spmv(queue, _kernels(queue)['spmv_csr'], matrix, x_data.buffer,
+         y_data.buffer)
+   y_data.finish(queue)
+   return y
+
+def conj_grad(queue, matrix, b, x=None, tolerance=0.01,
+      max_iterations=1000):
+   """Solve matrix * x = b for a symmetric positive-definite matrix,
+   starting from zero. Stops, like Ch13/conj_grad, when the residual's
+   length falls below tolerance. Returns x, the number of iterations and
+   the residual's length"""
+   n = matrix.num_rows
+   if matrix.num_cols != n:
+      raise ValueError("The matrix must be square")
+   if x is None:
+      x = numpy.zeros(n, dtype=numpy.float32)
+   b_data = DeviceData(queue, b, FLOAT)
+   x_data = DeviceData(queue, x, FLOAT)
+   if b_data.size != n or x_data.size != n:
+      raise ValueError("Vector sizes don't match the matrix")
+   if n == 0 or matrix.num_values == 0:
+      x.fill(0)
+      return x, 0, 0.0
+
+   kernels = _kernels(queue)
+   local_size = max_group_size(queue, kernels.values())
+   num_groups = min((n + local_size - 1)//local_size, 64)
+   global_size = ((n + local_size - 1)//local_size * local_size,)
+   local = (local_size,)
+   size = n * 4
+   r = cl.Buffer(queue.context, cl.mem_flags.READ_WRITE, size)
+   p = cl.Buffer(queue.context, cl.mem_flags.READ_WRITE, size)
+   A_times_p = cl.Buffer(queue.context, cl.mem_flags.READ_WRITE, size)
+   partial = cl.Buffer(queue.context, cl.mem_flags.READ_WRITE,
+         num_groups * 4)
+   sums = numpy.empty(num_groups, dtype=numpy.float32)
+
+   # The partial sums of each dot product are added on the host
+   def dot(a, b):
+      kernels['dot'](queue, (num_groups * local_size,), local, a, b,
+            numpy.int32(n), cl.LocalMemory(local_size * 4), partial)
+      cl.enqueue_copy(queue, sums, partial)
+      return float(sums.sum(dtype=numpy.float64))
+
+   # x = 0, so the residual and the first direction are b
+   cl.enqueue_fill_buffer(queue, x_data.buffer, numpy.float32(0), 0, size)
+   cl.enqueue_copy(queue, r, b_data.buffer)
+   cl.enqueue_copy(queue, p, b_data.buffer)
+   old_r_dot_r = dot(r, r)
+   r_length = math.sqrt(old_r_dot_r)
+
+   iteration = 0
+   while iteration < max_iterations and r_length >= tolerance:
+      _spmv(queue, kernels['spmv_csr'], matrix, p, A_times_p)
+      alpha = old_r_dot_r/dot(A_times_p, p)
+      kernels['cg_step'](queue, global_size, local, x_data.buffer, r, p,
+            A_times_p, numpy.float32(alpha), numpy.int32(n))
+      new_r_dot_r = dot(r, r)
+      r_length = math.sqrt(new_r_dot_r)
+      kernels['cg_direction'](queue, global_size, local, p, r,
+            numpy.float32(new_r_dot_r/old_r_dot_r), numpy.int32(n))
+      old_r_dot_r = new_r_dot_r
+      iteration += 1
+
+   x_data.finish(queue)
+   return x, iteration, r_length
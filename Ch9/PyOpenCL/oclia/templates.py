@@ -0,0 +1,147 @@
+import numpy
+import pyopencl as cl
+
+from .common import source_path, build, max_group_size, has_extension, \
+      DeviceData
+
+# The templates of Ch4/templates, instantiated the way kernel_templates.c
+# does it
+TEMPLATE_DIR = source_path('Ch4', 'templates')
+
+TYPE_NAMES = {
+   numpy.dtype(numpy.int32): 'int',
+   numpy.dtype(numpy.uint32): 'uint',
+   numpy.dtype(numpy.float32): 'float',
+   numpy.dtype(numpy.float64): 'double',
+   numpy.dtype(numpy.float16): 'half'
+}
+
+KERNEL_NAMES = {
+   'reduce': ('reduce',),
+   'scan': ('scan_groups', 'scan_add'),
+   'sort': ('sort_step', 'sort_step_scalar')
+}
+
+WIDTHS = (1, 2, 4, 8, 16)
+
+# Compiled instances: (program, kernels, group size)
+_instances = {}
+
+def accumulator(dtype):
+   """Sums of half are accumulated in float"""
+   if dtype == numpy.float16:
+      return numpy.dtype(numpy.float32)
+   return numpy.dtype(dtype)
+
+def template_options(dtype, width):
+   """Build options that instantiate a template, as kt_options writes
+   them. Ch4/templates/template_prelude.h turns them into the type
+   definitions"""
+   return '-I%s -DT=%s -DACC=%s -DWIDTH=%d' % (TEMPLATE_DIR,
+         TYPE_NAMES[dtype], TYPE_NAMES[accumulator(dtype)], width)
+
+def instance(queue, algorithm, dtype, width):
+   """Find or build an instance of a template for a type and width"""
+   dtype = numpy.dtype(dtype)
+   if width not in WIDTHS:
+      raise ValueError("Templates can't be instantiated with width %d"
+            % width)
+   if dtype not in TYPE_NAMES:
+      raise TypeError("Unsupported element type %s" % dtype)
+   if (dtype == numpy.float64 and not has_extension(queue, 'cl_khr_fp64')) \
+         or (dtype == numpy.float16 and
+         not has_extension(queue, 'cl_khr_fp16')):
+      raise TypeError("The device doesn't support %s" % TYPE_NAMES[dtype])
+
+   key = (queue.context.int_ptr, queue.device.int_ptr, algorithm, dtype,
+         width)
+   inst = _instances.get(key)
+   if inst is None:
+      program = build(queue, '%s/template_%s.cl' % (TEMPLATE_DIR, algorithm),
+            template_options(dtype, width))
+      kernels = [cl.Kernel(program, name) for name in KERNEL_NAMES[algorithm]]
+      inst = (program, kernels, max_group_size(queue, kernels))
+      _instances[key] = inst
+   return inst
+
+def reduce(queue, data, width=4):
+   """Sum of the elements of data, as a numpy scalar of the accumulator
+   type. Waits for the result"""
+   data = DeviceData(queue, data, TYPE_NAMES)
+   acc = accumulator(data.dtype)
+   if data.size == 0:
+      return acc.type(0)
+   program, kernels, local_size = instance(queue, 'reduce', data.dtype,
+         width)
+   last = instance(queue, 'reduce', acc, 1)
+
+   # First pass: up to 1024 work-groups, each leaving one sum
+   num_groups = (data.size//width + local_size - 1)//local_size
+   num_groups = min(max(num_groups, 1), 1024)
+   partial = cl.Buffer(queue.context, cl.mem_flags.READ_WRITE,
+         num_groups * acc.itemsize)
+   result = cl.Buffer(queue.context, cl.mem_flags.READ_WRITE, acc.itemsize)
+   kernels[0](queue, (num_groups * local_size,), (local_size,),
+         data.buffer, numpy.uint32(data.size),
+         cl.LocalMemory(local_size * acc.itemsize), partial)
+
+   # Second pass: one work-group adds the sums
+   local_size = last[2]
+   last[1][0](queue, (local_size,), (local_size,), partial,
+         numpy.uint32(num_groups), cl.LocalMemory(local_size * acc.itemsize),
+         result)
+   total = numpy.empty(1, dtype=acc)
+   cl.enqueue_copy(queue, total, result)
+   return total[0]
+
+def _scan(queue, dtype, width, buffer, count):
+   program, kernels, local_size = instance(queue, 'scan', dtype, width)
+   num_groups = ((count + width - 1)//width + local_size - 1)//local_size
+   global_size = (num_groups * local_size,)
+   sums = cl.Buffer(queue.context, cl.mem_flags.READ_WRITE,
+         num_groups * dtype.itemsize)
+
+   # Scan within work-groups, then scan the groups' totals the same way
+   # and add them back
+   kernels[0](queue, global_size, (local_size,), buffer,
+         numpy.uint32(count), cl.LocalMemory(local_size * dtype.itemsize),
+         sums)
+   if num_groups > 1:
+      _scan(queue, dtype, width, sums, num_groups)
+      kernels[1](queue, global_size, (local_size,), buffer,
+            numpy.uint32(count), sums)
+
+def scan(queue, data, width=4):
+   """Replace the elements of data with their inclusive prefix sums.
+   half is scanned in half"""
+   data = DeviceData(queue, data, TYPE_NAMES)
+   if data.size == 0:
+      return
+   _scan(queue, data.dtype, width, data.buffer, data.size)
+   data.finish(queue)
+
+def sort(queue, data, descending=False, width=4):
+   """Sort data, whose size must be a power of two, in place"""
+   data = DeviceData(queue, data, TYPE_NAMES)
+   count = data.size
+   if count & (count - 1):
+      raise ValueError("Sorts need a power of two elements, not %d" % count)
+   if count < 2:
+      return
+   program, kernels, group_size = instance(queue, 'sort', data.dtype, width)
+
+   # Strides of at least the width compare whole vectors
+   size = 2
+   while size <= count:
+      stride = size//2
+      while stride > 0:
+         if stride >= width:
+            kernel, global_size = kernels[0], count//2//width
+         else:
+            kernel, global_size = kernels[1], count//2
+         kernel(queue, (global_size,), (min(group_size, global_size),),
+               data.buffer, numpy.uint32(size), numpy.uint32(stride),
+               numpy.int32(descending))
+         stride //= 2
+      size *= 2
+   data.finish(queue)
@@ -0,0 +1,83 @@
+import os
+import sys
+import numpy
+import pyopencl as cl
+
+# The oclia package is in the parent directory
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+      '..'))
+import oclia
+
+# Create context and command queue
+platform = cl.get_platforms()[0]
+devices = platform.get_devices()
+context = cl.Context(devices)
+queue = cl.CommandQueue(context, devices[0])
+check = True
+
+# Reduce, scan and sort numpy arrays in place
+data = numpy.random.randint(0, 100, 1 << 20).astype(numpy.int32)
+total = oclia.reduce(queue, data)
+check = check and total == data.sum()
+
+expected = numpy.cumsum(data, dtype=numpy.int32)
+oclia.scan(queue, data)
+check = check and numpy.array_equal(data, expected)
+
+values = numpy.random.rand(1 << 16).astype(numpy.float32)
+expected = numpy.sort(values)
+oclia.sort(queue, values)
+check = check and numpy.array_equal(values, expected)
+
+# FFT and inverse FFT
+signal = (numpy.random.rand(4096) +
+      1j * numpy.random.rand(4096)).astype(numpy.complex64)
+original = signal.copy()
+oclia.fft(queue, signal)
+check = check and numpy.allclose(signal, numpy.fft.fft(original),
+      rtol=1.0e-3, atol=1.0e-2)
+oclia.ifft(queue, signal)
+check = check and numpy.allclose(signal, original, rtol=1.0e-3,
+      atol=1.0e-3)
+
+# A diagonally dominant tridiagonal system, solved with CG
+n = 1000
+rows = numpy.concatenate([numpy.arange(n), numpy.arange(n-1),
+      numpy.arange(1, n)])
+cols = numpy.concatenate([numpy.arange(n), numpy.arange(1, n),
+      numpy.arange(n-1)])
+coeffs = numpy.concatenate([numpy.full(n, 4.0), numpy.full(2*(n-1), -1.0)])
+matrix = oclia.SparseMatrix.from_coo(queue, rows, cols, coeffs, (n, n))
+b = numpy.random.rand(n).astype(numpy.float32)
+x, iterations, residual = oclia.conj_grad(queue, matrix, b,
+      tolerance=1.0e-4)
+check = check and numpy.allclose(oclia.spmv(queue, matrix, x), b,
+      atol=1.0e-3)
+print("CG converged in %d iterations, residual %g" % (iterations, residual))
+
+# A 5x5 box filter, which is separable
+image = numpy.random.randint(0, 256, (480, 640)).astype(numpy.uint8)
+blurred = oclia.filter2d(queue, image,
+      numpy.full((5, 5), 1.0/25, dtype=numpy.float32))
+padded = numpy.pad(image.astype(numpy.float32), 2, mode='edge')
+expected = sum(padded[j:j+480, i:i+640] for j in range(5)
+      for i in range(5))/25
+check = check and numpy.abs(blurred - numpy.rint(expected)).max() <= 1
+
+# 1x5 and 5x1 filters, which take a single horizontal or vertical pass
+weights = numpy.array([1, 4, 6, 4, 1], dtype=numpy.float32)/16
+for shape in ((1, 5), (5, 1)):
+   blurred = oclia.filter2d(queue, image, weights.reshape(shape))
+   padded = numpy.pad(image.astype(numpy.float32),
+         ((shape[0]//2, shape[0]//2), (shape[1]//2, shape[1]//2)),
+         mode='edge')
+   if shape[0] == 1:
+      expected = sum(weights[k] * padded[:, k:k+640] for k in range(5))
+   else:
+      expected = sum(weights[k] * padded[k:k+480, :] for k in range(5))
+   check = check and numpy.abs(blurred - numpy.rint(expected)).max() <= 1
+
+if check:
+   print("Check passed.")
+else:
+   print("Check failed.")